@@ -155,9 +155,7 @@ Eventhandler{type = "tick", func = function(self, args)
 	-- Update the cursor.
 	Widgets.Cursor.inst:update()
 	-- Update built models.
-	while true do
-		local msg = Client.threads.model_builder:pop_message()
-		if not msg then break end
+	for k,msg in ipairs(Client.threads.model_builder:pop_messages()) do
 		if msg.model then
 			local obj = Object:find{id = tonumber(msg.name)}
 			if obj and obj.spec then
@@ -208,6 +206,8 @@ Eventhandler{type = "tick", func = function(self, args)
 		end
 		local vel = Client.player_object.velocity
 		if vel then Sound.listener_velocity = vel end
+		-- Terrain level of detail.
+		TilesRender.lod_center = Client.player_object.position
 		-- Refresh the active portion of the map.
 		Client.player_object:refresh()
 		-- Maintain the respawn widget.
@@ -92,4 +92,5 @@ while not Program.quit do
 	Program.profiling.update = t2 - t1
 	Program.profiling.event = t3 - t2
 	Program.profiling.render = t4 - t3
+	Program.profiling.gc = Program.gc_stats
 end
@@ -141,6 +141,8 @@ Creature.set_slot = function(self, slot, spec, count)
 end
 
 Creature.update = function(self, secs)
+	-- Retry building the model if the builder thread was busy.
+	if self.model_pending then self:update_model() end
 	-- Update slots.
 	if self.slots then
 		local species = self.spec
@@ -174,8 +176,9 @@ Creature.update_model = function(self)
 	if not self.spec.models then return end
 	if not Model.morph then return end
 	-- Build the character model in a separate thread.
-	-- The result is handled in the tick handler in event.lua.
-	Client.threads.model_builder:push_message(tostring(self.id), serialize{
+	-- The result is handled in the tick handler in event.lua. If the message
+	-- queue of the thread is full, the build is retried on the next update.
+	self.model_pending = not Client.threads.model_builder:push_message(tostring(self.id), serialize{
 		beheaded = Bitwise:bchk(self.flags or 0, Protocol.object_flags.BEHEADED),
 		body_scale = self.body_scale,
 		body_style = self.body_style,
@@ -138,5 +138,10 @@ while not Program.quit do
 	local args = assert(loadstring("return " .. msg.string))()
 	local mdl = args and build(args)
 	-- Return the model.
-	Program:push_message{name = msg.name, model = mdl}
+	-- The model is moved to avoid copying it. The queue is bounded so the
+	-- push is retried until the main thread has caught up.
+	while not Program:push_message{name = msg.name, model = mdl, move = true} do
+		Program:wait(0.02)
+		if Program.quit then return end
+	end
 end
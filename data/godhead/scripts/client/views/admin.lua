@@ -61,8 +61,12 @@ Model memory: %d kB
 Update tick: %d ms
 Event tick: %d ms
 Render tick: %d ms
+GC tick: %d ms
+GC allocated: %d kB
+GC cycles: %d
 ]], Database.memory_used / 1024, gcinfo(), Voxel.memory_used / 1024, models / 1024,
-1000 * Program.profiling.update, 1000 * Program.profiling.event, 1000 * Program.profiling.render)
+1000 * Program.profiling.update, 1000 * Program.profiling.event, 1000 * Program.profiling.render,
+1000 * Program.profiling.gc.time, Program.profiling.gc.alloc / 1024, Program.profiling.gc.cycles)
 	self.label_database:build()
 end
 
@@ -6,20 +6,26 @@ Sectors = Class()
 --   <li>database: Database.</li>
 --   <li>save_objects: False to disable saving of objects.</li>
 --   <li>save_terrain: False to disable saving of terrain.</li>
+--   <li>terrain_store: Terrain store to use instead of the terrain table.</li>
 --   <li>unload_time: Number of seconds it takes for an inactive sector to be unloaded.</li></ul>
 -- @return New sectors.
 Sectors.new = function(clss, args)
 	local self = Class.new(clss, args)
 	self.sectors = {}
+	self.loading = {}
 	self.save_objects = (self.save_objects ~= false)
 	self.save_terrain = (self.save_terrain ~= false)
 	self.unload_time = self.unload_time or 10
 	-- Use asynchronous writes for much better write performance.
-	self.database:query("PRAGMA synchronous=OFF;")
+	-- Asynchronous databases are already written in a worker thread in
+	-- the WAL mode so they don't need to give up crash safety.
+	if not self.database.async then
+		self.database:query("PRAGMA synchronous=OFF;")
+	end
 	self.database:query("PRAGMA count_changes=OFF;")
 	-- Initialize the database tables needed by us.
 	if self.save_objects then
-		self.database:query("CREATE TABLE IF NOT EXISTS objects (id INTEGER PRIMARY KEY,sector UNSIGNED INTEGER,data TEXT);");
+		self.database:query("CREATE TABLE IF NOT EXISTS objects (id INTEGER PRIMARY KEY,sector UNSIGNED INTEGER,data BLOB);");
 	end
 	if self.save_terrain then
 		self.database:query("CREATE TABLE IF NOT EXISTS terrain (sector INTEGER PRIMARY KEY,data BLOB);");
@@ -38,54 +44,137 @@ end
 Sectors.created_sector = function(self, sector, terrain, objects)
 end
 
---- Removes all sectors from the database.
+--- Removes all sectors from the database.<br/>
+-- The terrain store is erased before the database transaction is committed,
+-- in the same order as in Sectors.save_world.
 -- @param self Sectors.
 Sectors.erase_world = function(self, erase)
 	self.database:query("BEGIN TRANSACTION;")
 	if self.save_objects then self.database:query("DELETE FROM objects;") end
 	if self.save_terrain then self.database:query("DELETE FROM terrain;") end
+	if self.save_terrain and self.terrain_store then self.terrain_store:erase_all() end
 	self.database:query("END TRANSACTION;")
 end
 
---- Reads a sector from the database.
+--- Finishes the asynchronous loads of sectors synchronously.<br/>
+-- Called before saving so that sectors whose objects haven't arrived yet
+-- aren't saved without them.
+-- @param self Sectors.
+Sectors.finish_loading = function(self)
+	local loading = self.loading
+	self.loading = {}
+	for k,v in pairs(loading) do
+		self:read_sector(k, v.terrain)
+	end
+end
+
+--- Reads a sector from the database.<br/>
+-- For asynchronous databases, the rows are read by the worker thread so
+-- that the main thread doesn't need to wait for the queued object writes.
+-- The sector is then created when the rows arrive.
 -- @param self Sectors.
 -- @param sector Sector index.
 Sectors.load_sector = function(self, sector)
-	local objects = {}
 	local terrain = nil
 	-- Only load once.
 	if self.sectors[sector] then return end
 	self.sectors[sector] = true
 	-- Load terrain.
-	if self.save_terrain then
+	-- Sectors saved before the terrain store was taken into use are still
+	-- in the terrain table so it's used as a fallback.
+	if self.save_terrain and self.terrain_store then
+		terrain = self.terrain_store:load_sector(sector) or nil
+	end
+	if not self.database.async then
+		return self:read_sector(sector, terrain)
+	end
+	-- Read the rows asynchronously.
+	-- The load is abandoned if Sectors.finish_loading or Sectors.unload_world
+	-- gets to the sector before the rows arrive.
+	local loading = {terrain = terrain}
+	local rows = {}
+	local pending = 1
+	local finish = function()
+		pending = pending - 1
+		if pending > 0 or self.loading[sector] ~= loading then return end
+		self.loading[sector] = nil
+		if rows.terrain and self:read_terrain(sector, rows.terrain) then
+			terrain = true
+		end
+		local objects = {}
+		for k,v in ipairs(rows.objects or {}) do
+			self:read_object(v, objects)
+		end
+		self:created_sector(sector, terrain, objects)
+	end
+	local query = function(name, sql)
+		pending = pending + 1
+		local id = self.database:query_async(sql, {sector}, function(r, e)
+			if e then print(string.format("WARNING: Loading sector %d failed: %s", sector, e)) end
+			rows[name] = r
+			finish()
+		end)
+		if not id then finish() end
+	end
+	self.loading[sector] = loading
+	if self.save_terrain and not terrain then
+		query("terrain", "SELECT * FROM terrain WHERE sector=?;")
+	end
+	if self.save_objects then
+		query("objects", "SELECT * FROM objects WHERE sector=?;")
+	end
+	finish()
+end
+
+--- Creates an object from a row of the objects table.
+-- @param self Sectors.
+-- @param row Row of the objects table.
+-- @param objects Array to add the object to.
+Sectors.read_object = function(self, row, objects)
+	local ok,ret = pcall(Object.load, Object, {data = row[3]})
+	if not ok then
+		print(ret)
+	elseif ret then
+		ret.realized = true
+		table.insert(objects, ret)
+	end
+end
+
+--- Reads the rows of a sector synchronously.
+-- @param self Sectors.
+-- @param sector Sector index.
+-- @param terrain True if the terrain was loaded from the terrain store.
+Sectors.read_sector = function(self, sector, terrain)
+	local objects = {}
+	-- Load legacy terrain.
+	if self.save_terrain and not terrain then
 		local rows = self.database:query("SELECT * FROM terrain WHERE sector=?;", {sector})
-		if #rows ~= 0 then
-			for k,v in ipairs(rows) do
-				Voxel:paste_region{sector = sector, packet = v[2]}
-			end
+		if self:read_terrain(sector, rows) then
 			terrain = true
 		end
 	end
 	-- Load objects.
 	if self.save_objects then
-		local rows = self.database:query("SELECT * FROM objects WHERE sector=?;", {sector})
-		for k,v in ipairs(rows) do
-			local func = assert(loadstring("return function()\n" .. v[3] .. "\nend"))()
-			if func then
-				local ok,ret = pcall(func)
-				if not ok then
-					print(ret)
-				elseif ret then
-					ret.realized = true
-					table.insert(objects, ret)
-				end
-			end
+		for v in self.database:rows("SELECT * FROM objects WHERE sector=?;", {sector}) do
+			self:read_object(v, objects)
 		end
 	end
 	-- Load custom content.
 	self:created_sector(sector, terrain, objects)
 end
 
+--- Pastes the rows of the legacy terrain table.
+-- @param self Sectors.
+-- @param sector Sector index.
+-- @param rows Rows of the terrain table.
+-- @return True if there were any rows.
+Sectors.read_terrain = function(self, sector, rows)
+	for k,v in ipairs(rows) do
+		Voxel:paste_region{sector = sector, packet = v[2]}
+	end
+	return #rows ~= 0
+end
+
 --- Saves a sector to the database.
 -- @param self Sectors.
 -- @param sector Sector index.
@@ -101,23 +190,45 @@ Sectors.save_sector = function(self, sector)
 		end
 	end
 	-- Write terrain.
-	if self.save_terrain then
+	-- The legacy row is only deleted once the store has the sector. If the
+	-- store fails, the sector is written to the terrain table instead and
+	-- removed from the store so that the older copy there isn't loaded.
+	if self.save_terrain and self.terrain_store and self.terrain_store:save_sector(sector) then
+		self.database:query("DELETE FROM terrain WHERE sector=?;", {sector})
+	elseif self.save_terrain then
+		if self.terrain_store then
+			print(string.format("WARNING: Saving sector %d to the terrain store failed", sector))
+			self.terrain_store:erase_sector(sector)
+		end
 		self.database:query("DELETE FROM terrain WHERE sector=?;", {sector})
 		local data = Voxel:copy_region{sector = sector}
 		self.database:query("INSERT INTO terrain (sector,data) VALUES (?,?);", {sector, data})
 	end
 end
 
---- Saves all active sectors to the database.
+--- Saves all active sectors to the database.<br/>
+-- The terrain store can't take part in the database transaction, so its
+-- writes are collected to a batch that is committed just before the
+-- transaction. The region files are then synced once per save instead of
+-- once per sector. If the program crashes before the database commit, the
+-- new terrain is loaded with the objects of the previous save. Committing
+-- in the other order could instead lose sectors whose legacy terrain rows
+-- are deleted by the transaction. If the terrain can't be committed, the
+-- transaction is rolled back.
 -- @param self Sectors.
 -- @param erase True to completely erase the old map.
 -- @param progress Progress callback.
+-- @return True on success.
 Sectors.save_world = function(self, erase, progress)
+	local store = self.save_terrain and self.terrain_store
+	self:finish_loading()
 	self.database:query("BEGIN TRANSACTION;")
+	if store then store:begin() end
 	-- Erase old world from the database.
 	if erase then
 		if self.save_objects then self.database:query("DELETE FROM objects;") end
 		if self.save_terrain then self.database:query("DELETE FROM terrain;") end
+		if store then store:erase_all() end
 	end
 	-- Write the new world data.
 	local sectors = Program.sectors
@@ -137,7 +248,23 @@ Sectors.save_world = function(self, erase, progress)
 			self:save_sector(k)
 		end
 	end
+	return self:commit_transaction(store)
+end
+
+--- Finishes a save transaction.<br/>
+-- The batch of the terrain store is committed first and the database
+-- transaction is rolled back if that fails.
+-- @param self Sectors.
+-- @param store Terrain store with a batch or nil.
+-- @return True on success.
+Sectors.commit_transaction = function(self, store)
+	if store and not store:commit() then
+		print("WARNING: Committing the terrain store failed")
+		self.database:query("ROLLBACK TRANSACTION;")
+		return
+	end
 	self.database:query("END TRANSACTION;")
+	return true
 end
 
 --- Unloads the world without saving.
@@ -145,17 +272,25 @@ end
 Sectors.unload_world = function(self)
 	Program:unload_world()
 	self.sectors = {}
+	self.loading = {}
 end
 
---- Unloads sectors that have been inactive long enough.
+--- Unloads sectors that have been inactive long enough.<br/>
+-- The sectors are saved like in Sectors.save_world, with the terrain
+-- committed just before the database transaction. Sectors that are still
+-- being loaded are kept until their rows have arrived.
 -- @param self Sectors.
 Sectors.update = function(self)
 	if not self.unload_time then return end
+	local store = self.save_terrain and self.terrain_store
 	local written = 0
 	for k,d in pairs(Program.sectors) do
-		if d > self.unload_time and written < 40 then
+		if d > self.unload_time and written < 40 and not self.loading[k] then
 			-- Group into a single transaction.
-			if written == 0 then self.database:query("BEGIN TRANSACTION;") end
+			if written == 0 then
+				self.database:query("BEGIN TRANSACTION;")
+				if store then store:begin() end
+			end
 			written = written + 1
 			-- Save and unload the sector.
 			self:save_sector(k)
@@ -164,5 +299,7 @@ Sectors.update = function(self)
 		end
 	end
 	-- Finish the transaction.
-	if written > 0 then self.database:query("END TRANSACTION;") end
+	if written > 0 then
+		self:commit_transaction(store)
+	end
 end
@@ -188,13 +188,7 @@ Editor.fill = function(self, p1, p2, erase)
 	if y1 > y2 then y1,y2 = y2,y1 end
 	if z1 > z2 then z1,z2 = z2,z1 end
 	-- Fill all voxels within the range.
-	for x = x1,x2 do
-		for y = y1,y2 do
-			for z = z1,z2 do
-				Voxel:set_tile(Vector(x,y,z), mat)
-			end
-		end
-	end
+	Voxel:fill_box{point = Vector(x1,y1,z1), size = Vector(x2-x1+1,y2-y1+1,z2-z1+1), tile = mat}
 end
 
 Editor.load = function(self, name)
@@ -74,6 +74,7 @@ require "system/render"
 require "system/sound"
 require "system/speech"
 require "system/tiles-render"
+TilesRender.lod_distance = 32
 require "system/reload"
 --FIXME: watchdog needs to be re-enabled once its fixed
 --require "system/watchdog"
@@ -177,7 +177,8 @@ Protocol:add_handler{type = "ADMIN_STATS", func = function(args)
 		Vision: %d+%d
 		Sectors: %d
 		Tick update: %d ms
-		Tick event: %d ms]],
+		Tick event: %d ms
+		Tick GC: %d ms, %d kB allocated, %d cycles]],
 		num_players_real, num_players_miss,
 		num_creatures_real, num_creatures_idle, num_creatures_miss,
 		num_items_real, num_items_inv, num_items_miss,
@@ -185,5 +186,6 @@ Protocol:add_handler{type = "ADMIN_STATS", func = function(args)
 		num_objects_real, num_objects_miss,
 		num_vision_real, num_vision_miss,
 		num_sectors,
-		Program.profiling.update * 1000, Program.profiling.event * 1000))}
+		Program.profiling.update * 1000, Program.profiling.event * 1000,
+		Program.profiling.gc.time * 1000, Program.profiling.gc.alloc / 1024, Program.profiling.gc.cycles))}
 end}
@@ -169,13 +169,11 @@ Ai.choose_combat_action = function(self)
 	-- Check if we could walk forward.
 	if spec.ai_enable_walk then
 		local dst = (ctr + dir):floor()
-		local f1 = Voxel:get_tile(dst)
-		local f2 = Voxel:get_tile(dst + Vector(0,1,0))
-		if f1 == 0 and f2 == 0 then
+		local f = Voxel:get_tiles{dst, dst + Vector(0,1,0), dst + Vector(0,2,0)}
+		if f[1] == 0 and f[2] == 0 then
 			allow_forward = true
-		elseif f2 == 0 and spec.ai_enable_jump then
-			local f3 = Voxel:get_tile(dst + Vector(0,2,0))
-			if f3 == 0 then
+		elseif f[2] == 0 and spec.ai_enable_jump then
+			if f[3] == 0 then
 				allow_forward_jump = true
 			end
 		end
@@ -183,13 +181,11 @@ Ai.choose_combat_action = function(self)
 	-- Check if we could walk backward.
 	if spec.ai_enable_backstep and math.random() > spec.ai_offense_factor then
 		local dstb = (ctr - dir):floor()
-		local b1 = Voxel:get_tile(dstb)
-		local b2 = Voxel:get_tile(dstb + Vector(0,1,0))
-		if b1 == 0 and b2 == 0 then
+		local b = Voxel:get_tiles{dstb, dstb + Vector(0,1,0), dstb + Vector(0,2,0)}
+		if b[1] == 0 and b[2] == 0 then
 			allow_backward = true
-		elseif b2 == 0 and spec.ai_enable_jump then
-			local b3 = Voxel:get_tile(dstb + Vector(0,2,0))
-			if b3 == 0 then
+		elseif b[2] == 0 and spec.ai_enable_jump then
+			if b[3] == 0 then
 				allow_backward_jump = true
 			end
 		end
@@ -198,14 +194,12 @@ Ai.choose_combat_action = function(self)
 	if spec.ai_enable_strafe and math.random() > spec.ai_offense_factor then
 		local dirl = Quaternion{axis = Vector(0,1), angle = 0.5 * math.pi} * dir
 		local dstl = (ctr + dirl):floor()
-		local l1 = Voxel:get_tile(dstl)
-		local l2 = Voxel:get_tile(dstl + Vector(0,1))
-		if l2 == 0 then
-			if l1 == 0 then
+		local l = Voxel:get_tiles{dstl, dstl + Vector(0,1), dstl + Vector(0,2)}
+		if l[2] == 0 then
+			if l[1] == 0 then
 				allow_strafe_left = true
 			elseif spec.ai_enable_jump then
-				local l3 = Voxel:get_tile(dstl + Vector(0,2))
-				allow_strafe_left_jump = (l3 == 0)
+				allow_strafe_left_jump = (l[3] == 0)
 			end
 		end
 	end
@@ -213,14 +207,12 @@ Ai.choose_combat_action = function(self)
 	if spec.ai_enable_strafe and math.random() > spec.ai_offense_factor then
 		local dirr = Quaternion{axis = Vector(0,1), angle = -0.5 * math.pi} * dir
 		local dstr = (ctr + dirr):floor()
-		local r1 = Voxel:get_tile(dstr)
-		local r2 = Voxel:get_tile(dstr + Vector(0,1))
-		if r2 == 0 then
-			if r1 == 0 then
+		local r = Voxel:get_tiles{dstr, dstr + Vector(0,1), dstr + Vector(0,2)}
+		if r[2] == 0 then
+			if r[1] == 0 then
 				allow_strafe_right = true
 			elseif spec.ai_enable_jump then
-				local r3 = Voxel:get_tile(dstr + Vector(0,2))
-				allow_strafe_right_jump = (r3 == 0)
+				allow_strafe_right_jump = (r[3] == 0)
 			end
 		end
 	end
@@ -139,12 +139,20 @@ Generator.generate = function(self, args)
 		sectorn = sectorn + 1
 	end
 	-- Create fractal terrain.
+	-- The terrain is generated by worker threads. The main thread keeps
+	-- serving clients and reports the progress until the batch finishes.
 	self:update_status(0, "Randomizing terrain")
-	local index = 0
-	for k in pairs(sectors) do
-		Generator.Main:generate(k)
-		self:update_status(index / sectorn)
-		index = index + 1
+	local list = {}
+	for k in pairs(sectors) do table.insert(list, k) end
+	local done
+	Generator.Main:generate_sectors(list, function(n, t)
+		self:update_status(n / t)
+	end, function()
+		done = true
+	end)
+	while not done do
+		Program:update()
+		self:update_network()
 	end
 	-- Paint regions.
 	self:update_status(0, "Creating regions")
@@ -450,6 +458,8 @@ Generator.update_network = function(self)
 		if not event then break end
 		if event.type == "login" then
 			self:inform_clients(event.client)
+		elseif event.type == "noise-batch" then
+			Eventhandler:event(event)
 		end
 	end
 end
@@ -9,22 +9,30 @@ Generator.Dungeon.mats = {
 	Material:find{name = "sand1"},
 	Material:find{name = "soil1"}}
 
---- Generates a dungeon area.
+--- Generates the terrain of a dungeon area.
 -- @param self Dungeon generator.
 -- @param pos Offset of the generated area.
 -- @param size Size of the generated area.
-Generator.Dungeon.generate = function(self, pos, size)
+-- @param batch Terrain generation batch.
+Generator.Dungeon.generate = function(self, pos, size, batch)
 	-- Create granite.
 	local m1 = Material:find{name = "granite1"}
-	Voxel:fill_region{point = pos, size = size, tile = m1.id}
+	batch:fill(pos, pos + size, m1.id)
 	-- Create common tiles.
 	-- FIXME: The distribution should be much more random.
 	local m = self.mats[math.random(1,#self.mats)]
 	if m then
-		Noise:perlin_terrain(pos, pos + size, m.id, 0.5, self.scale1, 4, 4, 0.25, Generator.inst.seed2)
+		batch:perlin(pos, pos + size, m.id, 0.5, self.scale1, 4, 4, 0.25, Generator.inst.seed2)
 	end
 	-- Create caverns.
-	Noise:perlin_terrain(pos, pos + size, 0, 0.1, self.scale2, 5, 5, 0.1, Generator.inst.seed1)
+	batch:perlin(pos, pos + size, 0, 0.1, self.scale2, 5, 5, 0.1, Generator.inst.seed1)
+end
+
+--- Populates a dungeon area after its terrain has been generated.
+-- @param self Dungeon generator.
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+Generator.Dungeon.populate = function(self, pos, size)
 	-- Create plants and ores.
 	Generator.inst:generate_resources(pos, size)
 end
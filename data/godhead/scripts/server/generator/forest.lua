@@ -9,16 +9,23 @@ Generator.Forest.mats = {
 	Material:find{name = "soil1"},
 	Material:find{name = "grass1"}}
 
---- Generates a forest area.
+--- Generates the terrain of a forest area.
 -- @param self Forest generator.
 -- @param pos Offset of the generated area.
 -- @param size Size of the generated area.
-Generator.Forest.generate = function(self, pos, size)
-	-- Create terrain.
-	Voxel:fill_region{point = pos, size = size, tile = 0}
-	Noise:perlin_terrain(pos, pos + size, self.mats[1].id, 0.15, self.scale1, 4, 4, 0.1, Generator.inst.seed1)
-	Noise:perlin_terrain(pos, pos + size, self.mats[2].id, 0.35, self.scale1, 4, 4, 0.15, Generator.inst.seed1)
-	Noise:perlin_terrain(pos, pos + size, self.mats[3].id, 0.45, self.scale1, 4, 4, 0.2, Generator.inst.seed1)
+-- @param batch Terrain generation batch.
+Generator.Forest.generate = function(self, pos, size, batch)
+	batch:carve(pos, pos + size)
+	batch:perlin(pos, pos + size, self.mats[1].id, 0.15, self.scale1, 4, 4, 0.1, Generator.inst.seed1)
+	batch:perlin(pos, pos + size, self.mats[2].id, 0.35, self.scale1, 4, 4, 0.15, Generator.inst.seed1)
+	batch:perlin(pos, pos + size, self.mats[3].id, 0.45, self.scale1, 4, 4, 0.2, Generator.inst.seed1)
+end
+
+--- Populates a forest area after its terrain has been generated.
+-- @param self Forest generator.
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+Generator.Forest.populate = function(self, pos, size)
 	-- Spawn plants.
 	local ord = {1,3,5,7,9}
 	for x = pos.x+1,pos.x+size.x-2,2 do
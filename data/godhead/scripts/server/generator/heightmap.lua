@@ -16,13 +16,15 @@ Generator.Heightmap.mats = {
     Material:find{name = "ferrostone1"},    -- underground  0x07
     Material:find{name = "sand1"}}          -- beach    0x08
 
---- Generates a dungeon area.
+--- Generates the terrain of a heightmap area.
 -- @param self Heightmap generator.
-
-Generator.Heightmap.generate = function(self, pos, size)
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+-- @param batch Terrain generation batch.
+Generator.Heightmap.generate = function(self, pos, size, batch)
     print("Pos.y :" .. pos.y)
     -- Fill the void
-    Voxel:fill_region{point = pos, size = size, tile = 0}
+    batch:carve(pos, pos + size)
     if pos.y < 120 then
         -- Create the ground for minimal height
         local m1 = Material:find{name = "granite1"}
@@ -33,8 +35,16 @@ Generator.Heightmap.generate = function(self, pos, size)
         if 120-pos.y > size.y then
             s1.y = size.y
         end
-        Voxel:fill_region{point = pos, size = s1, tile = m1.id}
-    else
+        batch:fill(pos, pos + s1, m1.id)
+    end
+end
+
+--- Populates a heightmap area after its terrain has been generated.
+-- @param self Heightmap generator.
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+Generator.Heightmap.populate = function(self, pos, size)
+    if pos.y >= 120 then
         -- TODO: add offset and scale (interpolation)
         Heightmap:heightmap_load(self.map, self.tiles, pos, size, self.mats)
     end
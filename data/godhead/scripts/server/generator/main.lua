@@ -13,11 +13,17 @@ require "server/generator/heightmap"
 Generator.Main = Class()
 Generator.Main.class_name = "Generator.Main"
 Generator.Main.scale1 = Vector(1,1,1) * (0.01 * Voxel.tile_scale)
+Generator.Main.queued = {}
 
---- Generates a sector of a suitable type.
+--- Generates the terrain of a sector of a suitable type.<br/>
+-- The terrain commands are added to the batch and the generator whose
+-- populate function must be called after the batch has been executed is
+-- returned.
 -- @param self Main generator.
 -- @param sector Sector index.
-Generator.Main.generate = function(self, sector)
+-- @param batch Terrain generation batch.
+-- @return Generator, position and size, or nil.
+Generator.Main.generate = function(self, sector, batch)
 	local w = Voxel.tiles_per_line
 	local size = Vector(w,w,w)
 	local pos = Generator.inst.inst:get_sector_offset(sector)
@@ -27,12 +33,58 @@ Generator.Main.generate = function(self, sector)
 	if pos.y > 1007 then return end
 	if not g then
         print("Void travel")
-		Voxel:fill_region{point = pos, size = size, tile = 0}
+		batch:carve(pos, pos + size)
 	else
-		g:generate(pos, size)
+		g:generate(pos, size, batch)
+		if g.populate then return g, pos, size end
 	end
 end
 
+--- Generates sectors in parallel.<br/>
+-- The terrain of all the sectors is generated natively in a single batch
+-- executed by worker threads. Once all the terrain is ready, the sectors
+-- are populated with plants, ores and patterns in the main thread.
+-- @param self Main generator.
+-- @param sectors List of sector indices.
+-- @param progress Function called with the number of finished and total sectors, or nil.
+-- @param finish Function called when the sectors have been generated, or nil.
+Generator.Main.generate_sectors = function(self, sectors, progress, finish)
+	local batch = NoiseBatch()
+	local populate = {}
+	for k,v in ipairs(sectors) do
+		local g,pos,size = self:generate(v, batch)
+		if g then table.insert(populate, {g, pos, size}) end
+	end
+	batch:execute{progress = progress, finish = function()
+		for k,v in ipairs(populate) do v[1]:populate(v[2], v[3]) end
+		if finish then finish() end
+	end}
+end
+
+--- Queues a sector for lazy generation.<br/>
+-- Sectors are often loaded in clusters so the sectors queued during the
+-- same frame are generated together in the next frame.
+-- @param self Main generator.
+-- @param sector Sector index.
+-- @param func Function called when the sector has been generated, or nil.
+Generator.Main.queue_sector = function(self, sector, func)
+	table.insert(self.queued, {sector, func})
+	if self.timer then return end
+	self.timer = Timer{delay = 0, func = function(timer)
+		local queued = self.queued
+		local sectors = {}
+		for k,v in ipairs(queued) do sectors[k] = v[1] end
+		timer:disable()
+		self.queued = {}
+		self.timer = nil
+		self:generate_sectors(sectors, nil, function()
+			for k,v in ipairs(queued) do
+				if v[2] then v[2]() end
+			end
+		end)
+	end}
+end
+
 Generator.Main.get_cluster = function(self, pos, size)
 	local s = Voxel.tiles_per_line
 	local a = {}
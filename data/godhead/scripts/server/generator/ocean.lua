@@ -8,20 +8,28 @@ Generator.Ocean.mats = {
 	Material:find{name = "ice1"},
 	Material:find{name = "water1"}}
 
---- Generates a dungeon area.
--- @param self Dungeon generator.
+--- Generates the terrain of an ocean area.
+-- @param self Ocean generator.
 -- @param pos Offset of the generated area.
 -- @param size Size of the generated area.
-Generator.Ocean.generate = function(self, pos, size)
+-- @param batch Terrain generation batch.
+Generator.Ocean.generate = function(self, pos, size, batch)
 	-- Create granite.
 	local m1 = Material:find{name = "granite1"}
-	Voxel:fill_region{point = pos, size = size, tile = m1.id}
+	batch:fill(pos, pos + size, m1.id)
 	-- Create ice.
-	Noise:perlin_terrain(pos, pos + size, self.mats[1].id, 0.3, self.scale1, 4, 4, 0.25, Generator.inst.seed2)
+	batch:perlin(pos, pos + size, self.mats[1].id, 0.3, self.scale1, 4, 4, 0.25, Generator.inst.seed2)
 	-- Create caverns.
-	Noise:perlin_terrain(pos, pos + size, 0, 0.15, self.scale2, 2, 2, 0.2, Generator.inst.seed1)
+	batch:perlin(pos, pos + size, 0, 0.15, self.scale2, 2, 2, 0.2, Generator.inst.seed1)
 	-- Create water.
-	Noise:perlin_terrain(pos, pos + size, self.mats[2].id, 0.3, self.scale1, 4, 4, 0.25, Generator.inst.seed3)
+	batch:perlin(pos, pos + size, self.mats[2].id, 0.3, self.scale1, 4, 4, 0.25, Generator.inst.seed3)
+end
+
+--- Populates an ocean area after its terrain has been generated.
+-- @param self Ocean generator.
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+Generator.Ocean.populate = function(self, pos, size)
 	-- Create plants and ores.
 	Generator.inst:generate_resources(pos, size, 5)
 end
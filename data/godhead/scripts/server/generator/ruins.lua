@@ -10,16 +10,24 @@ Generator.Ruins.mats = {
 	Material:find{name = "sand1"},
 	Material:find{name = "soil1"}}
 
---- Generates a ruins area.
+--- Generates the terrain of a ruins area.
 -- @param self Ruins generator.
 -- @param pos Offset of the generated area.
 -- @param size Size of the generated area.
-Generator.Ruins.generate = function(self, pos, size)
+-- @param batch Terrain generation batch.
+Generator.Ruins.generate = function(self, pos, size, batch)
 	-- Create granite.
 	local m1 = Material:find{name = "granite1"}
-	Voxel:fill_region{point = pos, size = size, tile = m1.id}
+	batch:fill(pos, pos + size, m1.id)
 	-- Create caverns.
-	Noise:perlin_terrain(pos, pos + size, 0, 0.2, self.scale2, 2, 2, 0.2, Generator.inst.seed1)
+	batch:perlin(pos, pos + size, 0, 0.2, self.scale2, 2, 2, 0.2, Generator.inst.seed1)
+end
+
+--- Populates a ruins area after its terrain has been generated.
+-- @param self Ruins generator.
+-- @param pos Offset of the generated area.
+-- @param size Size of the generated area.
+Generator.Ruins.populate = function(self, pos, size)
 	-- Create ruins.
 	-- FIXME: The pattern can overflow out of the sector if it's too big.
 	local pat = self.pats[math.random(1, #self.pats)]
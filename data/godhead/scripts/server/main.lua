@@ -65,6 +65,7 @@ while not Program.quit do
 	-- Store timings.
 	Program.profiling.update = t2 - t1
 	Program.profiling.event = t3 - t2
+	Program.profiling.gc = Program.gc_stats
 end
 
 -- Save at exit.
@@ -256,10 +256,8 @@ Creature.can_climb_low = function(self)
 	local ctr = self.position * Voxel.tile_scale + Vector(0,0.5,0)
 	local dir = self.rotation * Vector(0,0,-1)
 	local dst = (ctr + dir):floor()
-	local f1 = Voxel:get_tile(dst)
-	local f2 = Voxel:get_tile(dst + Vector(0,1,0))
-	local f3 = Voxel:get_tile(dst + Vector(0,2,0))
-	return f1 ~= 0 and f2 == 0 and f3 == 0
+	local f = Voxel:get_tiles{dst, dst + Vector(0,1,0), dst + Vector(0,2,0)}
+	return f[1] ~= 0 and f[2] == 0 and f[3] == 0
 end
 
 --- Checks if the creature could climb over a high wall.
@@ -270,10 +268,8 @@ Creature.can_climb_high = function(self)
 	local ctr = self.position * Voxel.tile_scale + Vector(0,0.5,0)
 	local dir = self.rotation * Vector(0,0,-1)
 	local dst = (ctr + dir):floor()
-	local f1 = Voxel:get_tile(dst + Vector(0,1,0))
-	local f2 = Voxel:get_tile(dst + Vector(0,2,0))
-	local f3 = Voxel:get_tile(dst + Vector(0,3,0))
-	return f1 ~= 0 and f2 == 0 and f3 == 0
+	local f = Voxel:get_tiles{dst + Vector(0,1,0), dst + Vector(0,2,0), dst + Vector(0,3,0)}
+	return f[1] ~= 0 and f[2] == 0 and f[3] == 0
 end
 
 --- Checks line of sight to the target point or object.
@@ -957,11 +953,11 @@ Creature.update_environment = function(self, secs)
 	return true, env
 end
 
---- Serializes the object to a string.
+--- Collects the persistent state of the object to a table.
 -- @param self Object.
--- @return Data string.
-Creature.write = function(self)
-	return string.format("local self=Creature%s\n%s%s%s", serialize{
+-- @return Data table.
+Creature.write_data = function(self)
+	return {class = "Creature", fields = {
 		angular = self.angular,
 		beheaded = self.beheaded or nil,
 		dead = self.dead,
@@ -974,7 +970,6 @@ Creature.write = function(self)
 		rotation = self.rotation,
 		spec = self.spec.name,
 		variables = self.variables},
-		Serialize:encode_skills(self.skills),
-		Serialize:encode_inventory(self.inventory),
-		"return self")
+		skills = Serialize:encode_skills_data(self.skills),
+		inventory = self.inventory and self.inventory.slots}
 end
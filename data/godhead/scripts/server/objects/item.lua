@@ -324,11 +324,11 @@ end
 Item.unequipped = function(self, user, slot)
 end
 
---- Serializes the object to a string.
+--- Collects the persistent state of the object to a table.
 -- @param self Object.
--- @return Data string.
-Item.write = function(self)
-	return string.format("local self=Item%s\n%s%s", serialize{
+-- @return Data table.
+Item.write_data = function(self)
+	return {class = "Item", fields = {
 		angular = self.angular,
 		count = self.count,
 		id = self.id,
@@ -337,6 +337,5 @@ Item.write = function(self)
 		position = self.position,
 		rotation = self.rotation,
 		variables = self.variables},
-		Serialize:encode_inventory(self.inventory),
-		"return self")
+		inventory = self.inventory and self.inventory.slots}
 end
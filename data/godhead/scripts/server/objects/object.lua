@@ -62,21 +62,26 @@ Object.contact_cb = function(self, result)
 	return true
 end
 
---- Creates a new object from a data string or database entry.
+--- Creates a new object from a data string or database entry.<br/>
+-- The data is either a packet created by Object.save or, for characters and
+-- databases written by older versions, a Lua code string.
 -- @param clss Object class.
 -- @param args Arguments.<ul>
---  <li>data: Data string.</li>
+--  <li>data: Data packet or string.</li>
 --  <li>id: Object ID to search from the database.</li></ul>
 -- @return Object or nil.
 Object.load = function(clss, args)
-	if args.data then
+	if type(args.data) == "string" then
 		local func = assert(loadstring("return function()\n" .. args.data .. "\nend"))()
 		if func then return func() end
+	elseif args.data then
+		local data,err = Program:unserialize(args.data, function(id) return Object:load{id = id} end)
+		if not data then error(err) end
+		return clss:read_data(data)
 	elseif args.id then
 		local rows = Serialize.db:query("SELECT * FROM objects WHERE id=?;", {args.id})
 		for k,v in ipairs(rows) do
-			local func = assert(loadstring("return function()\n" .. v[3] .. "\nend"))()
-			return func and func()
+			return Object:load{data = v[3]}
 		end
 	end
 end
@@ -374,14 +379,40 @@ Object.merge = function(self, args)
 end
 
 Object.purge = function(self)
-	Serialize.db:query("DELETE FROM objects WHERE id=?;", {self.id})
+	Serialize.db:write("DELETE FROM objects WHERE id=?;", {self.id}, "object:" .. self.id)
 end
 
---- Saves the object to the database.
+--- Creates an object from a table created with Object.write_data.
+-- @param clss Object class.
+-- @param data Data table.
+-- @return Object or nil.
+Object.read_data = function(clss, data)
+	local c = _G[data.class]
+	if not c then return end
+	local self = c(data.fields)
+	if data.skills then
+		self.skills.enabled = data.skills.enabled
+		for k,v in ipairs(data.skills) do self.skills:set(v) end
+	end
+	if data.inventory then
+		for k,v in pairs(data.inventory) do self:add_item{slot = k, object = v} end
+	end
+	return self
+end
+
+--- Saves the object to the database.<br/>
+-- The object is stored in the binary format of Program.serialize. Objects in
+-- the inventory of the object are saved as separate rows. The write is
+-- keyed by the object ID so that saving the object again before the write
+-- has been committed replaces the old write.
 -- @param self Object.
 Object.save = function(self)
-	local data = self:write()
-	Serialize.db:query("REPLACE INTO objects (id,sector,data) VALUES (?,?,?);", {self.id, self.sector, data})
+	local data = self:write_data()
+	local packet = assert(Program:serialize(data))
+	Serialize.db:write("REPLACE INTO objects (id,sector,data) VALUES (?,?,?);", {self.id, self.sector, packet}, "object:" .. self.id)
+	if data.inventory then
+		for k,v in pairs(data.inventory) do v:save() end
+	end
 end
 
 --- Sends a chat message to all players near the object.
@@ -561,13 +592,25 @@ end
 -- @param self Object.
 -- @return Data string.
 Object.write = function(self)
-	return string.format("local self=Object%s\n%s", serialize{
+	local data = self:write_data()
+	return string.format("local self=%s%s\n%s%s%s", data.class, serialize(data.fields),
+		data.skills and Serialize:encode_skills(self.skills) or "",
+		data.inventory and Serialize:encode_inventory(self.inventory) or "",
+		"return self")
+end
+
+--- Collects the persistent state of the object to a table.<br/>
+-- The table contains the class name, the constructor arguments and optionally
+-- the skills and the inventory slots of the object.
+-- @param self Object.
+-- @return Data table.
+Object.write_data = function(self)
+	return {class = "Object", fields = {
 		angular = self.angular,
 		id = self.id,
 		mass = self.mass,
 		name = self.name,
 		model = self.model_name,
 		position = self.position,
-		rotation = self.rotation},
-		"return self")
+		rotation = self.rotation}}
 end
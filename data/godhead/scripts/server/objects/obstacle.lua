@@ -108,17 +108,16 @@ Obstacle.use_cb = function(self, user)
 	Object.use_cb(self, user)
 end
 
---- Serializes the object to a string.
+--- Collects the persistent state of the object to a table.
 -- @param self Object.
--- @return Data string.
-Obstacle.write = function(self)
-	return string.format("local self=Obstacle%s\n%s", serialize{
+-- @return Data table.
+Obstacle.write_data = function(self)
+	return {class = "Obstacle", fields = {
 		angular = self.angular,
 		health = self.health,
 		id = self.id,
 		position = self.position,
 		rotation = self.rotation,
 		spec = self.spec.name,
-		variables = self.variables},
-		"return self")
+		variables = self.variables}}
 end
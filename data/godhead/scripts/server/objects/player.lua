@@ -503,11 +503,11 @@ Player.vision_cb = function(self, args)
 	if fun then fun(args) end
 end
 
---- Serializes the object to a string.
+--- Collects the persistent state of the object to a table.
 -- @param self Object.
--- @return Data string.
-Player.write = function(self)
-	return string.format("local self=Player%s\n%s%s%s", serialize{
+-- @return Data table.
+Player.write_data = function(self)
+	return {class = "Player", fields = {
 		angular = self.angular,
 		body_scale = self.body_scale,
 		body_style = self.body_style,
@@ -523,7 +523,6 @@ Player.write = function(self)
 		skin_style = self.skin_style,
 		spec = self.spec.name,
 		variables = self.variables},
-		Serialize:encode_skills(self.skills),
-		Serialize:encode_inventory(self.inventory),
-		"return self")
+		skills = Serialize:encode_skills_data(self.skills),
+		inventory = self.inventory and self.inventory.slots}
 end
@@ -60,7 +60,14 @@ end
 -- @param objects Array of objects.
 Sectors.created_sector = function(self, sector, terrain, objects)
 	-- Create fractal terrain for newly found sectors.
-	if not terrain then Generator.Main:generate(sector) end
+	-- The terrain is generated in the background so the rest is done
+	-- once it's ready so that monsters have ground to spawn on.
+	if not terrain then
+		Generator.Main:queue_sector(sector, function()
+			self:created_sector(sector, true, objects)
+		end)
+		return
+	end
 	-- Don't spawn monsters in town sectors.
 	local s = Generator.inst.sectors[sector]
 	if s == "Town" then return end
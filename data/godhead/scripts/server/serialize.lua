@@ -6,8 +6,13 @@ Serialize.data_version = "9"
 -- @param clss Serialize class.
 Serialize.init = function(clss)
 	-- Create the save database.
-	clss.db = Database{name = "save" .. Settings.file .. ".sqlite"}
-	clss.sectors = Sectors{database = clss.db}
+	-- The database is written in a worker thread so that saving the world
+	-- doesn't stall the game.
+	clss.db = Database{name = "save" .. Settings.file .. ".sqlite", async = true}
+	-- Terrain is stored in memory mapped region files next to the database
+	-- since they load much faster than terrain BLOBs.
+	clss.terrain = TerrainStore{name = "save" .. Settings.file .. ".terrain"}
+	clss.sectors = Sectors{database = clss.db, terrain_store = clss.terrain}
 	clss.db:query("CREATE TABLE IF NOT EXISTS keyval (key TEXT PRIMARY KEY,value TEXT);")
 	if clss:get_value("data_version") ~= clss.data_version then
 		clss.db:query("DROP TABLE IF EXISTS dialog_flags;")
@@ -70,6 +75,23 @@ Serialize.encode_skills = function(clss, skills)
 	return str
 end
 
+--- Makes a table out of skills.<br/>
+-- The table is the binary counterpart of the string created with
+-- Serialize.encode_skills and is restored by Object.read_data.
+-- @param clss Serialize class.
+-- @param skills Skills.
+-- @return Table or nil.
+Serialize.encode_skills_data = function(clss, skills)
+	if not skills then return end
+	local data = {enabled = skills.enabled}
+	for k,v in pairs(skills:get_names()) do
+		local val = skills:get_value{skill = v}
+		local max = skills:get_maximum{skill = v}
+		table.insert(data, {skill = v, maximum = max, value = val})
+	end
+	return data
+end
+
 --- Gets a value from the key-value database.
 -- @param clss Serialize class.
 -- @param key Key string.
@@ -197,9 +219,11 @@ Serialize.save_generator = function(clss, erase)
 	clss.db:query("REPLACE INTO generator_settings (key,value) VALUES (?,?);", {"seed1", tostring(Generator.inst.seed1)})
 	clss.db:query("REPLACE INTO generator_settings (key,value) VALUES (?,?);", {"seed2", tostring(Generator.inst.seed2)})
 	clss.db:query("REPLACE INTO generator_settings (key,value) VALUES (?,?);", {"seed3", tostring(Generator.inst.seed3)})
+	local rows = {}
 	for k,v in pairs(Generator.inst.sectors) do
-		clss.db:query("REPLACE INTO generator_sectors (id,value) VALUES (?,?);", {k, v})
+		table.insert(rows, {k, v})
 	end
+	clss.db:query_batch("REPLACE INTO generator_sectors (id,value) VALUES (?,?);", rows)
 	clss.db:query("END TRANSACTION;")
 end
 
@@ -222,11 +246,12 @@ Serialize.save_markers = function(clss, erase)
 	if erase then
 		clss.db:query("DELETE FROM markers;")
 	end
+	local rows = {}
 	for k,v in pairs(Marker.dict_name) do
-		clss.db:query("REPLACE INTO markers (name,id,x,y,z,unlocked,discoverable) VALUES (?,?,?,?,?,?,?);",
-			{k, v.target, v.position.x, v.position.y, v.position.z,
-			 v.unlocked and 1 or 0, v.discoverable and 1 or 0})
+		table.insert(rows, {k, v.target, v.position.x, v.position.y, v.position.z,
+			v.unlocked and 1 or 0, v.discoverable and 1 or 0})
 	end
+	clss.db:query_batch("REPLACE INTO markers (name,id,x,y,z,unlocked,discoverable) VALUES (?,?,?,?,?,?,?);", rows)
 	clss.db:query("END TRANSACTION;")
 end
 
@@ -249,13 +274,16 @@ Serialize.save_quests = function(clss, erase)
 		clss.db:query("DELETE FROM quests;")
 		clss.db:query("DELETE FROM dialog_flags;")
 	end
+	local quests = {}
 	for k,v in pairs(Quest.dict_name) do
-		clss.db:query("REPLACE INTO quests (name,status,desc,marker) VALUES (?,?,?,?);",
-			{k, v.status, v.text, v.marker})
+		table.insert(quests, {k, v.status, v.text, v.marker})
 	end
+	clss.db:query_batch("REPLACE INTO quests (name,status,desc,marker) VALUES (?,?,?,?);", quests)
+	local flags = {}
 	for k,v in pairs(Dialog.flags) do
-		clss.db:query("REPLACE INTO dialog_flags (name,value) VALUES (?,?);", {k, v})
+		table.insert(flags, {k, v})
 	end
+	clss.db:query_batch("REPLACE INTO dialog_flags (name,value) VALUES (?,?);", flags)
 	clss.db:query("END TRANSACTION;")
 end
 
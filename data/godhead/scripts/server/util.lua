@@ -158,17 +158,23 @@ Utils.explosion = function(clss, point, radius)
 	local r2 = (r1 + 3) * Voxel.tile_size
 	Effect:play{effect = "explosion1", point = point}
 	-- Damage nearby tiles.
+	-- The tiles are probed in one call so that only the non-empty ones
+	-- need to go through the material specific damage logic.
 	local _,ctr = Voxel:find_tile{point = point}
+	local tiles = {}
 	for x=-r1,r1 do
 		for y=-r1,r1 do
 			for z=-r1,r1 do
 				local o = Vector(x,y,z)
 				if o.length < r1 + 0.6 then
-					Voxel:damage(nil, ctr + o)
+					table.insert(tiles, ctr + o)
 				end
 			end
 		end
 	end
+	for k,v in ipairs(Voxel:get_tiles(tiles)) do
+		if v ~= 0 then Voxel:damage(nil, tiles[k]) end
+	end
 	-- Damage nearby objects.
 	for k1,v1 in pairs(Object:find{point = point, radius = r2}) do
 		local diff = v1.position - point
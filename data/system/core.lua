@@ -3,6 +3,15 @@ require "system/class"
 Program = Class()
 Program.class_name = "Program"
 
+local wrap_message = function(r)
+	if r.type == "model" and r.model then
+		r.model = Class.new(Model, {handle = r.model})
+	elseif r.type == "packet" and r.packet then
+		r.packet = Class.new(Packet, {handle = r.packet})
+	end
+	return r
+end
+
 --- Sets the name of the mod to be executed after this one quits.
 -- @param clss Program class.
 -- @param args Arguments.<ul>
@@ -28,9 +37,18 @@ end
 Program.pop_message = function(self)
 	local r = Los.program_pop_message()
 	if not r then return end
-	if r.type == "model" and r.model then
-		r.model = Class.new(Model, {handle = r.model})
-	end
+	return wrap_message(r)
+end
+
+--- Pops multiple messages sent by the parent script.<br/>
+-- Popping messages in batches is cheaper than popping them one by one.
+-- @param self Thread.
+-- @param count Maximum number of messages to pop.
+-- @return List of message tables or nil.
+Program.pop_messages = function(self, count)
+	local r = Los.program_pop_messages(count)
+	if not r then return end
+	for k,v in ipairs(r) do wrap_message(v) end
 	return r
 end
 
@@ -42,14 +60,24 @@ Program.push_event = function(clss, event)
 	table.insert(__events, event)
 end
 
---- Pushes a message to the parent script.
+--- Pushes a message to the parent script.<br/>
+-- Models and packets are copied by default. If move is true, their data
+-- is handed over to the receiver without copying and the sent model or
+-- packet is left empty. The message queue is bounded so pushing fails
+-- if the receiver is too far behind.
 -- @param self Thread.
--- @param ... Message arguments.
+-- @param ... Message arguments.<ul>
+--   <li>1,name: Message name.</li>
+--   <li>2,string: String.</li>
+--   <li>model: Model.</li>
+--   <li>move: True to move the model or packet instead of copying.</li>
+--   <li>packet: Packet.</li></ul>
 -- @return True on success.
 Program.push_message = function(self, ...)
 	local a = ...
 	if type(a) == "table" then
 		if a.model then a.model = a.model.handle end
+		if a.packet then a.packet = a.packet.handle end
 		return Los.program_push_message(a)
 	else
 		return Los.program_push_message(...)
@@ -84,6 +112,36 @@ Program.safe_call = function(clss, func)
 	xpcall(func, function(err) print(debug.traceback("ERROR: " .. err)) end)
 end
 
+--- Serializes a value to a compact binary packet.<br/>
+-- The value may be nil, a boolean, a number, a string, a vector, a quaternion,
+-- an object or a table containing such values. Objects are stored by ID. The
+-- packet is versioned and can be stored to the database as a blob.
+-- @param clss Program class.
+-- @param value Value to serialize.
+-- @return Packet on success. Nil and an error message otherwise.
+Program.serialize = function(clss, value)
+	local h,e = Los.program_serialize(value)
+	if not h then return nil, e end
+	return Class.new(Packet, {handle = h})
+end
+
+--- Unserializes a value created with Program.serialize.<br/>
+-- The value is decoded in a single pass without invoking the Lua parser.
+-- Since objects are stored by ID, the caller must provide a function that
+-- maps the IDs back to objects. If no function is given, objects decode to
+-- their IDs.
+-- @param clss Program class.
+-- @param data Packet or string.
+-- @param object Function that returns an object for the given ID.
+-- @return Value on success. Nil and an error message otherwise.
+Program.unserialize = function(clss, data, object)
+	if type(data) == "table" then data = data.handle end
+	return Los.program_unserialize(data, {
+		object = object,
+		quaternion = Class.new(Quaternion),
+		vector = Class.new(Vector)})
+end
+
 --- Request program shutdown.
 -- @param clss Program class.
 Program.shutdown = function(clss, args)
@@ -107,6 +165,23 @@ end
 -- @name Program.args
 -- @class table
 
+--- Time budget of the garbage collector per tick, in seconds.<br/>
+-- Garbage is collected incrementally at the end of each tick until the
+-- budget runs out. Setting the budget to zero returns the collection to
+-- the automatic collector of Lua.
+-- @name Program.gc_budget
+-- @class table
+
+--- Garbage collection statistics.<br/>
+-- The table contains the following fields: alloc (bytes allocated during the
+-- last tick), budget (time budget in seconds), cycles (number of completed
+-- collection cycles), live (bytes in use after the last cycle), memory (bytes
+-- in use), overruns (number of ticks that exceeded the budget due to too
+-- high memory use), step (step size in kilobytes) and time (seconds spent
+-- collecting during the last tick).
+-- @name Program.gc_stats
+-- @class table
+
 --- Boolean indicating whether the game needs to exit.
 -- @name Program.quit
 -- @class table
@@ -133,6 +208,8 @@ end
 
 Program.class_getters = {
 	args = function(s) return Los.program_get_args() end,
+	gc_budget = function(s) return Los.program_get_gc_budget() end,
+	gc_stats = function(s) return Los.program_get_gc_stats() end,
 	quit = function(s) return Los.program_get_quit() end,
 	sectors = function(s) return Los.program_get_sectors() end,
 	sector_size = function(s) return Los.program_get_sector_size() end,
@@ -141,6 +218,7 @@ Program.class_getters = {
 	time = function(s) return Los.program_get_time() end}
 
 Program.class_setters = {
+	gc_budget = function(s, v) Los.program_set_gc_budget(v) end,
 	quit = function(s, v) Los.program_set_quit(v) end,
 	sleep = function(s, v) Los.program_set_sleep(v) end}
 
@@ -152,9 +230,22 @@ Program.unittest = function()
 	assert(type(Program.sleep) == "number")
 	assert(type(Program.tick) == "number")
 	assert(type(Program.time) == "number")
+	-- Garbage collection scheduler.
+	local budget = Program.gc_budget
+	Program.gc_budget = 0.005
+	assert(math.abs(Program.gc_budget - 0.005) < 0.0001)
+	for i = 1,10 do
+		for j = 1,10000 do local t = {j} end
+		Program:update()
+	end
+	local stats = Program.gc_stats
+	assert(stats.alloc >= 0 and stats.memory > 0 and stats.step > 0)
+	assert(stats.time >= 0 and stats.time < 1)
+	Program.gc_budget = budget
 	Program.quit = true
 	assert(Program.quit)
 	-- Message passing disabled for non-threads.
 	assert(not Program:push_message("fail", "fail"))
 	assert(not Program:pop_message())
+	assert(not Program:pop_messages())
 end
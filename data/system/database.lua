@@ -1,4 +1,5 @@
 require "system/class"
+require "system/eventhandler"
 
 if not Los.program_load_extension("database") then
 	error("loading extension `database' failed")
@@ -8,11 +9,19 @@ end
 
 Database = Class()
 Database.class_name = "Database"
+Database.callbacks = {}
 
---- Opens a database.
+--- Opens a database.<br/>
+-- If async is true, the connection is handed over to a worker thread. Writes
+-- are then collected to a write-behind queue and committed by the worker in
+-- periodic group commits, so they return immediately without results or
+-- errors. Queries that may return rows wait for the queued writes to the
+-- tables they read and are executed synchronously unless
+-- Database.query_async is used.
 -- @param clss Database class.
 -- @param args Arguments.<ul>
---   <li>1,name: Unique database name.</li></ul>
+--   <li>1,name: Unique database name.</li>
+--   <li>async: True to write in a worker thread.</li></ul>
 -- @return New database.
 Database.new = function(clss, args)
 	local self = Class.new(clss)
@@ -21,10 +30,37 @@ Database.new = function(clss, args)
 		local n = (type(args) == "string") and args or args.name
 		assert(self.handle, string.format("creating database %q failed", n))
 	end
+	self.async = (type(args) == "table" and args.async) or nil
 	__userdata_lookup[self.handle] = self
 	return self
 end
 
+-- Translates packets to handles.
+local encode_bind = function(b)
+	if not b then return end
+	local s = {}
+	for k,v in pairs(b) do
+		s[k] = (type(v) == "table") and v.handle or v
+	end
+	return s
+end
+
+-- Translates handles to packets.
+local decode_row = function(r)
+	for k,v in pairs(r) do
+		if type(v) == "userdata" then r[k] = Class.new(Packet, {handle = v}) end
+	end
+	return r
+end
+
+--- Waits for all the queued writes to be committed.<br/>
+-- Does nothing for synchronous databases. If a transaction has been begun
+-- but not ended, the writes are executed but not committed.
+-- @param self Database.
+Database.flush = function(self)
+	Los.database_flush(self.handle)
+end
+
 --- Queries the database.<br/>
 -- Executes an SQLite query and returns the results in a table. The returned
 -- table contains a list of tables that denote the rows of the result. The row
@@ -32,32 +68,98 @@ end
 -- You can avoid escaping the arguments required by the query by writing a `?' in
 -- place of the argument in the query and then passing the value in the binding
 -- array. The binding array is a simple table that contains the arguments in the
--- same order as the query.
+-- same order as the query. Integral numbers are bound as integers and other
+-- numbers as doubles.<br/>
+-- Compiled statements are cached by the query string, so prefer binding
+-- arguments over formatting them into the query.<br/>
+-- For asynchronous databases, data modifying statements and transaction
+-- control statements are queued and an empty table is returned.
 -- @param self Database.
 -- @param args Arguments.<ul>
 --   <li>1: Query string.</li>
 --   <li>2: Array of values to bind to the statement.</ul>
 -- @return Table of rows.
 Database.query = function(self, a, b)
-	-- Translate packets to handles.
-	local s
-	if b then
-		s = {}
-		for k,v in pairs(b) do
-			s[k] = (type(v) == "table") and v.handle or v
-		end
-	end
-	-- Perform the query.
-	local t = Los.database_query(self.handle, a, s)
-	-- Translate handles to packets.
-	for k1,v1 in pairs(t) do
-		for k2,v2 in pairs(v1) do
-			if type(v2) == "userdata" then v1[k2] = Class.new(Packet, {handle = v2}) end
-		end
-	end
+	local t = Los.database_query(self.handle, a, encode_bind(b))
+	for k,v in pairs(t) do decode_row(v) end
 	return t
 end
 
+--- Queries an asynchronous database without waiting for the result.<br/>
+-- The query is executed by the worker thread on the next tick, after the
+-- writes queued before it. When the result arrives in an event of type
+-- "database-query", the callback is called with the table of rows, or with
+-- nil and an error string.
+-- @param self Database.
+-- @param a Query string.
+-- @param b Array of values to bind to the statement.
+-- @param f Callback function.
+-- @return Query ID or nil.
+Database.query_async = function(self, a, b, f)
+	local id = Los.database_query_async(self.handle, a, encode_bind(b))
+	if not id then return end
+	Database.callbacks[id] = f
+	return id
+end
+
+--- Executes a query once for each row of arguments.<br/>
+-- The statement is compiled once and all the rows are written in a single
+-- transaction, or in a savepoint if a transaction is already open. If any of
+-- the rows fails, the whole batch is rolled back, but the rest of the open
+-- transaction is kept. For asynchronous databases, the batch is
+-- queued and the number of rows queued is returned.
+-- @param self Database.
+-- @param a Query string.
+-- @param b Array of binding arrays.
+-- @return Number of rows executed, or nil on error.
+Database.query_batch = function(self, a, b)
+	local s = {}
+	for k,v in ipairs(b) do s[k] = encode_bind(v) end
+	return Los.database_query_batch(self.handle, a, s)
+end
+
+--- Iterates through the rows returned by a query.<br/>
+-- Unlike Database.query, the rows are fetched one by one as the iteration
+-- proceeds so that the whole result set never needs to be in memory.
+-- @param self Database.
+-- @param a Query string.
+-- @param b Array of values to bind to the statement.
+-- @return Iterator returning row tables.
+Database.rows = function(self, a, b)
+	local c = Los.database_iterate(self.handle, a, encode_bind(b))
+	return function()
+		if not c then return end
+		local r = Los.database_cursor_next(c)
+		if not r then c = nil return end
+		return decode_row(r)
+	end
+end
+
+--- Queues a write to the database.<br/>
+-- Like Database.query but the statement is always queued for asynchronous
+-- databases. If a key is given, a write with the same key that is still in
+-- the queue and in the same transaction is discarded, so the key must
+-- identify writes that completely replace each other.
+-- @param self Database.
+-- @param a Query string.
+-- @param b Array of values to bind to the statement.
+-- @param key Coalescing key string.
+Database.write = function(self, a, b, key)
+	Los.database_write(self.handle, a, encode_bind(b), key)
+end
+
+--- Statistics of the write-behind queue of an asynchronous database.
+-- @name Database.queue_stats
+-- @class table
+
+--- Hit and miss counts of the compiled statement cache.
+-- @name Database.statement_stats
+-- @class table
+
+Database:add_getters{
+	queue_stats = function(self) return Los.database_get_queue_stats(self.handle) end,
+	statement_stats = function(self) return Los.database_get_statement_stats(self.handle) end}
+
 --- Approximate memory used by add databases, in bytes.
 -- @name Database.memory_used
 -- @class table
@@ -65,6 +167,16 @@ end
 Database:add_class_getters{
 	memory_used = function(self) return Los.database_get_memory_used(self) end}
 
+-- Calls the callbacks of asynchronous queries.
+Eventhandler{type = "database-query", func = function(self, args)
+	local f = Database.callbacks[args.id]
+	if not f then return end
+	Database.callbacks[args.id] = nil
+	if args.error then return f(nil, args.error) end
+	for k,v in ipairs(args.rows) do decode_row(v) end
+	f(args.rows)
+end}
+
 Database.unittest = function()
 	-- Database creation.
 	local d = Database("unittest.sqlite")
@@ -80,4 +192,181 @@ Database.unittest = function()
 	assert(type(r[1]) == "table")
 	assert(r[1][1] == 1)
 	assert(r[1][2] == "unittest")
+	-- Binary serialization.
+	local p = Program:serialize{1, 2.5, -3, "a\0b", true, {x = Vector(1,2,3)}, r = Quaternion(0,0,0,1)}
+	d:query("INSERT INTO terrain (sector,data) VALUES (?,?);", {2, p})
+	local r = d:query("SELECT * FROM terrain WHERE sector=?;", {2})
+	local v = Program:unserialize(r[1][2])
+	assert(v[1] == 1 and v[2] == 2.5 and v[3] == -3 and v[4] == "a\0b" and v[5] == true)
+	assert(v[6].x.class == Vector and v[6].x.y == 2 and v.r.class == Quaternion and v.r.w == 1)
+	assert(not Program:serialize{f = print})
+	assert(not Program:unserialize("invalid"))
+	-- Sector save and load benchmark.
+	local rows = {}
+	for i = 1,500 do
+		rows[i] = {angular = Vector(0,0,0), health = 100, id = i, name = "object" .. i,
+			position = Vector(1000+i,50,1000), rotation = Quaternion(0,0,0,1), spec = "boulder",
+			variables = {charge = i % 7, looted = (i % 2 == 0)}}
+	end
+	local bench = function(save, load)
+		local t1 = Program.time
+		d:query("DROP TABLE IF EXISTS objects;")
+		d:query("CREATE TABLE objects (id INTEGER PRIMARY KEY,sector UNSIGNED INTEGER,data BLOB);")
+		d:query("BEGIN TRANSACTION;")
+		for k,v in ipairs(rows) do
+			d:query("INSERT INTO objects (id,sector,data) VALUES (?,?,?);", {k, 1, save(v)})
+		end
+		d:query("END TRANSACTION;")
+		local t2 = Program.time
+		local r = d:query("SELECT * FROM objects WHERE sector=?;", {1})
+		for k,v in ipairs(r) do
+			local o = load(v[3])
+			assert(o.id == v[1] and o.position.x == 1000 + v[1])
+		end
+		return t2 - t1, Program.time - t2
+	end
+	local ts,tl = bench(function(v)
+		return string.format("return {angular=Vector(%g,%g,%g),health=%d,id=%d,name=%q," ..
+			"position=Vector(%g,%g,%g),rotation=Quaternion(%g,%g,%g,%g),spec=%q," ..
+			"variables={charge=%d,looted=%s}}", v.angular.x, v.angular.y, v.angular.z,
+			v.health, v.id, v.name, v.position.x, v.position.y, v.position.z,
+			v.rotation.x, v.rotation.y, v.rotation.z, v.rotation.w, v.spec,
+			v.variables.charge, tostring(v.variables.looted))
+	end, function(v)
+		return assert(loadstring(v))()
+	end)
+	local bs,bl = bench(function(v)
+		return Program:serialize(v)
+	end, function(v)
+		return Program:unserialize(v)
+	end)
+	print(string.format("Database: 500 objects: text save %.1f ms load %.1f ms, binary save %.1f ms load %.1f ms",
+		1000 * ts, 1000 * tl, 1000 * bs, 1000 * bl))
+	-- Typed binding and batches.
+	d:query("DROP TABLE IF EXISTS numbers;")
+	d:query("CREATE TABLE numbers (id INTEGER PRIMARY KEY,value);")
+	local rows = {}
+	for i = 1,2000 do rows[i] = {i, (i % 2 == 0) and i or i + 0.5} end
+	assert(d:query_batch("INSERT INTO numbers (id,value) VALUES (?,?);", rows) == 2000)
+	assert(#d:query("SELECT id FROM numbers WHERE typeof(value)='integer';") == 1000)
+	assert(not d:query_batch("INSERT INTO numbers (id,value) VALUES (?,?);", {{2001, 1}, {1, 1}}))
+	assert(#d:query("SELECT id FROM numbers;") == 2000)
+	d:query("BEGIN TRANSACTION;")
+	d:query("INSERT INTO numbers (id,value) VALUES (?,?);", {2003, 1})
+	assert(not d:query_batch("INSERT INTO numbers (id,value) VALUES (?,?);", {{2001, 1}, {1, 1}, {2002, 1}}))
+	d:query("END TRANSACTION;")
+	local r = d:query("SELECT id FROM numbers WHERE id>?;", {2000})
+	assert(#r == 1 and r[1][1] == 2003)
+	d:query("DELETE FROM numbers WHERE id=?;", {2003})
+	-- Row iteration.
+	local n = 0
+	for r in d:rows("SELECT id,value FROM numbers WHERE id<=? ORDER BY id;", {10}) do
+		n = n + 1
+		assert(r[1] == n)
+		for r1 in d:rows("SELECT id FROM numbers WHERE id<=? ORDER BY id;", {10}) do break end
+	end
+	assert(n == 10)
+	local stats = d.statement_stats
+	assert(stats.hits > 0 and stats.cached > 0)
+	-- Query benchmark.
+	local t1 = Program.time
+	d:query("BEGIN TRANSACTION;")
+	for k,v in ipairs(rows) do d:query("REPLACE INTO numbers (id,value) VALUES (?,?);", v) end
+	d:query("END TRANSACTION;")
+	local t2 = Program.time
+	d:query_batch("REPLACE INTO numbers (id,value) VALUES (?,?);", rows)
+	local t3 = Program.time
+	for i = 1,20 do d:query("SELECT * FROM numbers;") end
+	local t4 = Program.time
+	for i = 1,20 do for r in d:rows("SELECT * FROM numbers;") do end end
+	local t5 = Program.time
+	print(string.format("Database: 2000 rows: query %.1f ms, query_batch %.1f ms, select %.1f ms, rows %.1f ms",
+		1000 * (t2 - t1), 1000 * (t3 - t2), 50 * (t4 - t3), 50 * (t5 - t4)))
+	-- Asynchronous writes.
+	-- A second synchronous connection to the same file sees exactly what
+	-- would be left on the disk if the program crashed at that point.
+	local a = Database{name = "unittest-async.sqlite", async = true}
+	a:query("DROP TABLE IF EXISTS async;")
+	a:query("CREATE TABLE async (id INTEGER PRIMARY KEY,value);")
+	a:flush()
+	local s = Database("unittest-async.sqlite")
+	local count = function() return s:query("SELECT COUNT(*) FROM async;")[1][1] end
+	assert(count() == 0)
+	-- Transactions are atomic even if the queue is flushed in the middle.
+	a:query("BEGIN TRANSACTION;")
+	for i = 1,100 do a:query("INSERT INTO async (id,value) VALUES (?,?);", {i, i}) end
+	a:flush()
+	assert(count() == 0)
+	assert(a:query("SELECT COUNT(*) FROM async;")[1][1] == 100)
+	a:query("END TRANSACTION;")
+	a:flush()
+	assert(count() == 100)
+	-- Rolling back only discards the writes of the transaction.
+	a:query("INSERT INTO async (id,value) VALUES (?,?);", {101, "x"})
+	a:query("BEGIN TRANSACTION;")
+	a:query("DELETE FROM async;")
+	a:query("ROLLBACK TRANSACTION;")
+	a:query_batch("INSERT INTO async (id,value) VALUES (?,?);", {{102, 1}, {1, 1}})
+	assert(a:query("SELECT COUNT(*) FROM async;")[1][1] == 101)
+	assert(count() == 101)
+	assert(a.queue_stats.errors == 1)
+	-- Coalescing of keyed writes.
+	local stats = a.queue_stats
+	for i = 1,10 do a:write("REPLACE INTO async (id,value) VALUES (?,?);", {1, i}, "async:1") end
+	a:write("REPLACE INTO async (id,value) VALUES (?,?);", {2, Program:serialize{2}}, "async:2")
+	assert(a.queue_stats.coalesced == stats.coalesced + 9)
+	assert(a:query("SELECT value FROM async WHERE id=?;", {1})[1][1] == 10)
+	assert(Program:unserialize(a:query("SELECT value FROM async WHERE id=?;", {2})[1][1])[1] == 2)
+	-- Asynchronous reads.
+	local res
+	a:query("UPDATE async SET value=? WHERE id=?;", {"y", 101})
+	a:query_async("SELECT value FROM async WHERE id=?;", {101}, function(r) res = r end)
+	while not res do
+		Program:update()
+		local e = Program:pop_event()
+		while e do
+			if e.type == "database-query" then Eventhandler:event(e) end
+			e = Program:pop_event()
+		end
+	end
+	assert(#res == 1 and res[1][1] == "y")
+	-- Synchronous reads only wait for the writes to the tables they read.
+	a:query("DROP TABLE IF EXISTS async2;")
+	a:query("CREATE TABLE async2 (id INTEGER PRIMARY KEY,value);")
+	assert(#a:query("SELECT * FROM async2;") == 0)
+	a:query("INSERT INTO async (id,value) VALUES (?,?);", {103, "z"})
+	assert(#a:query("SELECT * FROM async2;") == 0)
+	assert(a.queue_stats.pending == 1)
+	assert(a:query("SELECT value FROM async WHERE id=?;", {103})[1][1] == "z")
+	assert(a.queue_stats.pending == 0)
+	-- Main thread time spent saving.
+	local rows = {}
+	for i = 1,5000 do rows[i] = {i, Program:serialize{i, "object" .. i}} end
+	local save = function(d)
+		local t = Program.time
+		d:query("BEGIN TRANSACTION;")
+		for k,v in ipairs(rows) do d:query("REPLACE INTO async (id,value) VALUES (?,?);", v) end
+		d:query("END TRANSACTION;")
+		return Program.time - t
+	end
+	local ts = save(s)
+	local ta = save(a)
+	local t = Program.time
+	a:flush()
+	local tf = Program.time - t
+	print(string.format("Database: 5000 rows: synchronous save %.1f ms, asynchronous save %.1f ms + %.1f ms in the worker",
+		1000 * ts, 1000 * ta, 1000 * tf))
+	-- Transactions left open are rolled back on close.
+	-- The reopened connection must see the rows and be able to write, which
+	-- it couldn't if the old connection was still holding the transaction.
+	a:query("BEGIN TRANSACTION;")
+	a:query("DELETE FROM async;")
+	a:flush()
+	a = nil
+	collectgarbage()
+	a = Database{name = "unittest-async.sqlite", async = true}
+	assert(a:query("SELECT COUNT(*) FROM async;")[1][1] == 5000)
+	a:query("DELETE FROM async WHERE id=?;", {1})
+	a:flush()
+	assert(count() == 4999)
 end
@@ -82,7 +82,6 @@ Quaternion.new = function(clss, x, y, z, w)
 	else
 		self.handle = Los.quaternion_new(x, y, z, w)
 	end
-	__userdata_lookup[self.handle] = self
 	return self
 end
 
@@ -132,6 +131,13 @@ Quaternion.__str = function(self)
 	return Los.quaternion_tostring(self.handle)
 end
 
+--- Returns the components of the quaternion without creating a table.
+-- @param self Quaternion.
+-- @return X, Y, Z and W values.
+Quaternion.components = function(self)
+	return Los.quaternion_get_components(self.handle)
+end
+
 --- Normalized linear interpolation.
 -- @param self Quaternion.
 -- @param quat Quaternion.
@@ -233,11 +239,16 @@ Vector.class_name = "Vector"
 -- @return New vector.
 Vector.new = function(clss, x, y, z)
 	local self = Class.new(clss)
-	self.handle = Los.vector_new()
-	__userdata_lookup[self.handle] = self
-	Los.vector_set_x(self.handle, x)
-	Los.vector_set_y(self.handle, y)
-	Los.vector_set_z(self.handle, z)
+	self.handle = Los.vector_new(x, y, z)
+	return self
+end
+
+--- Adds another vector to the vector in place.
+-- @param self Vector.
+-- @param v Vector.
+-- @return Self.
+Vector.add_into = function(self, v)
+	Los.vector_add_into(self.handle, v.handle)
 	return self
 end
 
@@ -253,6 +264,13 @@ Vector.ceil = function(self)
 	return Vector(math.ceil(self.x), math.ceil(self.y), math.ceil(self.z))
 end
 
+--- Returns the components of the vector without creating a table.
+-- @param self Vector.
+-- @return X, Y and Z values.
+Vector.components = function(self)
+	return Los.vector_get_components(self.handle)
+end
+
 --- Returns a copy of the vector.
 -- @param self Vector.
 Vector.copy = function(self)
@@ -290,12 +308,42 @@ Vector.normalize = function(self)
 	return Class.new(Vector, {handle = handle})
 end
 
+--- Multiplies the vector by a scalar in place.
+-- @param self Vector.
+-- @param scalar Scalar.
+-- @return Self.
+Vector.mul_into = function(self, scalar)
+	Los.vector_mul_into(self.handle, scalar)
+	return self
+end
+
 --- Calculates the vector rounded to the nearest integers.
 -- @param self Vector.
 Vector.round = function(self)
 	return Vector(math.ceil(self.x + 0.5), math.ceil(self.y + 0.5), math.ceil(self.z + 0.5))
 end
 
+--- Sets all the components of the vector at once.<br/>
+-- Omitted components are set to zero.
+-- @param self Vector.
+-- @param x X value.
+-- @param y Y value.
+-- @param z Z value.
+-- @return Self.
+Vector.set_components = function(self, x, y, z)
+	Los.vector_set_components(self.handle, x, y, z)
+	return self
+end
+
+--- Subtracts another vector from the vector in place.
+-- @param self Vector.
+-- @param v Vector.
+-- @return Self.
+Vector.sub_into = function(self, v)
+	Los.vector_sub_into(self.handle, v.handle)
+	return self
+end
+
 --- Calculates the sum of two vectors.
 -- @param self Vector.
 -- @param v Vector.
@@ -388,4 +436,30 @@ Vector.unittest = function()
 	assert(d.x == 0 and d.y == 0 and d.z == 0)
 	d:normalize()
 	assert(d.x == 0 and d.y == 0 and d.z == 0)
+	-- In-place arithmetic.
+	local e = Vector(1,2,3)
+	assert(e:add_into(Vector(1,1,1)) == e)
+	e:sub_into(Vector(0,1,2)):mul_into(2)
+	local x,y,z = e:components()
+	assert(x == 4 and y == 4 and z == 4)
+	e:set_components(1,2)
+	assert(e.x == 1 and e.y == 2 and e.z == 0)
+	-- Allocation benchmark.
+	local count = 100000
+	collectgarbage("collect")
+	local t1 = Program.time
+	for i = 1,count do
+		local v = Vector(i, i, i) + Vector(1, 2, 3)
+	end
+	local t2 = Program.time
+	local acc = Vector()
+	local tmp = Vector()
+	for i = 1,count do
+		acc:add_into(tmp:set_components(i, i, i))
+	end
+	local t3 = Program.time
+	collectgarbage("collect")
+	local t4 = Program.time
+	print(string.format("Vector: %d temporaries %.3fs, in-place %.3fs, GC pause %.3fs",
+		2 * count, t2 - t1, t3 - t2, t4 - t3))
 end
@@ -19,7 +19,8 @@ end
 -- @param self Object.
 -- @param ... Arguments.<ul>
 --   <li>material: Material index.</li>
---   <li>vertices: Array of vertices.</li></ul>
+--   <li>vertices: Array of vertices.</li>
+--   <li>weld: True to merge vertices with matching existing vertices.</li></ul>
 Model.add_triangles = function(self, ...)
 	Los.model_add_triangles(self.handle, ...)
 end
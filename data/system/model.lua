@@ -30,7 +30,8 @@ Model.find = function(clss, args)
 	end
 end
 
---- Creates a copy of the model.
+--- Creates a copy of the model.<br/>
+-- The model data is shared until either of the models is modified.
 -- @param self Model.
 -- @return New model.
 Model.copy = function(self)
@@ -113,6 +114,7 @@ Model.unittest = function()
 	local m1 = m:copy()
 	assert(m1)
 	assert(m1.handle)
+	assert(m1.memory_used <= m.memory_used)
 	-- Function access.
 	m:calculate_bounds()
 end
@@ -1,3 +1,6 @@
+require "system/class"
+require "system/eventhandler"
+
 if not Los.program_load_extension("noise") then
 	error("loading extension `noise' failed")
 end
@@ -26,6 +29,10 @@ Noise.perlin_noise = function(self, ...)
 end
 
 --- Finds all noise coordinates whose values exceed a threshold and creates voxel terrain out of them.
+--
+-- The noise is evaluated a row at a time in a pool of worker threads. The
+-- values are identical to those of Noise.perlin_noise.
+--
 -- @param self Noise class.
 -- @param ... Arguments.<ul>
 --   <li>1,min: Range start position vector.</li>
@@ -60,14 +67,259 @@ end
 --   <li>6,octaves: Number of octaves.
 --   <li>7,persistence: Noise persistence.</li>
 --   <li>8,seed: Noise seed.</li></ul>
--- @return Table of vectors.
+-- @return Table of vectors, or nil on failure.
 Noise.perlin_threshold = function(self, ...)
 	local a,b,c,d,e,f,g,h = ...
+	local r
 	if a.class then
-		return Los.noise_perlin_threshold(a.handle, b.handle, c, d and d.handle, f, g, h)
+		r = Los.noise_perlin_threshold(a.handle, b.handle, c, d and d.handle, e, f, g, h)
 	else
-		return Los.noise_perlin_threshold(a.min.handle, a.max.handle,
+		r = Los.noise_perlin_threshold(a.min.handle, a.max.handle,
 			a.threshold, a.scale and a.scale.handle,
 			a.frequency, a.octaves, a.persistent, a.seed)
 	end
+	if not r then return end
+	for k,v in pairs(r) do
+		r[k] = Class.new(Vector, {handle = v})
+	end
+	return r
+end
+
+------------------------------------------------------------------------------
+
+NoiseBatch = Class()
+NoiseBatch.class_name = "NoiseBatch"
+NoiseBatch.dict_id = {}
+
+--- Creates a new terrain generation batch.<br/>
+-- The batch is a list of terrain editing commands that are executed in a
+-- pool of worker threads, one sector at a time. The commands affecting a
+-- sector are applied in the order in which they were added, so the result
+-- is the same as that of executing them one by one.
+-- @param clss NoiseBatch class.
+-- @return New batch.
+NoiseBatch.new = function(clss)
+	local self = Class.new(clss)
+	self.handle = Los.noise_batch_new()
+	__userdata_lookup[self.handle] = self
+	return self
+end
+
+--- Adds a command that fills a box with empty tiles.
+-- @param self Batch.
+-- @param min Range start position vector.
+-- @param max Range end position vector.
+NoiseBatch.carve = function(self, min, max)
+	Los.noise_batch_fill(self.handle, min.handle, max.handle, 0)
+end
+
+--- Removes all the commands of the batch.
+-- @param self Batch.
+NoiseBatch.clear = function(self)
+	Los.noise_batch_clear(self.handle)
+end
+
+--- Starts executing the commands in worker threads.<br/>
+-- The tiles of the affected sectors are copied when the execution starts
+-- and the results are pasted back to the map one sector at a time in the
+-- main thread as they're finished. Each paste emits a "noise-batch" event
+-- whose handler calls the progress callback with the number of finished
+-- and total sectors. The finish callback is called after the last sector
+-- with the number of sectors whose generation failed.
+-- Other changes to the affected sectors made while the batch is running
+-- are overwritten by the paste.
+-- @param self Batch.
+-- @param args Arguments.<ul>
+--   <li>finish: Function called with the number of failed sectors when the batch has finished.</li>
+--   <li>progress: Function called with the number of finished and total sectors.</li></ul>
+-- @return Batch ID or nil.
+NoiseBatch.execute = function(self, args)
+	local id = Los.noise_batch_execute(self.handle)
+	if not id then return end
+	self.finish = args and args.finish
+	self.progress = args and args.progress
+	NoiseBatch.dict_id[id] = self
+	return id
+end
+
+--- Adds a command that fills a box with tiles.
+-- @param self Batch.
+-- @param ... Arguments.<ul>
+--   <li>1,min: Range start position vector.</li>
+--   <li>2,max: Range end position vector.</li>
+--   <li>3,tile: Tile type.</li></ul>
+NoiseBatch.fill = function(self, ...)
+	local a,b,c = ...
+	if a.class then
+		Los.noise_batch_fill(self.handle, a.handle, b.handle, c)
+	else
+		Los.noise_batch_fill(self.handle, a.min.handle, a.max.handle, a.tile)
+	end
+end
+
+--- Adds a command that creates tiles where Perlin noise exceeds a threshold.<br/>
+-- The result is the same as that of Noise.perlin_terrain.
+-- @param self Batch.
+-- @param ... Arguments.<ul>
+--   <li>1,min: Range start position vector.</li>
+--   <li>2,max: Range end position vector.</li>
+--   <li>3,tile: Tile type.</li>
+--   <li>4,threshold: Threshold value.</li>
+--   <li>5,scale: Coordinate scale factor.</li>
+--   <li>6,frequency: Noise frequency.</li>
+--   <li>7,octaves: Number of octaves.
+--   <li>8,persistence: Noise persistence.</li>
+--   <li>9,seed: Noise seed.</li></ul>
+NoiseBatch.perlin = function(self, ...)
+	local a,b,c,d,e,f,g,h,i = ...
+	if a.class then
+		Los.noise_batch_perlin(self.handle, a.handle, b.handle, c, d, e and e.handle, f, g, h, i)
+	else
+		Los.noise_batch_perlin(self.handle, a.min.handle, a.max.handle,
+			a.tile, a.threshold, a.scale and a.scale.handle,
+			a.frequency, a.octaves, a.persistent, a.seed)
+	end
+end
+
+--- Adds a command that replaces tiles of one type with another.
+-- @param self Batch.
+-- @param ... Arguments.<ul>
+--   <li>1,min: Range start position vector.</li>
+--   <li>2,max: Range end position vector.</li>
+--   <li>3,match: Tile type to replace.</li>
+--   <li>4,tile: Replacement tile type.</li></ul>
+NoiseBatch.replace = function(self, ...)
+	local a,b,c,d = ...
+	if a.class then
+		Los.noise_batch_replace(self.handle, a.handle, b.handle, c, d)
+	else
+		Los.noise_batch_replace(self.handle, a.min.handle, a.max.handle, a.match, a.tile)
+	end
+end
+
+--- Waits for the batch to finish and pastes all the results to the map.<br/>
+-- The callbacks are still called by the event handler as usual.
+-- @param self Batch.
+NoiseBatch.wait = function(self)
+	Los.noise_batch_wait(self.handle)
+end
+
+--- Number of commands in the batch.
+-- @name NoiseBatch.commands
+-- @class table
+
+--- True if the batch is being executed.
+-- @name NoiseBatch.running
+-- @class table
+
+NoiseBatch:add_getters{
+	commands = function(self) return Los.noise_batch_get_commands(self.handle) end,
+	running = function(self) return Los.noise_batch_get_running(self.handle) end}
+
+-- Calls the callbacks of running batches.
+Eventhandler{type = "noise-batch", func = function(self, args)
+	local b = NoiseBatch.dict_id[args.id]
+	if not b then return end
+	if b.progress then b.progress(args.done, args.total) end
+	if args.done < args.total then return end
+	NoiseBatch.dict_id[args.id] = nil
+	if b.finish then b.finish(args.failed) end
+end}
+
+Noise.unittest = function()
+	-- Row evaluation must match point evaluation.
+	local args = {min = Vector(-7,10,20), max = Vector(20,14,23), threshold = 0.5,
+		scale = Vector(0.3,0.2,0.15), frequency = 3, octaves = 4, persistent = 0.25, seed = 77}
+	local found = {}
+	for k,v in pairs(Noise:perlin_threshold(args)) do
+		found[string.format("%d,%d,%d", v.x, v.y, v.z)] = true
+	end
+	for z = args.min.z,args.max.z-1 do
+		for y = args.min.y,args.max.y-1 do
+			for x = args.min.x,args.max.x-1 do
+				local n = Noise:perlin_noise{point = Vector(x,y,z), scale = args.scale, frequency = args.frequency,
+					octaves = args.octaves, persistent = args.persistent, seed = args.seed}
+				assert((n >= args.threshold) == (found[string.format("%d,%d,%d", x, y, z)] or false))
+			end
+		end
+	end
+	-- Generation throughput with the fractal terrain settings of the game.
+	local m = Material{name = "noise unittest"}
+	local org = Vector(1000,1000,1000)
+	local t = Program.time
+	Noise:perlin_terrain(org, org + Vector(64,64,64), m.id, 0.5, Vector(0.3,0.3,0.3), 4, 4, 0.25, 1234)
+	Noise:perlin_terrain(org, org + Vector(64,64,64), 0, 0.2, Vector(0.15,0.3,0.15), 2, 2, 0.3, 4321)
+	t = Program.time - t
+	print(string.format("Noise: 2x64^3 tiles: %.1f ms, %.2f M voxels/s", t * 1000, 2 * 64^3 / t / 1000000))
+	-- Batches must match the sequential dungeon generator.
+	local w = Voxel.tiles_per_line
+	local size = Vector(2*w,w,2*w)
+	local m2 = Material{name = "noise unittest 2"}
+	local generate = function(fill, perlin, replace)
+		for x = 0,1 do
+			for z = 0,1 do
+				local p = org + Vector(x*w,0,z*w)
+				local q = p + Vector(w,w,w)
+				fill(p, q, m.id)
+				perlin(p, q, m2.id, 0.5, Vector(0.6,0.6,0.6), 4, 4, 0.25, 1234)
+				perlin(p, q, 0, 0.1, Vector(0.3,0.6,0.3), 5, 5, 0.1, 4321)
+			end
+		end
+		fill(org + Vector(3,5,3), org + Vector(2*w-3,9,7), 0)
+		replace(org, org + Vector(w+5,w,2*w), m2.id, m.id)
+	end
+	local t1 = Program.time
+	generate(function(a, b, c)
+		Voxel:fill_region{point = a, size = b - a, tile = c}
+	end, function(...)
+		Noise:perlin_terrain(...)
+	end, function(a, b, c, d)
+		for z = a.z,b.z-1 do
+			for y = a.y,b.y-1 do
+				for x = a.x,b.x-1 do
+					local v = Vector(x,y,z)
+					if Voxel:get_tile(v) == c then Voxel:set_tile(v, d) end
+				end
+			end
+		end
+	end)
+	local t2 = Program.time
+	local tiles = {}
+	for z = 0,size.z-1 do
+		for y = 0,size.y-1 do
+			for x = 0,size.x-1 do
+				table.insert(tiles, Voxel:get_tile(org + Vector(x,y,z)))
+			end
+		end
+	end
+	Voxel:fill_region{point = org, size = size, tile = 0}
+	local b = NoiseBatch()
+	generate(function(...) b:fill(...) end, function(...) b:perlin(...) end, function(...) b:replace(...) end)
+	assert(b.commands == 14)
+	local done
+	local events = 0
+	local t3 = Program.time
+	b:execute{progress = function(n, t) events = events + 1 end, finish = function(f) done = f end}
+	local t4 = Program.time
+	while not done do
+		Program:update()
+		local e = Program:pop_event()
+		while e do
+			if e.type == "noise-batch" then Eventhandler:event(e) end
+			e = Program:pop_event()
+		end
+	end
+	local t5 = Program.time
+	assert(done == 0 and events >= 1 and not b.running)
+	local i = 1
+	for z = 0,size.z-1 do
+		for y = 0,size.y-1 do
+			for x = 0,size.x-1 do
+				assert(Voxel:get_tile(org + Vector(x,y,z)) == tiles[i])
+				i = i + 1
+			end
+		end
+	end
+	print(string.format("NoiseBatch: 2x1x2 sector dungeon: sequential %.1f ms, batch %.1f ms of which %.1f ms blocking",
+		1000 * (t2 - t1), 1000 * (t5 - t3), 1000 * (t4 - t3)))
 end
@@ -6,11 +6,19 @@ Object.class_name = "Object"
 --- Finds objects.
 -- @param clss Object class.
 -- @param args Arguments.<ul>
+--   <li>angle: Cone half angle in radians for cone search.</li>
+--   <li>class: Only return objects of this class.</li>
+--   <li>count: Number of nearest objects to return for nearest neighbor search.</li>
+--   <li>dir: Cone direction vector for cone search.</li>
 --   <li>id: Object ID for ID search.</li>
---   <li>point: Center point for radius search.</li>
---   <li>radius: Search radius for radius search.</li>
+--   <li>min: Minimum point for box search.</li>
+--   <li>max: Maximum point for box search.</li>
+--   <li>point: Center point for radius, cone or nearest neighbor search.</li>
+--   <li>radius: Search radius for radius, cone or nearest neighbor search.</li>
+--   <li>realized: True to only return realized objects.</li>
+--   <li>result: Table to store the results to instead of creating a new one.</li>
 --   <li>sector: Return all object in this sector.</li></ul>
--- @return Table of matching objects.
+-- @return Dictionary of matching objects keyed by ID.
 Object.find = function(self, args)
 	if args.id then
 		-- Search by ID.
@@ -24,15 +32,27 @@ Object.find = function(self, args)
 		return obj
 	else
 		-- Search by position or sector.
-		local list = Los.object_find{
+		-- The engine stores the matches directly to the result table.
+		local dict = Los.object_find{
+			angle = args.angle,
+			count = args.count,
+			dir = args.dir and args.dir.handle,
+			max = args.max and args.max.handle,
+			min = args.min and args.min.handle,
 			point = args.point and args.point.handle,
 			radius = args.radius,
+			realized = args.realized,
+			result = args.result,
 			sector = args.sector}
-		for k,v in pairs(list) do list[k] = __userdata_lookup[v] end
-		-- Create an easily searchable dictionary.
-		local dict = {}
-		for k,v in pairs(list) do
-			dict[v.id] = v
+		-- The engine only references the wrappers weakly, so objects whose
+		-- wrapper isn't alive are returned as userdata. Look them up like
+		-- before and filter by class in the same pass.
+		for k,v in pairs(dict) do
+			if type(v) == "userdata" then
+				v = __userdata_lookup[v]
+				dict[k] = v
+			end
+			if v and args.class and v.class ~= args.class then dict[k] = nil end
 		end
 		return dict
 	end
@@ -46,6 +66,7 @@ Object.new = function(clss, args)
 	local self = Class.new(clss)
 	self.handle = Los.object_new()
 	__userdata_lookup[self.handle] = self
+	Los.data_set_wrapper(self.handle, self)
 	if args then
 		for k,v in pairs(args) do
 			if k ~= "realized" then self[k] = v end
@@ -178,6 +199,26 @@ Object.unittest = function()
 		Program:update()
 		o.realized = false
 	end
+	-- Spatial queries.
+	do
+		local objs = {}
+		for i = 1,10 do
+			objs[i] = Object{position = Vector(1000 + 10*i,50,1000), realized = true}
+		end
+		local function num(t) local n = 0 for k,v in pairs(t) do n = n + 1 end return n end
+		local r1 = Object:find{point = Vector(1055,50,1000), radius = 12}
+		assert(num(r1) == 2 and r1[objs[5].id] and r1[objs[6].id])
+		local r2 = Object:find{min = Vector(1015,0,990), max = Vector(1045,100,1010)}
+		assert(num(r2) == 3 and r2[objs[2].id] and r2[objs[4].id])
+		local r3 = Object:find{point = Vector(1050,50,1000), radius = 100, dir = Vector(1,0,0), angle = 0.1}
+		assert(num(r3) == 6 and not r3[objs[4].id])
+		local r4 = Object:find{point = Vector(1000,50,1000), radius = 100, count = 2}
+		assert(num(r4) == 2 and r4[objs[1].id] and r4[objs[2].id])
+		local r5 = {}
+		assert(Object:find{point = Vector(1100,50,1000), radius = 1, result = r5} == r5)
+		assert(num(r5) == 1 and r5[objs[10].id])
+		for k,v in pairs(objs) do v.realized = false end
+	end
 	-- Unloading objects.
 	Program:unload_world()
 	for k,v in pairs(__objects_realized) do assert(false) end
@@ -8,6 +8,15 @@ end
 
 Thread = Class()
 
+local wrap_message = function(r)
+	if r.type == "model" and r.model then
+		r.model = Class.new(Model, {handle = r.model})
+	elseif r.type == "packet" and r.packet then
+		r.packet = Class.new(Packet, {handle = r.packet})
+	end
+	return r
+end
+
 --- Creates a new thread.
 -- @param clss Thread class.
 -- @param ... Arguments.<ul>
@@ -21,19 +30,65 @@ Thread.new = function(clss, ...)
 	return Class.new(Thread, {handle = h})
 end
 
+--- Starts the job worker pool.<br/>
+-- The workers are lightweight script states that have the standard Lua
+-- libraries but no access to the engine. The given script is loaded once
+-- to each worker and it should define the job functions as globals. Jobs
+-- are submitted with Thread:submit and their results are returned as
+-- events of type "job".
+-- @param clss Thread class.
+-- @param args Arguments.<ul>
+--   <li>code: Script code that defines the job functions.</li>
+--   <li>file: Script file that defines the job functions.</li>
+--   <li>workers: Number of workers. Defaults to the number of CPUs.</li></ul>
+-- @return Number of workers or nil.
+Thread.start_pool = function(clss, args)
+	return Los.thread_start_pool(args)
+end
+
+--- Stops the job worker pool.<br/>
+-- Running jobs are finished but queued jobs and unhandled results are discarded.
+-- @param clss Thread class.
+Thread.stop_pool = function(clss)
+	Los.thread_stop_pool()
+end
+
+--- Submits a job to the worker pool.<br/>
+-- The job function is called in one of the workers with the arguments as
+-- its only parameter. The arguments and the return value are copied between
+-- the script states, so they may only contain nil, booleans, numbers, strings
+-- and tables. When the job finishes, an event with the fields type="job",
+-- id, func, and result or error is pushed to the event queue.
+-- @param clss Thread class.
+-- @param func Name of the job function.
+-- @param args Arguments.
+-- @return Job ID or nil.
+Thread.submit = function(clss, func, args)
+	return Los.thread_submit(func, args)
+end
+
 --- Pops a message sent by the child script of the thread.
 -- @param self Thread.
 -- @return Message table or nil.
 Thread.pop_message = function(self)
 	local r = Los.thread_pop_message(self.handle)
 	if not r then return end
-	if r.type == "model" and r.model then
-		r.model = Class.new(Model, {handle = r.model})
-	end
+	return wrap_message(r)
+end
+
+--- Pops multiple messages sent by the child script of the thread.<br/>
+-- Popping messages in batches is cheaper than popping them one by one.
+-- @param self Thread.
+-- @param count Maximum number of messages to pop.
+-- @return List of message tables.
+Thread.pop_messages = function(self, count)
+	local r = Los.thread_pop_messages(self.handle, count)
+	for k,v in ipairs(r) do wrap_message(v) end
 	return r
 end
 
---- Pushes a message to the child script of the thread.
+--- Pushes a message to the child script of the thread.<br/>
+-- See Program.push_message for the supported arguments.
 -- @param self Thread.
 -- @param ... Message arguments.
 -- @return True on success.
@@ -41,6 +96,7 @@ Thread.push_message = function(self, ...)
 	local a = ...
 	if type(a) == "table" then
 		if a.model then a.model = a.model.handle end
+		if a.packet then a.packet = a.packet.handle end
 		return Los.thread_push_message(self.handle, a)
 	else
 		return Los.thread_push_message(self.handle, ...)
@@ -79,4 +135,70 @@ Thread.unittest = function()
 	assert(m.type == "model")
 	assert(m.model)
 	assert(m.model.class_name == "Model")
+	-- Packet moving.
+	print("Testing thread message packet moving...")
+	local t3 = Thread(nil, "", [[
+		require "system/core"
+		require "system/network"
+		local m
+		repeat m = Program:pop_message() until m
+		assert(m.type == "packet")
+		local ok,a,b = m.packet:read("uint32", "string")
+		assert(ok and a == 42 and b == "moved")
+		assert(Program:push_message{name = "reply", packet = m.packet, move = true})]])
+	local p = Packet(1, "uint32", 42, "string", "moved")
+	assert(t3:push_message{name = "packet", packet = p, move = true})
+	assert(p.size == 1)
+	repeat m = t3:pop_message() until m
+	assert(m.type == "packet" and m.name == "reply")
+	-- Batched message passing.
+	print("Testing thread batched message passing...")
+	local t4 = Thread(nil, "", [[
+		require "system/core"
+		for i = 1,100 do assert(Program:push_message("batch", tostring(i))) end]])
+	local msgs = {}
+	repeat
+		for k,v in ipairs(t4:pop_messages(64)) do table.insert(msgs, v) end
+	until #msgs == 100
+	for i = 1,100 do assert(msgs[i].string == tostring(i)) end
+	-- Message throughput.
+	print("Testing thread message throughput...")
+	local t5 = Thread(nil, "", [[
+		require "system/core"
+		local n = 0
+		while n < 100000 do
+			if Program:push_message("bench") then n = n + 1 end
+		end]])
+	local t = Program.time
+	local n = 0
+	while n < 100000 do n = n + #t5:pop_messages() end
+	print(string.format("  %d messages in %.3f seconds", n, Program.time - t))
+	-- Worker pool.
+	print("Testing thread worker pool...")
+	assert(Thread:start_pool{workers = 2, code = [[
+		function square(a) return {a[1] * a[1], s = a.s .. "!"} end
+		function fail() error("failed") end]]})
+	assert(not Thread:start_pool{workers = 2})
+	local jobs = {}
+	for i = 1,100 do jobs[Thread:submit("square", {i, s = "x"})] = i end
+	local fail = Thread:submit("fail")
+	local done = 0
+	local failed
+	while done < 100 or not failed do
+		Program:update()
+		local e = Program:pop_event()
+		if e and e.type == "job" then
+			if e.id == fail then
+				assert(e.error and not e.result)
+				failed = true
+			else
+				local i = jobs[e.id]
+				assert(i and e.func == "square")
+				assert(e.result[1] == i * i and e.result.s == "x!")
+				done = done + 1
+			end
+		end
+	end
+	Thread:stop_pool()
+	assert(not Thread:submit("square", {1}))
 end
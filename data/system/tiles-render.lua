@@ -1,3 +1,38 @@
+require "system/class"
+require "system/math"
+
 if not Los.program_load_extension("tiles-render") then
 	error("loading extension `tiles-render' failed")
 end
+
+------------------------------------------------------------------------------
+
+TilesRender = Class()
+TilesRender.class_name = "TilesRender"
+
+--- Center point of the terrain level of detail rings.<br/>
+-- Usually the position of the camera or the player.
+-- @name TilesRender.lod_center
+-- @class table
+
+--- Width of the terrain level of detail rings, in world units.<br/>
+-- Terrain blocks are built at a lower resolution every time their distance
+-- to the center grows by this amount. Zero disables the level of detail.
+-- @name TilesRender.lod_distance
+-- @class table
+
+--- Statistics of the rendered terrain.<br/>
+-- Contains the number of blocks and how many of them are at a reduced level
+-- of detail, the approximate memory used by their meshes in bytes, and the
+-- number of block builds and the total time spent building them in seconds.
+-- @name TilesRender.stats
+-- @class table
+
+TilesRender.class_getters = {
+	lod_center = function(s) return Class.new(Vector, {handle = Los.tiles_render_get_lod_center()}) end,
+	lod_distance = function(s) return Los.tiles_render_get_lod_distance() end,
+	stats = function(s) return Los.tiles_render_get_stats() end}
+
+TilesRender.class_setters = {
+	lod_center = function(s, v) Los.tiles_render_set_lod_center(v.handle) end,
+	lod_distance = function(s, v) Los.tiles_render_set_lod_distance(v) end}
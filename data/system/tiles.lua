@@ -140,6 +140,52 @@ Voxel.fill_region = function(self, args)
 	return Los.voxel_fill_region{point = args.point.handle, size = args.size.handle, tile = args.tile}
 end
 
+--- Fills or carves a box of tiles.<br/>
+-- All the tiles are modified in a single pass and each affected block is
+-- marked for rebuilding only once. If the tile is zero, the box is carved.
+-- @param self Voxel class.
+-- @param args Arguments.<ul>
+--   <li>match: Tile number to replace, or nil to replace all tiles.</li>
+--   <li>point: Tile index vector.</li>
+--   <li>size: Size vector, in tiles.</li>
+--   <li>tile: Tile number.</li></ul>
+-- @return Number of modified tiles.
+Voxel.fill_box = function(self, args)
+	local r = args.size * 0.5
+	return Los.voxel_fill_shape{shape = "box", center = (args.point + r).handle, radius = r.handle, match = args.match, tile = args.tile}
+end
+
+--- Fills or carves a vertical cylinder of tiles.<br/>
+-- A tile is modified if its center is inside the cylinder. If the tile is
+-- zero, the cylinder is carved.
+-- @param self Voxel class.
+-- @param args Arguments.<ul>
+--   <li>center: Center of the cylinder, in tiles.</li>
+--   <li>height: Height of the cylinder, in tiles.</li>
+--   <li>match: Tile number to replace, or nil to replace all tiles.</li>
+--   <li>radius: Radius of the cylinder, in tiles.</li>
+--   <li>tile: Tile number.</li></ul>
+-- @return Number of modified tiles.
+Voxel.fill_cylinder = function(self, args)
+	local r = Vector(args.radius, 0.5 * args.height, args.radius)
+	return Los.voxel_fill_shape{shape = "cylinder", center = args.center.handle, radius = r.handle, match = args.match, tile = args.tile}
+end
+
+--- Fills or carves a sphere of tiles.<br/>
+-- A tile is modified if its center is inside the sphere. If the tile is
+-- zero, the sphere is carved.
+-- @param self Voxel class.
+-- @param args Arguments.<ul>
+--   <li>center: Center of the sphere, in tiles.</li>
+--   <li>match: Tile number to replace, or nil to replace all tiles.</li>
+--   <li>radius: Radius of the sphere, in tiles.</li>
+--   <li>tile: Tile number.</li></ul>
+-- @return Number of modified tiles.
+Voxel.fill_sphere = function(self, args)
+	local r = Vector(args.radius, args.radius, args.radius)
+	return Los.voxel_fill_shape{shape = "sphere", center = args.center.handle, radius = r.handle, match = args.match, tile = args.tile}
+end
+
 --- Finds all blocks near the given point.
 -- @param self Voxel class.
 -- @param args Arguments.<ul>
@@ -150,6 +196,16 @@ Voxel.find_blocks = function(self, args)
 	return Los.voxel_find_blocks{point = args.point.handle, radius = args.radius}
 end
 
+--- Finds the topmost non-empty tile of each column in a box.
+-- @param self Voxel class.
+-- @param args Arguments.<ul>
+--   <li>point: Tile index vector.</li>
+--   <li>size: Size vector, in tiles.</li></ul>
+-- @return List of Y tile indices or false for empty columns, in rows along the X axis.
+Voxel.find_heights = function(self, args)
+	return Los.voxel_find_heights{point = args.point.handle, size = args.size.handle}
+end
+
 --- Finds the tile nearest to the given point.
 -- @param self Voxel class.
 -- @param args Arguments.<ul>
@@ -163,7 +219,10 @@ Voxel.find_tile = function(self, args)
 	return t, Class.new(Vector, {handle = p})
 end
 
---- Gets the data of a voxel block.
+--- Gets the data of a voxel block.<br/>
+-- The block is compressed and the compressed data is cached until the block
+-- changes or its sector is unloaded, so replicating the block to several
+-- clients only copies the cached data to each packet.
 -- @param self Voxel class.
 -- @param args Arguments.<ul>
 --   <li>index: Block index.</li>
@@ -173,6 +232,7 @@ end
 Voxel.get_block = function(self, args)
 	local handle = Los.voxel_get_block{index = args.index, packet = args.packet and args.packet.handle, type = args.type}
 	if args.packet then return args.packet end
+	if not handle then return end
 	return Class.new(Packet, {handle = handle})
 end
 
@@ -185,6 +245,16 @@ Voxel.get_tile = function(self, a)
 	return Los.voxel_get_tile(a.handle)
 end
 
+--- Gets the contents of multiple tiles.
+-- @param self Voxel class.
+-- @param points List of tile index vectors.
+-- @return List of tiles. Tiles outside the map are returned as zero.
+Voxel.get_tiles = function(self, points)
+	local h = {}
+	for k,v in ipairs(points) do h[k] = v.handle end
+	return Los.voxel_get_tiles{points = h}
+end
+
 --- Intersects a ray with map tiles.
 -- @param self Object.
 -- @param ... Arguments.<ul>
@@ -193,11 +263,46 @@ end
 -- @return Position vector in world space, tile index vector.
 Voxel.intersect_ray = function(self, ...)
 	local a,b = ...
-	if not a.class then
-		return Los.voxel_intersect_ray(a.handle, b.handle)
+	local p,t
+	if a.class then
+		p,t = Los.voxel_intersect_ray(a.handle, b.handle)
 	else
-		return Los.voxel_intersect_ray(a.start_point.handle, a.end_point.handle)
+		p,t = Los.voxel_intersect_ray(a.start_point.handle, a.end_point.handle)
+	end
+	if not p then return end
+	return Class.new(Vector, {handle = p}), Class.new(Vector, {handle = t})
+end
+
+--- Intersects multiple rays with map tiles.
+-- @param self Object.
+-- @param rays List of rays, each being a list of a start point and an end point in world space.
+-- @return List of tables with point and tile fields for rays that hit and false for the rest.
+Voxel.intersect_rays = function(self, rays)
+	local h = {}
+	for k,v in ipairs(rays) do
+		h[2 * k - 1] = v[1].handle
+		h[2 * k] = v[2].handle
+	end
+	local r = Los.voxel_intersect_rays{rays = h}
+	for k,v in ipairs(r) do
+		if v then
+			v.point = Class.new(Vector, {handle = v.point})
+			v.tile = Class.new(Vector, {handle = v.tile})
+		end
 	end
+	return r
+end
+
+--- Replaces tiles of one type with another inside a box.
+-- @param self Voxel class.
+-- @param args Arguments.<ul>
+--   <li>match: Tile number to replace.</li>
+--   <li>point: Tile index vector.</li>
+--   <li>size: Size vector, in tiles.</li>
+--   <li>tile: Tile number.</li></ul>
+-- @return Number of modified tiles.
+Voxel.replace_region = function(self, args)
+	return self:fill_box{point = args.point, size = args.size, match = args.match, tile = args.tile}
 end
 
 --- Pastes a terrain region from a packet to the map.
@@ -254,6 +359,18 @@ end
 -- @name Voxel.fill
 -- @class table
 
+--- Statistics of the compressed block cache.<br/>
+-- Contains the number of cached blocks, their size in bytes, and the numbers
+-- of cache hits and misses.
+-- @name Voxel.block_cache_stats
+-- @class table
+
+--- Greedy meshing toggle.<br/>
+-- When enabled, flat areas of cube tiles are merged into large faces when
+-- building the terrain models.
+-- @name Voxel.greedy
+-- @class table
+
 --- Approximate memory used by terrain, in bytes.
 -- @name Voxel.memory_used
 -- @class table
@@ -267,8 +384,10 @@ end
 -- @class table
 
 Voxel.class_getters = {
+	block_cache_stats = function(s) return Los.voxel_get_block_cache_stats() end,
 	blocks_per_line = function(s) return Los.voxel_get_blocks_per_line() end,
 	fill = function(s) return Los.voxel_get_fill() end,
+	greedy = function(s) return Los.voxel_get_greedy() end,
 	materials = function(s) return Los.voxel_get_materials() end,
 	memory_used = function(s) return Los.voxel_get_memory_used() end,
 	tiles_per_line = function(s) return Los.voxel_get_tiles_per_line() end}
@@ -276,6 +395,7 @@ Voxel.class_getters = {
 Voxel.class_setters = {
 	blocks_per_line = function(s, v) Los.voxel_set_blocks_per_line(v) end,
 	fill = function(s, v) Los.voxel_set_fill(v) end,
+	greedy = function(s, v) Los.voxel_set_greedy(v) end,
 	tiles_per_line = function(s, v) Los.voxel_set_tiles_per_line(v) end}
 
 Voxel.unittest = function()
@@ -283,4 +403,274 @@ Voxel.unittest = function()
 	assert(Voxel:get_tile(Vector(100,101,102)) == 0)
 	Voxel:set_tile(Vector(100,101,102), 5)
 	assert(Voxel:get_tile(Vector(100,101,102)) == 5)
+	-- Meshing options.
+	assert(Voxel.greedy)
+	Voxel.greedy = false
+	assert(not Voxel.greedy)
+	Voxel.greedy = true
+	-- Ray casts.
+	local m = Material{name = "unittest"}
+	Voxel:set_tile(Vector(100,101,102), m.id)
+	local w = Program.sector_size / Voxel.tiles_per_line
+	local p,t = Voxel:intersect_ray(Vector(90.5,101.5,102.5) * w, Vector(110.5,101.5,102.5) * w)
+	assert(p and t.x == 100 and t.y == 101 and t.z == 102)
+	assert(math.abs(p.x - 100 * w) < 0.001)
+	assert(not Voxel:intersect_ray(Vector(90.5,101.5,102.5) * w, Vector(99.5,101.5,102.5) * w))
+	local r = Voxel:intersect_rays{
+		{Vector(100.5,90.5,102.5) * w, Vector(100.5,110.5,102.5) * w},
+		{Vector(100.5,90.5,102.5) * w, Vector(100.5,95.5,102.5) * w},
+		{Vector(110.5,101.5,102.5) * w, Vector(90.5,101.5,102.5) * w}}
+	assert(#r == 3)
+	assert(r[1] and r[1].tile.y == 101 and math.abs(r[1].point.y - 101 * w) < 0.001)
+	assert(r[2] == false)
+	assert(r[3] and r[3].tile.x == 100 and math.abs(r[3].point.x - 101 * w) < 0.001)
+	-- Block replication.
+	local index = next(Voxel:find_blocks{point = Vector(100.5,101.5,102.5) * w, radius = 0.1 * w})
+	local s = Voxel.block_cache_stats
+	local p1 = Voxel:get_block{index = index, type = 1}
+	local p2 = Voxel:get_block{index = index, type = 1}
+	local c = Voxel.block_cache_stats
+	assert(p1 ~= p2 and p1.size == p2.size)
+	assert(c.misses == s.misses + 1 and c.hits == s.hits + 1)
+	assert(p1.size < 10 + (Voxel.tiles_per_line / Voxel.blocks_per_line) ^ 3)
+	Voxel:set_tile(Vector(100,101,102), 0)
+	local p3 = Voxel:get_block{index = index, type = 1}
+	assert(Voxel.block_cache_stats.misses == c.misses + 1)
+	-- Bulk edits.
+	local o = Vector(200,200,200)
+	assert(Voxel:fill_box{point = o, size = Vector(8,4,8), tile = m.id} == 256)
+	assert(Voxel:get_tile(o + Vector(7,3,7)) == m.id and Voxel:get_tile(o + Vector(8,3,7)) == 0)
+	assert(Voxel:fill_sphere{center = o + Vector(4,4,4), radius = 1, tile = 0} == 4)
+	assert(Voxel:get_tile(o + Vector(3,3,3)) == 0 and Voxel:get_tile(o + Vector(3,2,3)) == m.id)
+	assert(Voxel:replace_region{point = o, size = Vector(8,1,8), match = m.id, tile = 5} == 64)
+	assert(Voxel:fill_cylinder{center = o + Vector(4,2,4), radius = 2, height = 4, match = 0, tile = 5} == 4)
+	local t = Voxel:get_tiles{o, o + Vector(0,1,0), o + Vector(3,3,3), o + Vector(4,3,4), Vector(-1,0,0)}
+	assert(#t == 5 and t[1] == 5 and t[2] == m.id and t[3] == 5 and t[4] == 5 and t[5] == 0)
+	local h = Voxel:find_heights{point = o + Vector(3,-2,3), size = Vector(2,20,1)}
+	assert(#h == 2 and h[1] == 203 and h[2] == 203)
+	assert(Voxel:find_heights{point = o + Vector(20,0,0), size = Vector(1,20,1)}[1] == false)
+	-- Bulk edit benchmark.
+	local t1 = Program.time
+	for x = 0,15 do
+		for y = 0,15 do
+			for z = 0,15 do
+				if (Vector(x,y,z) - Vector(7.5,7.5,7.5)).length < 8 then
+					Voxel:set_tile(o + Vector(x,y,z), 0)
+				end
+			end
+		end
+	end
+	local t2 = Program.time
+	Voxel:fill_sphere{center = o + Vector(8,8,8), radius = 8, tile = m.id}
+	local t3 = Program.time
+	local points = {}
+	for i = 1,1000 do points[i] = o + Vector(i % 16, i % 7, i % 13) end
+	local t4 = Program.time
+	local single = {}
+	for k,v in ipairs(points) do single[k] = Voxel:get_tile(v) end
+	local t5 = Program.time
+	local batch = Voxel:get_tiles(points)
+	local t6 = Program.time
+	assert(#batch == 1000)
+	for k,v in ipairs(single) do assert(batch[k] == v) end
+	print(string.format("Voxel: 16^3 sphere: set_tile %.1f ms, fill_sphere %.1f ms; 1000 probes: get_tile %.1f ms, get_tiles %.1f ms",
+		(t2 - t1) * 1000, (t3 - t2) * 1000, (t5 - t4) * 1000, (t6 - t5) * 1000))
+	Voxel:fill_box{point = o, size = Vector(16,16,16), tile = 0}
+end
+
+------------------------------------------------------------------------------
+
+TerrainStore = Class()
+TerrainStore.class_name = "TerrainStore"
+
+--- Opens a terrain store.<br/>
+-- The store keeps the terrain of each sector compressed in memory mapped
+-- region files so that sectors can be loaded without going through SQLite.
+-- Sectors are written to free space and only then swapped in, so a crash
+-- in the middle of a save never loses the previous version of a sector.
+-- @param clss TerrainStore class.
+-- @param args Arguments.<ul>
+--   <li>1,name: Unique directory name.</li>
+--   <li>sync: False to skip flushing writes to the disk.</li></ul>
+-- @return New terrain store.
+TerrainStore.new = function(clss, args)
+	local self = Class.new(clss)
+	self.handle = Los.terrain_store_new(args)
+	if not self.handle then
+		local n = (type(args) == "string") and args or args.name
+		assert(self.handle, string.format("creating terrain store %q failed", n))
+	end
+	__userdata_lookup[self.handle] = self
+	return self
+end
+
+--- Begins a batch of writes.<br/>
+-- Until the batch is committed, saved and erased sectors are only visible
+-- to this store. The files keep referring to the old sectors so that the
+-- commit can be ordered with other writes, such as a database transaction.
+-- @param self Terrain store.
+TerrainStore.begin = function(self)
+	Los.terrain_store_begin(self.handle)
+end
+
+--- Commits the batch of writes.<br/>
+-- The sectors written by the batch are flushed to the disk at once and
+-- then swapped in, so each region file is synced only twice per batch. A
+-- crash during the commit leaves each sector in either its old or its new
+-- state.
+-- @param self Terrain store.
+-- @return True on success.
+TerrainStore.commit = function(self)
+	return Los.terrain_store_commit(self.handle)
+end
+
+--- Removes all sectors from the store.<br/>
+-- Inside a batch, the region files are deleted when the batch is committed.
+-- @param self Terrain store.
+-- @return True on success.
+TerrainStore.erase_all = function(self)
+	return Los.terrain_store_erase_all(self.handle)
+end
+
+--- Removes a sector from the store.
+-- @param self Terrain store.
+-- @param sector Sector index.
+-- @return True if the sector was stored.
+TerrainStore.erase_sector = function(self, sector)
+	return Los.terrain_store_erase(self.handle, sector)
+end
+
+--- Loads the terrain of a sector from the store.<br/>
+-- The stored tiles are decompressed directly into the sector, replacing
+-- its old contents.
+-- @param self Terrain store.
+-- @param sector Sector index.
+-- @return True if the sector was stored and valid.
+TerrainStore.load_sector = function(self, sector)
+	return Los.terrain_store_load(self.handle, sector)
+end
+
+--- Saves the terrain of a sector to the store.
+-- @param self Terrain store.
+-- @param sector Sector index.
+-- @return True on success.
+TerrainStore.save_sector = function(self, sector)
+	return Los.terrain_store_save(self.handle, sector)
+end
+
+--- Statistics of the store.<br/>
+-- Contains the numbers of corrupt, missing, read and written sectors, the
+-- number of disk syncs, the number of open region files and their total
+-- size in bytes.
+-- @name TerrainStore.stats
+-- @class table
+
+--- Flushes writes to the disk when true.
+-- @name TerrainStore.sync
+-- @class table
+
+TerrainStore:add_getters{
+	stats = function(self) return Los.terrain_store_get_stats(self.handle) end,
+	sync = function(self) return Los.terrain_store_get_sync(self.handle) end}
+
+TerrainStore:add_setters{
+	sync = function(self, v) Los.terrain_store_set_sync(self.handle, v) end}
+
+TerrainStore.unittest = function()
+	-- Create terrain for a cube of 10x10x10 sectors.
+	local m = Material{name = "unittest-store"}
+	local n = Voxel.tiles_per_line
+	local o = Vector(100,0,100) * n
+	local old = Program.sectors
+	Voxel:fill_box{point = o, size = Vector(10,5,10) * n, tile = m.id}
+	Voxel:fill_box{point = o + Vector(0,5,0) * n, size = Vector(10,5,10) * n, tile = 0}
+	for i = 0,99 do
+		local c = o + Vector(i % 10 + 0.5, 5, math.floor(i / 10) + 0.5) * n
+		Voxel:fill_sphere{center = c, radius = 0.4 * n, tile = (i % 2 == 0) and 0 or 5}
+	end
+	local sectors = {}
+	for k in pairs(Program.sectors) do
+		if not old[k] then table.insert(sectors, k) end
+	end
+	assert(#sectors == 1000)
+	local samples = {}
+	local points = {}
+	for i = 1,1000 do points[i] = o + Vector(i % 160, (i * 7) % 160, (i * 13) % 160) end
+	local expect = Voxel:get_tiles(points)
+	assert(#expect == 1000)
+	for k,v in ipairs(points) do assert(expect[k] == Voxel:get_tile(v)) end
+	local unload = function()
+		for k,v in ipairs(sectors) do Program:unload_sector{sector = v} end
+	end
+	-- Saving and loading.
+	local s = TerrainStore{name = "unittest-terrain", sync = false}
+	assert(not s.sync)
+	s:erase_all()
+	assert(not s:load_sector(sectors[1]))
+	assert(s.stats.misses == 1)
+	local t1 = Program.time
+	for k,v in ipairs(sectors) do assert(s:save_sector(v)) end
+	local t2 = Program.time
+	unload()
+	local t3 = Program.time
+	for k,v in ipairs(sectors) do assert(s:load_sector(v)) end
+	local t4 = Program.time
+	local got = Voxel:get_tiles(points)
+	for k,v in ipairs(expect) do assert(got[k] == v) end
+	local stats = s.stats
+	assert(stats.reads == 1000 and stats.writes == 1000 and stats.corrupt == 0)
+	assert(stats.size > 0 and stats.regions > 0)
+	-- Overwriting reuses the freed slots.
+	for k,v in ipairs(sectors) do assert(s:save_sector(v)) end
+	assert(s.stats.size <= 2 * stats.size)
+	-- Reopening sees the saved sectors.
+	local r = TerrainStore{name = "unittest-terrain"}
+	assert(r.sync)
+	unload()
+	assert(r:load_sector(sectors[2]))
+	assert(r:erase_sector(sectors[2]))
+	assert(not r:load_sector(sectors[2]))
+	assert(not s:load_sector(sectors[2]))
+	r = nil
+	collectgarbage("collect")
+	-- Batches are synced once per region and hidden until committed.
+	local b = TerrainStore{name = "unittest-terrain"}
+	-- Sector 2 was erased but is still loaded, so every sector is loaded
+	-- for the SQLite benchmark after this.
+	for i = 1,1000 do assert(b:load_sector(sectors[i]) or i == 2) end
+	b:begin()
+	assert(b:erase_sector(sectors[3]))
+	for i = 4,1000 do assert(b:save_sector(sectors[i])) end
+	assert(b.stats.syncs == 0)
+	assert(not b:load_sector(sectors[3]) and s:load_sector(sectors[3]))
+	assert(b:commit())
+	assert(b.stats.syncs > 0 and b.stats.syncs <= 2 * b.stats.regions)
+	assert(not s:load_sector(sectors[3]))
+	b = nil
+	collectgarbage("collect")
+	-- SQLite benchmark.
+	local d = Database("unittest-terrain.sqlite")
+	d:query("PRAGMA synchronous=OFF;")
+	d:query("DROP TABLE IF EXISTS terrain;")
+	d:query("CREATE TABLE terrain (sector INTEGER PRIMARY KEY,data BLOB);")
+	local t5 = Program.time
+	d:query("BEGIN TRANSACTION;")
+	for k,v in ipairs(sectors) do
+		d:query("INSERT INTO terrain (sector,data) VALUES (?,?);", {v, Voxel:copy_region{sector = v}})
+	end
+	d:query("END TRANSACTION;")
+	local t6 = Program.time
+	unload()
+	local t7 = Program.time
+	for k,v in ipairs(sectors) do
+		local rows = d:query("SELECT * FROM terrain WHERE sector=?;", {v})
+		Voxel:paste_region{sector = v, packet = rows[1][2]}
+	end
+	local t8 = Program.time
+	got = Voxel:get_tiles(points)
+	for k,v in ipairs(expect) do assert(got[k] == v) end
+	print(string.format("TerrainStore: 1000 sectors: save %.1f ms, load %.1f ms; SQLite save %.1f ms, load %.1f ms; %d bytes",
+		1000 * (t2 - t1), 1000 * (t4 - t3), 1000 * (t6 - t5), 1000 * (t8 - t7), stats.size))
+	unload()
+	s:erase_all()
 end
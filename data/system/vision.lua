@@ -63,7 +63,7 @@ Vision.update = function(self)
 	for k,v in ipairs(e) do
 		-- Translate the object handle.
 		if v.object then
-			v.object = __userdata_lookup[v.object]
+			if type(v.object) == "userdata" then v.object = __userdata_lookup[v.object] end
 			self.objects[v.object] = (v.type == "object-shown") and true or nil
 		end
 		-- Call the callback.
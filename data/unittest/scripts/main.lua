@@ -7,6 +7,11 @@ end
 
 Los.program_unittest()
 
+-- The engine benchmarks are slow, so they only run when requested.
+if Los.program_get_args() == "benchmark" then
+	Los.program_benchmark()
+end
+
 require "system/class"
 catch(function() Class.unittest() end)
 
@@ -37,8 +42,13 @@ catch(function() Material.unittest() end)
 catch(function() Voxel.unittest() end)
 catch(function() Ai.unittest() end)
 
+require "system/noise"
+catch(function() Noise.unittest() end)
+
 require "system/database"
+require "system/network"
 catch(function() Database.unittest() end)
+catch(function() TerrainStore.unittest() end)
 
 require "system/vision"
 catch(function() Vision.unittest() end)
@@ -103,6 +113,8 @@ end
 
 -- Checks for valgrind.
 require "system/tiles-render"
+TilesRender.lod_center = Vector(100,100,100)
+TilesRender.lod_distance = 20
 local mat = Material{name = "test1", shader = "default", type = "rounded"}
 for i=1,100 do
 	Voxel:set_tile(Vector(100+10*i,100,100), mat.id)
@@ -89,5 +89,41 @@ void liarc_packet_free (
 	lisys_free (self);
 }
 
+/**
+ * \brief Turns a writable packet into a readable one without copying.
+ *
+ * The buffer of the writer is handed over to a new reader so that the packet
+ * can be moved to another thread and read there.
+ *
+ * \param self Packet.
+ * \return Nonzero on success.
+ */
+int liarc_packet_set_readable (
+	LIArcPacket* self)
+{
+	int length;
+	char* buffer;
+	LIArcReader* reader;
+
+	if (self->writer == NULL)
+		return 1;
+
+	/* Allocate the reader. */
+	buffer = self->writer->memory.buffer;
+	length = self->writer->memory.length;
+	reader = liarc_reader_new (buffer, length);
+	if (reader == NULL)
+		return 0;
+
+	/* Steal the buffer from the writer. */
+	self->writer->memory.buffer = NULL;
+	liarc_writer_free (self->writer);
+	self->writer = NULL;
+	self->buffer = buffer;
+	self->reader = reader;
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -33,5 +33,6 @@ struct _LIArcPacket
 LIAPICALL (LIArcPacket*, liarc_packet_new_readable, (const char* buffer, int length));
 LIAPICALL (LIArcPacket*, liarc_packet_new_writable, (int type));
 LIAPICALL (void, liarc_packet_free, (LIArcPacket* self));
+LIAPICALL (int, liarc_packet_set_readable, (LIArcPacket* self));
 
 #endif
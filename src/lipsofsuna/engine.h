@@ -19,9 +19,11 @@
 #define __LIPS_ENGINE_H__
 
 #include "engine/engine.h"
+#include "engine/engine-grid.h"
 #include "engine/engine-model.h"
 #include "engine/engine-object.h"
 #include "engine/engine-sector.h"
 #include "engine/engine-types.h"
+#include "engine/engine-unittest.h"
 
 #endif
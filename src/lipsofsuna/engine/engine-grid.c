@@ -0,0 +1,493 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LIEng Engine
+ * @{
+ * \addtogroup LIEngGrid Grid
+ * @{
+ */
+
+#include "engine.h"
+#include "engine-grid.h"
+
+typedef struct _LIEngGridNearest LIEngGridNearest;
+struct _LIEngGridNearest
+{
+	int count;
+	int found;
+	float* dist;
+	void* data;
+	LIEngGridFunc filter;
+	LIEngObject** result;
+	LIMatVector point;
+};
+
+static LIEngGridBucket* private_bucket (
+	LIEngGrid* self,
+	int        x,
+	int        y,
+	int        z);
+
+static int private_find (
+	LIEngGrid*         self,
+	const LIMatAabb*   box,
+	const LIMatVector* center,
+	float              radius,
+	LIEngGridFunc      func,
+	void*              data);
+
+static int private_find_bucket (
+	LIEngGridBucket*   bucket,
+	const LIMatAabb*   box,
+	const LIMatVector* center,
+	float              radius2,
+	LIEngGridFunc      func,
+	void*              data);
+
+static int private_nearest (
+	void*        data,
+	LIEngObject* object);
+
+static float private_range (
+	const LIEngGrid* self,
+	const LIMatAabb* box,
+	int*             min,
+	int*             max);
+
+static int private_reserve (
+	LIEngGridBucket* bucket);
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new object grid.
+ *
+ * The grid is a loose uniform grid that stores objects by the cell
+ * their position is in. The infinite set of cells is hashed to a fixed
+ * number of buckets so the memory use doesn't depend on the extents of
+ * the world. Queries check the exact positions so hash collisions only
+ * add candidates, never incorrect results.
+ *
+ * \param cell_size Size of a grid cell in world units.
+ * \return New grid or NULL.
+ */
+LIEngGrid* lieng_grid_new (
+	float cell_size)
+{
+	LIEngGrid* self;
+
+	self = lisys_calloc (1, sizeof (LIEngGrid));
+	if (self == NULL)
+		return NULL;
+	self->cell_size = cell_size;
+
+	return self;
+}
+
+/**
+ * \brief Frees the grid.
+ * \param self Grid.
+ */
+void lieng_grid_free (
+	LIEngGrid* self)
+{
+	int i;
+
+	for (i = 0 ; i < LIENG_GRID_BUCKETS ; i++)
+		lisys_free (self->buckets[i].array);
+	lisys_free (self);
+}
+
+/**
+ * \brief Finds objects inside an axis-aligned bounding box.
+ * \param self Grid.
+ * \param box Bounding box in world space.
+ * \param func Function called for each found object or NULL.
+ * \param data Userdata passed to the function.
+ * \return Number of found objects.
+ */
+int lieng_grid_find_box (
+	LIEngGrid*       self,
+	const LIMatAabb* box,
+	LIEngGridFunc    func,
+	void*            data)
+{
+	return private_find (self, box, NULL, 0.0f, func, data);
+}
+
+/**
+ * \brief Finds the objects nearest to the given point.
+ *
+ * The search starts from a radius of one grid cell and is expanded until
+ * enough objects are found or the maximum search radius is reached. The
+ * results are sorted by distance so that the nearest object is first.
+ *
+ * \param self Grid.
+ * \param point Center point in world space.
+ * \param radius Maximum search radius.
+ * \param filter Function returning nonzero for acceptable objects or NULL.
+ * \param data Userdata passed to the filter.
+ * \param result Return location for up to count objects.
+ * \param count Maximum number of objects to return.
+ * \return Number of found objects.
+ */
+int lieng_grid_find_nearest (
+	LIEngGrid*         self,
+	const LIMatVector* point,
+	float              radius,
+	LIEngGridFunc      filter,
+	void*              data,
+	LIEngObject**      result,
+	int                count)
+{
+	int min[3];
+	int max[3];
+	float r;
+	LIMatAabb box;
+	LIEngGridNearest nearest;
+
+	if (count <= 0)
+		return 0;
+	nearest.dist = lisys_calloc (count, sizeof (float));
+	if (nearest.dist == NULL)
+		return 0;
+	nearest.count = count;
+	nearest.data = data;
+	nearest.filter = filter;
+	nearest.result = result;
+	nearest.point = *point;
+
+	/* Expand the search radius until enough objects have been found. */
+	r = LIMAT_MIN (self->cell_size, radius);
+	while (1)
+	{
+		nearest.found = 0;
+		box.min = limat_vector_subtract (*point, limat_vector_init (r, r, r));
+		box.max = limat_vector_add (*point, limat_vector_init (r, r, r));
+		private_find (self, &box, point, r, private_nearest, &nearest);
+		if (nearest.found >= count || r >= radius)
+			break;
+		/* Once the box covers all the buckets, doubling it again only costs
+		   more full scans, so the last scan uses the full radius. */
+		if (private_range (self, &box, min, max) >= LIENG_GRID_BUCKETS)
+			r = radius;
+		else
+			r = LIMAT_MIN (2.0f * r, radius);
+	}
+	lisys_free (nearest.dist);
+
+	return LIMAT_MIN (nearest.found, count);
+}
+
+/**
+ * \brief Finds objects inside a sphere.
+ * \param self Grid.
+ * \param point Center point in world space.
+ * \param radius Radius of the sphere.
+ * \param func Function called for each found object or NULL.
+ * \param data Userdata passed to the function.
+ * \return Number of found objects.
+ */
+int lieng_grid_find_sphere (
+	LIEngGrid*         self,
+	const LIMatVector* point,
+	float              radius,
+	LIEngGridFunc      func,
+	void*              data)
+{
+	LIMatAabb box;
+
+	box.min = limat_vector_subtract (*point, limat_vector_init (radius, radius, radius));
+	box.max = limat_vector_add (*point, limat_vector_init (radius, radius, radius));
+
+	return private_find (self, &box, point, radius, func, data);
+}
+
+/**
+ * \brief Inserts an object to the grid.
+ * \param self Grid.
+ * \param object Object.
+ * \return Nonzero on success.
+ */
+int lieng_grid_insert (
+	LIEngGrid*   self,
+	LIEngObject* object)
+{
+	LIEngGridBucket* bucket;
+	const LIMatVector* p;
+
+	lisys_assert (object->grid_bucket == NULL);
+
+	/* Find the bucket. */
+	p = &object->transform.position;
+	bucket = private_bucket (self,
+		(int) floorf (p->x / self->cell_size),
+		(int) floorf (p->y / self->cell_size),
+		(int) floorf (p->z / self->cell_size));
+
+	/* Append to the bucket. */
+	if (!private_reserve (bucket))
+		return 0;
+	object->grid_bucket = bucket;
+	object->grid_index = bucket->count;
+	bucket->array[bucket->count++] = object;
+
+	return 1;
+}
+
+/**
+ * \brief Removes an object from the grid.
+ * \param self Grid.
+ * \param object Object.
+ */
+void lieng_grid_remove (
+	LIEngGrid*   self,
+	LIEngObject* object)
+{
+	LIEngObject* last;
+	LIEngGridBucket* bucket;
+
+	bucket = object->grid_bucket;
+	if (bucket == NULL)
+		return;
+	last = bucket->array[--bucket->count];
+	bucket->array[object->grid_index] = last;
+	last->grid_index = object->grid_index;
+	object->grid_bucket = NULL;
+	object->grid_index = 0;
+}
+
+/**
+ * \brief Moves the object to the correct bucket after its position changed.
+ *
+ * If there is not enough memory for moving the object, it's left to its
+ * old bucket and zero is returned.
+ *
+ * \param self Grid.
+ * \param object Object.
+ * \return Nonzero on success.
+ */
+int lieng_grid_update (
+	LIEngGrid*   self,
+	LIEngObject* object)
+{
+	LIEngGridBucket* bucket;
+	const LIMatVector* p;
+
+	p = &object->transform.position;
+	bucket = private_bucket (self,
+		(int) floorf (p->x / self->cell_size),
+		(int) floorf (p->y / self->cell_size),
+		(int) floorf (p->z / self->cell_size));
+	if (bucket == object->grid_bucket)
+		return 1;
+	if (!private_reserve (bucket))
+		return 0;
+	lieng_grid_remove (self, object);
+
+	return lieng_grid_insert (self, object);
+}
+
+/*****************************************************************************/
+
+static LIEngGridBucket* private_bucket (
+	LIEngGrid* self,
+	int        x,
+	int        y,
+	int        z)
+{
+	uint32_t hash;
+
+	hash = ((uint32_t) x * 73856093) ^ ((uint32_t) y * 19349663) ^ ((uint32_t) z * 83492791);
+
+	return self->buckets + (hash & (LIENG_GRID_BUCKETS - 1));
+}
+
+static int private_find (
+	LIEngGrid*         self,
+	const LIMatAabb*   box,
+	const LIMatVector* center,
+	float              radius,
+	LIEngGridFunc      func,
+	void*              data)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	int num = 0;
+	int min[3];
+	int max[3];
+	float cells;
+	float radius2;
+	LIEngGridBucket* bucket;
+
+	/* Calculate the cell range. */
+	cells = private_range (self, box, min, max);
+	radius2 = radius * radius;
+
+	/* Scan all buckets if the range is large. */
+	if (cells >= LIENG_GRID_BUCKETS)
+	{
+		for (i = 0 ; i < LIENG_GRID_BUCKETS ; i++)
+			num += private_find_bucket (self->buckets + i, box, center, radius2, func, data);
+		return num;
+	}
+
+	/* Mark visited buckets since several cells can hash to the same one. */
+	if (++self->stamp == 0)
+	{
+		for (i = 0 ; i < LIENG_GRID_BUCKETS ; i++)
+			self->buckets[i].stamp = 0;
+		self->stamp = 1;
+	}
+
+	/* Scan the buckets of the cells in range. */
+	for (z = min[2] ; z <= max[2] ; z++)
+	for (y = min[1] ; y <= max[1] ; y++)
+	for (x = min[0] ; x <= max[0] ; x++)
+	{
+		bucket = private_bucket (self, x, y, z);
+		if (bucket->stamp == self->stamp)
+			continue;
+		bucket->stamp = self->stamp;
+		num += private_find_bucket (bucket, box, center, radius2, func, data);
+	}
+
+	return num;
+}
+
+static int private_find_bucket (
+	LIEngGridBucket*   bucket,
+	const LIMatAabb*   box,
+	const LIMatVector* center,
+	float              radius2,
+	LIEngGridFunc      func,
+	void*              data)
+{
+	int i;
+	int num = 0;
+	LIMatVector d;
+	LIEngObject* object;
+	const LIMatVector* p;
+
+	for (i = 0 ; i < bucket->count ; i++)
+	{
+		object = bucket->array[i];
+		p = &object->transform.position;
+		if (p->x < box->min.x || p->x > box->max.x ||
+		    p->y < box->min.y || p->y > box->max.y ||
+		    p->z < box->min.z || p->z > box->max.z)
+			continue;
+		if (center != NULL)
+		{
+			d = limat_vector_subtract (*p, *center);
+			if (limat_vector_dot (d, d) > radius2)
+				continue;
+		}
+		if (func != NULL)
+			func (data, object);
+		num++;
+	}
+
+	return num;
+}
+
+static int private_nearest (
+	void*        data,
+	LIEngObject* object)
+{
+	int i;
+	float dist;
+	LIMatVector d;
+	LIEngGridNearest* self = data;
+
+	/* Filter the object. */
+	if (self->filter != NULL && !self->filter (self->data, object))
+		return 0;
+
+	/* Find the insertion position. */
+	d = limat_vector_subtract (object->transform.position, self->point);
+	dist = limat_vector_dot (d, d);
+	i = LIMAT_MIN (self->found, self->count);
+	if (i == self->count && dist >= self->dist[i - 1])
+		return 0;
+	if (i == self->count)
+		i--;
+
+	/* Insert sorted by distance. */
+	for ( ; i > 0 && self->dist[i - 1] > dist ; i--)
+	{
+		self->dist[i] = self->dist[i - 1];
+		self->result[i] = self->result[i - 1];
+	}
+	self->dist[i] = dist;
+	self->result[i] = object;
+	self->found++;
+
+	return 1;
+}
+
+static float private_range (
+	const LIEngGrid* self,
+	const LIMatAabb* box,
+	int*             min,
+	int*             max)
+{
+	int i;
+	float tmp[6];
+
+	/* The box can be infinite, for example when searching with an
+	   infinite radius, so the cell coordinates are clamped before they
+	   are converted to integers. */
+	tmp[0] = floorf (box->min.x / self->cell_size);
+	tmp[1] = floorf (box->min.y / self->cell_size);
+	tmp[2] = floorf (box->min.z / self->cell_size);
+	tmp[3] = floorf (box->max.x / self->cell_size);
+	tmp[4] = floorf (box->max.y / self->cell_size);
+	tmp[5] = floorf (box->max.z / self->cell_size);
+	for (i = 0 ; i < 3 ; i++)
+	{
+		min[i] = (int) LIMAT_CLAMP (tmp[i], -LIENG_GRID_RANGE, LIENG_GRID_RANGE);
+		max[i] = (int) LIMAT_CLAMP (tmp[i + 3], -LIENG_GRID_RANGE, LIENG_GRID_RANGE);
+	}
+
+	return (float)(max[0] - min[0] + 1) * (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+}
+
+static int private_reserve (
+	LIEngGridBucket* bucket)
+{
+	int capacity;
+	LIEngObject** tmp;
+
+	if (bucket->count < bucket->capacity)
+		return 1;
+	capacity = bucket->capacity? 2 * bucket->capacity : 8;
+	tmp = lisys_realloc (bucket->array, capacity * sizeof (LIEngObject*));
+	if (tmp == NULL)
+		return 0;
+	bucket->array = tmp;
+	bucket->capacity = capacity;
+
+	return 1;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,89 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __ENGINE_GRID_H__
+#define __ENGINE_GRID_H__
+
+#include <lipsofsuna/math.h>
+#include <lipsofsuna/system.h>
+#include "engine-types.h"
+
+#define LIENG_GRID_BUCKETS 16384
+#define LIENG_GRID_CELL_SIZE 32.0f
+#define LIENG_GRID_RANGE 16777216.0f
+
+typedef int (*LIEngGridFunc)(void*, LIEngObject*);
+typedef struct _LIEngGrid LIEngGrid;
+typedef struct _LIEngGridBucket LIEngGridBucket;
+
+struct _LIEngGridBucket
+{
+	int count;
+	int capacity;
+	uint32_t stamp;
+	LIEngObject** array;
+};
+
+struct _LIEngGrid
+{
+	float cell_size;
+	uint32_t stamp;
+	LIEngGridBucket buckets[LIENG_GRID_BUCKETS];
+};
+
+LIAPICALL (LIEngGrid*, lieng_grid_new, (
+	float cell_size));
+
+LIAPICALL (void, lieng_grid_free, (
+	LIEngGrid* self));
+
+LIAPICALL (int, lieng_grid_find_box, (
+	LIEngGrid*       self,
+	const LIMatAabb* box,
+	LIEngGridFunc    func,
+	void*            data));
+
+LIAPICALL (int, lieng_grid_find_nearest, (
+	LIEngGrid*         self,
+	const LIMatVector* point,
+	float              radius,
+	LIEngGridFunc      filter,
+	void*              data,
+	LIEngObject**      result,
+	int                count));
+
+LIAPICALL (int, lieng_grid_find_sphere, (
+	LIEngGrid*         self,
+	const LIMatVector* point,
+	float              radius,
+	LIEngGridFunc      func,
+	void*              data));
+
+LIAPICALL (int, lieng_grid_insert, (
+	LIEngGrid*   self,
+	LIEngObject* object));
+
+LIAPICALL (void, lieng_grid_remove, (
+	LIEngGrid*   self,
+	LIEngObject* object));
+
+LIAPICALL (int, lieng_grid_update, (
+	LIEngGrid*   self,
+	LIEngObject* object));
+
+#endif
@@ -51,16 +51,24 @@ LIEngModel* lieng_model_new (
 	return self;
 }
 
+/**
+ * \brief Creates a copy of the model.
+ *
+ * The model data is shared with the original model until either of them
+ * is modified. Any function that modifies the data must call
+ * lieng_model_unshare first.
+ *
+ * \param model Model.
+ * \return New model or NULL.
+ */
 LIEngModel* lieng_model_new_copy (
 	LIEngModel* model)
 {
 	LIEngModel* self;
 	LIMdlModel* model_;
 
-	/* Copy the model. */
-	model_ = limdl_model_new_copy (model->model);
-	if (model_ == NULL)
-		return NULL;
+	/* Share the model data. */
+	model_ = limdl_model_ref (model->model);
 
 	/* Allocate self. */
 	self = lieng_model_new_model (model->engine, model_);
@@ -126,7 +134,10 @@ void lieng_model_free (
 	{
 		object = iter.value;
 		if (object->model == self)
+		{
+			limdl_pose_set_model (object->pose, NULL);
 			object->model = NULL;
+		}
 	}
 
 	/* Free data. */
@@ -151,10 +162,39 @@ void lieng_model_changed (
 		private_changed (self);
 }
 
+/**
+ * \brief Detaches the model data so that it can be moved elsewhere.
+ *
+ * The model is left with empty model data and a change event is emitted.
+ * Shared model data can't be detached since other models still use it.
+ *
+ * \param self Model.
+ * \return Model data owned by the caller or NULL.
+ */
+LIMdlModel* lieng_model_detach (
+	LIEngModel* self)
+{
+	LIMdlModel* empty;
+	LIMdlModel* model;
+
+	if (self->model == NULL || limdl_model_get_shared (self->model))
+		return NULL;
+
+	/* Replace with empty data. */
+	empty = limdl_model_new ();
+	if (empty == NULL)
+		return NULL;
+	model = self->model;
+	self->model = empty;
+	private_changed (self);
+
+	return model;
+}
+
 void lieng_model_calculate_bounds (
 	LIEngModel* self)
 {
-	if (self->model != NULL)
+	if (self->model != NULL && lieng_model_unshare (self))
 		limdl_model_calculate_bounds (self->model);
 }
 
@@ -165,27 +205,95 @@ int lieng_model_load (
 {
 	char* file;
 	char* path;
+	char* path_baked;
+	LISysStat st;
+	LISysStat st_baked;
 	LIMdlModel* tmpmdl;
+	LIMdlModel* tmpmdl_old;
 
-	/* Allocate path. */
+	/* Find the portable model. */
 	file = lisys_string_concat (name, ".lmdl");
-	if (name == NULL)
+	if (file == NULL)
 		return 0;
 	path = lipth_paths_get_graphics (self->engine->paths, file);
 	lisys_free (file);
 	if (path == NULL)
 		return 0;
 
-	/* Load model geometry. */
-	tmpmdl = limdl_model_new_from_file (path, mesh);
+	/* Find the baked model. */
+	file = lisys_string_concat (name, ".blmdl");
+	if (file == NULL)
+	{
+		lisys_free (path);
+		return 0;
+	}
+	path_baked = lipth_paths_get_graphics (self->engine->paths, file);
+	lisys_free (file);
+	if (path_baked == NULL)
+	{
+		lisys_free (path);
+		return 0;
+	}
+
+	/* Try the baked model first. */
+	/* Baked models are only valid for the native structure layout they were
+	   written with, so the portable model is used if the baked one is
+	   missing or rejected. The baked model is also ignored if the portable
+	   model has been modified after it was baked. */
+	tmpmdl = NULL;
+	if (lisys_filesystem_stat (path_baked, &st_baked) &&
+	   (!lisys_filesystem_stat (path, &st) || st.mtime <= st_baked.mtime))
+		tmpmdl = limdl_model_new_from_file (path_baked, mesh);
+	lisys_free (path_baked);
+
+	/* Load the portable model. */
+	if (tmpmdl == NULL)
+		tmpmdl = limdl_model_new_from_file (path, mesh);
 	lisys_free (path);
 	if (tmpmdl == NULL)
 		return 0;
 
 	/* Replace model data. */
-	limdl_model_free (self->model);
+	/* The old data is released only after the poses have been updated since
+	   their animation channels reference the animations of the old model. */
+	tmpmdl_old = self->model;
 	self->model = tmpmdl;
 	private_changed (self);
+	if (tmpmdl_old != NULL)
+		limdl_model_free (tmpmdl_old);
+
+	return 1;
+}
+
+/**
+ * \brief Makes sure that the model data isn't shared with other models.
+ *
+ * If the model data is shared, a private copy of it is created and any
+ * objects and extensions using the model are updated to use the copy. The
+ * data is not copied again if the model is already the sole owner.
+ *
+ * \param self Model.
+ * \return Nonzero on success.
+ */
+int lieng_model_unshare (
+	LIEngModel* self)
+{
+	LIMdlModel* copy;
+	LIMdlModel* shared;
+
+	if (self->model == NULL || !limdl_model_get_shared (self->model))
+		return 1;
+
+	/* Copy the shared data. */
+	copy = limdl_model_new_copy (self->model);
+	if (copy == NULL)
+		return 0;
+
+	/* Replace the shared data. */
+	shared = self->model;
+	self->model = copy;
+	private_changed (self);
+	limdl_model_free (shared);
 
 	return 1;
 }
@@ -50,9 +50,15 @@ LIAPICALL (void, lieng_model_calculate_bounds, (
 LIAPICALL (void, lieng_model_changed, (
 	LIEngModel* self));
 
+LIAPICALL (LIMdlModel*, lieng_model_detach, (
+	LIEngModel* self));
+
 LIAPICALL (int, lieng_model_load, (
 	LIEngModel* self,
 	const char* name,
 	int         mesh));
 
+LIAPICALL (int, lieng_model_unshare, (
+	LIEngModel* self));
+
 #endif
@@ -23,6 +23,7 @@
  */
 
 #include "lipsofsuna/network.h"
+#include "engine.h"
 #include "engine-object.h"
 
 static int private_warp (
@@ -64,12 +65,22 @@ LIEngObject* lieng_object_new (
 		return 0;
 	}
 
+	/* Insert to spatial index. */
+	if (!lieng_grid_insert (engine->grid, self))
+	{
+		lialg_u32dic_remove (engine->objects, self->id);
+		lisys_free (self);
+		return 0;
+	}
+
 	/* Allocate pose buffer. */
 	self->pose = limdl_pose_new ();
 	if (self->pose == NULL)
 	{
+		lieng_grid_remove (engine->grid, self);
 		lialg_u32dic_remove (engine->objects, self->id);
 		lisys_free (self);
+		return 0;
 	}
 
 	/* Invoke callbacks. */
@@ -96,6 +107,7 @@ void lieng_object_free (
 	lical_callbacks_call (self->engine->callbacks, "object-free", lical_marshal_DATA_PTR, self);
 
 	/* Remove from engine. */
+	lieng_grid_remove (self->engine->grid, self);
 	lialg_u32dic_remove (self->engine->objects, self->id);
 
 	/* Free pose. */
@@ -320,15 +332,31 @@ int lieng_object_set_transform (
 	const LIMatTransform* value)
 {
 	int realized;
+	LIMatTransform old;
+
+	/* Move in the spatial grid. */
+	/* The grid leaves the object to its old bucket on failure so the
+	   original transformation only needs to be restored. */
+	old = self->transform;
+	self->transform = *value;
+	if (!lieng_grid_update (self->engine->grid, self))
+	{
+		self->transform = old;
+		return 0;
+	}
 
 	/* Warp to new position. */
 	realized = lieng_object_get_realized (self);
 	if (realized)
 	{
 		if (!private_warp (self, &value->position))
+		{
+			/* Moving back can't fail since the old slot was just freed. */
+			self->transform = old;
+			lieng_grid_update (self->engine->grid, self);
 			return 0;
+		}
 	}
-	self->transform = *value;
 
 	/* Invoke callbacks. */
 	lical_callbacks_call (self->engine->callbacks, "object-transform", lical_marshal_DATA_PTR_PTR, self, value);
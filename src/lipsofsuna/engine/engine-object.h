@@ -22,6 +22,7 @@
 #include <lipsofsuna/math.h>
 #include <lipsofsuna/physics.h>
 #include <lipsofsuna/system.h>
+#include "engine-grid.h"
 #include "engine-model.h"
 #include "engine-types.h"
 
@@ -35,6 +36,8 @@ struct _LIEngObject
 	LIEngEngine* engine;
 	LIEngModel* model;
 	LIEngSector* sector;
+	LIEngGridBucket* grid_bucket;
+	int grid_index;
 	LIMatTransform transform;
 	LIMatTransform transform_event;
 	LIMdlPose* pose;
@@ -0,0 +1,194 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LIEng Engine
+ * @{
+ * \addtogroup LIEngUnittest Unittest
+ * @{
+ */
+
+#include <sys/time.h>
+#include "engine.h"
+#include "engine-grid.h"
+#include "engine-unittest.h"
+
+#define BENCHMARK_OBJECTS 10000
+#define BENCHMARK_QUERIES 10000
+#define BENCHMARK_NEAREST 5
+#define BENCHMARK_RADIUS 32.0f
+#define BENCHMARK_WORLD 2000.0f
+
+static double private_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
+static void private_random_point (
+	LIAlgRandom* random,
+	LIMatVector* result)
+{
+	result->x = BENCHMARK_WORLD * lialg_random_float (random);
+	result->y = 0.05f * BENCHMARK_WORLD * lialg_random_float (random);
+	result->z = BENCHMARK_WORLD * lialg_random_float (random);
+}
+
+static void private_benchmark_grid ()
+{
+	int i;
+	int j;
+	int k;
+	int num0;
+	int num1;
+	int errors = 0;
+	float dist;
+	double t0;
+	double t1;
+	double t2;
+	double t3;
+	double t4;
+	LIAlgRandom random;
+	LIEngGrid* grid;
+	LIEngObject* objects;
+	LIEngObject* nearest[BENCHMARK_NEAREST];
+	LIMatVector diff;
+	LIMatVector* points;
+
+	/* Create the grid and the objects. The grid only needs the positions
+	   of the objects so they're not added to any engine. */
+	lialg_random_init (&random, 1);
+	grid = lieng_grid_new (LIENG_GRID_CELL_SIZE);
+	objects = lisys_calloc (BENCHMARK_OBJECTS, sizeof (LIEngObject));
+	points = lisys_calloc (BENCHMARK_QUERIES, sizeof (LIMatVector));
+	if (grid == NULL || objects == NULL || points == NULL)
+	{
+		if (grid != NULL)
+			lieng_grid_free (grid);
+		lisys_free (objects);
+		lisys_free (points);
+		return;
+	}
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+	{
+		objects[i].id = i + 1;
+		objects[i].transform = limat_transform_identity ();
+		private_random_point (&random, &objects[i].transform.position);
+		lieng_grid_insert (grid, objects + i);
+	}
+	for (i = 0 ; i < BENCHMARK_QUERIES ; i++)
+		private_random_point (&random, points + i);
+
+	/* Time sphere queries with the grid. */
+	t0 = private_time ();
+	for (i = num0 = 0 ; i < BENCHMARK_QUERIES ; i++)
+		num0 += lieng_grid_find_sphere (grid, points + i, BENCHMARK_RADIUS, NULL, NULL);
+	t1 = private_time ();
+
+	/* Time the same with a linear search for reference. */
+	for (i = num1 = 0 ; i < BENCHMARK_QUERIES ; i++)
+	{
+		for (j = 0 ; j < BENCHMARK_OBJECTS ; j++)
+		{
+			diff = limat_vector_subtract (points[i], objects[j].transform.position);
+			if (limat_vector_get_length (diff) <= BENCHMARK_RADIUS)
+				num1++;
+		}
+	}
+	t2 = private_time ();
+	if (num0 != num1)
+		printf ("Grid: FAILED! %d objects found instead of %d.\n", num0, num1);
+
+	/* Time nearest neighbor queries and verify them. */
+	for (i = 0 ; i < BENCHMARK_QUERIES ; i++)
+	{
+		num0 = lieng_grid_find_nearest (grid, points + i, LIMAT_INFINITE, NULL, NULL, nearest, BENCHMARK_NEAREST);
+		if (num0 != BENCHMARK_NEAREST)
+		{
+			errors++;
+			continue;
+		}
+		diff = limat_vector_subtract (points[i], nearest[num0 - 1]->transform.position);
+		dist = limat_vector_get_length (diff);
+		for (j = k = 0 ; j < BENCHMARK_OBJECTS ; j++)
+		{
+			diff = limat_vector_subtract (points[i], objects[j].transform.position);
+			if (limat_vector_get_length (diff) < dist)
+				k++;
+		}
+		if (k != BENCHMARK_NEAREST - 1)
+			errors++;
+	}
+	t3 = private_time ();
+	for (i = 0 ; i < BENCHMARK_QUERIES ; i++)
+		lieng_grid_find_nearest (grid, points + i, LIMAT_INFINITE, NULL, NULL, nearest, BENCHMARK_NEAREST);
+	t3 = private_time () - t3;
+	if (errors)
+		printf ("Grid: FAILED! %d nearest neighbor queries were wrong.\n", errors);
+
+	/* Asking for more neighbors than there are objects makes the search
+	   expand to the infinite radius. */
+	for (i = 0 ; i < BENCHMARK_OBJECTS - 2 ; i++)
+		lieng_grid_remove (grid, objects + i);
+	num0 = lieng_grid_find_nearest (grid, points, LIMAT_INFINITE, NULL, NULL, nearest, BENCHMARK_NEAREST);
+	if (num0 != 2)
+		printf ("Grid: FAILED! %d objects found instead of 2.\n", num0);
+	for (i = 0 ; i < BENCHMARK_OBJECTS - 2 ; i++)
+		lieng_grid_insert (grid, objects + i);
+
+	/* Time moving the objects. */
+	t4 = private_time ();
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+	{
+		objects[i].transform.position.x += 10.0f * lialg_random_float (&random) - 5.0f;
+		objects[i].transform.position.z += 10.0f * lialg_random_float (&random) - 5.0f;
+		lieng_grid_update (grid, objects + i);
+	}
+	t4 = private_time () - t4;
+
+	printf ("Grid: %d queries among %d objects, %.3f ms grid, %.3f ms linear\n",
+		BENCHMARK_QUERIES, BENCHMARK_OBJECTS, 1000.0 * (t1 - t0), 1000.0 * (t2 - t1));
+	printf ("Grid: %d nearest neighbor queries %.3f ms, %d updates %.3f ms\n",
+		BENCHMARK_QUERIES, 1000.0 * t3, BENCHMARK_OBJECTS, 1000.0 * t4);
+
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+		lieng_grid_remove (grid, objects + i);
+	lieng_grid_free (grid);
+	lisys_free (objects);
+	lisys_free (points);
+}
+
+/*****************************************************************************/
+
+/**
+ * \brief Runs the engine unit tests and benchmarks.
+ *
+ * Ten thousand objects are scattered to the spatial index and queried with
+ * random spheres to compare the grid to a linear search. The nearest
+ * neighbor search is verified against a brute force search.
+ */
+void lieng_unittest ()
+{
+	printf ("Benchmarking object queries.\n");
+	private_benchmark_grid ();
+}
+
+/** @} */
+/** @} */
@@ -109,6 +109,8 @@ lieng_engine_free (LIEngEngine* self)
 
 	if (self->objects != NULL)
 		lialg_u32dic_free (self->objects);
+	if (self->grid != NULL)
+		lieng_grid_free (self->grid);
 	if (self->models != NULL)
 		lialg_u32dic_free (self->models);
 	lisys_free (self);
@@ -150,6 +152,9 @@ private_init (LIEngEngine* self)
 	self->objects = lialg_u32dic_new ();
 	if (self->objects == NULL)
 		return 0;
+	self->grid = lieng_grid_new (LIENG_GRID_CELL_SIZE);
+	if (self->grid == NULL)
+		return 0;
 
 	/* Models. */
 	self->models = lialg_u32dic_new ();
@@ -25,6 +25,7 @@
 #include <lipsofsuna/model.h>
 #include <lipsofsuna/paths.h>
 #include <lipsofsuna/system.h>
+#include "engine-grid.h"
 #include "engine-model.h"
 #include "engine-object.h"
 #include "engine-sector.h"
@@ -37,6 +38,7 @@ struct _LIEngEngine
 	LIAlgRandom random;
 	LIAlgSectors* sectors;
 	LIAlgU32dic* models;
+	LIEngGrid* grid;
 	LIAlgU32dic* objects;
 	LICalCallbacks* callbacks;
 	LIPthPaths* paths;
@@ -0,0 +1,591 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtDatabase Database
+ * @{
+ */
+
+#include "ext-module.h"
+
+static int private_authorize (
+	void*       data,
+	int         action,
+	const char* arg1,
+	const char* arg2,
+	const char* arg3,
+	const char* arg4);
+
+static void private_evict (
+	LIExtDatabase* self);
+
+static int private_keyword (
+	const char* sql,
+	const char* word);
+
+static void private_lower (
+	char* str);
+
+static const char* private_skip (
+	const char* sql,
+	const char* word);
+
+static void private_statement_free (
+	LIExtDatabaseStatement* self);
+
+/*****************************************************************************/
+
+/**
+ * \brief Opens a database.
+ * \param path Path to the database file in UTF-8.
+ * \return Database or NULL.
+ */
+LIExtDatabase* liext_database_new (
+	const char* path)
+{
+	LIExtDatabase* self;
+
+	/* Allocate self. */
+	self = lisys_calloc (1, sizeof (LIExtDatabase));
+	if (self == NULL)
+		return NULL;
+	self->refs = 1;
+
+	/* Allocate the statement cache. */
+	self->statements = lialg_strdic_new ();
+	if (self->statements == NULL)
+	{
+		lisys_free (self);
+		return NULL;
+	}
+
+	/* Open the database. */
+	if (sqlite3_open_v2 (path, &self->sql, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+	{
+		lisys_error_set (EINVAL, "sqlite: %s", sqlite3_errmsg (self->sql));
+		sqlite3_close (self->sql);
+		lialg_strdic_free (self->statements);
+		lisys_free (self);
+		return NULL;
+	}
+
+	/* Track the tables read by statements. */
+	sqlite3_set_authorizer (self->sql, private_authorize, self);
+
+	return self;
+}
+
+/**
+ * \brief Releases a reference to the database.
+ *
+ * The database is closed when the last reference is released. Cursors hold
+ * a reference to the database so that their statements remain valid even
+ * if the database userdata is garbage collected first.
+ *
+ * \param self Database.
+ */
+void liext_database_free (
+	LIExtDatabase* self)
+{
+	LIAlgStrdicIter iter;
+
+	if (--self->refs > 0)
+		return;
+
+	/* Finish queued writes. */
+	if (self->worker != NULL)
+		liext_database_worker_free (self->worker);
+	if (self->mutex != NULL)
+		lisys_mutex_free (self->mutex);
+
+	/* Finalize cached statements. */
+	LIALG_STRDIC_FOREACH (iter, self->statements)
+		private_statement_free (iter.value);
+	lialg_strdic_free (self->statements);
+
+	/* Make sure we aren't leaking statements. */
+	lisys_assert (sqlite3_next_stmt (self->sql, NULL) == NULL);
+
+	sqlite3_close (self->sql);
+	lisys_free (self);
+}
+
+/**
+ * \brief Executes a statement that returns no rows.
+ * \param self Database.
+ * \param sql SQL statement.
+ * \return Nonzero on success.
+ */
+int liext_database_exec (
+	LIExtDatabase* self,
+	const char*    sql)
+{
+	int ret;
+	LIExtDatabaseStatement* statement;
+
+	statement = liext_database_prepare (self, sql);
+	if (statement == NULL)
+		return 0;
+	ret = sqlite3_step (statement->statement);
+	if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	{
+		lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self->sql));
+		liext_database_release (self, statement);
+		return 0;
+	}
+	liext_database_release (self, statement);
+
+	return 1;
+}
+
+/**
+ * \brief Reserves the connection for the calling thread.
+ *
+ * Synchronous databases are only ever used by the main thread so this does
+ * nothing for them. For asynchronous databases, the connection is locked
+ * from the worker. The queued writes aren't waited for, so statements
+ * reading the database need to be passed to #liext_database_sync first.
+ *
+ * \param self Database.
+ */
+void liext_database_lock (
+	LIExtDatabase* self)
+{
+	if (self->worker != NULL)
+		lisys_mutex_lock (self->mutex);
+}
+
+/**
+ * \brief Releases the connection reserved with #liext_database_lock.
+ * \param self Database.
+ */
+void liext_database_unlock (
+	LIExtDatabase* self)
+{
+	if (self->worker != NULL)
+		lisys_mutex_unlock (self->mutex);
+}
+
+/**
+ * \brief Waits for the queued writes that a statement could read.
+ *
+ * The tables read by each statement are recorded when it is prepared. The
+ * write-behind queue is only flushed if a write to one of them is still
+ * queued or being executed by the worker, so that reads of other tables
+ * don't stall the main thread. Since the queue could also contain schema
+ * changes that the statement needs in order to compile, this must also be
+ * called without a statement before preparing it. The connection must be
+ * locked by the caller.
+ *
+ * \param self Database.
+ * \param statement Statement prepared for the read, or NULL.
+ */
+void liext_database_sync (
+	LIExtDatabase*          self,
+	LIExtDatabaseStatement* statement)
+{
+	if (self->worker == NULL || !liext_database_worker_pending (self->worker, statement))
+		return;
+	lisys_mutex_unlock (self->mutex);
+	liext_database_worker_flush (self->worker);
+	lisys_mutex_lock (self->mutex);
+}
+
+/**
+ * \brief Gets a prepared statement for the SQL string.
+ *
+ * Statements are cached by their SQL text so that repeated queries skip
+ * the SQL compiler. The returned statement is reserved for the caller until
+ * released with #liext_database_release. If the cached statement is
+ * already reserved, for example by an open cursor, a temporary uncached
+ * statement is prepared instead.
+ *
+ * \param self Database.
+ * \param sql SQL statement.
+ * \return Statement or NULL.
+ */
+LIExtDatabaseStatement* liext_database_prepare (
+	LIExtDatabase* self,
+	const char*    sql)
+{
+	int cache = 1;
+	LIExtDatabaseStatement* statement;
+
+	/* Try the cache. */
+	statement = lialg_strdic_find (self->statements, sql);
+	if (statement != NULL)
+	{
+		if (!statement->busy)
+		{
+			self->stats.hits++;
+			statement->busy = 1;
+			statement->used = ++self->clock;
+			return statement;
+		}
+		cache = 0;
+	}
+	self->stats.misses++;
+
+	/* Allocate a new statement. */
+	statement = lisys_calloc (1, sizeof (LIExtDatabaseStatement));
+	if (statement == NULL)
+		return NULL;
+	statement->busy = 1;
+	statement->cached = cache;
+	statement->used = ++self->clock;
+	self->preparing = statement;
+	if (sqlite3_prepare_v2 (self->sql, sql, -1, &statement->statement, NULL) != SQLITE_OK)
+	{
+		lisys_error_set (EINVAL, "SQL prepare: %s", sqlite3_errmsg (self->sql));
+		self->preparing = NULL;
+		private_statement_free (statement);
+		return NULL;
+	}
+	self->preparing = NULL;
+
+	/* Add to the cache. */
+	if (cache)
+	{
+		if (!lialg_strdic_insert (self->statements, sql, statement))
+			statement->cached = 0;
+		else
+			private_evict (self);
+	}
+
+	return statement;
+}
+
+/**
+ * \brief Releases a statement reserved with #liext_database_prepare.
+ * \param self Database.
+ * \param statement Statement.
+ */
+void liext_database_release (
+	LIExtDatabase*          self,
+	LIExtDatabaseStatement* statement)
+{
+	if (!statement->cached)
+	{
+		private_statement_free (statement);
+		return;
+	}
+	sqlite3_reset (statement->statement);
+	sqlite3_clear_bindings (statement->statement);
+	statement->busy = 0;
+	private_evict (self);
+}
+
+/**
+ * \brief Opens a cursor for iterating the rows of a query.
+ * \param database Database.
+ * \param sql SQL statement.
+ * \return Cursor or NULL.
+ */
+LIExtDatabaseCursor* liext_database_cursor_new (
+	LIExtDatabase* database,
+	const char*    sql)
+{
+	LIExtDatabaseCursor* self;
+
+	self = lisys_calloc (1, sizeof (LIExtDatabaseCursor));
+	if (self == NULL)
+		return NULL;
+	self->database = database;
+	self->statement = liext_database_prepare (database, sql);
+	if (self->statement == NULL)
+	{
+		lisys_free (self);
+		return NULL;
+	}
+	database->refs++;
+
+	return self;
+}
+
+/**
+ * \brief Closes the cursor.
+ * \param self Cursor.
+ */
+void liext_database_cursor_free (
+	LIExtDatabaseCursor* self)
+{
+	liext_database_cursor_close (self);
+	lisys_free (self);
+}
+
+/**
+ * \brief Releases the statement and the database of the cursor.
+ *
+ * Called automatically when the last row has been read so that the
+ * statement is returned to the cache without waiting for the garbage
+ * collector.
+ *
+ * \param self Cursor.
+ */
+void liext_database_cursor_close (
+	LIExtDatabaseCursor* self)
+{
+	if (self->statement == NULL)
+		return;
+	if (self->database->mutex != NULL)
+		lisys_mutex_lock (self->database->mutex);
+	liext_database_release (self->database, self->statement);
+	if (self->database->mutex != NULL)
+		lisys_mutex_unlock (self->database->mutex);
+	liext_database_free (self->database);
+	self->statement = NULL;
+	self->database = NULL;
+}
+
+/**
+ * \brief Classifies an SQL statement for the write-behind queue.
+ *
+ * Transaction control statements and statements that are known to only
+ * modify the database can be queued. Everything else is assumed to return
+ * rows and must be executed synchronously.
+ *
+ * \param sql SQL statement.
+ * \return Job type.
+ */
+int liext_database_classify (
+	const char* sql)
+{
+	while (*sql == ' ' || *sql == '\t' || *sql == '\n' || *sql == '\r')
+		sql++;
+	if (private_keyword (sql, "BEGIN"))
+		return LIEXT_DATABASE_JOB_BEGIN;
+	if (private_keyword (sql, "END") || private_keyword (sql, "COMMIT"))
+		return LIEXT_DATABASE_JOB_COMMIT;
+	if (private_keyword (sql, "ROLLBACK"))
+	{
+		/* Rolling back to a savepoint doesn't end the transaction. */
+		for (sql += 8 ; *sql == ' ' || *sql == '\t' ; sql++) {}
+		if (private_keyword (sql, "TO"))
+			return LIEXT_DATABASE_JOB_WRITE;
+		return LIEXT_DATABASE_JOB_ROLLBACK;
+	}
+	if (private_keyword (sql, "INSERT") ||
+	    private_keyword (sql, "REPLACE") ||
+	    private_keyword (sql, "UPDATE") ||
+	    private_keyword (sql, "DELETE") ||
+	    private_keyword (sql, "CREATE") ||
+	    private_keyword (sql, "DROP") ||
+	    private_keyword (sql, "ALTER"))
+		return LIEXT_DATABASE_JOB_WRITE;
+
+	return LIEXT_DATABASE_JOB_READ;
+}
+
+/**
+ * \brief Gets the name of the table modified by an SQL statement.
+ *
+ * Only plain INSERT, REPLACE, UPDATE and DELETE statements are recognized.
+ * The caller must assume that anything else could modify any table.
+ *
+ * \param sql SQL statement.
+ * \return New lowercase string, or NULL if not known.
+ */
+char* liext_database_get_table (
+	const char* sql)
+{
+	int len;
+	int insert;
+	char* name;
+	const char* end;
+
+	/* Skip to the table name. */
+	sql = private_skip (sql, NULL);
+	if (private_keyword (sql, "INSERT") || private_keyword (sql, "UPDATE"))
+	{
+		insert = private_keyword (sql, "INSERT");
+		sql = private_skip (sql + 6, NULL);
+		if (private_keyword (sql, "OR"))
+			sql = private_skip (private_skip (sql + 2, NULL), "");
+		if (insert)
+			sql = private_skip (sql, "INTO");
+	}
+	else if (private_keyword (sql, "REPLACE"))
+		sql = private_skip (private_skip (sql + 7, NULL), "INTO");
+	else if (private_keyword (sql, "DELETE"))
+		sql = private_skip (private_skip (sql + 6, NULL), "FROM");
+	else
+		return NULL;
+	if (sql == NULL)
+		return NULL;
+
+	/* Read the name without the database prefix. */
+	/* Quoted names are rare enough to be treated as unknown. */
+	for (end = sql ; (*end >= 'a' && *end <= 'z') || (*end >= 'A' && *end <= 'Z') ||
+	     (*end >= '0' && *end <= '9') || *end == '_' ; end++) {}
+	if (*end == '.')
+	{
+		for (sql = ++end ; (*end >= 'a' && *end <= 'z') || (*end >= 'A' && *end <= 'Z') ||
+		     (*end >= '0' && *end <= '9') || *end == '_' ; end++) {}
+	}
+	len = end - sql;
+	if (!len || *end == '"' || *end == '`' || *end == ']')
+		return NULL;
+	name = lisys_string_dupn (sql, len);
+	if (name == NULL)
+		return NULL;
+	private_lower (name);
+
+	return name;
+}
+
+/*****************************************************************************/
+
+static int private_authorize (
+	void*       data,
+	int         action,
+	const char* arg1,
+	const char* arg2,
+	const char* arg3,
+	const char* arg4)
+{
+	char* name;
+	LIExtDatabase* self = data;
+	LIExtDatabaseStatement* statement = self->preparing;
+
+	/* Statements are also authorized when SQLite recompiles them after
+	   schema changes but their tables have already been recorded then. */
+	if (statement == NULL || statement->reads_all)
+		return SQLITE_OK;
+
+	switch (action)
+	{
+		case SQLITE_SELECT:
+		case SQLITE_FUNCTION:
+			break;
+		case SQLITE_READ:
+			/* Table names are case insensitive. */
+			if (statement->reads == NULL)
+				statement->reads = lialg_strdic_new ();
+			name = lisys_string_dup (arg1);
+			if (statement->reads == NULL || name == NULL)
+			{
+				statement->reads_all = 1;
+				lisys_free (name);
+				break;
+			}
+			private_lower (name);
+			if (lialg_strdic_find (statement->reads, name) == NULL &&
+			   !lialg_strdic_insert (statement->reads, name, statement))
+				statement->reads_all = 1;
+			lisys_free (name);
+			break;
+		default:
+			/* Pragmas and such could depend on anything. */
+			statement->reads_all = 1;
+			break;
+	}
+
+	return SQLITE_OK;
+}
+
+static void private_evict (
+	LIExtDatabase* self)
+{
+	LIAlgStrdicIter iter;
+	LIAlgStrdicNode* oldest;
+	LIExtDatabaseStatement* statement;
+
+	while (self->statements->size > LIEXT_DATABASE_STATEMENTS_MAX)
+	{
+		/* Find the least recently used idle statement. */
+		oldest = NULL;
+		LIALG_STRDIC_FOREACH (iter, self->statements)
+		{
+			statement = iter.value;
+			if (statement->busy)
+				continue;
+			if (oldest == NULL || statement->used < ((LIExtDatabaseStatement*) oldest->value)->used)
+				oldest = iter.node;
+		}
+		if (oldest == NULL)
+			return;
+
+		/* Finalize it. */
+		private_statement_free (oldest->value);
+		lialg_strdic_remove_node (self->statements, oldest);
+	}
+}
+
+static int private_keyword (
+	const char* sql,
+	const char* word)
+{
+	for ( ; *word != '\0' ; sql++, word++)
+	{
+		if (*sql != *word && *sql != *word - 'A' + 'a')
+			return 0;
+	}
+	if ((*sql >= 'a' && *sql <= 'z') || (*sql >= 'A' && *sql <= 'Z') ||
+	    (*sql >= '0' && *sql <= '9') || *sql == '_')
+		return 0;
+
+	return 1;
+}
+
+static void private_lower (
+	char* str)
+{
+	for ( ; *str != '\0' ; str++)
+	{
+		if (*str >= 'A' && *str <= 'Z')
+			*str = *str - 'A' + 'a';
+	}
+}
+
+/* Skips whitespace, or a keyword and the whitespace following it. An empty
+   keyword matches any word. Returns NULL if the keyword doesn't match. */
+static const char* private_skip (
+	const char* sql,
+	const char* word)
+{
+	if (sql == NULL)
+		return NULL;
+	if (word != NULL && *word == '\0')
+	{
+		while ((*sql >= 'a' && *sql <= 'z') || (*sql >= 'A' && *sql <= 'Z'))
+			sql++;
+	}
+	else if (word != NULL)
+	{
+		if (!private_keyword (sql, word))
+			return NULL;
+		sql += strlen (word);
+	}
+	while (*sql == ' ' || *sql == '\t' || *sql == '\n' || *sql == '\r')
+		sql++;
+
+	return sql;
+}
+
+static void private_statement_free (
+	LIExtDatabaseStatement* self)
+{
+	sqlite3_finalize (self->statement);
+	if (self->reads != NULL)
+		lialg_strdic_free (self->reads);
+	lisys_free (self);
+}
+
+/** @} */
+/** @} */
@@ -25,6 +25,12 @@
 #include <sqlite3.h>
 #include "ext-module.h"
 
+static int private_tick (
+	LIExtModule* self,
+	float        secs);
+
+/*****************************************************************************/
+
 LIMaiExtensionInfo liext_database_info =
 {
 	LIMAI_EXTENSION_VERSION, "Database",
@@ -43,6 +49,21 @@ LIExtModule* liext_databases_new (
 		return NULL;
 	self->program = program;
 
+	/* Allocate the worker list. */
+	self->workers = lialg_ptrdic_new ();
+	if (self->workers == NULL)
+	{
+		liext_databases_free (self);
+		return NULL;
+	}
+
+	/* Register callbacks. */
+	if (!lical_callbacks_insert (program->callbacks, "tick", 0, private_tick, self, self->calls + 0))
+	{
+		liext_databases_free (self);
+		return NULL;
+	}
+
 	/* Register classes. */
 	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_DATABASE, self);
 	liext_script_database (program->script);
@@ -53,8 +74,29 @@ LIExtModule* liext_databases_new (
 void liext_databases_free (
 	LIExtModule* self)
 {
+	/* The databases are owned by the script so they have been freed. */
+	lical_handle_releasev (self->calls, sizeof (self->calls) / sizeof (LICalHandle));
+	if (self->workers != NULL)
+	{
+		lisys_assert (self->workers->size == 0);
+		lialg_ptrdic_free (self->workers);
+	}
 	lisys_free (self);
 }
 
+/*****************************************************************************/
+
+static int private_tick (
+	LIExtModule* self,
+	float        secs)
+{
+	LIAlgPtrdicIter iter;
+
+	LIALG_PTRDIC_FOREACH (iter, self->workers)
+		liext_database_worker_update (iter.value, secs);
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -20,12 +20,227 @@
 
 #include <lipsofsuna/extension.h>
 
+#include <sqlite3.h>
+
 #define LIEXT_SCRIPT_DATABASE "Database"
+#define LIEXT_SCRIPT_DATABASE_CURSOR "DatabaseCursor"
+#define LIEXT_DATABASE_INTEGER_MAX 9007199254740992.0
+#define LIEXT_DATABASE_STATEMENTS_MAX 64
+#define LIEXT_DATABASE_BATCHES_MAX 64
+#define LIEXT_DATABASE_COMMIT_SECS 1.0f
+#define LIEXT_DATABASE_IDLE_USECS 200
+#define LIEXT_DATABASE_QUEUE_MAX 4096
+
+enum
+{
+	LIEXT_DATABASE_JOB_NONE,
+	LIEXT_DATABASE_JOB_BEGIN,
+	LIEXT_DATABASE_JOB_COMMIT,
+	LIEXT_DATABASE_JOB_ROLLBACK,
+	LIEXT_DATABASE_JOB_READ,
+	LIEXT_DATABASE_JOB_WRITE
+};
 
 typedef struct _LIExtModule LIExtModule;
+typedef struct _LIExtDatabaseWorker LIExtDatabaseWorker;
+
+typedef struct _LIExtDatabaseStatement LIExtDatabaseStatement;
+struct _LIExtDatabaseStatement
+{
+	int busy;
+	int cached;
+	int used;
+	int reads_all;
+	LIAlgStrdic* reads;
+	sqlite3_stmt* statement;
+};
+
+typedef struct _LIExtDatabase LIExtDatabase;
+struct _LIExtDatabase
+{
+	int clock;
+	int refs;
+	sqlite3* sql;
+	LIAlgStrdic* statements;
+	LIExtDatabaseStatement* preparing;
+	LIExtDatabaseWorker* worker;
+	LISysMutex* mutex;
+	struct
+	{
+		int hits;
+		int misses;
+	} stats;
+};
+
+typedef struct _LIExtDatabaseCursor LIExtDatabaseCursor;
+struct _LIExtDatabaseCursor
+{
+	LIExtDatabase* database;
+	LIExtDatabaseStatement* statement;
+};
+
+LIExtDatabase* liext_database_new (
+	const char* path);
+
+void liext_database_free (
+	LIExtDatabase* self);
+
+int liext_database_exec (
+	LIExtDatabase* self,
+	const char*    sql);
+
+void liext_database_lock (
+	LIExtDatabase* self);
+
+void liext_database_unlock (
+	LIExtDatabase* self);
+
+void liext_database_sync (
+	LIExtDatabase*          self,
+	LIExtDatabaseStatement* statement);
+
+LIExtDatabaseStatement* liext_database_prepare (
+	LIExtDatabase* self,
+	const char*    sql);
+
+void liext_database_release (
+	LIExtDatabase*          self,
+	LIExtDatabaseStatement* statement);
+
+LIExtDatabaseCursor* liext_database_cursor_new (
+	LIExtDatabase* database,
+	const char*    sql);
+
+void liext_database_cursor_free (
+	LIExtDatabaseCursor* self);
+
+void liext_database_cursor_close (
+	LIExtDatabaseCursor* self);
+
+int liext_database_classify (
+	const char* sql);
+
+char* liext_database_get_table (
+	const char* sql);
+
+/*****************************************************************************/
+
+typedef struct _LIExtDatabaseValue LIExtDatabaseValue;
+struct _LIExtDatabaseValue
+{
+	int type;
+	int length;
+	double number;
+	sqlite3_int64 integer;
+	char* data;
+};
+
+typedef struct _LIExtDatabaseJob LIExtDatabaseJob;
+struct _LIExtDatabaseJob
+{
+	int id;
+	int type;
+	int scope;
+	char* sql;
+	char* error;
+	LIExtDatabaseJob* next;
+	struct
+	{
+		int count;
+		int width;
+		LIExtDatabaseValue* array;
+	} binds;
+	struct
+	{
+		int count;
+		int capacity;
+		int width;
+		LIExtDatabaseValue* array;
+	} rows;
+};
+
+typedef struct _LIExtDatabaseBatch LIExtDatabaseBatch;
+struct _LIExtDatabaseBatch
+{
+	int count;
+	int capacity;
+	LIExtDatabaseJob** array;
+};
+
+struct _LIExtDatabaseWorker
+{
+	int depth;
+	int reading;
+	int scope;
+	int sent;
+	int transaction;
+	int savepoints;
+	float interval;
+	float timer;
+	volatile int done;
+	volatile int quit;
+	LIAlgStrdic* keys;
+	LIAlgStrdic* tables;
+	LIExtDatabase* database;
+	LIExtDatabaseBatch* queue;
+	LIExtModule* module;
+	LISysChannel* batches;
+	LISysMutex* mutex;
+	LISysThread* thread;
+	struct
+	{
+		LIExtDatabaseJob* first;
+		LIExtDatabaseJob* last;
+	} results;
+	struct
+	{
+		int coalesced;
+		int commits;
+		int errors;
+		int writes;
+	} stats;
+};
+
+LIExtDatabaseWorker* liext_database_worker_new (
+	LIExtModule*   module,
+	LIExtDatabase* database);
+
+void liext_database_worker_free (
+	LIExtDatabaseWorker* self);
+
+void liext_database_worker_flush (
+	LIExtDatabaseWorker* self);
+
+int liext_database_worker_pending (
+	LIExtDatabaseWorker*    self,
+	LIExtDatabaseStatement* statement);
+
+int liext_database_worker_read (
+	LIExtDatabaseWorker* self,
+	const char*          sql,
+	lua_State*           lua,
+	int                  bind);
+
+int liext_database_worker_write (
+	LIExtDatabaseWorker* self,
+	const char*          sql,
+	const char*          key,
+	lua_State*           lua,
+	int                  bind,
+	int                  batch);
+
+void liext_database_worker_update (
+	LIExtDatabaseWorker* self,
+	float                secs);
+
+/*****************************************************************************/
+
 struct _LIExtModule
 {
+	int id;
 	LIMaiProgram* program;
+	LIAlgPtrdic* workers;
+	LICalHandle calls[1];
 };
 
 LIExtModule* liext_databases_new (
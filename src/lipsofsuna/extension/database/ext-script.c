@@ -25,30 +25,256 @@
 #include <sqlite3.h>
 #include "ext-module.h"
 
+static int private_bind (
+	LIExtDatabase* self,
+	sqlite3_stmt*  statement,
+	lua_State*     lua,
+	int            table)
+{
+	int i;
+	int ok;
+	size_t len;
+	double number;
+	const char* str;
+	LIArcPacket* packet;
+	LIScrData* data;
+
+	for (i = 1 ; i < sqlite3_bind_parameter_count (statement) + 1 ; i++)
+	{
+		/* We got a table that has the bound variables in fields matching
+		   the indices of the bound variables. We can simply loop through
+		   the table and use the binding index as the key. */
+		lua_rawgeti (lua, table, i);
+		switch (lua_type (lua, -1))
+		{
+			/* Bind integers as integers and other numbers as doubles. */
+			case LUA_TNUMBER:
+				number = lua_tonumber (lua, -1);
+				if (number >= -LIEXT_DATABASE_INTEGER_MAX && number <= LIEXT_DATABASE_INTEGER_MAX &&
+				    number == (sqlite3_int64) number)
+					ok = sqlite3_bind_int64 (statement, i, (sqlite3_int64) number);
+				else
+					ok = sqlite3_bind_double (statement, i, number);
+				break;
+
+			/* Bind strings as text. */
+			case LUA_TSTRING:
+				str = lua_tolstring (lua, -1, &len);
+				ok = sqlite3_bind_text (statement, i, str, len, SQLITE_TRANSIENT);
+				break;
+
+			/* Bind packets as blobs. */
+			case LUA_TUSERDATA:
+				data = liscr_isdata (lua, -1, LISCR_SCRIPT_PACKET);
+				if (data == NULL)
+				{
+					ok = sqlite3_bind_null (statement, i);
+					break;
+				}
+				packet = liscr_data_get_data (data);
+				if (packet->writer != NULL)
+				{
+					ok = sqlite3_bind_blob (statement, i, packet->writer->memory.buffer,
+						packet->writer->memory.length, SQLITE_TRANSIENT);
+				}
+				else
+				{
+					ok = sqlite3_bind_blob (statement, i, packet->reader->buffer,
+						packet->reader->length, SQLITE_TRANSIENT);
+				}
+				break;
+
+			/* Bind any other values as NULL. */
+			default:
+				ok = sqlite3_bind_null (statement, i);
+				break;
+		}
+		lua_pop (lua, 1);
+		if (ok != SQLITE_OK)
+		{
+			lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self->sql));
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void private_free_cursor (
+	LIExtDatabaseCursor* self)
+{
+	liext_database_cursor_free (self);
+}
+
 static void private_free_database (
-	sqlite3* self)
+	LIExtDatabase* self)
 {
-	/* Make sure we aren't leaking statements. */
-	lisys_assert (sqlite3_next_stmt (self, NULL) == NULL);
+	liext_database_free (self);
+}
+
+static void private_push_row (
+	LIScrScript*  script,
+	lua_State*    lua,
+	sqlite3_stmt* statement)
+{
+	int col;
+	int cols;
+	int size;
+	const char* str;
+	LIArcPacket* packet;
+	LIScrData* data;
+
+	/* Create a row table. */
+	cols = sqlite3_column_count (statement);
+	lua_createtable (lua, cols, 0);
 
-	sqlite3_close (self);
+	/* Push the columns to the table. */
+	for (col = 0 ; col < cols ; col++)
+	{
+		switch (sqlite3_column_type (statement, col))
+		{
+			case SQLITE_INTEGER:
+				lua_pushnumber (lua, sqlite3_column_int64 (statement, col));
+				lua_rawseti (lua, -2, col + 1);
+				break;
+			case SQLITE_FLOAT:
+				lua_pushnumber (lua, sqlite3_column_double (statement, col));
+				lua_rawseti (lua, -2, col + 1);
+				break;
+			case SQLITE_TEXT:
+				str = (const char*) sqlite3_column_text (statement, col);
+				size = sqlite3_column_bytes (statement, col);
+				if (str != NULL)
+				{
+					lua_pushlstring (lua, str, size);
+					lua_rawseti (lua, -2, col + 1);
+				}
+				break;
+			case SQLITE_BLOB:
+				str = sqlite3_column_blob (statement, col);
+				size = sqlite3_column_bytes (statement, col);
+				packet = liarc_packet_new_readable (str, size);
+				if (packet != NULL)
+				{
+					data = liscr_data_new (script, lua, packet, LISCR_SCRIPT_PACKET, liarc_packet_free);
+					if (data != NULL)
+						lua_rawseti (lua, -2, col + 1);
+					else
+						liarc_packet_free (packet);
+				}
+				break;
+			case SQLITE_NULL:
+				break;
+			default:
+				lisys_assert (0 && "invalid column type");
+				break;
+		}
+	}
 }
 
 /*****************************************************************************/
 
+static void DatabaseCursor_next (LIScrArgs* args)
+{
+	int ret;
+	LIExtDatabaseCursor* self;
+
+	self = args->self;
+	if (self->statement == NULL)
+		return;
+
+	/* Step to the next row. */
+	liext_database_lock (self->database);
+	ret = sqlite3_step (self->statement->statement);
+	if (ret == SQLITE_ROW)
+	{
+		private_push_row (args->script, args->lua, self->statement->statement);
+		liext_database_unlock (self->database);
+		liscr_args_seti_stack (args);
+		return;
+	}
+
+	/* Return the statement to the cache when done. */
+	if (ret != SQLITE_DONE)
+	{
+		lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self->database->sql));
+		lisys_error_report ();
+	}
+	liext_database_unlock (self->database);
+	liext_database_cursor_close (self);
+}
+
 static void Database_get_memory_used (LIScrArgs* args)
 {
 	liscr_args_seti_int (args, sqlite3_memory_used ());
 }
 
+static void Database_iterate (LIScrArgs* args)
+{
+	const char* query;
+	LIExtDatabase* self;
+	LIExtDatabaseCursor* cursor;
+	LIScrData* data;
+
+	self = args->self;
+	if (!liscr_args_geti_string (args, 0, &query) &&
+	    !liscr_args_gets_string (args, "query", &query))
+		return;
+
+	/* Create a cursor. */
+	liext_database_lock (self);
+	liext_database_sync (self, NULL);
+	cursor = liext_database_cursor_new (self, query);
+	if (cursor == NULL)
+	{
+		liext_database_unlock (self);
+		lisys_error_report ();
+		return;
+	}
+	liext_database_sync (self, cursor->statement);
+
+	/* Bind variables. */
+	if (liscr_args_geti_table (args, 1) || liscr_args_gets_table (args, "bind"))
+	{
+		if (!private_bind (self, cursor->statement->statement, args->lua, lua_gettop (args->lua)))
+		{
+			liext_database_unlock (self);
+			lisys_error_report ();
+			liext_database_cursor_free (cursor);
+			return;
+		}
+		lua_pop (args->lua, 1);
+	}
+	liext_database_unlock (self);
+
+	/* Allocate userdata. */
+	data = liscr_data_new (args->script, args->lua, cursor, LIEXT_SCRIPT_DATABASE_CURSOR, private_free_cursor);
+	if (data == NULL)
+	{
+		liext_database_cursor_free (cursor);
+		return;
+	}
+	liscr_args_seti_stack (args);
+}
+
+static void Database_flush (LIScrArgs* args)
+{
+	LIExtDatabase* self;
+
+	self = args->self;
+	if (self->worker != NULL)
+		liext_database_worker_flush (self->worker);
+}
+
 static void Database_new (LIScrArgs* args)
 {
 	int ok;
+	int async = 0;
 	char* path;
 	char* path1;
 	const char* ptr;
 	const char* name;
-	sqlite3* sql;
+	LIExtDatabase* self;
 	LIExtModule* module;
 	LIScrData* data;
 
@@ -94,21 +320,28 @@ static void Database_new (LIScrArgs* args)
 	}
 
 	/* Open database. */
-	if (sqlite3_open_v2 (path, &sql, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+	self = liext_database_new (path);
+	lisys_free (path);
+	if (self == NULL)
 	{
-		lisys_error_set (EINVAL, "sqlite: %s", sqlite3_errmsg (sql));
 		lisys_error_report ();
-		lisys_free (path);
-		lisys_free (sql);
 		return;
 	}
-	lisys_free (path);
+
+	/* Start the asynchronous worker. */
+	liscr_args_gets_bool (args, "async", &async);
+	if (async && liext_database_worker_new (module, self) == NULL)
+	{
+		lisys_error_report ();
+		liext_database_free (self);
+		return;
+	}
 
 	/* Allocate userdata. */
-	data = liscr_data_new (args->script, args->lua, sql, LIEXT_SCRIPT_DATABASE, private_free_database);
+	data = liscr_data_new (args->script, args->lua, self, LIEXT_SCRIPT_DATABASE, private_free_database);
 	if (data == NULL)
 	{
-		sqlite3_close (sql);
+		liext_database_free (self);
 		return;
 	}
 	liscr_args_seti_stack (args);
@@ -116,184 +349,249 @@ static void Database_new (LIScrArgs* args)
 
 static void Database_query (LIScrArgs* args)
 {
-	int i;
-	int col;
 	int row;
 	int ret;
-	int size;
+	int bind = 0;
 	const char* query;
-	const char* str;
-	sqlite3* self;
-	LIArcPacket* packet;
-	LIScrData* data;
-	sqlite3_stmt* statement;
+	LIExtDatabase* self;
+	LIExtDatabaseStatement* statement;
 
 	self = args->self;
 	if (!liscr_args_geti_string (args, 0, &query) &&
 	    !liscr_args_gets_string (args, "query", &query))
 		return;
+	if (liscr_args_geti_table (args, 1) || liscr_args_gets_table (args, "bind"))
+		bind = lua_gettop (args->lua);
+
+	/* Queue writes of asynchronous databases. */
+	/* Statements that may return rows are executed synchronously after
+	   the queued writes to the tables they read have finished. */
+	if (self->worker != NULL && liext_database_classify (query) != LIEXT_DATABASE_JOB_READ)
+	{
+		liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+		if (!liext_database_worker_write (self->worker, query, NULL, args->lua, bind, 0))
+			lisys_error_report ();
+		return;
+	}
 
-	/* Create a statement. */
-	if (sqlite3_prepare_v2 (self, query, -1, &statement, NULL) != SQLITE_OK)
+	/* Get a statement. */
+	liext_database_lock (self);
+	liext_database_sync (self, NULL);
+	statement = liext_database_prepare (self, query);
+	if (statement == NULL)
 	{
-		lisys_error_set (EINVAL, "SQL prepare: %s", sqlite3_errmsg (self));
+		liext_database_unlock (self);
 		lisys_error_report ();
 		return;
 	}
+	liext_database_sync (self, statement);
 
 	/* Bind variables. */
-	if (liscr_args_geti_table (args, 1) || liscr_args_gets_table (args, "bind"))
+	if (bind)
 	{
-		for (i = 1 ; i < sqlite3_bind_parameter_count (statement) + 1 ; i++)
+		if (!private_bind (self, statement->statement, args->lua, bind))
 		{
-			/* We got a table that has the bound variables in fields matching
-			   the indices of the bound variables. We can simply loop through
-			   the table and use the binding index as the key. */
-			lua_pushnumber (args->lua, i);
-			lua_gettable (args->lua, -2);
-			switch (lua_type (args->lua, -1))
-			{
-				/* Bind numbers as doubles. */
-				case LUA_TNUMBER:
-					if (sqlite3_bind_double (statement, i, lua_tonumber (args->lua, -1)) != SQLITE_OK)
-					{
-						lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self));
-						lisys_error_report ();
-						sqlite3_finalize (statement);
-						return;
-					}
-					break;
-
-				/* Bind strings as text. */
-				case LUA_TSTRING:
-					if (sqlite3_bind_text (statement, i, lua_tostring (args->lua, -1), -1, SQLITE_TRANSIENT) != SQLITE_OK)
-					{
-						lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self));
-						lisys_error_report ();
-						sqlite3_finalize (statement);
-						return;
-					}
-					break;
-
-				/* Bind packets as blobs. */
-				case LUA_TUSERDATA:
-					data = liscr_isdata (args->lua, -1, LISCR_SCRIPT_PACKET);
-					if (data == NULL)
-						break;
-					packet = liscr_data_get_data (data);
-					if (packet->writer != NULL)
-					{
-						if (sqlite3_bind_blob (statement, i, packet->writer->memory.buffer,
-							packet->writer->memory.length, SQLITE_TRANSIENT) != SQLITE_OK)
-						{
-							lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self));
-							lisys_error_report ();
-							sqlite3_finalize (statement);
-							return;
-						}
-					}
-					else
-					{
-						if (sqlite3_bind_blob (statement, i, packet->reader->buffer,
-							packet->reader->length, SQLITE_TRANSIENT) != SQLITE_OK)
-						{
-							lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self));
-							lisys_error_report ();
-							sqlite3_finalize (statement);
-							return;
-						}
-					}
-					break;
-
-				/* Bind any other values as NULL. */
-				default:
-					if (sqlite3_bind_null (statement, i) != SQLITE_OK)
-					{
-						lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self));
-						lisys_error_report ();
-						sqlite3_finalize (statement);
-						return;
-					}
-					break;
-			}
-			lua_pop (args->lua, 1);
+			liext_database_release (self, statement);
+			liext_database_unlock (self);
+			lisys_error_report ();
+			return;
 		}
-		lua_pop (args->lua, 1);
 	}
 
 	/* Execute the statement and process results. */
-	for (row = 0, ret = sqlite3_step (statement) ; ret != SQLITE_DONE ; ret = sqlite3_step (statement), row++)
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	for (row = 0, ret = sqlite3_step (statement->statement) ; ret != SQLITE_DONE ; ret = sqlite3_step (statement->statement), row++)
 	{
 		/* Check for errors. */
 		if (ret != SQLITE_ROW)
 		{
-			lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self));
+			lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self->sql));
+			lisys_error_report ();
+			break;
+		}
+
+		/* Add the row to the return values. */
+		private_push_row (args->script, args->lua, statement->statement);
+		liscr_args_seti_stack (args);
+	}
+	liext_database_release (self, statement);
+	liext_database_unlock (self);
+}
+
+static void Database_query_async (LIScrArgs* args)
+{
+	int id;
+	int bind = 0;
+	const char* query;
+	LIExtDatabase* self;
+
+	self = args->self;
+	if (!liscr_args_geti_string (args, 0, &query) &&
+	    !liscr_args_gets_string (args, "query", &query))
+		return;
+	if (self->worker == NULL)
+	{
+		lisys_error_set (EINVAL, "the database is not asynchronous");
+		lisys_error_report ();
+		return;
+	}
+	if (liscr_args_geti_table (args, 1) || liscr_args_gets_table (args, "bind"))
+		bind = lua_gettop (args->lua);
+
+	/* Queue the query. */
+	id = liext_database_worker_read (self->worker, query, args->lua, bind);
+	if (!id)
+	{
+		lisys_error_report ();
+		return;
+	}
+	liscr_args_seti_int (args, id);
+}
+
+static void Database_query_batch (LIScrArgs* args)
+{
+	int i;
+	int ok;
+	int ret;
+	int rows;
+	const char* query;
+	LIExtDatabase* self;
+	LIExtDatabaseStatement* statement;
+
+	self = args->self;
+	if (!liscr_args_geti_string (args, 0, &query) &&
+	    !liscr_args_gets_string (args, "query", &query))
+		return;
+	if (!liscr_args_geti_table (args, 1) && !liscr_args_gets_table (args, "rows"))
+		return;
+	rows = lua_gettop (args->lua);
+
+	/* Queue the batch if asynchronous. */
+	if (self->worker != NULL)
+	{
+		if (!liext_database_worker_write (self->worker, query, NULL, args->lua, rows, 1))
+		{
 			lisys_error_report ();
-			sqlite3_finalize (statement);
 			return;
 		}
-		if (!row)
-			liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+		liscr_args_seti_int (args, lua_objlen (args->lua, rows));
+		return;
+	}
 
-		/* Create a row table. */
-		lua_newtable (args->lua);
+	/* Get a statement. */
+	statement = liext_database_prepare (self, query);
+	if (statement == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+
+	/* Begin a savepoint. */
+	/* Outside transactions, the savepoint starts a transaction of its own so
+	   that the journal is synced only once. Inside the transaction of the
+	   caller, it allows the rows to be rolled back without the rest. */
+	if (!liext_database_exec (self, "SAVEPOINT liext_batch;"))
+	{
+		lisys_error_report ();
+		liext_database_release (self, statement);
+		return;
+	}
 
-		/* Push the columns to the table. */
-		for (col = 0 ; col < sqlite3_column_count (statement) ; col++)
+	/* Execute the statement for each row. */
+	for (ok = 1, i = 1 ; ok ; i++)
+	{
+		lua_rawgeti (args->lua, rows, i);
+		if (lua_type (args->lua, -1) != LUA_TTABLE)
 		{
-			switch (sqlite3_column_type (statement, col))
-			{
-				case SQLITE_INTEGER:
-					lua_pushnumber (args->lua, col + 1);
-					lua_pushnumber (args->lua, sqlite3_column_int (statement, col));
-					lua_settable (args->lua, -3);
-					break;
-				case SQLITE_FLOAT:
-					lua_pushnumber (args->lua, col + 1);
-					lua_pushnumber (args->lua, sqlite3_column_double (statement, col));
-					lua_settable (args->lua, -3);
-					break;
-				case SQLITE_TEXT:
-					str = (const char*) sqlite3_column_text (statement, col);
-					size = sqlite3_column_bytes (statement, col);
-					lua_pushnumber (args->lua, col + 1);
-					if (size > 0 && str != NULL)
-						lua_pushstring (args->lua, str);
-					else
-						lua_pushstring (args->lua, str);
-					lua_settable (args->lua, -3);
-					break;
-				case SQLITE_BLOB:
-					str = sqlite3_column_blob (statement, col);
-					size = sqlite3_column_bytes (statement, col);
-					packet = liarc_packet_new_readable (str, size);
-					if (packet != NULL)
-					{
-						lua_pushnumber (args->lua, col + 1);
-						data = liscr_data_new (args->script, args->lua, packet, LISCR_SCRIPT_PACKET, liarc_packet_free);
-						if (data != NULL)
-							lua_settable (args->lua, -3);
-						else
-						{
-							lua_pop (args->lua, 1);
-							liarc_packet_free (packet);
-						}
-					}
-					break;
-				case SQLITE_NULL:
-					break;
-				default:
-					lisys_assert (0 && "invalid column type");
-					break;
-			}
+			lua_pop (args->lua, 1);
+			break;
+		}
+		ok = private_bind (self, statement->statement, args->lua, lua_gettop (args->lua));
+		lua_pop (args->lua, 1);
+		if (!ok)
+			break;
+		do
+			ret = sqlite3_step (statement->statement);
+		while (ret == SQLITE_ROW);
+		if (ret != SQLITE_DONE)
+		{
+			lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self->sql));
+			ok = 0;
 		}
+		sqlite3_reset (statement->statement);
+		sqlite3_clear_bindings (statement->statement);
+	}
+	liext_database_release (self, statement);
 
-		/* Add the row to the return values. */
-		liscr_args_seti_stack (args);
+	/* Commit or roll back. */
+	if (ok && !liext_database_exec (self, "RELEASE liext_batch;"))
+		ok = 0;
+	if (!ok)
+	{
+		lisys_error_report ();
+		liext_database_exec (self, "ROLLBACK TO liext_batch;");
+		liext_database_exec (self, "RELEASE liext_batch;");
+		return;
 	}
-	if (!row)
-		liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
-	sqlite3_finalize (statement);
+	liscr_args_seti_int (args, i - 1);
+}
+
+static void Database_write (LIScrArgs* args)
+{
+	int bind = 0;
+	const char* key = NULL;
+	const char* query;
+	LIExtDatabase* self;
+
+	self = args->self;
+	if (!liscr_args_geti_string (args, 0, &query) &&
+	    !liscr_args_gets_string (args, "query", &query))
+		return;
+	if (!liscr_args_geti_string (args, 2, &key))
+		liscr_args_gets_string (args, "key", &key);
+
+	/* Execute synchronously if not asynchronous. */
+	if (self->worker == NULL)
+	{
+		Database_query (args);
+		return;
+	}
+
+	/* Queue the write. */
+	if (liscr_args_geti_table (args, 1) || liscr_args_gets_table (args, "bind"))
+		bind = lua_gettop (args->lua);
+	if (!liext_database_worker_write (self->worker, query, key, args->lua, bind, 0))
+		lisys_error_report ();
+}
+
+static void Database_get_queue_stats (LIScrArgs* args)
+{
+	LIExtDatabase* self;
+	LIExtDatabaseWorker* worker;
+
+	self = args->self;
+	worker = self->worker;
+	if (worker == NULL)
+		return;
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	liscr_args_sets_int (args, "coalesced", worker->stats.coalesced);
+	liscr_args_sets_int (args, "commits", worker->stats.commits);
+	liscr_args_sets_int (args, "errors", worker->stats.errors);
+	liscr_args_sets_int (args, "pending", worker->queue->count);
+	liscr_args_sets_int (args, "writes", worker->stats.writes);
+}
+
+static void Database_get_statement_stats (LIScrArgs* args)
+{
+	LIExtDatabase* self;
+
+	self = args->self;
+	liext_database_lock (self);
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	liscr_args_sets_int (args, "cached", self->statements->size);
+	liscr_args_sets_int (args, "hits", self->stats.hits);
+	liscr_args_sets_int (args, "misses", self->stats.misses);
+	liext_database_unlock (self);
 }
 
 /*****************************************************************************/
@@ -303,7 +601,15 @@ void liext_script_database (
 {
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_DATABASE, "database_get_memory_used", Database_get_memory_used);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_DATABASE, "database_new", Database_new);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_flush", Database_flush);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_iterate", Database_iterate);
 	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_query", Database_query);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_query_async", Database_query_async);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_query_batch", Database_query_batch);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_write", Database_write);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_get_queue_stats", Database_get_queue_stats);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE, "database_get_statement_stats", Database_get_statement_stats);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_DATABASE_CURSOR, "database_cursor_next", DatabaseCursor_next);
 }
 
 /** @} */
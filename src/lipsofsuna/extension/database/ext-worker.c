@@ -0,0 +1,1087 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtDatabase Database
+ * @{
+ */
+
+#include "ext-module.h"
+
+static LIExtDatabaseBatch* private_batch_new ();
+
+static void private_batch_free (
+	LIExtDatabaseBatch* batch);
+
+static int private_capture (
+	LIExtDatabaseJob* job,
+	lua_State*        lua,
+	int               table,
+	int               batch);
+
+static int private_capture_value (
+	LIExtDatabaseValue* value,
+	lua_State*          lua,
+	int                 index);
+
+static int private_exec (
+	LIExtDatabaseWorker* self,
+	const char*          sql);
+
+static LIExtDatabaseJob* private_job_new (
+	LIExtDatabaseWorker* self,
+	int                  type,
+	const char*          sql);
+
+static void private_job_free (
+	LIExtDatabaseJob* job);
+
+static int private_mark (
+	LIExtDatabaseWorker* self,
+	int                  type,
+	const char*          sql);
+
+static int private_push (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job,
+	const char*          key);
+
+static void private_push_event (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job);
+
+static void private_run_batch (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseBatch*  batch);
+
+static int private_run_job (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job);
+
+static int private_send (
+	LIExtDatabaseWorker* self);
+
+static int private_store_row (
+	LIExtDatabaseJob* job,
+	sqlite3_stmt*     statement);
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data);
+
+/*****************************************************************************/
+
+/**
+ * \brief Starts an asynchronous worker for the database.
+ *
+ * The worker thread owns the connection from now on. Writes are collected
+ * to a write-behind queue that is handed over to the worker periodically
+ * and executed there in a single group commit. The database is switched to
+ * the WAL journal mode so that each group commit is atomic and durable
+ * without blocking readers.
+ *
+ * \param module Module.
+ * \param database Database.
+ * \return Worker or NULL.
+ */
+LIExtDatabaseWorker* liext_database_worker_new (
+	LIExtModule*   module,
+	LIExtDatabase* database)
+{
+	LIExtDatabaseWorker* self;
+
+	lisys_assert (database->worker == NULL);
+
+	/* Check for thread support. */
+	if (!sqlite3_threadsafe ())
+	{
+		lisys_error_set (ENOTSUP, "SQLite was built without thread support");
+		return NULL;
+	}
+
+	/* Enable write-ahead logging. */
+	if (!liext_database_exec (database, "PRAGMA journal_mode=WAL;") ||
+	    !liext_database_exec (database, "PRAGMA synchronous=NORMAL;"))
+		return NULL;
+
+	/* Allocate self. */
+	self = lisys_calloc (1, sizeof (LIExtDatabaseWorker));
+	if (self == NULL)
+		return NULL;
+	self->database = database;
+	self->interval = LIEXT_DATABASE_COMMIT_SECS;
+	self->module = module;
+	self->keys = lialg_strdic_new ();
+	self->tables = lialg_strdic_new ();
+	self->queue = private_batch_new ();
+	self->batches = lisys_channel_new (LIEXT_DATABASE_BATCHES_MAX);
+	self->mutex = lisys_mutex_new ();
+	database->mutex = lisys_mutex_new ();
+	if (self->keys == NULL || self->tables == NULL || self->queue == NULL || self->batches == NULL ||
+	    self->mutex == NULL || database->mutex == NULL)
+	{
+		liext_database_worker_free (self);
+		return NULL;
+	}
+
+	/* Register to the module. */
+	if (!lialg_ptrdic_insert (module->workers, self, self))
+	{
+		liext_database_worker_free (self);
+		return NULL;
+	}
+	database->worker = self;
+
+	/* Start the thread. */
+	self->thread = lisys_thread_new (private_worker_main, self);
+	if (self->thread == NULL)
+	{
+		liext_database_worker_free (self);
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * \brief Finishes the queued writes and stops the worker.
+ *
+ * If the scripts have left a transaction open, it is rolled back when the
+ * connection is closed, just like it would be after a crash.
+ *
+ * \param self Worker.
+ */
+void liext_database_worker_free (
+	LIExtDatabaseWorker* self)
+{
+	LIExtDatabaseJob* job;
+	LIExtDatabaseJob* job_next;
+
+	/* Stop the thread. */
+	if (self->thread != NULL)
+	{
+		liext_database_worker_flush (self);
+		self->quit = 1;
+		lisys_thread_free (self->thread);
+	}
+
+	/* Discard unhandled results. */
+	for (job = self->results.first ; job != NULL ; job = job_next)
+	{
+		job_next = job->next;
+		private_job_free (job);
+	}
+
+	/* Unregister from the module. */
+	lialg_ptrdic_remove (self->module->workers, self);
+	if (self->database->worker == self)
+		self->database->worker = NULL;
+
+	if (self->batches != NULL)
+		lisys_channel_free (self->batches);
+	if (self->queue != NULL)
+		private_batch_free (self->queue);
+	if (self->keys != NULL)
+		lialg_strdic_free (self->keys);
+	if (self->tables != NULL)
+		lialg_strdic_free (self->tables);
+	if (self->mutex != NULL)
+		lisys_mutex_free (self->mutex);
+	lisys_free (self);
+}
+
+/**
+ * \brief Hands the write-behind queue to the worker and waits for it to finish.
+ *
+ * Unless a transaction is left open by the scripts, all the queued writes
+ * have been committed when this returns.
+ *
+ * \param self Worker.
+ */
+void liext_database_worker_flush (
+	LIExtDatabaseWorker* self)
+{
+	if (!private_send (self))
+		lisys_error_report ();
+	while (self->done != self->sent)
+		lisys_usleep (LIEXT_DATABASE_IDLE_USECS);
+}
+
+/**
+ * \brief Checks if a statement could read writes that haven't finished.
+ *
+ * The batch of the last queued write of each table is recorded so that the
+ * check only needs to compare it with the number of finished batches. Writes
+ * whose table isn't known, such as schema changes, affect all statements.
+ *
+ * \param self Worker.
+ * \param statement Statement prepared on the main thread, or NULL.
+ * \return Nonzero if the queue needs to be flushed before the statement.
+ */
+int liext_database_worker_pending (
+	LIExtDatabaseWorker*    self,
+	LIExtDatabaseStatement* statement)
+{
+	int done = self->done;
+	LIAlgStrdicIter iter;
+
+	/* Check for writes that could have modified any table. */
+	if ((intptr_t) lialg_strdic_find (self->tables, "*") > done)
+		return 1;
+	if (statement == NULL)
+		return 0;
+
+	/* Check for writes to the tables read by the statement. */
+	if (statement->reads_all)
+	{
+		LIALG_STRDIC_FOREACH (iter, self->tables)
+		{
+			if ((intptr_t) iter.value > done)
+				return 1;
+		}
+	}
+	else if (statement->reads != NULL)
+	{
+		LIALG_STRDIC_FOREACH (iter, statement->reads)
+		{
+			if ((intptr_t) lialg_strdic_find (self->tables, iter.key) > done)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Queues an asynchronous read.
+ *
+ * The query is executed by the worker after the writes queued before it.
+ * The queue is handed over on the next update instead of waiting for the
+ * commit interval. When it finishes, an event containing the rows is
+ * emitted.
+ *
+ * \param self Worker.
+ * \param sql SQL statement.
+ * \param lua Lua state.
+ * \param bind Stack index of the array of values to bind, or zero.
+ * \return Query ID or zero.
+ */
+int liext_database_worker_read (
+	LIExtDatabaseWorker* self,
+	const char*          sql,
+	lua_State*           lua,
+	int                  bind)
+{
+	LIExtDatabaseJob* job;
+
+	job = private_job_new (self, LIEXT_DATABASE_JOB_READ, sql);
+	if (job == NULL)
+		return 0;
+	job->id = ++self->module->id;
+	if (!private_capture (job, lua, bind, 0) || !private_push (self, job, NULL))
+	{
+		private_job_free (job);
+		return 0;
+	}
+	self->reading = 1;
+
+	return job->id;
+}
+
+/**
+ * \brief Queues a write.
+ *
+ * If a key is given and a write with the same key is still in the queue in
+ * the same transaction, the old write is discarded in favor of the new one.
+ * Transaction control statements are converted to savepoints so that they
+ * nest inside the group commits of the worker.
+ *
+ * \param self Worker.
+ * \param sql SQL statement.
+ * \param key Coalescing key, or NULL.
+ * \param lua Lua state.
+ * \param bind Stack index of the values to bind, or zero.
+ * \param batch Nonzero if the bind table is an array of binding arrays.
+ * \return Nonzero on success.
+ */
+int liext_database_worker_write (
+	LIExtDatabaseWorker* self,
+	const char*          sql,
+	const char*          key,
+	lua_State*           lua,
+	int                  bind,
+	int                  batch)
+{
+	int type;
+	LIExtDatabaseJob* job;
+
+	/* Track the transaction scope. */
+	type = liext_database_classify (sql);
+	if (type == LIEXT_DATABASE_JOB_READ)
+		type = LIEXT_DATABASE_JOB_WRITE;
+	if (type == LIEXT_DATABASE_JOB_BEGIN)
+	{
+		self->depth++;
+		self->scope++;
+	}
+	else if (type == LIEXT_DATABASE_JOB_COMMIT || type == LIEXT_DATABASE_JOB_ROLLBACK)
+	{
+		if (self->depth > 0)
+			self->depth--;
+		self->scope++;
+	}
+
+	/* Queue the job. */
+	if (!private_mark (self, type, sql))
+		return 0;
+	job = private_job_new (self, type, sql);
+	if (job == NULL)
+		return 0;
+	if (!private_capture (job, lua, bind, batch) || !private_push (self, job, key))
+	{
+		private_job_free (job);
+		return 0;
+	}
+	self->stats.writes++;
+
+	/* Limit the length of the queue. */
+	if (self->queue->count >= LIEXT_DATABASE_QUEUE_MAX)
+		return private_send (self);
+
+	return 1;
+}
+
+/**
+ * \brief Emits events for finished reads and starts group commits.
+ *
+ * Called once per tick by the main thread of the program. The queue is
+ * handed over to the worker once the commit interval has passed, or right
+ * away if it contains reads, but not while the scripts have a transaction
+ * open.
+ *
+ * \param self Worker.
+ * \param secs Seconds since the last update.
+ */
+void liext_database_worker_update (
+	LIExtDatabaseWorker* self,
+	float                secs)
+{
+	LIExtDatabaseJob* job;
+	LIExtDatabaseJob* job_next;
+
+	/* Start a group commit. */
+	self->timer += secs;
+	if ((self->timer >= self->interval || self->reading) && !self->depth)
+	{
+		if (!private_send (self))
+			lisys_error_report ();
+	}
+
+	/* Take the finished reads. */
+	lisys_mutex_lock (self->mutex);
+	job = self->results.first;
+	self->results.first = NULL;
+	self->results.last = NULL;
+	lisys_mutex_unlock (self->mutex);
+
+	/* Emit events. */
+	for ( ; job != NULL ; job = job_next)
+	{
+		job_next = job->next;
+		private_push_event (self, job);
+		private_job_free (job);
+	}
+}
+
+/*****************************************************************************/
+
+static LIExtDatabaseBatch* private_batch_new ()
+{
+	LIExtDatabaseBatch* self;
+
+	self = lisys_calloc (1, sizeof (LIExtDatabaseBatch));
+	if (self == NULL)
+		return NULL;
+	self->capacity = 64;
+	self->array = lisys_calloc (self->capacity, sizeof (LIExtDatabaseJob*));
+	if (self->array == NULL)
+	{
+		lisys_free (self);
+		return NULL;
+	}
+
+	return self;
+}
+
+static void private_batch_free (
+	LIExtDatabaseBatch* batch)
+{
+	int i;
+
+	for (i = 0 ; i < batch->count ; i++)
+	{
+		if (batch->array[i] != NULL)
+			private_job_free (batch->array[i]);
+	}
+	lisys_free (batch->array);
+	lisys_free (batch);
+}
+
+static int private_capture (
+	LIExtDatabaseJob* job,
+	lua_State*        lua,
+	int               table,
+	int               batch)
+{
+	int i;
+	int j;
+	int count;
+	int width;
+	int rows;
+	LIExtDatabaseValue* values;
+
+	/* Calculate the size of the bindings. */
+	/* The binding arrays may have holes for NULL values so we need to find
+	   the largest index instead of trusting the length operator. */
+	count = 1;
+	width = 0;
+	if (table)
+	{
+		rows = batch? lua_objlen (lua, table) : 1;
+		for (count = 0 ; count < rows ; count++)
+		{
+			if (batch)
+			{
+				lua_rawgeti (lua, table, count + 1);
+				if (lua_type (lua, -1) != LUA_TTABLE)
+				{
+					lua_pop (lua, 1);
+					break;
+				}
+			}
+			else
+				lua_pushvalue (lua, table);
+			lua_pushnil (lua);
+			while (lua_next (lua, -2))
+			{
+				if (lua_type (lua, -2) == LUA_TNUMBER)
+				{
+					i = (int) lua_tonumber (lua, -2);
+					if (i > width && i == lua_tonumber (lua, -2))
+						width = i;
+				}
+				lua_pop (lua, 1);
+			}
+			lua_pop (lua, 1);
+		}
+	}
+	if (!count || !width)
+	{
+		job->binds.count = count;
+		return 1;
+	}
+
+	/* Allocate the values. */
+	values = lisys_calloc (count * width, sizeof (LIExtDatabaseValue));
+	if (values == NULL)
+		return 0;
+	job->binds.count = count;
+	job->binds.width = width;
+	job->binds.array = values;
+
+	/* Copy the values. */
+	for (i = 0 ; i < count ; i++)
+	{
+		if (batch)
+			lua_rawgeti (lua, table, i + 1);
+		else
+			lua_pushvalue (lua, table);
+		for (j = 0 ; j < width ; j++)
+		{
+			lua_rawgeti (lua, -1, j + 1);
+			if (!private_capture_value (values + i * width + j, lua, -1))
+			{
+				lua_pop (lua, 2);
+				return 0;
+			}
+			lua_pop (lua, 1);
+		}
+		lua_pop (lua, 1);
+	}
+
+	return 1;
+}
+
+static int private_capture_value (
+	LIExtDatabaseValue* value,
+	lua_State*          lua,
+	int                 index)
+{
+	size_t len;
+	double number;
+	const char* str;
+	LIArcPacket* packet;
+	LIScrData* data;
+
+	switch (lua_type (lua, index))
+	{
+		/* Integral numbers are bound as integers like in synchronous queries. */
+		case LUA_TNUMBER:
+			number = lua_tonumber (lua, index);
+			if (number >= -LIEXT_DATABASE_INTEGER_MAX && number <= LIEXT_DATABASE_INTEGER_MAX &&
+			    number == (sqlite3_int64) number)
+			{
+				value->type = SQLITE_INTEGER;
+				value->integer = (sqlite3_int64) number;
+			}
+			else
+			{
+				value->type = SQLITE_FLOAT;
+				value->number = number;
+			}
+			return 1;
+
+		/* Strings and packets are copied since the worker runs later. */
+		case LUA_TSTRING:
+			str = lua_tolstring (lua, index, &len);
+			value->type = SQLITE_TEXT;
+			break;
+		case LUA_TUSERDATA:
+			data = liscr_isdata (lua, index, LISCR_SCRIPT_PACKET);
+			if (data == NULL)
+			{
+				value->type = SQLITE_NULL;
+				return 1;
+			}
+			packet = liscr_data_get_data (data);
+			if (packet->writer != NULL)
+			{
+				str = packet->writer->memory.buffer;
+				len = packet->writer->memory.length;
+			}
+			else
+			{
+				str = packet->reader->buffer;
+				len = packet->reader->length;
+			}
+			value->type = SQLITE_BLOB;
+			break;
+
+		default:
+			value->type = SQLITE_NULL;
+			return 1;
+	}
+
+	value->data = lisys_malloc (len + 1);
+	if (value->data == NULL)
+	{
+		value->type = SQLITE_NULL;
+		return 0;
+	}
+	memcpy (value->data, str, len);
+	value->data[len] = '\0';
+	value->length = len;
+
+	return 1;
+}
+
+static int private_exec (
+	LIExtDatabaseWorker* self,
+	const char*          sql)
+{
+	if (liext_database_exec (self->database, sql))
+		return 1;
+	self->stats.errors++;
+	lisys_error_report ();
+	return 0;
+}
+
+static LIExtDatabaseJob* private_job_new (
+	LIExtDatabaseWorker* self,
+	int                  type,
+	const char*          sql)
+{
+	LIExtDatabaseJob* job;
+
+	job = lisys_calloc (1, sizeof (LIExtDatabaseJob));
+	if (job == NULL)
+		return NULL;
+	job->type = type;
+	job->scope = self->scope;
+	job->sql = lisys_string_dup (sql);
+	if (job->sql == NULL)
+	{
+		lisys_free (job);
+		return NULL;
+	}
+
+	return job;
+}
+
+static void private_job_free (
+	LIExtDatabaseJob* job)
+{
+	int i;
+
+	for (i = 0 ; i < job->binds.count * job->binds.width ; i++)
+		lisys_free (job->binds.array[i].data);
+	for (i = 0 ; i < job->rows.count * job->rows.width ; i++)
+		lisys_free (job->rows.array[i].data);
+	lisys_free (job->binds.array);
+	lisys_free (job->rows.array);
+	lisys_free (job->error);
+	lisys_free (job->sql);
+	lisys_free (job);
+}
+
+static int private_mark (
+	LIExtDatabaseWorker* self,
+	int                  type,
+	const char*          sql)
+{
+	char* name;
+	LIAlgStrdicNode* node;
+	void* batch = (void*)(intptr_t)(self->sent + 1);
+
+	/* Find the modified table. */
+	/* Rollbacks and unrecognized writes could modify any table. */
+	if (type == LIEXT_DATABASE_JOB_BEGIN || type == LIEXT_DATABASE_JOB_COMMIT)
+		return 1;
+	name = NULL;
+	if (type == LIEXT_DATABASE_JOB_WRITE)
+		name = liext_database_get_table (sql);
+
+	/* Store the batch that will contain the write. */
+	node = lialg_strdic_find_node (self->tables, name != NULL? name : "*");
+	if (node != NULL)
+		node->value = batch;
+	else
+		node = lialg_strdic_insert (self->tables, name != NULL? name : "*", batch);
+	lisys_free (name);
+
+	return node != NULL;
+}
+
+static int private_push (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job,
+	const char*          key)
+{
+	int capacity;
+	LIAlgStrdicNode* node;
+	LIExtDatabaseJob* old;
+	LIExtDatabaseJob** tmp;
+	LIExtDatabaseBatch* queue = self->queue;
+
+	/* Make room for the job. */
+	if (queue->count == queue->capacity)
+	{
+		capacity = queue->capacity << 1;
+		tmp = lisys_realloc (queue->array, capacity * sizeof (LIExtDatabaseJob*));
+		if (tmp == NULL)
+			return 0;
+		queue->array = tmp;
+		queue->capacity = capacity;
+	}
+
+	/* Coalesce with the previous write of the key. */
+	/* The old write is replaced with an empty job instead of being removed
+	   so that the indices of the other coalescable writes stay valid. */
+	if (key != NULL)
+	{
+		node = lialg_strdic_find_node (self->keys, key);
+		if (node != NULL)
+		{
+			old = queue->array[(intptr_t) node->value];
+			if (old->scope == job->scope)
+			{
+				old->type = LIEXT_DATABASE_JOB_NONE;
+				self->stats.coalesced++;
+			}
+			node->value = (void*)(intptr_t) queue->count;
+		}
+		else if (!lialg_strdic_insert (self->keys, key, (void*)(intptr_t) queue->count))
+			return 0;
+	}
+
+	queue->array[queue->count++] = job;
+
+	return 1;
+}
+
+static void private_push_event (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job)
+{
+	int i;
+	int j;
+	LIArcPacket* packet;
+	LIExtDatabaseValue* value;
+	LIScrData* data;
+	LIScrScript* script = self->module->program->script;
+	lua_State* lua = liscr_script_get_lua (script);
+
+	/* Create the event. */
+	lua_newtable (lua);
+	lua_pushnumber (lua, job->id);
+	lua_setfield (lua, -2, "id");
+	if (job->error != NULL)
+	{
+		lua_pushstring (lua, job->error);
+		lua_setfield (lua, -2, "error");
+	}
+
+	/* Add the rows. */
+	lua_createtable (lua, job->rows.count, 0);
+	for (i = 0 ; i < job->rows.count ; i++)
+	{
+		lua_createtable (lua, job->rows.width, 0);
+		for (j = 0 ; j < job->rows.width ; j++)
+		{
+			value = job->rows.array + i * job->rows.width + j;
+			switch (value->type)
+			{
+				case SQLITE_INTEGER:
+					lua_pushnumber (lua, value->integer);
+					lua_rawseti (lua, -2, j + 1);
+					break;
+				case SQLITE_FLOAT:
+					lua_pushnumber (lua, value->number);
+					lua_rawseti (lua, -2, j + 1);
+					break;
+				case SQLITE_TEXT:
+					lua_pushlstring (lua, value->data, value->length);
+					lua_rawseti (lua, -2, j + 1);
+					break;
+				case SQLITE_BLOB:
+					packet = liarc_packet_new_readable (value->data, value->length);
+					if (packet != NULL)
+					{
+						data = liscr_data_new (script, lua, packet, LISCR_SCRIPT_PACKET, liarc_packet_free);
+						if (data != NULL)
+							lua_rawseti (lua, -2, j + 1);
+						else
+							liarc_packet_free (packet);
+					}
+					break;
+			}
+		}
+		lua_rawseti (lua, -2, i + 1);
+	}
+	lua_setfield (lua, -2, "rows");
+
+	/* Add to the queue. */
+	limai_program_event_table (self->module->program, "database-query");
+}
+
+static void private_run_batch (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseBatch*  batch)
+{
+	int i;
+	int ok;
+	LIExtDatabaseJob* job;
+	LIExtDatabase* database = self->database;
+
+	lisys_mutex_lock (database->mutex);
+	for (i = 0 ; i < batch->count ; i++)
+	{
+		job = batch->array[i];
+
+		/* Open the group transaction. */
+		/* The transactions of the scripts become savepoints inside the
+		   group transaction so that they are still atomic but don't force
+		   a separate commit. */
+		if (job->type != LIEXT_DATABASE_JOB_NONE && job->type != LIEXT_DATABASE_JOB_READ &&
+		   !self->transaction && sqlite3_get_autocommit (database->sql))
+			self->transaction = private_exec (self, "BEGIN TRANSACTION;");
+
+		/* Execute the job. */
+		switch (job->type)
+		{
+			case LIEXT_DATABASE_JOB_BEGIN:
+				if (private_exec (self, "SAVEPOINT liext_user;"))
+					self->savepoints++;
+				break;
+			case LIEXT_DATABASE_JOB_COMMIT:
+				if (!self->savepoints)
+				{
+					lisys_error_set (EINVAL, "SQL: cannot commit - no transaction is active");
+					lisys_error_report ();
+					self->stats.errors++;
+					break;
+				}
+				private_exec (self, "RELEASE liext_user;");
+				self->savepoints--;
+				break;
+			case LIEXT_DATABASE_JOB_ROLLBACK:
+				if (!self->savepoints)
+				{
+					lisys_error_set (EINVAL, "SQL: cannot rollback - no transaction is active");
+					lisys_error_report ();
+					self->stats.errors++;
+					break;
+				}
+				private_exec (self, "ROLLBACK TO liext_user;");
+				private_exec (self, "RELEASE liext_user;");
+				self->savepoints--;
+				break;
+			case LIEXT_DATABASE_JOB_READ:
+				if (!private_run_job (self, job))
+					job->error = lisys_string_dup (lisys_error_get_string ());
+				break;
+			case LIEXT_DATABASE_JOB_WRITE:
+				/* Batches are all or nothing like their synchronous counterparts. */
+				if (job->binds.count > 1)
+				{
+					private_exec (self, "SAVEPOINT liext_batch;");
+					ok = private_run_job (self, job);
+					if (!ok)
+						private_exec (self, "ROLLBACK TO liext_batch;");
+					private_exec (self, "RELEASE liext_batch;");
+				}
+				else
+					ok = private_run_job (self, job);
+				if (!ok)
+				{
+					lisys_error_report ();
+					self->stats.errors++;
+				}
+				break;
+		}
+
+		/* Pass the results of reads to the main thread. */
+		if (job->type == LIEXT_DATABASE_JOB_READ)
+		{
+			lisys_mutex_lock (self->mutex);
+			if (self->results.last != NULL)
+				self->results.last->next = job;
+			else
+				self->results.first = job;
+			self->results.last = job;
+			lisys_mutex_unlock (self->mutex);
+			batch->array[i] = NULL;
+		}
+	}
+
+	/* Commit the group unless the scripts have a transaction open. */
+	if (self->transaction && !self->savepoints)
+	{
+		if (!private_exec (self, "COMMIT TRANSACTION;"))
+			private_exec (self, "ROLLBACK TRANSACTION;");
+		self->transaction = 0;
+		self->stats.commits++;
+	}
+	lisys_mutex_unlock (database->mutex);
+}
+
+static int private_run_job (
+	LIExtDatabaseWorker* self,
+	LIExtDatabaseJob*    job)
+{
+	int i;
+	int j;
+	int ok;
+	int ret;
+	sqlite3_stmt* statement;
+	LIExtDatabaseValue* value;
+	LIExtDatabaseStatement* prepared;
+
+	/* Get a statement. */
+	prepared = liext_database_prepare (self->database, job->sql);
+	if (prepared == NULL)
+		return 0;
+	statement = prepared->statement;
+
+	/* Execute the statement for each set of bindings. */
+	for (ok = 1, i = 0 ; ok && i < job->binds.count ; i++)
+	{
+		/* Bind the values. */
+		for (j = 0 ; ok && j < job->binds.width && j < sqlite3_bind_parameter_count (statement) ; j++)
+		{
+			value = job->binds.array + i * job->binds.width + j;
+			switch (value->type)
+			{
+				case SQLITE_INTEGER:
+					ret = sqlite3_bind_int64 (statement, j + 1, value->integer);
+					break;
+				case SQLITE_FLOAT:
+					ret = sqlite3_bind_double (statement, j + 1, value->number);
+					break;
+				case SQLITE_TEXT:
+					ret = sqlite3_bind_text (statement, j + 1, value->data, value->length, SQLITE_STATIC);
+					break;
+				case SQLITE_BLOB:
+					ret = sqlite3_bind_blob (statement, j + 1, value->data, value->length, SQLITE_STATIC);
+					break;
+				default:
+					ret = sqlite3_bind_null (statement, j + 1);
+					break;
+			}
+			if (ret != SQLITE_OK)
+			{
+				lisys_error_set (EINVAL, "SQL bind: %s", sqlite3_errmsg (self->database->sql));
+				ok = 0;
+			}
+		}
+		if (!ok)
+			break;
+
+		/* Step through the rows. */
+		while ((ret = sqlite3_step (statement)) == SQLITE_ROW)
+		{
+			if (job->type == LIEXT_DATABASE_JOB_READ && !private_store_row (job, statement))
+			{
+				ok = 0;
+				break;
+			}
+		}
+		if (ok && ret != SQLITE_DONE)
+		{
+			lisys_error_set (EINVAL, "SQL step: %s", sqlite3_errmsg (self->database->sql));
+			ok = 0;
+		}
+		sqlite3_reset (statement);
+		sqlite3_clear_bindings (statement);
+	}
+	liext_database_release (self->database, prepared);
+
+	return ok;
+}
+
+static int private_send (
+	LIExtDatabaseWorker* self)
+{
+	LIExtDatabaseBatch* queue;
+
+	self->timer = 0.0f;
+	self->reading = 0;
+	if (!self->queue->count)
+		return 1;
+
+	/* Allocate a new queue. */
+	queue = private_batch_new ();
+	if (queue == NULL)
+		return 0;
+
+	/* Hand the old queue over to the worker. */
+	/* The channel only fills up if the worker is far behind so waiting
+	   here is what limits the memory used by the queued writes. */
+	while (!lisys_channel_push (self->batches, self->queue))
+		lisys_usleep (LIEXT_DATABASE_IDLE_USECS);
+	self->queue = queue;
+	self->sent++;
+	lialg_strdic_clear (self->keys);
+
+	return 1;
+}
+
+static int private_store_row (
+	LIExtDatabaseJob* job,
+	sqlite3_stmt*     statement)
+{
+	int col;
+	int capacity;
+	const void* data;
+	LIExtDatabaseValue* tmp;
+	LIExtDatabaseValue* value;
+
+	/* Make room for the row. */
+	if (!job->rows.width)
+		job->rows.width = sqlite3_column_count (statement);
+	if (job->rows.count == job->rows.capacity)
+	{
+		capacity = job->rows.capacity? job->rows.capacity << 1 : 16;
+		tmp = lisys_realloc (job->rows.array, capacity * job->rows.width * sizeof (LIExtDatabaseValue));
+		if (tmp == NULL)
+			return 0;
+		job->rows.array = tmp;
+		job->rows.capacity = capacity;
+	}
+
+	/* Copy the columns. */
+	value = job->rows.array + job->rows.count * job->rows.width;
+	memset (value, 0, job->rows.width * sizeof (LIExtDatabaseValue));
+	job->rows.count++;
+	for (col = 0 ; col < job->rows.width ; col++, value++)
+	{
+		value->type = sqlite3_column_type (statement, col);
+		switch (value->type)
+		{
+			case SQLITE_INTEGER:
+				value->integer = sqlite3_column_int64 (statement, col);
+				break;
+			case SQLITE_FLOAT:
+				value->number = sqlite3_column_double (statement, col);
+				break;
+			case SQLITE_TEXT:
+			case SQLITE_BLOB:
+				if (value->type == SQLITE_TEXT)
+					data = sqlite3_column_text (statement, col);
+				else
+					data = sqlite3_column_blob (statement, col);
+				value->length = sqlite3_column_bytes (statement, col);
+				value->data = lisys_malloc (value->length + 1);
+				if (value->data == NULL)
+				{
+					value->type = SQLITE_NULL;
+					return 0;
+				}
+				if (data != NULL)
+					memcpy (value->data, data, value->length);
+				value->data[value->length] = '\0';
+				break;
+		}
+	}
+
+	return 1;
+}
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data)
+{
+	int quit;
+	LIExtDatabaseBatch* batch;
+	LIExtDatabaseWorker* self = data;
+
+	while (1)
+	{
+		/* The quit flag is read before popping so that no batch queued
+		   before the flag was set can be missed. */
+		quit = self->quit;
+		batch = lisys_channel_pop (self->batches);
+		if (batch == NULL)
+		{
+			if (quit)
+				break;
+			lisys_usleep (LIEXT_DATABASE_IDLE_USECS);
+			continue;
+		}
+
+		/* Execute the batch. */
+		private_run_batch (self, batch);
+		private_batch_free (batch);
+		__sync_synchronize ();
+		self->done++;
+	}
+}
+
+/** @} */
+/** @} */
@@ -36,6 +36,8 @@ static void Model_add_material (LIScrArgs* args)
 
 	/* Create a model builder. */
 	model = args->self;
+	if (!lieng_model_unshare (model))
+		return;
 	builder = limdl_builder_new (model->model);
 	if (builder == NULL)
 		return;
@@ -64,9 +66,12 @@ static void Model_add_material (LIScrArgs* args)
 static void Model_add_triangles (LIScrArgs* args)
 {
 	int i;
+	int ret;
 	int group = 1;
+	int weld = 0;
 	int vertices_cap = 0;
 	int vertices_num = 0;
+	int* welded;
 	float* attrs[8];
 	LIMdlIndex* indices = NULL;
 	LIMatVector zero = { 0.0f, 0.0f, 0.0f };
@@ -79,6 +84,7 @@ static void Model_add_triangles (LIScrArgs* args)
 	/* Get the edited material group. */
 	model = args->self;
 	liscr_args_gets_int (args, "material", &group);
+	liscr_args_gets_bool (args, "weld", &weld);
 	if (group < 1 || group > model->model->materials.count)
 		return;
 
@@ -162,6 +168,12 @@ static void Model_add_triangles (LIScrArgs* args)
 		indices[i] = model->model->vertices.count + i;
 
 	/* Create a model builder. */
+	if (!lieng_model_unshare (model))
+	{
+		lisys_free (vertices);
+		lisys_free (indices);
+		return;
+	}
 	builder = limdl_builder_new (model->model);
 	if (builder == NULL)
 	{
@@ -170,10 +182,26 @@ static void Model_add_triangles (LIScrArgs* args)
 		return;
 	}
 
-	/* Insert the vertices and indices. */
-	limdl_builder_insert_vertices (builder, vertices, vertices_num, NULL);
-	limdl_builder_insert_indices (builder, 0, group - 1, indices, vertices_num, 0);
-	limdl_builder_finish (builder);
+	/* Insert the vertices. */
+	if (weld)
+	{
+		/* Welded vertices may reuse existing vertices so the indices are
+		   only known after the insertion. */
+		welded = lisys_calloc (vertices_num, sizeof (int));
+		ret = (welded != NULL && limdl_builder_insert_vertices_welded (builder, vertices, vertices_num, welded));
+		for (i = 0 ; ret && i < vertices_num ; i++)
+			indices[i] = welded[i];
+		lisys_free (welded);
+	}
+	else
+		ret = limdl_builder_insert_vertices (builder, vertices, vertices_num, NULL);
+
+	/* Insert the indices. */
+	if (ret)
+	{
+		limdl_builder_insert_indices (builder, 0, group - 1, indices, vertices_num, 0);
+		limdl_builder_finish (builder);
+	}
 
 	/* Cleanup. */
 	limdl_builder_free (builder);
@@ -194,6 +222,8 @@ static void Model_calculate_lod (LIScrArgs* args)
 	if (liscr_args_geti_float (args, 1, &factor))
 		factor = LIMAT_CLAMP (factor, 0.0f, 1.0f);
 
+	if (!lieng_model_unshare (model))
+		return;
 	builder = limdl_builder_new (model->model);
 	if (builder == NULL)
 		return;
@@ -217,6 +247,8 @@ static void Model_edit_material (LIScrArgs* args)
 
 	/* Get the engine model. */
 	model = args->self;
+	if (!lieng_model_unshare (model))
+		return;
 	liscr_args_gets_string (args, "match_shader", &shader);
 	liscr_args_gets_string (args, "match_texture", &texture);
 
@@ -279,6 +311,8 @@ static void Model_merge (LIScrArgs* args)
 	{
 		model1 = args->self;
 		model2 = liscr_data_get_data (data);
+		if (!lieng_model_unshare (model1))
+			return;
 		if (!limdl_model_merge (model1->model, model2->model))
 			lisys_error_report ();
 	}
@@ -302,6 +336,8 @@ static void Model_morph (LIScrArgs* args)
 		liscr_args_gets_data (args, "ref", LISCR_SCRIPT_MODEL, &data);
 	if (data != NULL)
 		ref = liscr_data_get_data (data);
+	if (!lieng_model_unshare (model))
+		return;
 
 	liscr_args_seti_bool (args, limdl_model_morph (model->model,
 		(ref != NULL)? ref->model : NULL, shape, value));
@@ -312,6 +348,8 @@ static void Model_remove_vertices (LIScrArgs* args)
 	LIEngModel* model;
 
 	model = args->self;
+	if (!lieng_model_unshare (model))
+		return;
 	limdl_model_clear_vertices (model->model);
 }
 
@@ -0,0 +1,588 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtNoise Noise
+ * @{
+ */
+
+#include "ext-module.h"
+
+static void private_apply (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command,
+	LIExtNoiseSector*        sector,
+	float*                   row);
+
+static void private_clear_sectors (
+	LIExtNoiseBatch* self);
+
+static int private_covers (
+	LIExtNoiseBatch*  self,
+	LIExtNoiseSector* sector);
+
+static int private_find_sectors (
+	LIExtNoiseBatch* self);
+
+static void private_finish (
+	LIExtNoiseBatch* self);
+
+static int private_intersect (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command,
+	const LIExtNoiseSector*  sector,
+	int*                     min,
+	int*                     max);
+
+static void private_worker (
+	LISysThread* thread,
+	void*        data);
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new terrain generation batch.
+ * \param module Module.
+ * \return New batch or NULL.
+ */
+LIExtNoiseBatch* liext_noise_batch_new (
+	LIExtModule* module)
+{
+	LIExtNoiseBatch* self;
+
+	self = lisys_calloc (1, sizeof (LIExtNoiseBatch));
+	if (self == NULL)
+		return NULL;
+	self->module = module;
+
+	return self;
+}
+
+/**
+ * \brief Frees the batch.
+ *
+ * If the batch is still running, the workers are stopped and the sectors
+ * that have not been pasted yet are discarded.
+ *
+ * \param self Batch.
+ */
+void liext_noise_batch_free (
+	LIExtNoiseBatch* self)
+{
+	if (self->running)
+	{
+		lisys_mutex_lock (self->mutex);
+		self->cancel = 1;
+		lisys_mutex_unlock (self->mutex);
+		liext_noise_batch_wait (self);
+	}
+	private_clear_sectors (self);
+	lisys_free (self->commands.array);
+	lisys_free (self);
+}
+
+/**
+ * \brief Removes all the commands of the batch.
+ * \param self Batch.
+ */
+void liext_noise_batch_clear (
+	LIExtNoiseBatch* self)
+{
+	if (self->running)
+		return;
+	private_clear_sectors (self);
+	self->commands.count = 0;
+}
+
+/**
+ * \brief Starts executing the commands of the batch.
+ *
+ * The tiles of the affected sectors are copied to private buffers and the
+ * commands are then applied to them by a pool of worker threads, one sector
+ * at a time. Since each sector is processed by a single worker in the order
+ * in which the commands were inserted, the result is identical to that of
+ * executing the commands one by one.
+ *
+ * The finished sectors are pasted back to the map in the main thread when
+ * the batch is updated. Changes made by other means to the affected sectors
+ * while the batch is running are overwritten.
+ *
+ * \param self Batch.
+ * \return Nonzero on success.
+ */
+int liext_noise_batch_execute (
+	LIExtNoiseBatch* self)
+{
+	int i;
+	int count;
+	LIExtNoiseSector* sector;
+	LIVoxManager* voxels;
+
+	if (self->running)
+	{
+		lisys_error_set (EINVAL, "the batch is already running");
+		return 0;
+	}
+	voxels = limai_program_find_component (self->module->program, "voxels");
+	if (voxels == NULL)
+	{
+		lisys_error_set (EINVAL, "the voxel manager is not available");
+		return 0;
+	}
+	self->voxels = voxels;
+
+	/* Find the affected sectors. */
+	private_clear_sectors (self);
+	if (!private_find_sectors (self))
+		return 0;
+
+	/* Copy the tiles of the affected sectors. */
+	/* Sectors whose first command overwrites all the tiles need not be
+	   copied. This is the common case when generating new sectors. */
+	count = voxels->tiles_per_line;
+	for (i = 0 ; i < self->sectors.count ; i++)
+	{
+		sector = self->sectors.array + i;
+		sector->voxels = lisys_calloc (voxels->tiles_per_sector, sizeof (LIVoxVoxel));
+		if (sector->voxels == NULL)
+		{
+			private_clear_sectors (self);
+			return 0;
+		}
+		sector->loaded = lialg_sectors_data_index (voxels->sectors, LIALG_SECTORS_CONTENT_VOXEL, sector->index, 0) != NULL;
+		if (sector->loaded && !private_covers (self, sector))
+		{
+			livox_manager_copy_voxels (voxels, sector->offset[0], sector->offset[1],
+				sector->offset[2], count, count, count, sector->voxels);
+		}
+	}
+
+	/* Allocate the worker state. */
+	self->next = 0;
+	self->done = 0;
+	self->failed = 0;
+	self->pasted = 0;
+	self->cancel = 0;
+	self->mutex = lisys_mutex_new ();
+	self->finished = lisys_calloc (self->sectors.count + 1, sizeof (int));
+	self->threads.count = LIMAT_MAX (1, LIMAT_MIN (lisys_batch_get_cpus (), self->sectors.count));
+	self->threads.array = lisys_calloc (self->threads.count, sizeof (LISysThread*));
+	if (self->mutex == NULL || self->finished == NULL || self->threads.array == NULL)
+	{
+		private_clear_sectors (self);
+		return 0;
+	}
+	if (!lialg_ptrdic_insert (self->module->batches, self, self))
+	{
+		private_clear_sectors (self);
+		return 0;
+	}
+	self->id = ++self->module->batch_id;
+	self->running = 1;
+
+	/* Start the workers. */
+	/* The main thread keeps running the game so one worker is started even
+	   on single core systems. If no thread could be started, the commands
+	   are executed in the calling thread. */
+	for (i = 0 ; i < self->threads.count ; i++)
+		self->threads.array[i] = lisys_thread_new (private_worker, self);
+	for (i = 0 ; i < self->threads.count ; i++)
+	{
+		if (self->threads.array[i] != NULL)
+			break;
+	}
+	if (i == self->threads.count)
+		private_worker (NULL, self);
+
+	return 1;
+}
+
+/**
+ * \brief Appends a command to the batch.
+ * \param self Batch.
+ * \param command Command.
+ * \return Nonzero on success.
+ */
+int liext_noise_batch_insert (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command)
+{
+	int capacity;
+	LIExtNoiseCommand* tmp;
+
+	if (self->running)
+	{
+		lisys_error_set (EINVAL, "the batch is already running");
+		return 0;
+	}
+	if (command->min[0] >= command->max[0] ||
+	    command->min[1] >= command->max[1] ||
+	    command->min[2] >= command->max[2])
+		return 1;
+	if (self->commands.count == self->commands.capacity)
+	{
+		capacity = LIMAT_MAX (16, 2 * self->commands.capacity);
+		tmp = lisys_realloc (self->commands.array, capacity * sizeof (LIExtNoiseCommand));
+		if (tmp == NULL)
+			return 0;
+		self->commands.array = tmp;
+		self->commands.capacity = capacity;
+	}
+	self->commands.array[self->commands.count++] = *command;
+
+	return 1;
+}
+
+/**
+ * \brief Pastes the sectors finished by the workers to the map.
+ *
+ * Called by the module every tick for the running batches. A progress event
+ * is emitted whenever sectors have been pasted, and the last event of the
+ * batch has the number of pasted sectors equal to the total.
+ *
+ * \param self Batch.
+ * \return Nonzero if the batch is still running.
+ */
+int liext_noise_batch_update (
+	LIExtNoiseBatch* self)
+{
+	int i;
+	int done;
+	int count;
+	LIExtNoiseSector* sector;
+
+	if (!self->running)
+		return 0;
+	lisys_mutex_lock (self->mutex);
+	done = self->done;
+	lisys_mutex_unlock (self->mutex);
+
+	/* Paste the finished sectors. */
+	/* Sectors unloaded while the batch was running are skipped so that
+	   they don't get recreated with partial contents. */
+	count = self->voxels->tiles_per_line;
+	if (self->pasted == done && done < self->sectors.count)
+		return 1;
+	for (i = self->pasted ; i < done ; i++)
+	{
+		sector = self->sectors.array + self->finished[i];
+		if (sector->state == LIEXT_NOISE_SECTOR_DONE && (!sector->loaded ||
+		    lialg_sectors_data_index (self->voxels->sectors, LIALG_SECTORS_CONTENT_VOXEL, sector->index, 0) != NULL))
+		{
+			livox_manager_paste_voxels (self->voxels, sector->offset[0], sector->offset[1],
+				sector->offset[2], count, count, count, sector->voxels);
+			sector->state = LIEXT_NOISE_SECTOR_PASTED;
+		}
+		lisys_free (sector->voxels);
+		sector->voxels = NULL;
+	}
+	self->pasted = done;
+	limai_program_event (self->module->program, "noise-batch",
+		"id", LISCR_TYPE_INT, self->id,
+		"done", LISCR_TYPE_INT, self->pasted,
+		"failed", LISCR_TYPE_INT, self->failed,
+		"total", LISCR_TYPE_INT, self->sectors.count, NULL);
+	if (done < self->sectors.count)
+		return 1;
+	private_finish (self);
+
+	return 0;
+}
+
+/**
+ * \brief Waits for the workers to finish and pastes the results to the map.
+ * \param self Batch.
+ */
+void liext_noise_batch_wait (
+	LIExtNoiseBatch* self)
+{
+	int i;
+
+	if (!self->running)
+		return;
+	for (i = 0 ; i < self->threads.count ; i++)
+	{
+		if (self->threads.array[i] != NULL)
+		{
+			lisys_thread_free (self->threads.array[i]);
+			self->threads.array[i] = NULL;
+		}
+	}
+	if (self->cancel)
+		private_finish (self);
+	else
+		liext_noise_batch_update (self);
+}
+
+/*****************************************************************************/
+
+static void private_apply (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command,
+	LIExtNoiseSector*        sector,
+	float*                   row)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	int min[3];
+	int max[3];
+	int start[3];
+	int line = self->voxels->tiles_per_line;
+	LIVoxVoxel* tile;
+
+	if (!private_intersect (self, command, sector, min, max))
+		return;
+	for (z = min[2] ; z < max[2] ; z++)
+	for (y = min[1] ; y < max[1] ; y++)
+	{
+		tile = sector->voxels + min[0] + y * line + z * line * line;
+		switch (command->type)
+		{
+			case LIEXT_NOISE_COMMAND_FILL:
+				for (x = min[0] ; x < max[0] ; x++, tile++)
+					livox_voxel_init (tile, command->tile);
+				break;
+			case LIEXT_NOISE_COMMAND_PERLIN:
+				if (row == NULL)
+				{
+					sector->state = LIEXT_NOISE_SECTOR_FAILED;
+					return;
+				}
+				start[0] = sector->offset[0] + min[0];
+				start[1] = sector->offset[1] + y;
+				start[2] = sector->offset[2] + z;
+				if (!liext_noise_perlin_row (self->module, start, max[0] - min[0], &command->scale,
+				     command->seed, command->octaves, command->frequency, command->persistence, row))
+				{
+					sector->state = LIEXT_NOISE_SECTOR_FAILED;
+					return;
+				}
+				for (i = 0, x = min[0] ; x < max[0] ; i++, x++, tile++)
+				{
+					if (row[i] >= command->threshold)
+						livox_voxel_init (tile, command->tile);
+				}
+				break;
+			case LIEXT_NOISE_COMMAND_REPLACE:
+				for (x = min[0] ; x < max[0] ; x++, tile++)
+				{
+					if (tile->type == command->match)
+						livox_voxel_init (tile, command->tile);
+				}
+				break;
+		}
+	}
+}
+
+static void private_clear_sectors (
+	LIExtNoiseBatch* self)
+{
+	int i;
+
+	lisys_assert (!self->running);
+	for (i = 0 ; i < self->sectors.count ; i++)
+		lisys_free (self->sectors.array[i].voxels);
+	lisys_free (self->sectors.array);
+	lisys_free (self->threads.array);
+	lisys_free (self->finished);
+	if (self->mutex != NULL)
+		lisys_mutex_free (self->mutex);
+	self->sectors.array = NULL;
+	self->sectors.count = 0;
+	self->threads.array = NULL;
+	self->threads.count = 0;
+	self->finished = NULL;
+	self->mutex = NULL;
+}
+
+static int private_covers (
+	LIExtNoiseBatch*  self,
+	LIExtNoiseSector* sector)
+{
+	int i;
+	int min[3];
+	int max[3];
+	int line = self->voxels->tiles_per_line;
+	const LIExtNoiseCommand* command;
+
+	for (i = 0 ; i < self->commands.count ; i++)
+	{
+		command = self->commands.array + i;
+		if (!private_intersect (self, command, sector, min, max))
+			continue;
+		return command->type == LIEXT_NOISE_COMMAND_FILL &&
+			min[0] == 0 && min[1] == 0 && min[2] == 0 &&
+			max[0] == line && max[1] == line && max[2] == line;
+	}
+
+	return 0;
+}
+
+static int private_find_sectors (
+	LIExtNoiseBatch* self)
+{
+	int i;
+	int index;
+	int line;
+	int min[3];
+	int max[3];
+	int sec[3];
+	int capacity = 0;
+	LIAlgU32dic* found;
+	LIExtNoiseSector* tmp;
+	const LIExtNoiseCommand* command;
+
+	found = lialg_u32dic_new ();
+	if (found == NULL)
+		return 0;
+
+	line = self->voxels->tiles_per_line;
+	for (i = 0 ; i < self->commands.count ; i++)
+	{
+		command = self->commands.array + i;
+		min[0] = command->min[0] / line;
+		min[1] = command->min[1] / line;
+		min[2] = command->min[2] / line;
+		max[0] = (command->max[0] - 1) / line;
+		max[1] = (command->max[1] - 1) / line;
+		max[2] = (command->max[2] - 1) / line;
+		for (sec[2] = min[2] ; sec[2] <= max[2] ; sec[2]++)
+		for (sec[1] = min[1] ; sec[1] <= max[1] ; sec[1]++)
+		for (sec[0] = min[0] ; sec[0] <= max[0] ; sec[0]++)
+		{
+			/* Add each sector only once. */
+			index = lialg_sectors_offset_to_index (self->voxels->sectors, sec[0], sec[1], sec[2]);
+			if (lialg_u32dic_find (found, index) != NULL)
+				continue;
+			if (self->sectors.count == capacity)
+			{
+				capacity = LIMAT_MAX (16, 2 * capacity);
+				tmp = lisys_realloc (self->sectors.array, capacity * sizeof (LIExtNoiseSector));
+				if (tmp == NULL)
+				{
+					lialg_u32dic_free (found);
+					return 0;
+				}
+				self->sectors.array = tmp;
+			}
+			if (!lialg_u32dic_insert (found, index, self))
+			{
+				lialg_u32dic_free (found);
+				return 0;
+			}
+			tmp = self->sectors.array + self->sectors.count++;
+			memset (tmp, 0, sizeof (LIExtNoiseSector));
+			tmp->index = index;
+			tmp->offset[0] = sec[0] * line;
+			tmp->offset[1] = sec[1] * line;
+			tmp->offset[2] = sec[2] * line;
+		}
+	}
+	lialg_u32dic_free (found);
+
+	return 1;
+}
+
+static void private_finish (
+	LIExtNoiseBatch* self)
+{
+	int i;
+
+	for (i = 0 ; i < self->threads.count ; i++)
+	{
+		if (self->threads.array[i] != NULL)
+			lisys_thread_free (self->threads.array[i]);
+	}
+	lisys_free (self->threads.array);
+	self->threads.array = NULL;
+	self->threads.count = 0;
+	lialg_ptrdic_remove (self->module->batches, self);
+	self->running = 0;
+}
+
+static int private_intersect (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command,
+	const LIExtNoiseSector*  sector,
+	int*                     min,
+	int*                     max)
+{
+	int i;
+	int line = self->voxels->tiles_per_line;
+
+	for (i = 0 ; i < 3 ; i++)
+	{
+		min[i] = LIMAT_MAX (command->min[i] - sector->offset[i], 0);
+		max[i] = LIMAT_MIN (command->max[i] - sector->offset[i], line);
+		if (min[i] >= max[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void private_worker (
+	LISysThread* thread,
+	void*        data)
+{
+	int i;
+	int index;
+	float* row;
+	LIExtNoiseBatch* self = data;
+	LIExtNoiseSector* sector;
+
+	/* Allocate the noise row buffer. */
+	/* If the allocation fails, the sectors processed by this worker fail
+	   when they need noise instead of being left unprocessed. */
+	row = lisys_calloc (self->voxels->tiles_per_line, sizeof (float));
+
+	while (1)
+	{
+		/* Get the next sector. */
+		lisys_mutex_lock (self->mutex);
+		if (self->cancel || self->next >= self->sectors.count)
+		{
+			lisys_mutex_unlock (self->mutex);
+			break;
+		}
+		index = self->next++;
+		lisys_mutex_unlock (self->mutex);
+
+		/* Apply the commands in order. */
+		sector = self->sectors.array + index;
+		for (i = 0 ; i < self->commands.count && sector->state == LIEXT_NOISE_SECTOR_QUEUED ; i++)
+			private_apply (self, self->commands.array + i, sector, row);
+		if (sector->state == LIEXT_NOISE_SECTOR_QUEUED)
+			sector->state = LIEXT_NOISE_SECTOR_DONE;
+
+		/* Hand the sector over to the main thread. */
+		lisys_mutex_lock (self->mutex);
+		if (sector->state == LIEXT_NOISE_SECTOR_FAILED)
+			self->failed++;
+		self->finished[self->done++] = index;
+		lisys_mutex_unlock (self->mutex);
+	}
+
+	lisys_free (row);
+}
+
+/** @} */
+/** @} */
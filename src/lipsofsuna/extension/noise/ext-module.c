@@ -26,12 +26,56 @@
 
 #define NOISE_SCALE 0x7FFFFFFF
 #define NOISE_SCALE2 0x40000000
+#define NOISE_THREAD_VOXELS 32768
+
+typedef struct _LIExtNoiseJob LIExtNoiseJob;
+struct _LIExtNoiseJob
+{
+	int next;
+	int failed;
+	int min[3];
+	int size[3];
+	int seed;
+	int octaves;
+	float frequency;
+	float persistence;
+	float* result;
+	LIExtModule* module;
+	LIMatVector scale;
+	LISysMutex* mutex;
+};
+
+static void private_init (
+	int    seed,
+	int    octaves,
+	float  frequency,
+	float  persistence,
+	int*   offset,
+	float* amplitudes,
+	float* frequencies);
+
+static float private_mix (
+	const float* values,
+	float        fx,
+	float        fy,
+	float        fz);
 
 static uint32_t private_noise (
 	int x,
 	int y,
 	int z);
 
+static void private_worker (
+	LISysThread* thread,
+	void*        data);
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data);
+
+static int private_workers_start (
+	LIExtModule* self);
+
 static uint32_t private_smooth_noise (
 	int x,
 	int y,
@@ -42,6 +86,10 @@ static float private_interpolated_noise (
 	float y,
 	float z);
 
+static int private_tick (
+	LIExtModule* self,
+	float        secs);
+
 /*****************************************************************************/
 
 LIMaiExtensionInfo liext_noise_info =
@@ -62,9 +110,26 @@ LIExtModule* liext_noise_new (
 		return NULL;
 	self->program = program;
 
+	/* Allocate the running batch list. */
+	self->batches = lialg_ptrdic_new ();
+	if (self->batches == NULL)
+	{
+		liext_noise_free (self);
+		return NULL;
+	}
+
+	/* Register callbacks. */
+	if (!lical_callbacks_insert (program->callbacks, "tick", 0, private_tick, self, self->calls + 0))
+	{
+		liext_noise_free (self);
+		return NULL;
+	}
+
 	/* Register classes. */
 	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_NOISE, self);
+	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_NOISE_BATCH, self);
 	liext_script_noise (program->script);
+	liext_script_noise_batch (program->script);
 
 	return self;
 }
@@ -72,6 +137,33 @@ LIExtModule* liext_noise_new (
 void liext_noise_free (
 	LIExtModule* self)
 {
+	int i;
+
+	/* Stop the region workers. */
+	if (self->workers.array != NULL)
+	{
+		lisys_mutex_lock (self->workers.mutex);
+		self->workers.quit = 1;
+		lisys_cond_broadcast (self->workers.wake);
+		lisys_mutex_unlock (self->workers.mutex);
+		for (i = 0 ; i < self->workers.count ; i++)
+			lisys_thread_free (self->workers.array[i]);
+		lisys_free (self->workers.array);
+	}
+	if (self->workers.done != NULL)
+		lisys_cond_free (self->workers.done);
+	if (self->workers.wake != NULL)
+		lisys_cond_free (self->workers.wake);
+	if (self->workers.mutex != NULL)
+		lisys_mutex_free (self->workers.mutex);
+
+	/* The batches are owned by the script so they have been freed. */
+	lical_handle_releasev (self->calls, sizeof (self->calls) / sizeof (LICalHandle));
+	if (self->batches != NULL)
+	{
+		lisys_assert (self->batches->size == 0);
+		lialg_ptrdic_free (self->batches);
+	}
 	lisys_free (self);
 }
 
@@ -90,13 +182,8 @@ float liext_noise_perlin_noise (
 	float a;
 	float f;
 	float total = 0;
-	LIAlgRandom random;
-
-	lialg_random_init (&random, seed);
-	s[0] = lialg_random_range (&random, 0, 1024);
-	s[1] = lialg_random_range (&random, 0, 1024);
-	s[2] = lialg_random_range (&random, 0, 1024);
 
+	private_init (seed, 0, frequency, persistence, s, NULL, NULL);
 	for (i = 0 ; i < octaves ; i++)
 	{
 		a = powf (persistence, i);
@@ -107,8 +194,290 @@ float liext_noise_perlin_noise (
 	return total;
 }
 
+/**
+ * \brief Calculates Perlin noise for a box of tiles.
+ *
+ * The values are the same as those returned by #liext_noise_perlin_noise
+ * for the scaled tile coordinates, but the box is split to rows that are
+ * evaluated by #liext_noise_perlin_row in a pool of worker threads. The
+ * workers are started on the first call and sleep between the calls.
+ *
+ * \param self Module.
+ * \param min Start tile of the box.
+ * \param size Size of the box in tiles.
+ * \param scale Coordinate scale factor.
+ * \param seed Noise seed.
+ * \param octaves Number of octaves.
+ * \param frequency Noise frequency.
+ * \param persistence Noise persistence.
+ * \param result Buffer for size[0]*size[1]*size[2] values in X-major order.
+ * \return Nonzero on success.
+ */
+int liext_noise_perlin_region (
+	LIExtModule*       self,
+	const int*         min,
+	const int*         size,
+	const LIMatVector* scale,
+	int                seed,
+	int                octaves,
+	float              frequency,
+	float              persistence,
+	float*             result)
+{
+	int threads;
+	LIExtNoiseJob job;
+
+	/* Initialize the job. */
+	memset (&job, 0, sizeof (LIExtNoiseJob));
+	memcpy (job.min, min, 3 * sizeof (int));
+	memcpy (job.size, size, 3 * sizeof (int));
+	job.seed = seed;
+	job.octaves = octaves;
+	job.frequency = frequency;
+	job.persistence = persistence;
+	job.result = result;
+	job.module = self;
+	job.scale = *scale;
+
+	/* Small boxes are evaluated in the calling thread since waking up the
+	   workers would take longer than calculating the noise. */
+	threads = LIMAT_MIN (lisys_batch_get_cpus (), size[1] * size[2]);
+	threads = LIMAT_MIN (threads, size[0] * size[1] * size[2] / NOISE_THREAD_VOXELS);
+	if (threads <= 1 || !private_workers_start (self))
+	{
+		private_worker (NULL, &job);
+		return !job.failed;
+	}
+
+	/* Hand the job to the workers. */
+	/* The calling thread works on the rows too. If the workers are already
+	   busy with another call, the box is evaluated in this thread alone. */
+	lisys_mutex_lock (self->workers.mutex);
+	if (self->workers.job != NULL)
+	{
+		lisys_mutex_unlock (self->workers.mutex);
+		private_worker (NULL, &job);
+		return !job.failed;
+	}
+	job.mutex = self->workers.mutex;
+	self->workers.job = &job;
+	self->workers.slots = threads - 1;
+	self->workers.serial++;
+	lisys_cond_broadcast (self->workers.wake);
+	lisys_mutex_unlock (self->workers.mutex);
+	private_worker (NULL, &job);
+
+	/* Wait for the workers to finish their rows. */
+	/* The job lives in our stack so the workers must be done with it. */
+	lisys_mutex_lock (self->workers.mutex);
+	self->workers.job = NULL;
+	while (self->workers.busy)
+		lisys_cond_wait (self->workers.done, self->workers.mutex);
+	lisys_mutex_unlock (self->workers.mutex);
+
+	return !job.failed;
+}
+
+/**
+ * \brief Calculates Perlin noise for a row of tiles along the X axis.
+ *
+ * The values are bit-identical to those returned by #liext_noise_perlin_noise
+ * for the scaled tile coordinates. The Y and Z coordinates are the same for
+ * the whole row so their lattice offsets and interpolation factors are only
+ * calculated once per octave. The lattice values along the X axis are
+ * hashed once into a cache so that the inner loops are branch free and
+ * can be vectorized by the compiler.
+ *
+ * \param self Module.
+ * \param start Start tile of the row.
+ * \param count Number of tiles in the row.
+ * \param scale Coordinate scale factor.
+ * \param seed Noise seed.
+ * \param octaves Number of octaves.
+ * \param frequency Noise frequency.
+ * \param persistence Noise persistence.
+ * \param result Buffer for count values.
+ * \return Nonzero on success.
+ */
+int liext_noise_perlin_row (
+	LIExtModule*       self,
+	const int*         start,
+	int                count,
+	const LIMatVector* scale,
+	int                seed,
+	int                octaves,
+	float              frequency,
+	float              persistence,
+	float*             result)
+{
+	int i;
+	int j;
+	int k;
+	int o;
+	int s[3];
+	int ix;
+	int iy;
+	int iz;
+	int min;
+	int max;
+	int span;
+	float fy;
+	float fz;
+	float x;
+	float y;
+	float z;
+	float px;
+	float py;
+	float pz;
+	float values[8];
+	float amplitudes[32];
+	float frequencies[32];
+	float* lattice;
+	uint32_t m;
+	uint32_t n;
+	uint32_t base[4];
+
+	if (count <= 0)
+		return 1;
+	if (octaves > 32)
+	{
+		for (i = 0 ; i < count ; i++)
+		{
+			result[i] = liext_noise_perlin_noise (self, scale->x * (start[0] + i),
+				scale->y * start[1], scale->z * start[2], seed, octaves, frequency, persistence);
+		}
+		return 1;
+	}
+	private_init (seed, octaves, frequency, persistence, s, amplitudes, frequencies);
+	for (i = 0 ; i < count ; i++)
+		result[i] = 0.0f;
+
+	/* Allocate the lattice cache. */
+	/* Each octave needs four rows of lattice values, one for each
+	   combination of the neighboring Y and Z lattice lines. */
+	lattice = lisys_malloc (4 * (count + 2) * sizeof (float));
+	if (lattice == NULL)
+		return 0;
+
+	y = scale->y * start[1];
+	z = scale->z * start[2];
+	for (o = 0 ; o < octaves ; o++)
+	{
+		/* Calculate the lattice lines shared by the whole row. */
+		py = s[1] + y * frequencies[o];
+		pz = s[2] + z * frequencies[o];
+		iy = (int) py;
+		iz = (int) pz;
+		fy = py - iy;
+		fz = pz - iz;
+		for (j = 0 ; j < 4 ; j++)
+			base[j] = (uint32_t)(iy + (j & 1)) * 57 + (uint32_t)(iz + (j >> 1)) * 7919;
+
+		/* Find the range of lattice points along the X axis. */
+		/* The conversion to integers is monotonic so the range is spanned
+		   by the ends of the row. When the noise is so fine that there are
+		   more lattice points than tiles, they're hashed on demand. */
+		min = (int)(s[0] + (scale->x * start[0]) * frequencies[o]);
+		max = (int)(s[0] + (scale->x * (start[0] + count - 1)) * frequencies[o]);
+		if (min > max)
+		{
+			span = min;
+			min = max;
+			max = span;
+		}
+		span = max - min + 2;
+		if (max - min > count || span <= 0)
+		{
+			for (i = 0 ; i < count ; i++)
+			{
+				px = s[0] + (scale->x * (start[0] + i)) * frequencies[o];
+				ix = (int) px;
+				for (j = 0 ; j < 8 ; j++)
+				{
+					m = (uint32_t)(ix + (j & 1)) + base[j >> 1];
+					n = (m << 13) ^ m;
+					values[j] = (float)((n * (n * n * 15731 + 789221) + 1376312589) & NOISE_SCALE);
+				}
+				result[i] = result[i] + amplitudes[o] * private_mix (values, px - ix, fy, fz);
+			}
+			continue;
+		}
+
+		/* Hash the lattice points. */
+		for (j = 0 ; j < 4 ; j++)
+		{
+			for (k = 0 ; k < span ; k++)
+			{
+				m = (uint32_t)(min + k) + base[j];
+				n = (m << 13) ^ m;
+				lattice[j * span + k] = (float)((n * (n * n * 15731 + 789221) + 1376312589) & NOISE_SCALE);
+			}
+		}
+
+		/* Interpolate the lattice values. */
+		for (i = 0 ; i < count ; i++)
+		{
+			x = scale->x * (start[0] + i);
+			px = s[0] + x * frequencies[o];
+			ix = (int) px;
+			k = ix - min;
+			values[0] = lattice[k];
+			values[1] = lattice[k + 1];
+			values[2] = lattice[span + k];
+			values[3] = lattice[span + k + 1];
+			values[4] = lattice[2 * span + k];
+			values[5] = lattice[2 * span + k + 1];
+			values[6] = lattice[3 * span + k];
+			values[7] = lattice[3 * span + k + 1];
+			result[i] = result[i] + amplitudes[o] * private_mix (values, px - ix, fy, fz);
+		}
+	}
+	lisys_free (lattice);
+
+	return 1;
+}
+
 /*****************************************************************************/
 
+static void private_init (
+	int    seed,
+	int    octaves,
+	float  frequency,
+	float  persistence,
+	int*   offset,
+	float* amplitudes,
+	float* frequencies)
+{
+	int i;
+	LIAlgRandom random;
+
+	lialg_random_init (&random, seed);
+	offset[0] = lialg_random_range (&random, 0, 1024);
+	offset[1] = lialg_random_range (&random, 0, 1024);
+	offset[2] = lialg_random_range (&random, 0, 1024);
+	for (i = 0 ; i < octaves ; i++)
+	{
+		amplitudes[i] = powf (persistence, i);
+		frequencies[i] = powf (frequency, i);
+	}
+}
+
+static float private_mix (
+	const float* values,
+	float        fx,
+	float        fy,
+	float        fz)
+{
+	float s = 1.0f / NOISE_SCALE2;
+	float v00 = limat_mix (values[0] * s, values[1] * s, fx);
+	float v10 = limat_mix (values[2] * s, values[3] * s, fx);
+	float v01 = limat_mix (values[4] * s, values[5] * s, fx);
+	float v11 = limat_mix (values[6] * s, values[7] * s, fx);
+	float v0 = limat_mix (v00, v10, fy);
+	float v1 = limat_mix (v01, v11, fy);
+	return 1.0f - limat_mix (v0, v1, fz);
+}
+
 static uint32_t private_noise (
 	int x,
 	int y,
@@ -140,24 +509,140 @@ static float private_interpolated_noise (
 	int ix = (int) x;
 	int iy = (int) y;
 	int iz = (int) z;
-	float s = 1.0f / NOISE_SCALE2;
-	float v000 = private_smooth_noise (ix, iy, iz);
-	float v100 = private_smooth_noise (ix + 1, iy, iz);
-	float v010 = private_smooth_noise (ix, iy + 1, iz);
-	float v110 = private_smooth_noise (ix + 1, iy + 1, iz);
-	float v001 = private_smooth_noise (ix, iy, iz + 1);
-	float v101 = private_smooth_noise (ix + 1, iy, iz + 1);
-	float v011 = private_smooth_noise (ix, iy + 1, iz + 1);
-	float v111 = private_smooth_noise (ix + 1, iy + 1, iz + 1);
-	float fx = x - ix;
-	float v00 = limat_mix (v000 * s, v100 * s, fx);
-	float v10 = limat_mix (v010 * s, v110 * s, fx);
-	float v01 = limat_mix (v001 * s, v101 * s, fx);
-	float v11 = limat_mix (v011 * s, v111 * s, fx);
-	float fy = y - iy;
-	float v0 = limat_mix (v00, v10, fy);
-	float v1 = limat_mix (v01, v11, fy);
-	return 1.0f - limat_mix (v0, v1, z - iz);
+	float values[8];
+
+	values[0] = private_smooth_noise (ix, iy, iz);
+	values[1] = private_smooth_noise (ix + 1, iy, iz);
+	values[2] = private_smooth_noise (ix, iy + 1, iz);
+	values[3] = private_smooth_noise (ix + 1, iy + 1, iz);
+	values[4] = private_smooth_noise (ix, iy, iz + 1);
+	values[5] = private_smooth_noise (ix + 1, iy, iz + 1);
+	values[6] = private_smooth_noise (ix, iy + 1, iz + 1);
+	values[7] = private_smooth_noise (ix + 1, iy + 1, iz + 1);
+
+	return private_mix (values, x - ix, y - iy, z - iz);
+}
+
+static int private_tick (
+	LIExtModule* self,
+	float        secs)
+{
+	LIAlgPtrdicIter iter;
+
+	/* Finished batches remove themselves from the list but that's
+	   fine since the iterator has already advanced to the next node. */
+	LIALG_PTRDIC_FOREACH (iter, self->batches)
+		liext_noise_batch_update (iter.value);
+
+	return 1;
+}
+
+static void private_worker (
+	LISysThread* thread,
+	void*        data)
+{
+	int row;
+	int start[3];
+	LIExtNoiseJob* self = data;
+
+	while (1)
+	{
+		/* Get the next row. */
+		if (self->mutex != NULL)
+			lisys_mutex_lock (self->mutex);
+		row = self->next;
+		if (row < self->size[1] * self->size[2])
+			self->next++;
+		if (self->mutex != NULL)
+			lisys_mutex_unlock (self->mutex);
+		if (row >= self->size[1] * self->size[2])
+			break;
+
+		/* Calculate the row. */
+		start[0] = self->min[0];
+		start[1] = self->min[1] + row % self->size[1];
+		start[2] = self->min[2] + row / self->size[1];
+		if (!liext_noise_perlin_row (self->module, start, self->size[0], &self->scale,
+		     self->seed, self->octaves, self->frequency, self->persistence,
+		     self->result + row * self->size[0]))
+			self->failed = 1;
+	}
+}
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data)
+{
+	int serial = 0;
+	LIExtModule* self = data;
+	LIExtNoiseJob* job;
+
+	lisys_mutex_lock (self->workers.mutex);
+	while (1)
+	{
+		/* Sleep until there is a new job with free slots. */
+		while (!self->workers.quit && (self->workers.job == NULL ||
+		       !self->workers.slots || serial == self->workers.serial))
+			lisys_cond_wait (self->workers.wake, self->workers.mutex);
+		if (self->workers.quit)
+			break;
+		job = self->workers.job;
+		serial = self->workers.serial;
+		self->workers.slots--;
+		self->workers.busy++;
+
+		/* Calculate rows until they run out. */
+		lisys_mutex_unlock (self->workers.mutex);
+		private_worker (NULL, job);
+		lisys_mutex_lock (self->workers.mutex);
+		if (!--self->workers.busy)
+			lisys_cond_signal (self->workers.done);
+	}
+	lisys_mutex_unlock (self->workers.mutex);
+}
+
+static int private_workers_start (
+	LIExtModule* self)
+{
+	int i;
+	int count;
+
+	if (self->workers.array != NULL)
+		return 1;
+
+	/* Allocate the synchronization primitives. */
+	if (self->workers.mutex == NULL)
+		self->workers.mutex = lisys_mutex_new ();
+	if (self->workers.wake == NULL)
+		self->workers.wake = lisys_cond_new ();
+	if (self->workers.done == NULL)
+		self->workers.done = lisys_cond_new ();
+	if (self->workers.mutex == NULL || self->workers.wake == NULL || self->workers.done == NULL)
+		return 0;
+
+	/* Start the threads. */
+	/* The calling thread also works so one worker less than CPUs is enough. */
+	count = lisys_batch_get_cpus () - 1;
+	if (count <= 0)
+		return 0;
+	self->workers.array = lisys_calloc (count, sizeof (LISysThread*));
+	if (self->workers.array == NULL)
+		return 0;
+	for (i = 0 ; i < count ; i++)
+	{
+		self->workers.array[i] = lisys_thread_new (private_worker_main, self);
+		if (self->workers.array[i] == NULL)
+			break;
+	}
+	self->workers.count = i;
+	if (!i)
+	{
+		lisys_free (self->workers.array);
+		self->workers.array = NULL;
+		return 0;
+	}
+
+	return 1;
 }
 
 /** @} */
@@ -21,11 +21,101 @@
 #include "lipsofsuna/extension.h"
 
 #define LIEXT_SCRIPT_NOISE "Noise"
+#define LIEXT_SCRIPT_NOISE_BATCH "NoiseBatch"
+
+enum
+{
+	LIEXT_NOISE_COMMAND_FILL,
+	LIEXT_NOISE_COMMAND_PERLIN,
+	LIEXT_NOISE_COMMAND_REPLACE
+};
+
+enum
+{
+	LIEXT_NOISE_SECTOR_QUEUED,
+	LIEXT_NOISE_SECTOR_DONE,
+	LIEXT_NOISE_SECTOR_FAILED,
+	LIEXT_NOISE_SECTOR_PASTED
+};
 
 typedef struct _LIExtModule LIExtModule;
 struct _LIExtModule
 {
+	int batch_id;
+	LIAlgPtrdic* batches;
+	LICalHandle calls[1];
 	LIMaiProgram* program;
+	struct
+	{
+		int busy;
+		int count;
+		int quit;
+		int serial;
+		int slots;
+		void* job;
+		LISysCond* done;
+		LISysCond* wake;
+		LISysMutex* mutex;
+		LISysThread** array;
+	} workers;
+};
+
+typedef struct _LIExtNoiseCommand LIExtNoiseCommand;
+struct _LIExtNoiseCommand
+{
+	int type;
+	int min[3];
+	int max[3];
+	int tile;
+	int match;
+	int seed;
+	int octaves;
+	float threshold;
+	float frequency;
+	float persistence;
+	LIMatVector scale;
+};
+
+typedef struct _LIExtNoiseSector LIExtNoiseSector;
+struct _LIExtNoiseSector
+{
+	int index;
+	int state;
+	int loaded;
+	int offset[3];
+	LIVoxVoxel* voxels;
+};
+
+typedef struct _LIExtNoiseBatch LIExtNoiseBatch;
+struct _LIExtNoiseBatch
+{
+	int id;
+	int next;
+	int done;
+	int failed;
+	int pasted;
+	int cancel;
+	int running;
+	int* finished;
+	LIExtModule* module;
+	LISysMutex* mutex;
+	LIVoxManager* voxels;
+	struct
+	{
+		int count;
+		int capacity;
+		LIExtNoiseCommand* array;
+	} commands;
+	struct
+	{
+		int count;
+		LIExtNoiseSector* array;
+	} sectors;
+	struct
+	{
+		int count;
+		LISysThread** array;
+	} threads;
 };
 
 LIExtModule* liext_noise_new (
@@ -44,9 +134,58 @@ float liext_noise_perlin_noise (
 	float        frequency,
 	float        persistence);
 
+int liext_noise_perlin_region (
+	LIExtModule*       self,
+	const int*         min,
+	const int*         size,
+	const LIMatVector* scale,
+	int                seed,
+	int                octaves,
+	float              frequency,
+	float              persistence,
+	float*             result);
+
+int liext_noise_perlin_row (
+	LIExtModule*       self,
+	const int*         start,
+	int                count,
+	const LIMatVector* scale,
+	int                seed,
+	int                octaves,
+	float              frequency,
+	float              persistence,
+	float*             result);
+
+/*****************************************************************************/
+
+LIExtNoiseBatch* liext_noise_batch_new (
+	LIExtModule* module);
+
+void liext_noise_batch_free (
+	LIExtNoiseBatch* self);
+
+void liext_noise_batch_clear (
+	LIExtNoiseBatch* self);
+
+int liext_noise_batch_execute (
+	LIExtNoiseBatch* self);
+
+int liext_noise_batch_insert (
+	LIExtNoiseBatch*         self,
+	const LIExtNoiseCommand* command);
+
+int liext_noise_batch_update (
+	LIExtNoiseBatch* self);
+
+void liext_noise_batch_wait (
+	LIExtNoiseBatch* self);
+
 /*****************************************************************************/
 
 void liext_script_noise (
 	LIScrScript* self);
 
+void liext_script_noise_batch (
+	LIScrScript* self);
+
 #endif
@@ -24,6 +24,36 @@
 
 #include "ext-module.h"
 
+static void private_free_batch (
+	LIExtNoiseBatch* self)
+{
+	liext_noise_batch_free (self);
+}
+
+static int private_get_box (
+	LIScrArgs*         args,
+	int                arg,
+	LIExtNoiseCommand* command)
+{
+	LIMatVector min;
+	LIMatVector max;
+
+	if (!liscr_args_geti_vector (args, arg, &min) &&
+	    !liscr_args_gets_vector (args, "min", &min))
+		return 0;
+	if (!liscr_args_geti_vector (args, arg + 1, &max) &&
+	    !liscr_args_gets_vector (args, "max", &max))
+		return 0;
+	command->min[0] = (int) min.x;
+	command->min[1] = (int) min.y;
+	command->min[2] = (int) min.z;
+	command->max[0] = (int) max.x;
+	command->max[1] = (int) max.y;
+	command->max[2] = (int) max.z;
+
+	return 1;
+}
+
 static void Noise_perlin_noise (LIScrArgs* args)
 {
 	int seed = 0;
@@ -58,7 +88,6 @@ static void Noise_perlin_terrain (LIScrArgs* args)
 	int i;
 	int min[3];
 	int max[3];
-	int pos[3];
 	int size[3];
 	int tile = 0;
 	int seed = 0;
@@ -66,7 +95,7 @@ static void Noise_perlin_terrain (LIScrArgs* args)
 	float threshold = 0.5f;
 	float frequency = 2.0f;
 	float persistence = 0.25f;
-	float value;
+	float* values;
 	LIExtModule* module;
 	LIMatVector point1;
 	LIMatVector point2;
@@ -109,28 +138,39 @@ static void Noise_perlin_terrain (LIScrArgs* args)
 	size[0] = max[0] - min[0];
 	size[1] = max[1] - min[1];
 	size[2] = max[2] - min[2];
-	if (!size[0] || !size[1] || !size[2])
+	if (size[0] <= 0 || size[1] <= 0 || size[2] <= 0)
 		return;
 
+	/* Calculate the noise for the whole area. */
+	values = lisys_calloc (size[0] * size[1] * size[2], sizeof (float));
+	if (values == NULL)
+		return;
+	if (!liext_noise_perlin_region (module, min, size, &scale,
+	     seed, octaves, frequency, persistence, values))
+	{
+		lisys_free (values);
+		return;
+	}
+
 	/* Batch copy terrain data. */
 	/* Reading all tiles at once is faster than operating on
 	   individual tiles since there are fewer sector lookups. */
 	tmp = lisys_calloc (size[0] * size[1] * size[2], sizeof (LIVoxVoxel));
 	if (tmp == NULL)
+	{
+		lisys_free (values);
 		return;
+	}
 	livox_manager_copy_voxels (voxels, min[0], min[1], min[2],
 		size[0], size[1], size[2], tmp);
 
-	/* Apply thresholded perlin noise to the copied tiles. */
-	for (i = 0, pos[2] = min[2] ; pos[2] < max[2] ; pos[2]++)
-	for (pos[1] = min[1] ; pos[1] < max[1] ; pos[1]++)
-	for (pos[0] = min[0] ; pos[0] < max[0] ; pos[0]++, i++)
+	/* Apply the thresholded noise to the copied tiles. */
+	for (i = 0 ; i < size[0] * size[1] * size[2] ; i++)
 	{
-		value = liext_noise_perlin_noise (module, scale.x * pos[0],
-			scale.y * pos[1], scale.z * pos[2], seed, octaves, frequency, persistence);
-		if (value >= threshold)
+		if (values[i] >= threshold)
 			livox_voxel_init (tmp + i, tile);
 	}
+	lisys_free (values);
 
 	/* Batch write the copied tiles. */
 	livox_manager_paste_voxels (voxels, min[0], min[1], min[2],
@@ -140,15 +180,17 @@ static void Noise_perlin_terrain (LIScrArgs* args)
 
 static void Noise_perlin_threshold (LIScrArgs* args)
 {
+	int i;
 	int min[3];
 	int max[3];
 	int pos[3];
+	int size[3];
 	int seed = 0;
 	int octaves = 4;
 	float threshold = 0.5f;
 	float frequency = 2.0f;
 	float persistence = 0.25f;
-	float value;
+	float* values;
 	LIExtModule* module;
 	LIMatVector tmp;
 	LIMatVector point1;
@@ -182,18 +224,157 @@ static void Noise_perlin_threshold (LIScrArgs* args)
 	max[0] = (int) point2.x;
 	max[1] = (int) point2.y;
 	max[2] = (int) point2.z;
-	for (pos[2] = min[2] ; pos[2] < max[2] ; pos[2]++)
+	size[0] = max[0] - min[0];
+	size[1] = max[1] - min[1];
+	size[2] = max[2] - min[2];
+	if (size[0] <= 0 || size[1] <= 0 || size[2] <= 0)
+		return;
+
+	/* Calculate the noise for the whole area. */
+	values = lisys_calloc (size[0] * size[1] * size[2], sizeof (float));
+	if (values == NULL)
+		return;
+	if (!liext_noise_perlin_region (module, min, size, &scale,
+	     seed, octaves, frequency, persistence, values))
+	{
+		lisys_free (values);
+		return;
+	}
+
+	/* Return the points that exceed the threshold. */
+	for (i = 0, pos[2] = min[2] ; pos[2] < max[2] ; pos[2]++)
 	for (pos[1] = min[1] ; pos[1] < max[1] ; pos[1]++)
-	for (pos[0] = min[0] ; pos[0] < max[0] ; pos[0]++)
+	for (pos[0] = min[0] ; pos[0] < max[0] ; pos[0]++, i++)
 	{
-		value = liext_noise_perlin_noise (module, scale.x * pos[0],
-			scale.y * pos[1], scale.z * pos[2], seed, octaves, frequency, persistence);
-		if (value >= threshold)
+		if (values[i] >= threshold)
 		{
 			tmp = limat_vector_init (pos[0], pos[1], pos[2]);
 			liscr_args_seti_vector (args, &tmp);
 		}
 	}
+	lisys_free (values);
+}
+
+static void NoiseBatch_new (LIScrArgs* args)
+{
+	LIExtModule* module;
+	LIExtNoiseBatch* self;
+	LIScrData* data;
+
+	/* Allocate self. */
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_NOISE_BATCH);
+	self = liext_noise_batch_new (module);
+	if (self == NULL)
+		return;
+
+	/* Allocate userdata. */
+	data = liscr_data_new (args->script, args->lua, self, LIEXT_SCRIPT_NOISE_BATCH, private_free_batch);
+	if (data == NULL)
+	{
+		liext_noise_batch_free (self);
+		return;
+	}
+	liscr_args_seti_stack (args);
+}
+
+static void NoiseBatch_clear (LIScrArgs* args)
+{
+	liext_noise_batch_clear (args->self);
+}
+
+static void NoiseBatch_execute (LIScrArgs* args)
+{
+	LIExtNoiseBatch* self;
+
+	self = args->self;
+	if (!liext_noise_batch_execute (self))
+	{
+		lisys_error_report ();
+		return;
+	}
+	liscr_args_seti_int (args, self->id);
+}
+
+static void NoiseBatch_fill (LIScrArgs* args)
+{
+	LIExtNoiseCommand command;
+
+	memset (&command, 0, sizeof (LIExtNoiseCommand));
+	command.type = LIEXT_NOISE_COMMAND_FILL;
+	if (!private_get_box (args, 0, &command))
+		return;
+	if (!liscr_args_geti_int (args, 2, &command.tile))
+		liscr_args_gets_int (args, "tile", &command.tile);
+	if (!liext_noise_batch_insert (args->self, &command))
+		lisys_error_report ();
+}
+
+static void NoiseBatch_perlin (LIScrArgs* args)
+{
+	LIExtNoiseCommand command;
+
+	memset (&command, 0, sizeof (LIExtNoiseCommand));
+	command.type = LIEXT_NOISE_COMMAND_PERLIN;
+	command.octaves = 4;
+	command.threshold = 0.5f;
+	command.frequency = 2.0f;
+	command.persistence = 0.25f;
+	command.scale = limat_vector_init (1.0f, 1.0f, 1.0f);
+	if (!private_get_box (args, 0, &command))
+		return;
+	if (!liscr_args_geti_int (args, 2, &command.tile))
+		liscr_args_gets_int (args, "tile", &command.tile);
+	if (!liscr_args_geti_float (args, 3, &command.threshold))
+		liscr_args_gets_float (args, "threshold", &command.threshold);
+	if (!liscr_args_geti_vector (args, 4, &command.scale))
+		liscr_args_gets_vector (args, "scale", &command.scale);
+	if (!liscr_args_geti_float (args, 5, &command.frequency))
+		liscr_args_gets_float (args, "frequency", &command.frequency);
+	if (!liscr_args_geti_int (args, 6, &command.octaves))
+		liscr_args_gets_int (args, "octaves", &command.octaves);
+	if (!liscr_args_geti_float (args, 7, &command.persistence))
+		liscr_args_gets_float (args, "persistence", &command.persistence);
+	if (!liscr_args_geti_int (args, 8, &command.seed))
+		liscr_args_gets_int (args, "seed", &command.seed);
+	if (!liext_noise_batch_insert (args->self, &command))
+		lisys_error_report ();
+}
+
+static void NoiseBatch_replace (LIScrArgs* args)
+{
+	LIExtNoiseCommand command;
+
+	memset (&command, 0, sizeof (LIExtNoiseCommand));
+	command.type = LIEXT_NOISE_COMMAND_REPLACE;
+	if (!private_get_box (args, 0, &command))
+		return;
+	if (!liscr_args_geti_int (args, 2, &command.match))
+		liscr_args_gets_int (args, "match", &command.match);
+	if (!liscr_args_geti_int (args, 3, &command.tile))
+		liscr_args_gets_int (args, "tile", &command.tile);
+	if (!liext_noise_batch_insert (args->self, &command))
+		lisys_error_report ();
+}
+
+static void NoiseBatch_wait (LIScrArgs* args)
+{
+	liext_noise_batch_wait (args->self);
+}
+
+static void NoiseBatch_get_commands (LIScrArgs* args)
+{
+	LIExtNoiseBatch* self;
+
+	self = args->self;
+	liscr_args_seti_int (args, self->commands.count);
+}
+
+static void NoiseBatch_get_running (LIScrArgs* args)
+{
+	LIExtNoiseBatch* self;
+
+	self = args->self;
+	liscr_args_seti_bool (args, self->running);
 }
 
 /*****************************************************************************/
@@ -206,5 +387,19 @@ void liext_script_noise (
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_NOISE, "noise_perlin_threshold", Noise_perlin_threshold);
 }
 
+void liext_script_noise_batch (
+	LIScrScript* self)
+{
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_new", NoiseBatch_new);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_clear", NoiseBatch_clear);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_execute", NoiseBatch_execute);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_fill", NoiseBatch_fill);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_perlin", NoiseBatch_perlin);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_replace", NoiseBatch_replace);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_wait", NoiseBatch_wait);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_get_commands", NoiseBatch_get_commands);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_NOISE_BATCH, "noise_batch_get_running", NoiseBatch_get_running);
+}
+
 /** @} */
 /** @} */
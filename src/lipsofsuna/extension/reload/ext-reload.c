@@ -100,7 +100,8 @@ void liext_reload_update (
 		return;
 
 	/* Reload changed models. */
-	if (lisys_path_check_ext (event->name, "lmdl"))
+	if (lisys_path_check_ext (event->name, "lmdl") ||
+	    lisys_path_check_ext (event->name, "blmdl"))
 	{
 		name = lisys_path_format (LISYS_PATH_BASENAME, event->name, LISYS_PATH_STRIPEXTS, NULL);
 		if (name != NULL)
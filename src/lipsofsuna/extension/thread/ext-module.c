@@ -24,6 +24,12 @@
 
 #include "ext-module.h"
 
+static int private_tick (
+	LIExtModule* self,
+	float        secs);
+
+/*****************************************************************************/
+
 LIMaiExtensionInfo liext_thread_info =
 {
 	LIMAI_EXTENSION_VERSION, "Thread",
@@ -42,6 +48,13 @@ LIExtModule* liext_thread_new (
 		return NULL;
 	self->program = program;
 
+	/* Register callbacks. */
+	if (!lical_callbacks_insert (program->callbacks, "tick", 0, private_tick, self, self->calls + 0))
+	{
+		liext_thread_free (self);
+		return NULL;
+	}
+
 	/* Register classes. */
 	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_THREAD, self);
 	liext_script_thread (program->script);
@@ -52,8 +65,22 @@ LIExtModule* liext_thread_new (
 void liext_thread_free (
 	LIExtModule* self)
 {
+	lical_handle_releasev (self->calls, sizeof (self->calls) / sizeof (LICalHandle));
+	if (self->pool != NULL)
+		liext_pool_free (self->pool);
 	lisys_free (self);
 }
 
+/*****************************************************************************/
+
+static int private_tick (
+	LIExtModule* self,
+	float        secs)
+{
+	if (self->pool != NULL)
+		liext_pool_update (self->pool);
+	return 1;
+}
+
 /** @} */
 /** @} */
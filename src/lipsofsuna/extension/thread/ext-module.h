@@ -47,10 +47,78 @@ void liext_thread_inst_set_quit (
 
 /*****************************************************************************/
 
+#define LIEXT_POOL_QUEUE_SIZE 1024
+#define LIEXT_POOL_WORKERS_MAX 64
+
+typedef struct _LIExtPoolJob LIExtPoolJob;
+struct _LIExtPoolJob
+{
+	int id;
+	char* func;
+	char* error;
+	LIArcWriter* args;
+	LIArcWriter* result;
+};
+
+typedef struct _LIExtPool LIExtPool;
+typedef struct _LIExtPoolWorker LIExtPoolWorker;
+struct _LIExtPoolWorker
+{
+	int index;
+	int ready;
+	LIExtPool* pool;
+	LIScrScript* script;
+	LISysChannel* queue;
+	LISysThread* thread;
+};
+
+struct _LIExtPool
+{
+	int id;
+	int next;
+	int pending;
+	int queued;
+	int quit;
+	char* code;
+	char* file;
+	LIMaiProgram* program;
+	LISysChannel* results;
+	LISysCond* drained;
+	LISysCond* wake;
+	LISysMutex* mutex;
+	struct
+	{
+		int count;
+		LIExtPoolWorker* array;
+	} workers;
+};
+
+LIExtPool* liext_pool_new (
+	LIMaiProgram* program,
+	const char*   file,
+	const char*   code,
+	int           workers);
+
+void liext_pool_free (
+	LIExtPool* self);
+
+int liext_pool_submit (
+	LIExtPool*  self,
+	const char* func,
+	lua_State*  lua,
+	int         args);
+
+void liext_pool_update (
+	LIExtPool* self);
+
+/*****************************************************************************/
+
 typedef struct _LIExtModule LIExtModule;
 struct _LIExtModule
 {
 	LIMaiProgram* program;
+	LIExtPool* pool;
+	LICalHandle calls[1];
 };
 
 LIExtModule* liext_thread_new (
@@ -0,0 +1,513 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtThread Thread
+ * @{
+ */
+
+#include "ext-module.h"
+
+static void private_job_free (
+	LIExtPoolJob* job);
+
+static int private_load (
+	LIExtPool*       self,
+	LIExtPoolWorker* worker);
+
+static void private_push_event (
+	LIExtPool*    self,
+	LIExtPoolJob* job);
+
+static void private_run (
+	LIExtPoolWorker* worker,
+	LIExtPoolJob*    job);
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data);
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new worker pool.
+ *
+ * Each worker has a bare script state that has the standard Lua libraries
+ * but no engine classes. The given script is loaded once to each of them
+ * to define the job functions. The jobs are distributed evenly among the
+ * workers and idle workers steal jobs from the queues of busy ones.
+ * Workers that have nothing to do sleep until a job is submitted.
+ *
+ * \param program Program.
+ * \param file Script file that defines the job functions, or NULL.
+ * \param code Script code that defines the job functions, or NULL.
+ * \param workers Number of workers, or zero to use one per CPU.
+ * \return New pool or NULL.
+ */
+LIExtPool* liext_pool_new (
+	LIMaiProgram* program,
+	const char*   file,
+	const char*   code,
+	int           workers)
+{
+	int i;
+	LIExtPool* self;
+	LIExtPoolWorker* worker;
+
+	/* Allocate self. */
+	self = lisys_calloc (1, sizeof (LIExtPool));
+	if (self == NULL)
+		return NULL;
+	self->program = program;
+	if (code != NULL)
+	{
+		self->code = lisys_string_dup (code);
+		if (self->code == NULL)
+		{
+			liext_pool_free (self);
+			return NULL;
+		}
+	}
+	else if (file != NULL)
+	{
+		self->file = lisys_string_dup (file);
+		if (self->file == NULL)
+		{
+			liext_pool_free (self);
+			return NULL;
+		}
+	}
+
+	/* Allocate the result queue. */
+	self->results = lisys_channel_new (LIEXT_POOL_QUEUE_SIZE);
+	self->mutex = lisys_mutex_new ();
+	self->wake = lisys_cond_new ();
+	self->drained = lisys_cond_new ();
+	if (self->results == NULL || self->mutex == NULL || self->wake == NULL || self->drained == NULL)
+	{
+		liext_pool_free (self);
+		return NULL;
+	}
+
+	/* Allocate the workers. */
+	if (workers <= 0)
+		workers = lisys_batch_get_cpus ();
+	workers = LIMAT_CLAMP (workers, 1, LIEXT_POOL_WORKERS_MAX);
+	self->workers.array = lisys_calloc (workers, sizeof (LIExtPoolWorker));
+	if (self->workers.array == NULL)
+	{
+		liext_pool_free (self);
+		return NULL;
+	}
+	self->workers.count = workers;
+
+	/* Preload the worker scripts. */
+	for (i = 0 ; i < self->workers.count ; i++)
+	{
+		worker = self->workers.array + i;
+		worker->index = i;
+		worker->pool = self;
+		worker->queue = lisys_channel_new (LIEXT_POOL_QUEUE_SIZE);
+		if (worker->queue == NULL || !private_load (self, worker))
+		{
+			liext_pool_free (self);
+			return NULL;
+		}
+	}
+
+	/* Start the threads. */
+	for (i = 0 ; i < self->workers.count ; i++)
+	{
+		worker = self->workers.array + i;
+		worker->thread = lisys_thread_new (private_worker_main, worker);
+		if (worker->thread == NULL)
+		{
+			liext_pool_free (self);
+			return NULL;
+		}
+	}
+
+	return self;
+}
+
+/**
+ * \brief Frees the worker pool.
+ *
+ * Waits for the running jobs to finish and discards the queued ones.
+ *
+ * \param self Pool.
+ */
+void liext_pool_free (
+	LIExtPool* self)
+{
+	int i;
+	LIExtPoolJob* job;
+	LIExtPoolWorker* worker;
+
+	/* Stop the threads. */
+	if (self->mutex != NULL)
+	{
+		lisys_mutex_lock (self->mutex);
+		self->quit = 1;
+		if (self->wake != NULL)
+			lisys_cond_broadcast (self->wake);
+		if (self->drained != NULL)
+			lisys_cond_broadcast (self->drained);
+		lisys_mutex_unlock (self->mutex);
+	}
+	for (i = 0 ; i < self->workers.count ; i++)
+	{
+		worker = self->workers.array + i;
+		if (worker->thread != NULL)
+			lisys_thread_free (worker->thread);
+	}
+
+	/* Free the workers. */
+	for (i = 0 ; i < self->workers.count ; i++)
+	{
+		worker = self->workers.array + i;
+		if (worker->queue != NULL)
+		{
+			while ((job = lisys_channel_pop (worker->queue)) != NULL)
+				private_job_free (job);
+			lisys_channel_free (worker->queue);
+		}
+		if (worker->script != NULL)
+			liscr_script_free (worker->script);
+	}
+	lisys_free (self->workers.array);
+
+	/* Free the results. */
+	if (self->results != NULL)
+	{
+		while ((job = lisys_channel_pop (self->results)) != NULL)
+			private_job_free (job);
+		lisys_channel_free (self->results);
+	}
+	if (self->drained != NULL)
+		lisys_cond_free (self->drained);
+	if (self->wake != NULL)
+		lisys_cond_free (self->wake);
+	if (self->mutex != NULL)
+		lisys_mutex_free (self->mutex);
+
+	lisys_free (self->file);
+	lisys_free (self->code);
+	lisys_free (self);
+}
+
+/**
+ * \brief Submits a job to the worker pool.
+ *
+ * The arguments are copied to the worker as plain data. When the job has
+ * finished, a job event containing the return value is emitted.
+ *
+ * \param self Pool.
+ * \param func Name of the global job function in the worker script.
+ * \param lua Lua state of the calling program.
+ * \param args Stack index of the job arguments, or zero for none.
+ * \return Job ID or zero on failure.
+ */
+int liext_pool_submit (
+	LIExtPool*  self,
+	const char* func,
+	lua_State*  lua,
+	int         args)
+{
+	int i;
+	int index;
+	LIExtPoolJob* job;
+
+	/* Allocate the job. */
+	job = lisys_calloc (1, sizeof (LIExtPoolJob));
+	if (job == NULL)
+		return 0;
+	job->func = lisys_string_dup (func);
+	job->args = liarc_writer_new ();
+	if (job->func == NULL || job->args == NULL)
+	{
+		private_job_free (job);
+		return 0;
+	}
+
+	/* Copy the arguments. */
+	if (args)
+	{
+		if (!liscr_serialize_write (job->args, lua, args))
+		{
+			private_job_free (job);
+			return 0;
+		}
+	}
+	else
+		liarc_writer_append_uint8 (job->args, LISCR_SERIALIZE_NIL);
+
+	/* Queue the job. */
+	/* The jobs are distributed round robin. If the queue of the worker is
+	   full, the next one is tried. Imbalances are fixed by work stealing. */
+	job->id = ++self->id;
+	for (i = 0 ; i < self->workers.count ; i++)
+	{
+		index = (self->next + i) % self->workers.count;
+		if (lisys_channel_push (self->workers.array[index].queue, job))
+		{
+			self->next = (index + 1) % self->workers.count;
+			self->pending++;
+			lisys_mutex_lock (self->mutex);
+			self->queued++;
+			lisys_cond_signal (self->wake);
+			lisys_mutex_unlock (self->mutex);
+			return job->id;
+		}
+	}
+	lisys_error_set (ENOMEM, "job queue full");
+	private_job_free (job);
+
+	return 0;
+}
+
+/**
+ * \brief Emits events for finished jobs.
+ *
+ * Called once per tick by the main thread of the program.
+ *
+ * \param self Pool.
+ */
+void liext_pool_update (
+	LIExtPool* self)
+{
+	int i;
+	int count;
+	void* jobs[64];
+
+	do
+	{
+		count = lisys_channel_pop_batch (self->results, jobs, 64);
+		for (i = 0 ; i < count ; i++)
+		{
+			private_push_event (self, jobs[i]);
+			private_job_free (jobs[i]);
+			self->pending--;
+		}
+		if (count)
+		{
+			/* Wake up the workers blocked on a full result queue. */
+			lisys_mutex_lock (self->mutex);
+			lisys_cond_broadcast (self->drained);
+			lisys_mutex_unlock (self->mutex);
+		}
+	}
+	while (count == 64);
+}
+
+/*****************************************************************************/
+
+static void private_job_free (
+	LIExtPoolJob* job)
+{
+	if (job->args != NULL)
+		liarc_writer_free (job->args);
+	if (job->result != NULL)
+		liarc_writer_free (job->result);
+	lisys_free (job->func);
+	lisys_free (job->error);
+	lisys_free (job);
+}
+
+static int private_load (
+	LIExtPool*       self,
+	LIExtPoolWorker* worker)
+{
+	int ret;
+	char* path;
+	char* path_mod;
+	char* path_core;
+	LIPthPaths* paths = self->program->paths;
+
+	/* Allocate the script. */
+	worker->script = liscr_script_new ();
+	if (worker->script == NULL)
+		return 0;
+	liscr_script_set_cache (worker->script, paths->module_cache);
+	if (self->file == NULL && self->code == NULL)
+		return 1;
+
+	/* Get paths. */
+	path = (self->file != NULL)? lipth_paths_get_script (paths, self->file) : NULL;
+	path_mod = lisys_path_concat (paths->module_data, "scripts", NULL);
+	path_core = lisys_path_concat (paths->global_data, NULL);
+	if ((self->file != NULL && path == NULL) || path_mod == NULL || path_core == NULL)
+	{
+		lisys_free (path);
+		lisys_free (path_mod);
+		lisys_free (path_core);
+		return 0;
+	}
+
+	/* Load the job functions. */
+	if (self->code != NULL)
+		ret = liscr_script_load_string (worker->script, self->code, path_mod, path_core);
+	else
+		ret = liscr_script_load_file (worker->script, path, path_mod, path_core);
+	lisys_free (path);
+	lisys_free (path_mod);
+	lisys_free (path_core);
+
+	return ret;
+}
+
+static void private_push_event (
+	LIExtPool*    self,
+	LIExtPoolJob* job)
+{
+	LIArcReader* reader;
+	lua_State* lua = liscr_script_get_lua (self->program->script);
+
+	/* Create the event. */
+	lua_newtable (lua);
+	lua_pushnumber (lua, job->id);
+	lua_setfield (lua, -2, "id");
+	lua_pushstring (lua, job->func);
+	lua_setfield (lua, -2, "func");
+	if (job->error != NULL)
+	{
+		lua_pushstring (lua, job->error);
+		lua_setfield (lua, -2, "error");
+	}
+	else if (job->result != NULL)
+	{
+		reader = liarc_reader_new (liarc_writer_get_buffer (job->result), liarc_writer_get_length (job->result));
+		if (reader != NULL)
+		{
+			if (liscr_serialize_read (reader, lua))
+				lua_setfield (lua, -2, "result");
+			liarc_reader_free (reader);
+		}
+	}
+
+	/* Add to the queue. */
+	limai_program_event_table (self->program, "job");
+}
+
+static void private_run (
+	LIExtPoolWorker* worker,
+	LIExtPoolJob*    job)
+{
+	int top;
+	int ok;
+	LIArcReader* reader;
+	lua_State* lua = liscr_script_get_lua (worker->script);
+
+	/* Get the job function. */
+	top = lua_gettop (lua);
+	lua_getglobal (lua, job->func);
+	if (lua_type (lua, -1) != LUA_TFUNCTION)
+	{
+		lisys_error_set (EINVAL, "no job function `%s'", job->func);
+		job->error = lisys_string_dup (lisys_error_get_string ());
+		lua_settop (lua, top);
+		return;
+	}
+
+	/* Copy the arguments. */
+	reader = liarc_reader_new (liarc_writer_get_buffer (job->args), liarc_writer_get_length (job->args));
+	if (reader == NULL)
+	{
+		job->error = lisys_string_dup ("cannot allocate job arguments");
+		lua_settop (lua, top);
+		return;
+	}
+	ok = liscr_serialize_read (reader, lua);
+	liarc_reader_free (reader);
+	if (!ok)
+	{
+		job->error = lisys_string_dup (lisys_error_get_string ());
+		lua_settop (lua, top);
+		return;
+	}
+
+	/* Run the job. */
+	if (lua_pcall (lua, 1, 1, 0) != 0)
+	{
+		job->error = lisys_string_dup (lua_tostring (lua, -1));
+		lua_settop (lua, top);
+		return;
+	}
+
+	/* Copy the result. */
+	job->result = liarc_writer_new ();
+	if (job->result == NULL || !liscr_serialize_write (job->result, lua, -1))
+		job->error = lisys_string_dup (lisys_error_get_string ());
+	lua_settop (lua, top);
+}
+
+static void private_worker_main (
+	LISysThread* thread,
+	void*        data)
+{
+	int i;
+	LIExtPool* pool;
+	LIExtPoolJob* job;
+	LIExtPoolWorker* worker = data;
+
+	pool = worker->pool;
+	while (1)
+	{
+		/* Sleep until there is a job to claim. */
+		lisys_mutex_lock (pool->mutex);
+		while (!pool->quit && !pool->queued)
+			lisys_cond_wait (pool->wake, pool->mutex);
+		if (pool->quit)
+		{
+			lisys_mutex_unlock (pool->mutex);
+			break;
+		}
+		pool->queued--;
+		lisys_mutex_unlock (pool->mutex);
+
+		/* Get a job from our own queue or steal one from others. */
+		/* Claiming guarantees that one of the queues has a job for us, but
+		   another worker may take it from under the scan, so loop until found. */
+		job = NULL;
+		while (job == NULL)
+		{
+			job = lisys_channel_pop (worker->queue);
+			for (i = 1 ; job == NULL && i < pool->workers.count ; i++)
+				job = lisys_channel_pop (pool->workers.array[(worker->index + i) % pool->workers.count].queue);
+		}
+
+		/* Run the job and return the result. */
+		/* If the result queue is full, sleep until the main thread drains it. */
+		private_run (worker, job);
+		lisys_mutex_lock (pool->mutex);
+		while (!pool->quit && !lisys_channel_push (pool->results, job))
+			lisys_cond_wait (pool->drained, pool->mutex);
+		if (pool->quit)
+		{
+			lisys_mutex_unlock (pool->mutex);
+			private_job_free (job);
+			break;
+		}
+		lisys_mutex_unlock (pool->mutex);
+	}
+}
+
+/** @} */
+/** @} */
@@ -45,83 +45,121 @@ static void Thread_new (LIScrArgs* args)
 		liscr_args_seti_stack (args);
 }
 
+static void Thread_start_pool (LIScrArgs* args)
+{
+	int workers = 0;
+	const char* file = NULL;
+	const char* code = NULL;
+	LIExtModule* module;
+
+	/* Only one pool per program. */
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_THREAD);
+	if (module->pool != NULL)
+		return;
+
+	/* Read arguments. */
+	liscr_args_gets_string (args, "file", &file);
+	liscr_args_gets_string (args, "code", &code);
+	liscr_args_gets_int (args, "workers", &workers);
+
+	/* Start the workers. */
+	module->pool = liext_pool_new (module->program, file, code, workers);
+	if (module->pool == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+	liscr_args_seti_int (args, module->pool->workers.count);
+}
+
+static void Thread_stop_pool (LIScrArgs* args)
+{
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_THREAD);
+	if (module->pool != NULL)
+	{
+		liext_pool_free (module->pool);
+		module->pool = NULL;
+	}
+}
+
+static void Thread_submit (LIScrArgs* args)
+{
+	int id;
+	const char* func;
+	LIExtModule* module;
+
+	/* Read arguments. */
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_THREAD);
+	if (module->pool == NULL || args->input_mode == LISCR_ARGS_INPUT_TABLE)
+		return;
+	if (!liscr_args_geti_string (args, 0, &func))
+		return;
+
+	/* Queue the job. */
+	if (args->args_count > 1)
+		id = liext_pool_submit (module->pool, func, args->lua, args->args_start + 1);
+	else
+		id = liext_pool_submit (module->pool, func, args->lua, 0);
+	if (!id)
+	{
+		lisys_error_report ();
+		return;
+	}
+	liscr_args_seti_int (args, id);
+}
+
 static void Thread_pop_message (LIScrArgs* args)
 {
 	LIMaiMessage* message;
 	LIExtThread* self;
-	LIEngModel* model;
 
-	/* Pop the name. */
+	/* Pop the message. */
 	self = args->self;
 	message = limai_program_pop_message (self->program, LIMAI_MESSAGE_QUEUE_PROGRAM);
 	if (message == NULL)
 		return;
 
 	/* Return the message. */
-	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE);
-	liscr_args_sets_string (args, "name", message->name);
-	switch (message->type)
-	{
-		case LIMAI_MESSAGE_TYPE_EMPTY:
-			liscr_args_sets_string (args, "type", "empty");
-			break;
-		case LIMAI_MESSAGE_TYPE_MODEL:
-			liscr_args_sets_string (args, "type", "model");
-			model = lieng_model_new_model (self->program->parent->engine, message->model);
-			if (model != NULL)
-			{
-				message->model = NULL;
-				model->script = liscr_data_new (args->script, args->lua, model, LISCR_SCRIPT_MODEL, lieng_model_free);
-				if (model->script != NULL)
-					liscr_args_sets_stack (args, "model");
-				else
-					lieng_model_free (model);
-			}
-			break;
-		case LIMAI_MESSAGE_TYPE_STRING:
-			liscr_args_sets_string (args, "type", "string");
-			liscr_args_sets_string (args, "string", message->string);
-			break;
-	}
-
-	/* Free the message. */
+	limai_message_push_script (message, self->program->parent->engine, args->script, args->lua);
+	liscr_args_seti_stack (args);
 	limai_message_free (message);
 }
 
-static void Thread_push_message (LIScrArgs* args)
+static void Thread_pop_messages (LIScrArgs* args)
 {
-	const char* name = "";
-	const char* string = NULL;
-	LIScrData* data;
-	LIEngModel* emodel;
+	int i;
+	int count;
+	int max = LIMAI_MESSAGE_BATCH_MAX;
+	LIMaiMessage* messages[LIMAI_MESSAGE_BATCH_MAX];
 	LIExtThread* self;
 
-	/* Read the name. */
 	self = args->self;
-	if (!liscr_args_geti_string (args, 0, &name))
-		liscr_args_gets_string (args, "name", &name);
-
-	/* Read and push the data. */
-	if (liscr_args_geti_string (args, 1, &string) ||
-	    liscr_args_gets_string (args, "string", &string))
+	if (!liscr_args_geti_int (args, 0, &max))
+		liscr_args_gets_int (args, "count", &max);
+	max = LIMAT_CLAMP (max, 1, LIMAI_MESSAGE_BATCH_MAX);
+
+	/* Pop and return the messages. */
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	count = limai_program_pop_messages (self->program, LIMAI_MESSAGE_QUEUE_PROGRAM, messages, max);
+	for (i = 0 ; i < count ; i++)
 	{
-		if (limai_program_push_message (self->program, LIMAI_MESSAGE_QUEUE_THREAD, LIMAI_MESSAGE_TYPE_STRING, name, string))
-			liscr_args_seti_bool (args, 1);
-	}
-	else if (liscr_args_geti_data (args, 1, LISCR_SCRIPT_MODEL, &data) ||
-	         liscr_args_gets_data (args, "model", LISCR_SCRIPT_MODEL, &data))
-	{
-		emodel = liscr_data_get_data (data);
-		if (limai_program_push_message (self->program, LIMAI_MESSAGE_QUEUE_THREAD, LIMAI_MESSAGE_TYPE_MODEL, name, emodel->model))
-			liscr_args_seti_bool (args, 1);
-	}
-	else
-	{
-		if (limai_program_push_message (self->program, LIMAI_MESSAGE_QUEUE_THREAD, LIMAI_MESSAGE_TYPE_EMPTY, name, NULL))
-			liscr_args_seti_bool (args, 1);
+		limai_message_push_script (messages[i], self->program->parent->engine, args->script, args->lua);
+		liscr_args_seti_stack (args);
+		limai_message_free (messages[i]);
 	}
 }
 
+static void Thread_push_message (LIScrArgs* args)
+{
+	LIExtThread* self;
+
+	self = args->self;
+	if (limai_program_push_message_script (self->program, LIMAI_MESSAGE_QUEUE_THREAD, args))
+		liscr_args_seti_bool (args, 1);
+}
+
 static void Thread_set_quit (LIScrArgs* args)
 {
 	liext_thread_inst_set_quit (args->self);
@@ -133,7 +171,11 @@ void liext_script_thread (
 	LIScrScript* self)
 {
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_THREAD, "thread_new", Thread_new);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_THREAD, "thread_start_pool", Thread_start_pool);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_THREAD, "thread_stop_pool", Thread_stop_pool);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_THREAD, "thread_submit", Thread_submit);
 	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_THREAD, "thread_pop_message", Thread_pop_message);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_THREAD, "thread_pop_messages", Thread_pop_messages);
 	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_THREAD, "thread_push_message", Thread_push_message);
 	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_THREAD, "thread_set_quit", Thread_set_quit);
 }
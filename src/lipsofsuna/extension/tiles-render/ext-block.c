@@ -46,12 +46,15 @@ void liext_tiles_render_block_free (
 		liren_object_free (self->object);
 	if (self->model != NULL)
 		liren_model_free (self->model);
+	self->module->stats.memory -= self->memory;
 	lisys_free (self);
 }
 
 void liext_tiles_render_block_clear (
 	LIExtBlock* self)
 {
+	self->module->stats.memory -= self->memory;
+	self->memory = 0;
 	if (self->object != NULL)
 	{
 		liren_object_free (self->object);
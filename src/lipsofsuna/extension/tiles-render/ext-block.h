@@ -22,6 +22,9 @@
 
 struct _LIExtBlock
 {
+	int lod;
+	int seams;
+	int memory;
 	LIExtModule* module;
 	LIRenModel* model;
 	LIRenObject* object;
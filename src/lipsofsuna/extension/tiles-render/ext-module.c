@@ -22,6 +22,7 @@
  * @{
  */
 
+#include <sys/time.h>
 #include "ext-module.h"
 #include "ext-block.h"
 
@@ -40,10 +41,18 @@ static int private_process_result (
 static void private_remove_redundant_tasks (
 	LIExtBuildTask** tasks);
 
+static int private_lod_at (
+	LIExtModule* self,
+	int          x,
+	int          y,
+	int          z);
+
 static int private_tick (
 	LIExtModule* self,
 	float        secs);
 
+static double private_time ();
+
 static void private_worker_thread (
 	LISysAsyncCall* call,
 	void*           data);
@@ -108,6 +117,10 @@ LIExtModule* liext_tiles_render_new (
 		return NULL;
 	}
 
+	/* Register classes. */
+	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_TILES_RENDER, self);
+	liext_script_tiles_render (program->script);
+
 	return self;
 }
 
@@ -156,6 +169,56 @@ void liext_tiles_render_free (
 	lisys_free (self);
 }
 
+/**
+ * \brief Queues a block for building at its current level of detail.
+ * \param self Module.
+ * \param addr Block address.
+ * \return Nonzero on success.
+ */
+int liext_tiles_render_build_block (
+	LIExtModule*    self,
+	LIVoxBlockAddr* addr)
+{
+	int blockw;
+	LIVoxManager* manager;
+	LIExtBuildTask* ptr;
+	LIExtBuildTask* task;
+
+	/* Allocate a new task. */
+	task = lisys_calloc (1, sizeof (LIExtBuildTask));
+	if (task == NULL)
+		return 0;
+	task->addr = *addr;
+	task->lod = liext_tiles_render_get_lod (self, addr, &task->seams);
+	manager = self->voxels;
+	blockw = manager->tiles_per_line / manager->blocks_per_line;
+
+	/* Initialize a new terrain builder. */
+	task->builder = livox_builder_new_lod (self->voxels,
+		manager->tiles_per_line * addr->sector[0] + blockw * addr->block[0],
+		manager->tiles_per_line * addr->sector[1] + blockw * addr->block[1],
+		manager->tiles_per_line * addr->sector[2] + blockw * addr->block[2],
+		blockw, blockw, blockw, task->lod, task->seams);
+	if (task->builder == NULL)
+	{
+		lisys_free (task);
+		return 0;
+	}
+
+	/* Add the task to the pending queue. */
+	lisys_mutex_lock (self->tasks.mutex);
+	if (self->tasks.pending != NULL)
+	{
+		for (ptr = self->tasks.pending ; ptr->next != NULL ; ptr = ptr->next) {}
+		ptr->next = task;
+	}
+	else
+		self->tasks.pending = task;
+	lisys_mutex_unlock (self->tasks.mutex);
+
+	return 1;
+}
+
 void liext_tiles_render_clear_all (
 	LIExtModule* self)
 {
@@ -169,6 +232,109 @@ void liext_tiles_render_clear_all (
 	}
 }
 
+/**
+ * \brief Rebuilds the blocks whose level of detail has changed.
+ *
+ * Called automatically when the level of detail center has moved far
+ * enough. Blocks are rebuilt both when their own level changes and when
+ * the level of a neighbor changes their seams.
+ *
+ * \param self Module.
+ */
+void liext_tiles_render_update_lod (
+	LIExtModule* self)
+{
+	int lod;
+	int seams;
+	LIAlgMemdicIter iter;
+	LIExtBlock* block;
+
+	self->lod.updated = self->lod.center;
+	LIALG_MEMDIC_FOREACH (iter, self->blocks)
+	{
+		block = iter.value;
+		lod = liext_tiles_render_get_lod (self, iter.key, &seams);
+		if (lod != block->lod || seams != block->seams)
+			liext_tiles_render_build_block (self, iter.key);
+	}
+}
+
+/**
+ * \brief Gets the level of detail of a block.
+ *
+ * The level is determined by the distance of the block from the level of
+ * detail center. Faces of the block that border finer neighbors are
+ * returned in the seam mask so that the builder can hide the cracks.
+ *
+ * \param self Module.
+ * \param addr Block address.
+ * \param seams Return location for the seam mask.
+ * \return Level of detail.
+ */
+int liext_tiles_render_get_lod (
+	LIExtModule*          self,
+	const LIVoxBlockAddr* addr,
+	int*                  seams)
+{
+	int lod;
+	int pos[3];
+
+	pos[0] = addr->sector[0] * self->voxels->blocks_per_line + addr->block[0];
+	pos[1] = addr->sector[1] * self->voxels->blocks_per_line + addr->block[1];
+	pos[2] = addr->sector[2] * self->voxels->blocks_per_line + addr->block[2];
+	lod = private_lod_at (self, pos[0], pos[1], pos[2]);
+	*seams = 0;
+	if (!lod)
+		return 0;
+	if (private_lod_at (self, pos[0] - 1, pos[1], pos[2]) < lod)
+		*seams |= LIVOX_BUILD_SEAM_NEGATIVE_X;
+	if (private_lod_at (self, pos[0] + 1, pos[1], pos[2]) < lod)
+		*seams |= LIVOX_BUILD_SEAM_POSITIVE_X;
+	if (private_lod_at (self, pos[0], pos[1] - 1, pos[2]) < lod)
+		*seams |= LIVOX_BUILD_SEAM_NEGATIVE_Y;
+	if (private_lod_at (self, pos[0], pos[1] + 1, pos[2]) < lod)
+		*seams |= LIVOX_BUILD_SEAM_POSITIVE_Y;
+	if (private_lod_at (self, pos[0], pos[1], pos[2] - 1) < lod)
+		*seams |= LIVOX_BUILD_SEAM_NEGATIVE_Z;
+	if (private_lod_at (self, pos[0], pos[1], pos[2] + 1) < lod)
+		*seams |= LIVOX_BUILD_SEAM_POSITIVE_Z;
+
+	return lod;
+}
+
+/**
+ * \brief Sets the center point of the level of detail rings.
+ *
+ * This is usually the position of the camera.
+ *
+ * \param self Module.
+ * \param value Point in world space.
+ */
+void liext_tiles_render_set_lod_center (
+	LIExtModule*       self,
+	const LIMatVector* value)
+{
+	self->lod.center = *value;
+}
+
+/**
+ * \brief Sets the width of the level of detail rings.
+ *
+ * The level of detail of blocks decreases by one every time the distance
+ * to the center grows by the given amount. Zero disables the level of
+ * detail and builds all blocks at full resolution.
+ *
+ * \param self Module.
+ * \param value Distance in world units.
+ */
+void liext_tiles_render_set_lod_distance (
+	LIExtModule* self,
+	float        value)
+{
+	self->lod.distance = LIMAT_MAX (0.0f, value);
+	liext_tiles_render_update_lod (self);
+}
+
 /*****************************************************************************/
 
 static int private_block_free (
@@ -198,46 +364,48 @@ static int private_block_load (
 	LIExtModule*      self,
 	LIVoxUpdateEvent* event)
 {
-	int blockw;
-	LIVoxManager* manager;
-	LIExtBuildTask* ptr;
-	LIExtBuildTask* task;
+	int i;
+	int j;
+	int pos[3];
+	int line;
+	LIExtBlock* block;
+	LIVoxBlockAddr addr;
 
-	/* Allocate a new task. */
-	task = lisys_calloc (1, sizeof (LIExtBuildTask));
-	if (task == NULL)
-		return 1;
-	task->addr.sector[0] = event->sector[0];
-	task->addr.sector[1] = event->sector[1];
-	task->addr.sector[2] = event->sector[2];
-	task->addr.block[0] = event->block[0];
-	task->addr.block[1] = event->block[1];
-	task->addr.block[2] = event->block[2];
-	manager = self->voxels;
-	blockw = manager->tiles_per_line / manager->blocks_per_line;
+	addr.sector[0] = event->sector[0];
+	addr.sector[1] = event->sector[1];
+	addr.sector[2] = event->sector[2];
+	addr.block[0] = event->block[0];
+	addr.block[1] = event->block[1];
+	addr.block[2] = event->block[2];
+	block = lialg_memdic_find (self->blocks, &addr, sizeof (addr));
+	liext_tiles_render_build_block (self, &addr);
 
-	/* Initialize a new terrain builder. */
-	task->builder = livox_builder_new (self->voxels,
-		manager->tiles_per_line * event->sector[0] + blockw * event->block[0],
-		manager->tiles_per_line * event->sector[1] + blockw * event->block[1],
-		manager->tiles_per_line * event->sector[2] + blockw * event->block[2],
-		blockw, blockw, blockw);
-	if (task->builder == NULL)
-	{
-		lisys_free (task);
+	/* Rebuild the coarse neighbors of a changed block. */
+	/* The voxel manager only rebuilds the neighbors whose tiles next to the
+	   change are filled but the downsampled cells of coarse neighbors also
+	   cover tiles further away. The padding of the cells reaches over the
+	   edges and corners too so all the 26 neighbors are checked. */
+	if (block == NULL)
 		return 1;
-	}
-
-	/* Add the task to the pending queue. */
-	lisys_mutex_lock (self->tasks.mutex);
-	if (self->tasks.pending != NULL)
+	line = self->voxels->blocks_per_line;
+	for (i = 0 ; i < 27 ; i++)
 	{
-		for (ptr = self->tasks.pending ; ptr->next != NULL ; ptr = ptr->next) {}
-		ptr->next = task;
+		if (i == 13)
+			continue;
+		pos[0] = event->sector[0] * line + event->block[0] + i % 3 - 1;
+		pos[1] = event->sector[1] * line + event->block[1] + i / 3 % 3 - 1;
+		pos[2] = event->sector[2] * line + event->block[2] + i / 9 - 1;
+		if (pos[0] < 0 || pos[1] < 0 || pos[2] < 0)
+			continue;
+		for (j = 0 ; j < 3 ; j++)
+		{
+			addr.sector[j] = pos[j] / line;
+			addr.block[j] = pos[j] % line;
+		}
+		block = lialg_memdic_find (self->blocks, &addr, sizeof (addr));
+		if (block != NULL && block->lod)
+			liext_tiles_render_build_block (self, &addr);
 	}
-	else
-		self->tasks.pending = task;
-	lisys_mutex_unlock (self->tasks.mutex);
 
 	return 1;
 }
@@ -249,7 +417,9 @@ static int private_process_result (
 	LIExtBlock* block;
 
 	/* Delete emptied blocks. */
-	if (task->model == NULL)
+	/* Blocks that are empty only at a reduced level of detail are kept so
+	   that they get rebuilt when they are closer to the viewer again. */
+	if (task->model == NULL && !task->lod)
 	{
 		block = lialg_memdic_find (self->blocks, &task->addr, sizeof (LIVoxBlockAddr));
 		if (block != NULL)
@@ -276,6 +446,13 @@ static int private_process_result (
 
 	/* Replace the model of the block. */
 	liext_tiles_render_block_clear (block);
+	block->lod = task->lod;
+	block->seams = task->seams;
+	if (task->model == NULL)
+		return 1;
+	block->memory = task->model->vertices.count * sizeof (LIMdlVertex) +
+		task->model->lod.array[0].indices.count * sizeof (LIMdlIndex);
+	self->stats.memory += block->memory;
 	block->model = liren_model_new (self->client->render, task->model, 0);
 	if (block->model != NULL)
 	{
@@ -329,14 +506,54 @@ static void private_remove_redundant_tasks (
 	}
 }
 
+static int private_lod_at (
+	LIExtModule* self,
+	int          x,
+	int          y,
+	int          z)
+{
+	int lod;
+	int max;
+	int blockw;
+	float dist;
+	float size;
+	LIMatVector center;
+
+	if (self->lod.distance <= 0.0f)
+		return 0;
+
+	/* Calculate the distance to the center of the block. */
+	blockw = self->voxels->tiles_per_line / self->voxels->blocks_per_line;
+	size = blockw * self->voxels->tile_width;
+	center = limat_vector_init ((x + 0.5f) * size, (y + 0.5f) * size, (z + 0.5f) * size);
+	dist = limat_vector_get_length (limat_vector_subtract (center, self->lod.center));
+
+	/* The coarsest level has one cell per block. */
+	for (max = 0 ; (2 << max) <= blockw ; max++) {}
+	lod = (int)(dist / self->lod.distance);
+
+	return LIMAT_MIN (lod, max);
+}
+
 static int private_tick (
 	LIExtModule* self,
 	float        secs)
 {
 	int i;
+	float size;
 	LIExtBuildTask* task;
 	LIExtBuildTask* task_next;
 
+	/* Update the level of detail. */
+	/* This is only done after the center has moved at least half a block
+	   since the levels can't have changed much before that. */
+	if (self->lod.distance > 0.0f)
+	{
+		size = self->voxels->tile_width * self->voxels->tiles_per_line / self->voxels->blocks_per_line;
+		if (limat_vector_get_length (limat_vector_subtract (self->lod.center, self->lod.updated)) > 0.5f * size)
+			liext_tiles_render_update_lod (self);
+	}
+
 	/* Build blocks in another thread. */
 	/* Without this, there'd be major stuttering when multiple blocks are
 	   loaded quickly. That can happen when, for example, the player moves fast,
@@ -351,6 +568,8 @@ static int private_tick (
 	{
 		task_next = task->next;
 		private_process_result (self, task);
+		self->stats.builds++;
+		self->stats.time += task->time;
 		if (task->model != NULL)
 			limdl_model_free (task->model);
 		lisys_free (task);
@@ -363,6 +582,14 @@ static int private_tick (
 	return 1;
 }
 
+static double private_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
 static void private_worker_thread (
 	LISysAsyncCall* call,
 	void*           data)
@@ -383,6 +610,7 @@ static void private_worker_thread (
 		lisys_mutex_unlock (self->tasks.mutex);
 
 		/* Process the task. */
+		task->time = private_time ();
 		livox_builder_preprocess (task->builder);
 		if (!livox_builder_build_model (task->builder, &task->model))
 		{
@@ -393,6 +621,7 @@ static void private_worker_thread (
 		livox_builder_free (task->builder);
 		task->builder = NULL;
 		task->next = NULL;
+		task->time = private_time () - task->time;
 
 		/* Publish the result. */
 		lisys_mutex_lock (self->tasks.mutex);
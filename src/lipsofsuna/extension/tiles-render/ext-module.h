@@ -30,6 +30,9 @@ typedef struct _LIExtModule LIExtModule;
 
 struct _LIExtBuildTask
 {
+	int lod;
+	int seams;
+	double time;
 	LIVoxBlockAddr addr;
 	LIVoxBuilder* builder;
 	LIMdlModel* model;
@@ -44,6 +47,18 @@ struct _LIExtModule
 	LIMaiProgram* program;
 	LIVoxManager* voxels;
 	struct
+	{
+		float distance;
+		LIMatVector center;
+		LIMatVector updated;
+	} lod;
+	struct
+	{
+		int builds;
+		int memory;
+		double time;
+	} stats;
+	struct
 	{
 		LISysAsyncCall* worker;
 		LISysMutex* mutex;
@@ -68,4 +83,25 @@ int liext_tiles_render_build_block (
 void liext_tiles_render_clear_all (
 	LIExtModule* self);
 
+void liext_tiles_render_update_lod (
+	LIExtModule* self);
+
+int liext_tiles_render_get_lod (
+	LIExtModule*          self,
+	const LIVoxBlockAddr* addr,
+	int*                  seams);
+
+void liext_tiles_render_set_lod_center (
+	LIExtModule*       self,
+	const LIMatVector* value);
+
+void liext_tiles_render_set_lod_distance (
+	LIExtModule* self,
+	float        value);
+
+/*****************************************************************************/
+
+void liext_script_tiles_render (
+	LIScrScript* self);
+
 #endif
@@ -0,0 +1,98 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtTilesRender TilesRender
+ * @{
+ */
+
+#include "ext-module.h"
+#include "ext-block.h"
+
+static void TilesRender_get_lod_center (LIScrArgs* args)
+{
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TILES_RENDER);
+	liscr_args_seti_vector (args, &module->lod.center);
+}
+static void TilesRender_set_lod_center (LIScrArgs* args)
+{
+	LIMatVector value;
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TILES_RENDER);
+	if (liscr_args_geti_vector (args, 0, &value))
+		liext_tiles_render_set_lod_center (module, &value);
+}
+
+static void TilesRender_get_lod_distance (LIScrArgs* args)
+{
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TILES_RENDER);
+	liscr_args_seti_float (args, module->lod.distance);
+}
+static void TilesRender_set_lod_distance (LIScrArgs* args)
+{
+	float value;
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TILES_RENDER);
+	if (liscr_args_geti_float (args, 0, &value))
+		liext_tiles_render_set_lod_distance (module, value);
+}
+
+static void TilesRender_get_stats (LIScrArgs* args)
+{
+	int coarse = 0;
+	LIAlgMemdicIter iter;
+	LIExtBlock* block;
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TILES_RENDER);
+	LIALG_MEMDIC_FOREACH (iter, module->blocks)
+	{
+		block = iter.value;
+		if (block->lod)
+			coarse++;
+	}
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	liscr_args_sets_int (args, "blocks", module->blocks->size);
+	liscr_args_sets_int (args, "builds", module->stats.builds);
+	liscr_args_sets_float (args, "build_time", module->stats.time);
+	liscr_args_sets_int (args, "coarse_blocks", coarse);
+	liscr_args_sets_int (args, "memory", module->stats.memory);
+}
+
+/*****************************************************************************/
+
+void liext_script_tiles_render (
+	LIScrScript* self)
+{
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TILES_RENDER, "tiles_render_get_lod_center", TilesRender_get_lod_center);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TILES_RENDER, "tiles_render_set_lod_center", TilesRender_set_lod_center);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TILES_RENDER, "tiles_render_get_lod_distance", TilesRender_get_lod_distance);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TILES_RENDER, "tiles_render_set_lod_distance", TilesRender_set_lod_distance);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TILES_RENDER, "tiles_render_get_stats", TilesRender_get_stats);
+}
+
+/** @} */
+/** @} */
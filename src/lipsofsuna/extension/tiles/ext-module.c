@@ -26,6 +26,14 @@
 
 #define REBUILD_TIMER 0.2
 
+static int private_block_free (
+	LIExtModule*      self,
+	LIVoxUpdateEvent* event);
+
+static void private_block_data_free (
+	LIExtModule*    self,
+	LIExtBlockData* data);
+
 static int private_tick (
 	LIExtModule* self,
 	float        secs);
@@ -50,6 +58,14 @@ LIExtModule* liext_tiles_new (
 		return NULL;
 	self->program = program;
 
+	/* Allocate the encoded block cache. */
+	self->blocks = lialg_u32dic_new ();
+	if (self->blocks == NULL)
+	{
+		liext_tiles_free (self);
+		return NULL;
+	}
+
 	/* Create voxel manager. */
 	self->voxels = livox_manager_new (program->callbacks, program->sectors);
 	if (self->voxels == NULL)
@@ -66,7 +82,8 @@ LIExtModule* liext_tiles_new (
 	}
 
 	/* Register callbacks. */
-	if (!lical_callbacks_insert (program->callbacks, "tick", 0, private_tick, self, self->calls + 0))
+	if (!lical_callbacks_insert (program->callbacks, "tick", 0, private_tick, self, self->calls + 0) ||
+	    !lical_callbacks_insert (program->callbacks, "block-free", 0, private_block_free, self, self->calls + 1))
 	{
 		liext_tiles_free (self);
 		return NULL;
@@ -74,8 +91,10 @@ LIExtModule* liext_tiles_new (
 
 	/* Register classes. */
 	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_MATERIAL, self);
+	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_TERRAIN_STORE, self);
 	liscr_script_set_userdata (program->script, LIEXT_SCRIPT_VOXEL, self);
 	liext_script_material (program->script);
+	liext_script_terrain_store (program->script);
 	liext_script_voxel (program->script);
 
 	return self;
@@ -84,9 +103,19 @@ LIExtModule* liext_tiles_new (
 void liext_tiles_free (
 	LIExtModule* self)
 {
+	LIAlgU32dicIter iter;
+
 	/* Remove callbacks. */
 	lical_handle_releasev (self->calls, sizeof (self->calls) / sizeof (LICalHandle));
 
+	/* Free the encoded block cache. */
+	if (self->blocks != NULL)
+	{
+		LIALG_U32DIC_FOREACH (iter, self->blocks)
+			private_block_data_free (self, iter.value);
+		lialg_u32dic_free (self->blocks);
+	}
+
 	/* Unregister component. */
 	if (self->voxels != NULL)
 		limai_program_remove_component (self->program, "voxels");
@@ -98,6 +127,88 @@ void liext_tiles_free (
 	lisys_free (self);
 }
 
+/**
+ * \brief Gets the encoded and compressed data of a block.
+ *
+ * When a block changes, every client that sees it needs a copy of it. The
+ * encoded data is cached by the block index and the modification stamp of
+ * the block so that each version of the block is only compressed once no
+ * matter how many clients it's sent to. Cached blocks are re-encoded when
+ * their stamp changes and removed when their sector is unloaded.
+ *
+ * \param self Module.
+ * \param index Block index.
+ * \param sector Sector containing the block.
+ * \param x Block offset within the sector.
+ * \param y Block offset within the sector.
+ * \param z Block offset within the sector.
+ * \return Block data owned by the cache, or NULL.
+ */
+const LIExtBlockData* liext_tiles_encode_block (
+	LIExtModule* self,
+	int          index,
+	LIVoxSector* sector,
+	int          x,
+	int          y,
+	int          z)
+{
+	int stamp;
+	LIArcWriter* writer;
+	LIExtBlockData* data;
+
+	/* Check for a cache hit. */
+	stamp = livox_block_get_stamp (livox_sector_get_block (sector, x, y, z));
+	data = lialg_u32dic_find (self->blocks, index);
+	if (data != NULL)
+	{
+		if (data->stamp == stamp)
+		{
+			self->stats.hits++;
+			return data;
+		}
+		lialg_u32dic_remove (self->blocks, index);
+		private_block_data_free (self, data);
+	}
+	self->stats.misses++;
+
+	/* Encode the block. */
+	writer = liarc_writer_new ();
+	if (writer == NULL)
+		return NULL;
+	if (!livox_sector_write_block_compressed (sector, x, y, z, writer))
+	{
+		liarc_writer_free (writer);
+		return NULL;
+	}
+
+	/* Add to the cache. */
+	data = lisys_calloc (1, sizeof (LIExtBlockData));
+	if (data == NULL)
+	{
+		liarc_writer_free (writer);
+		return NULL;
+	}
+	data->stamp = stamp;
+	data->length = liarc_writer_get_length (writer);
+	data->data = lisys_malloc (data->length);
+	if (data->data == NULL)
+	{
+		lisys_free (data);
+		liarc_writer_free (writer);
+		return NULL;
+	}
+	memcpy (data->data, liarc_writer_get_buffer (writer), data->length);
+	liarc_writer_free (writer);
+	self->stats.memory += data->length;
+	if (!lialg_u32dic_insert (self->blocks, index, data))
+	{
+		private_block_data_free (self, data);
+		return NULL;
+	}
+
+	return data;
+}
+
 /**
  * \brief Gets the voxel manager of the module.
  *
@@ -117,6 +228,42 @@ LIVoxManager* liext_tiles_get_voxels (
 
 /*****************************************************************************/
 
+static int private_block_free (
+	LIExtModule*      self,
+	LIVoxUpdateEvent* event)
+{
+	int line;
+	int index;
+	LIExtBlockData* data;
+
+	/* Calculate the block index. */
+	line = self->voxels->blocks_per_line * self->voxels->sectors->count;
+	index = (self->voxels->blocks_per_line * event->sector[0] + event->block[0]) +
+	        (self->voxels->blocks_per_line * event->sector[1] + event->block[1]) * line +
+	        (self->voxels->blocks_per_line * event->sector[2] + event->block[2]) * line * line;
+
+	/* Remove the block from the cache. */
+	/* The stamps of reloaded blocks start from zero again so the old data
+	   could otherwise be mistaken for current. */
+	data = lialg_u32dic_find (self->blocks, index);
+	if (data != NULL)
+	{
+		lialg_u32dic_remove (self->blocks, index);
+		private_block_data_free (self, data);
+	}
+
+	return 1;
+}
+
+static void private_block_data_free (
+	LIExtModule*    self,
+	LIExtBlockData* data)
+{
+	self->stats.memory -= data->length;
+	lisys_free (data->data);
+	lisys_free (data);
+}
+
 static int private_tick (
 	LIExtModule* self,
 	float        secs)
@@ -22,17 +22,64 @@
 #include "lipsofsuna/extension.h"
 
 typedef struct _LIExtBlock LIExtBlock;
+typedef struct _LIExtBlockData LIExtBlockData;
 typedef struct _LIExtModule LIExtModule;
+typedef struct _LIExtRegion LIExtRegion;
+typedef struct _LIExtTerrainStore LIExtTerrainStore;
 
 #define LIEXT_SCRIPT_MATERIAL "Material"
+#define LIEXT_SCRIPT_TERRAIN_STORE "TerrainStore"
 #define LIEXT_SCRIPT_VOXEL "Voxel"
 
+struct _LIExtBlockData
+{
+	int stamp;
+	int length;
+	char* data;
+};
+
 struct _LIExtModule
 {
 	float timer;
-	LICalHandle calls[1];
+	LIAlgU32dic* blocks;
+	LICalHandle calls[2];
 	LIMaiProgram* program;
 	LIVoxManager* voxels;
+	struct
+	{
+		int hits;
+		int misses;
+		int memory;
+	} stats;
+};
+
+/* A memory mapped file that stores the sectors of a cube of the world in
+   fixed-size slots. The used slots are tracked in memory and rebuilt from
+   the index when the file is opened. */
+struct _LIExtRegion
+{
+	int slots;
+	uint8_t* used;
+	uint32_t* pending;
+	LISysMmap* mmap;
+};
+
+struct _LIExtTerrainStore
+{
+	int batch;
+	int erased;
+	int sync;
+	char* path;
+	LIAlgU32dic* regions;
+	LIExtModule* module;
+	struct
+	{
+		int corrupt;
+		int misses;
+		int reads;
+		int syncs;
+		int writes;
+	} stats;
 };
 
 LIExtModule* liext_tiles_new (
@@ -45,17 +92,61 @@ int liext_tiles_build_block (
 	LIExtModule*    self,
 	LIVoxBlockAddr* addr);
 
+const LIExtBlockData* liext_tiles_encode_block (
+	LIExtModule* self,
+	int          index,
+	LIVoxSector* sector,
+	int          x,
+	int          y,
+	int          z);
+
 LIVoxManager* liext_tiles_get_voxels (
 	LIExtModule* self);
 
 /*****************************************************************************/
 
+LIExtTerrainStore* liext_terrain_store_new (
+	LIExtModule* module,
+	const char*  path);
+
+void liext_terrain_store_free (
+	LIExtTerrainStore* self);
+
+void liext_terrain_store_begin (
+	LIExtTerrainStore* self);
+
+int liext_terrain_store_commit (
+	LIExtTerrainStore* self);
+
+int liext_terrain_store_erase (
+	LIExtTerrainStore* self,
+	int                sector);
+
+int liext_terrain_store_erase_all (
+	LIExtTerrainStore* self);
+
+int liext_terrain_store_load (
+	LIExtTerrainStore* self,
+	int                sector);
+
+int liext_terrain_store_save (
+	LIExtTerrainStore* self,
+	int                sector);
+
+int liext_terrain_store_get_size (
+	LIExtTerrainStore* self);
+
+/*****************************************************************************/
+
 void liext_script_material (
 	LIScrScript* self);
 
 void liext_script_tile (
 	LIScrScript* self);
 
+void liext_script_terrain_store (
+	LIScrScript* self);
+
 void liext_script_voxel (
 	LIScrScript* self);
 
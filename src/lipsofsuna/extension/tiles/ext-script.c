@@ -24,6 +24,144 @@
 
 #include "ext-module.h"
 
+static void TerrainStore_new (LIScrArgs* args)
+{
+	int ok;
+	int sync;
+	char* path;
+	const char* ptr;
+	const char* name;
+	LIExtModule* module;
+	LIExtTerrainStore* self;
+	LIScrData* data;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_TERRAIN_STORE);
+
+	/* Get and validate the directory name. */
+	if (!liscr_args_geti_string (args, 0, &name) &&
+	    !liscr_args_gets_string (args, "name", &name))
+		return;
+	for (ptr = name ; *ptr != '\0' ; ptr++)
+	{
+		if (*ptr >= 'a' && *ptr <= 'z') ok = 1;
+		else if (*ptr >= 'A' && *ptr <= 'Z') ok = 1;
+		else if (*ptr >= '0' && *ptr <= '9') ok = 1;
+		else if (*ptr == '-') ok = 1;
+		else if (*ptr == '_') ok = 1;
+		else if (*ptr == '.') ok = 1;
+		else ok = 0;
+		if (!ok)
+		{
+			lisys_error_set (EINVAL, "invalid terrain store name `%s'", name);
+			lisys_error_report ();
+			return;
+		}
+	}
+
+	/* The region files live in a directory next to the databases. */
+	path = lipth_paths_get_sql (module->program->paths, name);
+	if (path == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+
+	/* Open the store. */
+	self = liext_terrain_store_new (module, path);
+	lisys_free (path);
+	if (self == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+	if (liscr_args_gets_bool (args, "sync", &sync))
+		self->sync = sync;
+
+	/* Allocate userdata. */
+	data = liscr_data_new (args->script, args->lua, self, LIEXT_SCRIPT_TERRAIN_STORE, liext_terrain_store_free);
+	if (data == NULL)
+	{
+		liext_terrain_store_free (self);
+		return;
+	}
+	liscr_args_seti_stack (args);
+}
+
+static void TerrainStore_begin (LIScrArgs* args)
+{
+	liext_terrain_store_begin (args->self);
+}
+
+static void TerrainStore_commit (LIScrArgs* args)
+{
+	liscr_args_seti_bool (args, liext_terrain_store_commit (args->self));
+}
+
+static void TerrainStore_erase (LIScrArgs* args)
+{
+	int sector;
+
+	if (!liscr_args_geti_int (args, 0, &sector))
+		return;
+	liscr_args_seti_bool (args, liext_terrain_store_erase (args->self, sector));
+}
+
+static void TerrainStore_erase_all (LIScrArgs* args)
+{
+	liscr_args_seti_bool (args, liext_terrain_store_erase_all (args->self));
+}
+
+static void TerrainStore_load (LIScrArgs* args)
+{
+	int sector;
+
+	if (!liscr_args_geti_int (args, 0, &sector))
+		return;
+	liscr_args_seti_bool (args, liext_terrain_store_load (args->self, sector));
+}
+
+static void TerrainStore_save (LIScrArgs* args)
+{
+	int sector;
+
+	if (!liscr_args_geti_int (args, 0, &sector))
+		return;
+	liscr_args_seti_bool (args, liext_terrain_store_save (args->self, sector));
+}
+
+static void TerrainStore_get_stats (LIScrArgs* args)
+{
+	LIExtTerrainStore* self;
+
+	self = args->self;
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	liscr_args_sets_int (args, "corrupt", self->stats.corrupt);
+	liscr_args_sets_int (args, "misses", self->stats.misses);
+	liscr_args_sets_int (args, "reads", self->stats.reads);
+	liscr_args_sets_int (args, "regions", self->regions->size);
+	liscr_args_sets_int (args, "size", liext_terrain_store_get_size (self));
+	liscr_args_sets_int (args, "syncs", self->stats.syncs);
+	liscr_args_sets_int (args, "writes", self->stats.writes);
+}
+
+static void TerrainStore_get_sync (LIScrArgs* args)
+{
+	LIExtTerrainStore* self;
+
+	self = args->self;
+	liscr_args_seti_bool (args, self->sync);
+}
+
+static void TerrainStore_set_sync (LIScrArgs* args)
+{
+	int value;
+	LIExtTerrainStore* self;
+
+	self = args->self;
+	if (liscr_args_geti_bool (args, 0, &value))
+		self->sync = value;
+}
+
 static void Voxel_copy_region (LIScrArgs* args)
 {
 	int i;
@@ -107,14 +245,11 @@ static void Voxel_copy_region (LIScrArgs* args)
 
 static void Voxel_fill_region (LIScrArgs* args)
 {
-	int i;
-	int count;
 	int type = 0;
 	LIExtModule* module;
 	LIMatVector pos;
 	LIMatVector size;
 	LIVoxVoxel tile;
-	LIVoxVoxel* tiles;
 
 	/* Handle arguments. */
 	if (!liscr_args_gets_vector (args, "point", &pos) ||
@@ -125,21 +260,43 @@ static void Voxel_fill_region (LIScrArgs* args)
 	liscr_args_gets_int (args, "tile", &type);
 	livox_voxel_init (&tile, type);
 
-	/* Allocate tiles. */
-	count = (int) size.x * (int) size.y * (int) size.z;
-	tiles = lisys_calloc (count, sizeof (LIVoxVoxel));
-	if (tiles == NULL)
+	/* Fill the box in place. */
+	pos = limat_vector_init ((int) pos.x, (int) pos.y, (int) pos.z);
+	size = limat_vector_init (0.5f * (int) size.x, 0.5f * (int) size.y, 0.5f * (int) size.z);
+	pos = limat_vector_add (pos, size);
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	livox_manager_fill_shape (module->voxels, LIVOX_SHAPE_BOX, &pos, &size, -1, &tile);
+}
+
+static void Voxel_fill_shape (LIScrArgs* args)
+{
+	int type = 0;
+	int match = -1;
+	int shape = LIVOX_SHAPE_BOX;
+	const char* tmp;
+	LIExtModule* module;
+	LIMatVector center;
+	LIMatVector radius;
+	LIVoxVoxel tile;
+
+	/* Handle arguments. */
+	if (!liscr_args_gets_vector (args, "center", &center) ||
+	    !liscr_args_gets_vector (args, "radius", &radius))
 		return;
-	for (i = 0 ; i < count ; i++)
-		tiles[i] = tile;
+	if (liscr_args_gets_string (args, "shape", &tmp))
+	{
+		if (!strcmp (tmp, "box")) shape = LIVOX_SHAPE_BOX;
+		else if (!strcmp (tmp, "cylinder")) shape = LIVOX_SHAPE_CYLINDER;
+		else if (!strcmp (tmp, "sphere")) shape = LIVOX_SHAPE_SPHERE;
+		else return;
+	}
+	liscr_args_gets_int (args, "match", &match);
+	liscr_args_gets_int (args, "tile", &type);
+	livox_voxel_init (&tile, type);
 
-	/* Paste tiles to the map. */
+	/* Fill the shape. */
 	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
-	livox_manager_paste_voxels (module->voxels,
-		(int) pos.x, (int) pos.y, (int) pos.z,
-		(int) size.x, (int) size.y, (int) size.z, tiles);
-
-	lisys_free (tiles);
+	liscr_args_seti_int (args, livox_manager_fill_shape (module->voxels, shape, &center, &radius, match, &tile));
 }
 
 static void Voxel_find_blocks (LIScrArgs* args)
@@ -214,6 +371,44 @@ static void Voxel_find_blocks (LIScrArgs* args)
 	}
 }
 
+static void Voxel_find_heights (LIScrArgs* args)
+{
+	int i;
+	int count;
+	int* heights;
+	LIExtModule* module;
+	LIMatVector pos;
+	LIMatVector size;
+
+	/* Handle arguments. */
+	if (!liscr_args_gets_vector (args, "point", &pos) ||
+	    !liscr_args_gets_vector (args, "size", &size))
+		return;
+	if (size.x < 1.0f || size.y < 1.0f || size.z < 1.0f)
+		return;
+
+	/* Find the heights. */
+	count = (int) size.x * (int) size.z;
+	heights = lisys_calloc (count, sizeof (int));
+	if (heights == NULL)
+		return;
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	livox_manager_find_heights (module->voxels,
+		(int) pos.x, (int) pos.y, (int) pos.z,
+		(int) size.x, (int) size.y, (int) size.z, heights);
+
+	/* Return the heights in rows along the X axis. */
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	for (i = 0 ; i < count ; i++)
+	{
+		if (heights[i] == -1)
+			liscr_args_seti_bool (args, 0);
+		else
+			liscr_args_seti_int (args, heights[i]);
+	}
+	lisys_free (heights);
+}
+
 static void Voxel_find_tile (LIScrArgs* args)
 {
 	int index[3];
@@ -262,6 +457,7 @@ static void Voxel_get_block (LIScrArgs* args)
 	LIScrData* data = NULL;
 	LIVoxSector* sector;
 	LIVoxBlockAddr addr;
+	const LIExtBlockData* block;
 
 	/* Get block index. */
 	if (!liscr_args_gets_int (args, "index", &index))
@@ -283,6 +479,11 @@ static void Voxel_get_block (LIScrArgs* args)
 	if (sector == NULL)
 		return;
 
+	/* Get the encoded block. */
+	block = liext_tiles_encode_block (module, index, sector, addr.block[0], addr.block[1], addr.block[2]);
+	if (block == NULL)
+		return;
+
 	/* Get or create packet. */
 	if (!liscr_args_gets_data (args, "packet", LISCR_SCRIPT_PACKET, &data))
 	{
@@ -307,7 +508,19 @@ static void Voxel_get_block (LIScrArgs* args)
 
 	/* Build the packet. */
 	liarc_writer_append_uint32 (packet->writer, index);
-	livox_sector_write_block (sector, addr.block[0], addr.block[1], addr.block[2], packet->writer);
+	liarc_writer_append_raw (packet->writer, block->data, block->length);
+}
+
+static void Voxel_get_block_cache_stats (LIScrArgs* args)
+{
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	liscr_args_sets_int (args, "blocks", module->blocks->size);
+	liscr_args_sets_int (args, "hits", module->stats.hits);
+	liscr_args_sets_int (args, "memory", module->stats.memory);
+	liscr_args_sets_int (args, "misses", module->stats.misses);
 }
 
 static void Voxel_get_tile (LIScrArgs* args)
@@ -331,6 +544,60 @@ static void Voxel_get_tile (LIScrArgs* args)
 	liscr_args_seti_int (args, voxel.type);
 }
 
+static void Voxel_get_tiles (LIScrArgs* args)
+{
+	int i;
+	int count;
+	int* points = NULL;
+	LIExtModule* module;
+	LIMatVector* point;
+	LIScrData* data;
+	LIVoxVoxel* voxels = NULL;
+
+	/* Get arguments. */
+	if (!liscr_args_gets_table (args, "points"))
+		return;
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	count = lua_objlen (args->lua, -1);
+
+	/* Collect the tile indices. */
+	if (count)
+	{
+		points = lisys_calloc (3 * count, sizeof (int));
+		voxels = lisys_calloc (count, sizeof (LIVoxVoxel));
+		if (points == NULL || voxels == NULL)
+			count = 0;
+	}
+	for (i = 0 ; i < count ; i++)
+	{
+		lua_pushnumber (args->lua, i + 1);
+		lua_gettable (args->lua, -2);
+		data = liscr_isdata (args->lua, -1, LISCR_SCRIPT_VECTOR);
+		if (data != NULL)
+		{
+			/* Negative coordinates are outside the map like in get_tile. */
+			point = liscr_data_get_data (data);
+			points[3 * i + 0] = (point->x < 0.0f)? -1 : (int) point->x;
+			points[3 * i + 1] = (point->y < 0.0f)? -1 : (int) point->y;
+			points[3 * i + 2] = (point->z < 0.0f)? -1 : (int) point->z;
+		}
+		else
+			points[3 * i] = -1;
+		lua_pop (args->lua, 1);
+	}
+	lua_pop (args->lua, 1);
+
+	/* Get the tiles. */
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	if (count)
+		livox_manager_get_voxels (module->voxels, count, points, voxels);
+	for (i = 0 ; i < count ; i++)
+		liscr_args_seti_int (args, voxels[i].type);
+
+	lisys_free (points);
+	lisys_free (voxels);
+}
+
 static void Voxel_intersect_ray (LIScrArgs* args)
 {
 	LIExtModule* module;
@@ -359,6 +626,78 @@ static void Voxel_intersect_ray (LIScrArgs* args)
 	}
 }
 
+static void Voxel_intersect_rays (LIScrArgs* args)
+{
+	int i;
+	int count;
+	int* hits = NULL;
+	LIExtModule* module;
+	LIMatVector* rays = NULL;
+	LIMatVector* points = NULL;
+	LIMatVector* tiles = NULL;
+	LIScrData* data;
+
+	/* Get arguments. */
+	if (!liscr_args_gets_table (args, "rays"))
+		return;
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	count = lua_objlen (args->lua, -1) / 2;
+
+	/* Collect the start and end points of the rays. */
+	if (count)
+	{
+		rays = lisys_calloc (2 * count, sizeof (LIMatVector));
+		points = lisys_calloc (count, sizeof (LIMatVector));
+		tiles = lisys_calloc (count, sizeof (LIMatVector));
+		hits = lisys_calloc (count, sizeof (int));
+		if (rays == NULL || points == NULL || tiles == NULL || hits == NULL)
+			count = 0;
+	}
+	for (i = 0 ; i < 2 * count ; i++)
+	{
+		lua_pushnumber (args->lua, i + 1);
+		lua_gettable (args->lua, -2);
+		data = liscr_isdata (args->lua, -1, LISCR_SCRIPT_VECTOR);
+		if (data != NULL)
+			rays[i] = limat_vector_multiply (*((LIMatVector*) liscr_data_get_data (data)), 1.0f / module->voxels->tile_width);
+		lua_pop (args->lua, 1);
+	}
+	lua_pop (args->lua, 1);
+
+	/* Intersect with terrain. */
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	if (count)
+		livox_manager_intersect_rays (module->voxels, count, rays, points, tiles, hits);
+	for (i = 0 ; i < count ; i++)
+	{
+		if (!hits[i])
+		{
+			liscr_args_seti_bool (args, 0);
+			continue;
+		}
+		points[i] = limat_vector_multiply (points[i], module->voxels->tile_width);
+		lua_newtable (args->lua);
+		data = liscr_data_new_value (args->script, args->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+		if (data != NULL)
+		{
+			*((LIMatVector*) liscr_data_get_data (data)) = points[i];
+			lua_setfield (args->lua, -2, "point");
+		}
+		data = liscr_data_new_value (args->script, args->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+		if (data != NULL)
+		{
+			*((LIMatVector*) liscr_data_get_data (data)) = tiles[i];
+			lua_setfield (args->lua, -2, "tile");
+		}
+		liscr_args_seti_stack (args);
+	}
+
+	lisys_free (rays);
+	lisys_free (points);
+	lisys_free (tiles);
+	lisys_free (hits);
+}
+
 static void Voxel_paste_region (LIScrArgs* args)
 {
 	int i;
@@ -508,7 +847,7 @@ static void Voxel_set_block (LIScrArgs* args)
 		return;
 
 	/* Read block data. */
-	if (!livox_sector_read_block (sector, addr.block[0], addr.block[1], addr.block[2], packet->reader))
+	if (!livox_sector_read_block_compressed (sector, addr.block[0], addr.block[1], addr.block[2], packet->reader))
 		return;
 
 	/* Indicate success. */
@@ -621,6 +960,25 @@ static void Voxel_set_fill (LIScrArgs* args)
 	livox_manager_set_fill (module->voxels, type);
 }
 
+static void Voxel_get_greedy (LIScrArgs* args)
+{
+	LIExtModule* module;
+
+	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+	liscr_args_seti_bool (args, module->voxels->greedy);
+}
+static void Voxel_set_greedy (LIScrArgs* args)
+{
+	int value;
+	LIExtModule* module;
+
+	if (liscr_args_geti_bool (args, 0, &value))
+	{
+		module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
+		livox_manager_set_greedy (module->voxels, value);
+	}
+}
+
 static void Voxel_get_materials (LIScrArgs* args)
 {
 	LIAlgU32dicIter iter;
@@ -641,7 +999,7 @@ static void Voxel_get_memory_used (LIScrArgs* args)
 	LIExtModule* module;
 
 	module = liscr_script_get_userdata (args->script, LIEXT_SCRIPT_VOXEL);
-	liscr_args_seti_int (args, livox_manager_get_memory (module->voxels));
+	liscr_args_seti_int (args, livox_manager_get_memory (module->voxels) + module->stats.memory);
 }
 
 static void Voxel_get_tiles_per_line (LIScrArgs* args)
@@ -666,25 +1024,47 @@ static void Voxel_set_tiles_per_line (LIScrArgs* args)
 
 /*****************************************************************************/
 
+void liext_script_terrain_store (
+	LIScrScript* self)
+{
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_new", TerrainStore_new);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_begin", TerrainStore_begin);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_commit", TerrainStore_commit);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_erase", TerrainStore_erase);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_erase_all", TerrainStore_erase_all);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_load", TerrainStore_load);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_save", TerrainStore_save);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_get_stats", TerrainStore_get_stats);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_get_sync", TerrainStore_get_sync);
+	liscr_script_insert_mfunc (self, LIEXT_SCRIPT_TERRAIN_STORE, "terrain_store_set_sync", TerrainStore_set_sync);
+}
+
 void liext_script_voxel (
 	LIScrScript* self)
 {
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_copy_region", Voxel_copy_region);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_fill_region", Voxel_fill_region);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_fill_shape", Voxel_fill_shape);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_find_blocks", Voxel_find_blocks);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_find_heights", Voxel_find_heights);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_find_tile", Voxel_find_tile);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_block", Voxel_get_block);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_tile", Voxel_get_tile);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_tiles", Voxel_get_tiles);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_intersect_ray", Voxel_intersect_ray);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_intersect_rays", Voxel_intersect_rays);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_paste_region", Voxel_paste_region);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_update", Voxel_update);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_block", Voxel_set_block);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_tile", Voxel_set_tile);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_tiles", Voxel_set_tiles);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_block_cache_stats", Voxel_get_block_cache_stats);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_blocks_per_line", Voxel_get_blocks_per_line);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_blocks_per_line", Voxel_set_blocks_per_line);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_fill", Voxel_get_fill);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_fill", Voxel_set_fill);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_greedy", Voxel_get_greedy);
+	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_set_greedy", Voxel_set_greedy);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_materials", Voxel_get_materials);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_memory_used", Voxel_get_memory_used);
 	liscr_script_insert_cfunc (self, LIEXT_SCRIPT_VOXEL, "voxel_get_tiles_per_line", Voxel_get_tiles_per_line);
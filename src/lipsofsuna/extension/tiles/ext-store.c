@@ -0,0 +1,841 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LIExt Extension
+ * @{
+ * \addtogroup LIExtTiles Tiles
+ * @{
+ */
+
+#include <zlib.h>
+#include "ext-module.h"
+
+/* Each region file stores a cube of LINE^3 sectors. The file starts with
+   a header and an index of one 32-bit entry per sector, followed by slots
+   of SLOT bytes. An entry stores the first slot of the sector in the upper
+   24 bits and the number of slots in the lower 8 bits, or zero if the
+   sector isn't stored. Each stored sector starts with a record header
+   containing a checksum of the compressed payload. */
+#define STORE_MAGIC 0x524F534C
+#define STORE_RECORD_MAGIC 0x534F534C
+#define STORE_VERSION 1
+#define STORE_LINE 8
+#define STORE_SECTORS (STORE_LINE * STORE_LINE * STORE_LINE)
+#define STORE_SLOT 512
+#define STORE_GROW 256
+#define STORE_HEADER 64
+#define STORE_HEADER_SLOTS ((STORE_HEADER + 4 * STORE_SECTORS + STORE_SLOT - 1) / STORE_SLOT)
+#define STORE_RECORD 16
+
+static int private_allocate (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                count);
+
+static void private_discard (
+	LIExtRegion* region);
+
+static LIExtRegion* private_find_region (
+	LIExtTerrainStore* self,
+	int                sector,
+	int                create,
+	int*               local);
+
+static void private_free_region (
+	LIExtRegion* region);
+
+static uint32_t private_get_entry (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                local);
+
+static int private_pending (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region);
+
+static int private_region_key (
+	LIExtTerrainStore* self,
+	int                x,
+	int                y,
+	int                z);
+
+static void private_release (
+	LIExtRegion* region,
+	uint32_t     entry);
+
+static int private_remove_files (
+	LIExtTerrainStore* self);
+
+static int private_sync (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                offset,
+	int                length);
+
+/*****************************************************************************/
+
+/**
+ * \brief Opens a terrain store.
+ *
+ * The region files of the store are kept in the given directory, which is
+ * created if it doesn't exist. Region files are opened when a sector in
+ * them is first accessed and stay memory mapped until the store is freed.
+ *
+ * \param module Tiles module.
+ * \param path Path to the directory of the region files.
+ * \return Terrain store or NULL.
+ */
+LIExtTerrainStore* liext_terrain_store_new (
+	LIExtModule* module,
+	const char*  path)
+{
+	LIExtTerrainStore* self;
+
+	/* Allocate self. */
+	self = lisys_calloc (1, sizeof (LIExtTerrainStore));
+	if (self == NULL)
+		return NULL;
+	self->sync = 1;
+	self->module = module;
+	self->path = lisys_string_dup (path);
+	self->regions = lialg_u32dic_new ();
+	if (self->path == NULL || self->regions == NULL)
+	{
+		liext_terrain_store_free (self);
+		return NULL;
+	}
+
+	/* Create the directory. */
+	if (!lisys_filesystem_access (path, LISYS_ACCESS_EXISTS) &&
+	    !lisys_filesystem_makepath (path))
+	{
+		liext_terrain_store_free (self);
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * \brief Closes the terrain store.
+ *
+ * The writes of a batch that hasn't been committed are discarded.
+ *
+ * \param self Terrain store.
+ */
+void liext_terrain_store_free (
+	LIExtTerrainStore* self)
+{
+	LIAlgU32dicIter iter;
+
+	if (self->regions != NULL)
+	{
+		LIALG_U32DIC_FOREACH (iter, self->regions)
+			private_free_region (iter.value);
+		lialg_u32dic_free (self->regions);
+	}
+	lisys_free (self->path);
+	lisys_free (self);
+}
+
+/**
+ * \brief Begins a batch of writes.
+ *
+ * Until the batch is committed, saves and erases only change a pending
+ * copy of the index of the region. Loads see the pending state but the
+ * index in the files stays the same, so the caller can order the commit
+ * with other storage such as a database transaction. The records are
+ * written to free slots without syncing and synced all at once on commit.
+ *
+ * \param self Terrain store.
+ */
+void liext_terrain_store_begin (
+	LIExtTerrainStore* self)
+{
+	self->batch = 1;
+}
+
+/**
+ * \brief Commits the batch of writes.
+ *
+ * The records of the batch are synced to the disk first, after which the
+ * index entries are swapped and synced. Each region written by the batch
+ * is synced twice regardless of the number of sectors in it. The entries
+ * are single aligned words, so a crash during the commit leaves each
+ * sector either in its old or its new state.
+ *
+ * \param self Terrain store.
+ * \return Nonzero on success.
+ */
+int liext_terrain_store_commit (
+	LIExtTerrainStore* self)
+{
+	int i;
+	int ret = 1;
+	uint32_t old[STORE_SECTORS];
+	uint32_t* entries;
+	LIAlgU32dicIter iter;
+	LIExtRegion* region;
+
+	if (!self->batch)
+		return 1;
+
+	/* Sync the records. */
+	/* If the records of a region can't be synced, its part of the batch
+	   is discarded so that the index never refers to missing data. */
+	LIALG_U32DIC_FOREACH (iter, self->regions)
+	{
+		region = iter.value;
+		if (region->pending == NULL)
+			continue;
+		if (!private_sync (self, region, STORE_HEADER_SLOTS * STORE_SLOT,
+		    (region->slots - STORE_HEADER_SLOTS) * STORE_SLOT))
+		{
+			private_discard (region);
+			ret = 0;
+		}
+	}
+
+	/* Swap the index entries. */
+	/* The replaced slots are only released after the new index has
+	   reached the disk since the old one may still refer to them. */
+	LIALG_U32DIC_FOREACH (iter, self->regions)
+	{
+		region = iter.value;
+		if (region->pending == NULL)
+			continue;
+		entries = (uint32_t*)((char*) lisys_mmap_get_buffer (region->mmap) + STORE_HEADER);
+		memcpy (old, entries, sizeof (old));
+		memcpy (entries, region->pending, sizeof (old));
+		if (!private_sync (self, region, STORE_HEADER, sizeof (old)))
+		{
+			ret = 0;
+			continue;
+		}
+		for (i = 0 ; i < STORE_SECTORS ; i++)
+		{
+			if (old[i] != entries[i])
+				private_release (region, old[i]);
+		}
+	}
+
+	/* Delete the regions not written after erasing. */
+	if (self->erased && !private_remove_files (self))
+		ret = 0;
+
+	/* Finish the batch. */
+	LIALG_U32DIC_FOREACH (iter, self->regions)
+	{
+		region = iter.value;
+		lisys_free (region->pending);
+		region->pending = NULL;
+	}
+	self->batch = 0;
+	self->erased = 0;
+
+	return ret;
+}
+
+/**
+ * \brief Removes a sector from the store.
+ * \param self Terrain store.
+ * \param sector Sector index.
+ * \return Nonzero on success.
+ */
+int liext_terrain_store_erase (
+	LIExtTerrainStore* self,
+	int                sector)
+{
+	int local;
+	uint32_t old;
+	uint32_t* entries;
+	LIExtRegion* region;
+
+	region = private_find_region (self, sector, 0, &local);
+	if (region == NULL)
+		return 1;
+	entries = (uint32_t*)((char*) lisys_mmap_get_buffer (region->mmap) + STORE_HEADER);
+
+	/* Defer the erase until the batch is committed. */
+	if (self->batch)
+	{
+		if (!private_pending (self, region))
+			return 0;
+		old = region->pending[local];
+		region->pending[local] = 0;
+		if (old != entries[local])
+			private_release (region, old);
+		return 1;
+	}
+
+	old = entries[local];
+	if (!old)
+		return 1;
+	entries[local] = 0;
+	if (!private_sync (self, region, STORE_HEADER + 4 * local, 4))
+		return 0;
+	private_release (region, old);
+
+	return 1;
+}
+
+/**
+ * \brief Removes all sectors from the store.
+ *
+ * Inside a batch, the region files are deleted when the batch is committed.
+ *
+ * \param self Terrain store.
+ * \return Nonzero on success.
+ */
+int liext_terrain_store_erase_all (
+	LIExtTerrainStore* self)
+{
+	LIAlgU32dicIter iter;
+
+	/* Defer the erase until the batch is committed. */
+	/* The regions are treated as empty from now on and the files of the
+	   regions that the batch doesn't write to are deleted on commit. */
+	if (self->batch)
+	{
+		LIALG_U32DIC_FOREACH (iter, self->regions)
+			private_discard (iter.value);
+		self->erased = 1;
+		return 1;
+	}
+
+	/* Close the open regions. */
+	LIALG_U32DIC_FOREACH (iter, self->regions)
+		private_free_region (iter.value);
+	lialg_u32dic_clear (self->regions);
+
+	/* Delete the region files. */
+	return private_remove_files (self);
+}
+
+/**
+ * \brief Loads a sector from the store.
+ *
+ * The compressed payload is decompressed from the memory mapped file
+ * straight into the tiles of the sector, which is created if necessary.
+ * Payloads whose checksum doesn't match are treated as missing.
+ *
+ * \param self Terrain store.
+ * \param sector Sector index.
+ * \return Nonzero if the sector was stored and loaded.
+ */
+int liext_terrain_store_load (
+	LIExtTerrainStore* self,
+	int                sector)
+{
+	int ret;
+	int local;
+	int slot;
+	int count;
+	uint32_t entry;
+	uint32_t* record;
+	const char* buffer;
+	LIArcReader* reader;
+	LIExtRegion* region;
+	LIVoxSector* voxels;
+
+	/* Find the slots of the sector. */
+	region = private_find_region (self, sector, 0, &local);
+	if (region == NULL)
+	{
+		self->stats.misses++;
+		return 0;
+	}
+	buffer = lisys_mmap_get_buffer (region->mmap);
+	entry = private_get_entry (self, region, local);
+	if (!entry)
+	{
+		self->stats.misses++;
+		return 0;
+	}
+	slot = entry >> 8;
+	count = entry & 0xFF;
+
+	/* Validate the record. */
+	record = (uint32_t*)(buffer + slot * STORE_SLOT);
+	if (slot < STORE_HEADER_SLOTS || slot + count > region->slots ||
+	    record[0] != STORE_RECORD_MAGIC || record[1] != (uint32_t) sector ||
+	    record[2] > (uint32_t)(count * STORE_SLOT - STORE_RECORD) ||
+	    record[3] != crc32 (0, (const Bytef*) record + STORE_RECORD, record[2]))
+	{
+		lisys_error_set (EINVAL, "corrupt sector %d in terrain store", sector);
+		self->stats.corrupt++;
+		return 0;
+	}
+
+	/* Decompress directly into the sector. */
+	voxels = lialg_sectors_data_index (self->module->program->sectors, LIALG_SECTORS_CONTENT_VOXEL, sector, 1);
+	if (voxels == NULL)
+		return 0;
+	reader = liarc_reader_new ((const char*) record + STORE_RECORD, record[2]);
+	if (reader == NULL)
+		return 0;
+	ret = livox_sector_read_compressed (voxels, reader);
+	liarc_reader_free (reader);
+	if (!ret)
+	{
+		lisys_error_set (EINVAL, "corrupt sector %d in terrain store", sector);
+		self->stats.corrupt++;
+		return 0;
+	}
+	self->stats.reads++;
+
+	return 1;
+}
+
+/**
+ * \brief Saves a sector to the store.
+ *
+ * The sector is written to free slots and only then swapped in by
+ * replacing its index entry, so a crash during the write leaves the old
+ * version of the sector intact. If syncing is enabled, the payload is
+ * flushed to the disk before the index entry is updated and the entry
+ * before the function returns. Inside a batch, the entry is only updated
+ * when the batch is committed.
+ *
+ * \param self Terrain store.
+ * \param sector Sector index.
+ * \return Nonzero on success.
+ */
+int liext_terrain_store_save (
+	LIExtTerrainStore* self,
+	int                sector)
+{
+	int i;
+	int slot;
+	int local;
+	int count;
+	int length;
+	uint32_t old;
+	uint32_t* entries;
+	uint32_t* record;
+	char* buffer;
+	LIArcWriter* writer;
+	LIExtRegion* region;
+	LIVoxSector* voxels;
+
+	/* Compress the sector. */
+	voxels = lialg_sectors_data_index (self->module->program->sectors, LIALG_SECTORS_CONTENT_VOXEL, sector, 0);
+	if (voxels == NULL)
+		return 0;
+	writer = liarc_writer_new ();
+	if (writer == NULL)
+		return 0;
+	if (!livox_sector_write_compressed (voxels, writer))
+	{
+		liarc_writer_free (writer);
+		return 0;
+	}
+	length = liarc_writer_get_length (writer);
+	count = (STORE_RECORD + length + STORE_SLOT - 1) / STORE_SLOT;
+	if (count > 0xFF)
+	{
+		lisys_error_set (EINVAL, "sector %d too large for the terrain store", sector);
+		liarc_writer_free (writer);
+		return 0;
+	}
+
+	/* Write the record to free slots. */
+	region = private_find_region (self, sector, 1, &local);
+	if (region == NULL || (self->batch && !private_pending (self, region)))
+	{
+		liarc_writer_free (writer);
+		return 0;
+	}
+	slot = private_allocate (self, region, count);
+	if (!slot)
+	{
+		liarc_writer_free (writer);
+		return 0;
+	}
+	buffer = lisys_mmap_get_buffer (region->mmap);
+	record = (uint32_t*)(buffer + slot * STORE_SLOT);
+	record[0] = STORE_RECORD_MAGIC;
+	record[1] = sector;
+	record[2] = length;
+	record[3] = crc32 (0, (const Bytef*) liarc_writer_get_buffer (writer), length);
+	memcpy (buffer + slot * STORE_SLOT + STORE_RECORD, liarc_writer_get_buffer (writer), length);
+	liarc_writer_free (writer);
+	entries = (uint32_t*)(buffer + STORE_HEADER);
+
+	/* Defer the swap until the batch is committed. */
+	/* A record replaced within the same batch was never in the index on
+	   the disk so its slots can be reused right away. */
+	if (self->batch)
+	{
+		old = region->pending[local];
+		region->pending[local] = (slot << 8) | count;
+		if (old != entries[local])
+			private_release (region, old);
+		self->stats.writes++;
+		return 1;
+	}
+
+	/* Write the record. */
+	if (!private_sync (self, region, slot * STORE_SLOT, count * STORE_SLOT))
+	{
+		for (i = 0 ; i < count ; i++)
+			region->used[slot + i] = 0;
+		return 0;
+	}
+
+	/* Swap the index entry. */
+	/* The entry is a single aligned word so readers after a crash see
+	   either the old or the new slots. If the entry can't be synced,
+	   either of them may be on the disk so neither is released. */
+	old = entries[local];
+	entries[local] = (slot << 8) | count;
+	if (!private_sync (self, region, STORE_HEADER + 4 * local, 4))
+	{
+		entries[local] = old;
+		return 0;
+	}
+	if (old)
+		private_release (region, old);
+	self->stats.writes++;
+
+	return 1;
+}
+
+/**
+ * \brief Gets the total size of the open region files.
+ * \param self Terrain store.
+ * \return Size in bytes.
+ */
+int liext_terrain_store_get_size (
+	LIExtTerrainStore* self)
+{
+	int size = 0;
+	LIAlgU32dicIter iter;
+	LIExtRegion* region;
+
+	LIALG_U32DIC_FOREACH (iter, self->regions)
+	{
+		region = iter.value;
+		size += lisys_mmap_get_size (region->mmap);
+	}
+
+	return size;
+}
+
+/*****************************************************************************/
+
+static int private_allocate (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                count)
+{
+	int i;
+	int run = 0;
+	int slots;
+	uint8_t* used;
+
+	/* Find the first free run of slots. */
+	for (i = STORE_HEADER_SLOTS ; i < region->slots ; i++)
+	{
+		if (region->used[i])
+		{
+			run = 0;
+			continue;
+		}
+		if (++run == count)
+		{
+			memset (region->used + i - count + 1, 1, count);
+			return i - count + 1;
+		}
+	}
+
+	/* Append to the end of the file. */
+	/* Free slots at the end are reused by the appended run. */
+	slots = region->slots - run + count;
+	slots = (slots + STORE_GROW - 1) / STORE_GROW * STORE_GROW;
+	used = lisys_realloc (region->used, slots);
+	if (used == NULL)
+		return 0;
+	region->used = used;
+	if (!lisys_mmap_resize (region->mmap, slots * STORE_SLOT))
+		return 0;
+	memset (region->used + region->slots, 0, slots - region->slots);
+	i = region->slots - run;
+	region->slots = slots;
+	memset (region->used + i, 1, count);
+
+	return i;
+}
+
+static void private_discard (
+	LIExtRegion* region)
+{
+	int i;
+	uint32_t* entries;
+
+	if (region->pending == NULL)
+		return;
+	entries = (uint32_t*)((char*) lisys_mmap_get_buffer (region->mmap) + STORE_HEADER);
+	for (i = 0 ; i < STORE_SECTORS ; i++)
+	{
+		if (region->pending[i] != entries[i])
+			private_release (region, region->pending[i]);
+	}
+	lisys_free (region->pending);
+	region->pending = NULL;
+}
+
+static LIExtRegion* private_find_region (
+	LIExtTerrainStore* self,
+	int                sector,
+	int                create,
+	int*               local)
+{
+	int i;
+	int key;
+	int offset[3];
+	int slot;
+	int count;
+	char* path;
+	uint32_t* header;
+	LIExtRegion* region;
+	LIVoxManager* voxels;
+
+	/* Calculate the region and the index within it. */
+	voxels = self->module->voxels;
+	lialg_sectors_index_to_offset (self->module->program->sectors, sector, offset + 0, offset + 1, offset + 2);
+	key = private_region_key (self, offset[0] / STORE_LINE, offset[1] / STORE_LINE, offset[2] / STORE_LINE);
+	*local = offset[0] % STORE_LINE + (offset[1] % STORE_LINE) * STORE_LINE +
+		(offset[2] % STORE_LINE) * STORE_LINE * STORE_LINE;
+
+	/* Check for an open region. */
+	region = lialg_u32dic_find (self->regions, key);
+	if (region != NULL)
+		return region;
+
+	/* Format the path. */
+	path = lisys_string_format ("%s/%d-%d-%d.region", self->path,
+		offset[0] / STORE_LINE, offset[1] / STORE_LINE, offset[2] / STORE_LINE);
+	if (path == NULL)
+		return NULL;
+	if (!create && !lisys_filesystem_access (path, LISYS_ACCESS_EXISTS))
+	{
+		lisys_free (path);
+		return NULL;
+	}
+
+	/* Map the file. */
+	region = lisys_calloc (1, sizeof (LIExtRegion));
+	if (region == NULL)
+	{
+		lisys_free (path);
+		return NULL;
+	}
+	region->mmap = lisys_mmap_open_writable (path, STORE_HEADER_SLOTS * STORE_SLOT);
+	if (region->mmap == NULL)
+	{
+		lisys_free (region);
+		lisys_free (path);
+		return NULL;
+	}
+	region->slots = lisys_mmap_get_size (region->mmap) / STORE_SLOT;
+	header = lisys_mmap_get_buffer (region->mmap);
+
+	/* Initialize or validate the header. */
+	if (!header[0])
+	{
+		header[1] = STORE_VERSION;
+		header[2] = STORE_SLOT;
+		header[3] = STORE_LINE;
+		header[4] = voxels->tiles_per_line;
+		header[0] = STORE_MAGIC;
+		private_sync (self, region, 0, STORE_HEADER);
+	}
+	else if (header[0] != STORE_MAGIC || header[1] != STORE_VERSION ||
+	         header[2] != STORE_SLOT || header[3] != STORE_LINE ||
+	         header[4] != (uint32_t) voxels->tiles_per_line)
+	{
+		lisys_error_set (EINVAL, "incompatible terrain region `%s'", path);
+		private_free_region (region);
+		lisys_free (path);
+		return NULL;
+	}
+	lisys_free (path);
+
+	/* Find the used slots. */
+	/* Slots written after the last index update aren't referenced by the
+	   index and are reused automatically. */
+	region->used = lisys_calloc (region->slots, sizeof (uint8_t));
+	if (region->used == NULL)
+	{
+		private_free_region (region);
+		return NULL;
+	}
+	memset (region->used, 1, STORE_HEADER_SLOTS);
+	for (i = 0 ; i < STORE_SECTORS ; i++)
+	{
+		slot = header[STORE_HEADER / 4 + i] >> 8;
+		count = header[STORE_HEADER / 4 + i] & 0xFF;
+		if (slot >= STORE_HEADER_SLOTS && slot + count <= region->slots)
+			memset (region->used + slot, 1, count);
+	}
+
+	/* Add to the dictionary. */
+	if (!lialg_u32dic_insert (self->regions, key, region))
+	{
+		private_free_region (region);
+		return NULL;
+	}
+
+	return region;
+}
+
+static void private_free_region (
+	LIExtRegion* region)
+{
+	if (region->mmap != NULL)
+		lisys_mmap_free (region->mmap);
+	lisys_free (region->pending);
+	lisys_free (region->used);
+	lisys_free (region);
+}
+
+static uint32_t private_get_entry (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                local)
+{
+	if (region->pending != NULL)
+		return region->pending[local];
+	if (self->erased)
+		return 0;
+	return ((uint32_t*)((char*) lisys_mmap_get_buffer (region->mmap) + STORE_HEADER))[local];
+}
+
+static int private_pending (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region)
+{
+	if (region->pending != NULL)
+		return 1;
+	region->pending = lisys_calloc (STORE_SECTORS, sizeof (uint32_t));
+	if (region->pending == NULL)
+		return 0;
+	if (!self->erased)
+	{
+		memcpy (region->pending, (char*) lisys_mmap_get_buffer (region->mmap) + STORE_HEADER,
+			STORE_SECTORS * sizeof (uint32_t));
+	}
+
+	return 1;
+}
+
+static int private_region_key (
+	LIExtTerrainStore* self,
+	int                x,
+	int                y,
+	int                z)
+{
+	int lines;
+
+	lines = (self->module->program->sectors->count + STORE_LINE - 1) / STORE_LINE;
+
+	return x + y * lines + z * lines * lines;
+}
+
+static void private_release (
+	LIExtRegion* region,
+	uint32_t     entry)
+{
+	int slot;
+	int count;
+
+	slot = entry >> 8;
+	count = entry & 0xFF;
+	if (slot >= STORE_HEADER_SLOTS && slot + count <= region->slots)
+		memset (region->used + slot, 0, count);
+}
+
+static int private_remove_files (
+	LIExtTerrainStore* self)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	int key;
+	int ret = 1;
+	char* file;
+	const char* name;
+	LIExtRegion* region;
+	LISysDir* dir;
+
+	dir = lisys_dir_open (self->path);
+	if (dir == NULL)
+		return 0;
+	lisys_dir_set_filter (dir, lisys_dir_filter_files, NULL);
+	if (!lisys_dir_scan (dir))
+	{
+		lisys_dir_free (dir);
+		return 0;
+	}
+	for (i = 0 ; i < lisys_dir_get_count (dir) ; i++)
+	{
+		name = lisys_dir_get_name (dir, i);
+		if (!lisys_path_check_ext (name, "region"))
+			continue;
+
+		/* Keep the regions written by the current batch. */
+		if (sscanf (name, "%d-%d-%d.region", &x, &y, &z) == 3)
+		{
+			key = private_region_key (self, x, y, z);
+			region = lialg_u32dic_find (self->regions, key);
+			if (region != NULL)
+			{
+				if (region->pending != NULL)
+					continue;
+				private_free_region (region);
+				lialg_u32dic_remove (self->regions, key);
+			}
+		}
+
+		/* Delete the file. */
+		file = lisys_dir_get_path (dir, i);
+		if (file == NULL || remove (file) != 0)
+			ret = 0;
+		lisys_free (file);
+	}
+	lisys_dir_free (dir);
+
+	return ret;
+}
+
+static int private_sync (
+	LIExtTerrainStore* self,
+	LIExtRegion*       region,
+	int                offset,
+	int                length)
+{
+	if (!self->sync)
+		return 1;
+	self->stats.syncs++;
+	return lisys_mmap_sync (region->mmap, offset, length);
+}
+
+/** @} */
+/** @} */
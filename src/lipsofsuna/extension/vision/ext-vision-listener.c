@@ -123,7 +123,7 @@ void liext_vision_listener_update (
 				lialg_u32dic_remove (self->objects, object->id);
 				lua_pushnumber (lua, lua_objlen (lua, -1) + 1);
 				lua_newtable (lua);
-				if (liscr_pushdata (lua, object->script))
+				if (liscr_pushwrapper (lua, object->script))
 				{
 					lua_setfield (lua, -2, "object");
 					lua_pushstring (lua, "object-hidden");
@@ -151,7 +151,7 @@ void liext_vision_listener_update (
 				lialg_u32dic_insert (self->objects, object->id, NULL + 1);
 				lua_pushnumber (lua, lua_objlen (lua, -1) + 1);
 				lua_newtable (lua);
-				if (liscr_pushdata (lua, object->script))
+				if (liscr_pushwrapper (lua, object->script))
 				{
 					lua_setfield (lua, -2, "object");
 					lua_pushstring (lua, "object-shown");
@@ -171,7 +171,7 @@ void liext_vision_listener_update (
 				lialg_u32dic_remove (self->objects, object->id);
 				lua_pushnumber (lua, lua_objlen (lua, -1) + 1);
 				lua_newtable (lua);
-				if (liscr_pushdata (lua, object->script))
+				if (liscr_pushwrapper (lua, object->script))
 				{
 					lua_setfield (lua, -2, "object");
 					lua_pushstring (lua, "object-hidden");
@@ -24,6 +24,21 @@
 
 #include "main-message.h"
 
+static LIArcPacket* private_copy_packet (
+	const LIArcPacket* packet);
+
+static void private_free_data (
+	LIMaiMessage* self);
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new message with a copy of the data.
+ * \param type Message type.
+ * \param name Message name.
+ * \param data Message data to be copied.
+ * \return New message or NULL.
+ */
 LIMaiMessage* limai_message_new (
 	int         type,
 	const char* name,
@@ -31,43 +46,98 @@ LIMaiMessage* limai_message_new (
 {
 	LIMaiMessage* self;
 
+	/* Allocate the message. */
+	self = limai_message_new_move (type, name, NULL);
+	if (self == NULL)
+		return NULL;
+
+	/* Copy the data. */
+	switch (type)
+	{
+		case LIMAI_MESSAGE_TYPE_EMPTY:
+			break;
+		case LIMAI_MESSAGE_TYPE_MODEL:
+			self->model = limdl_model_new_copy (data);
+			if (self->model == NULL)
+			{
+				limai_message_free (self);
+				return NULL;
+			}
+			break;
+		case LIMAI_MESSAGE_TYPE_PACKET:
+			self->packet = private_copy_packet (data);
+			if (self->packet == NULL)
+			{
+				limai_message_free (self);
+				return NULL;
+			}
+			break;
+		case LIMAI_MESSAGE_TYPE_STRING:
+			self->string = lisys_string_dup (data);
+			if (self->string == NULL)
+			{
+				limai_message_free (self);
+				return NULL;
+			}
+			break;
+	}
+
+	return self;
+}
+
+/**
+ * \brief Creates a new message that takes ownership of the data.
+ *
+ * The data isn't copied, which makes passing large models and packets
+ * between threads cheap. Writable packets are turned into readable ones.
+ * If the function fails, the caller still owns the data.
+ *
+ * \param type Message type.
+ * \param name Message name.
+ * \param data Message data to be owned by the message, or NULL.
+ * \return New message or NULL.
+ */
+LIMaiMessage* limai_message_new_move (
+	int         type,
+	const char* name,
+	void*       data)
+{
+	LIMaiMessage* self;
+
 	self = lisys_calloc (1, sizeof (LIMaiMessage));
 	if (self == NULL)
-		return 0;
+		return NULL;
 	self->type = type;
 	self->name = lisys_string_dup (name);
 	if (self->name == NULL)
 	{
 		lisys_free (self);
-		return 0;
+		return NULL;
 	}
 	switch (type)
 	{
 		case LIMAI_MESSAGE_TYPE_EMPTY:
 			break;
 		case LIMAI_MESSAGE_TYPE_MODEL:
-			self->model = limdl_model_new_copy (data);
-			if (self->model == NULL)
+			self->model = data;
+			break;
+		case LIMAI_MESSAGE_TYPE_PACKET:
+			if (data != NULL && !liarc_packet_set_readable (data))
 			{
 				lisys_free (self->name);
 				lisys_free (self);
-				return 0;
+				return NULL;
 			}
+			self->packet = data;
 			break;
 		case LIMAI_MESSAGE_TYPE_STRING:
-			self->string = lisys_string_dup (data);
-			if (self->string == NULL)
-			{
-				lisys_free (self->name);
-				lisys_free (self);
-				return 0;
-			}
+			self->string = data;
 			break;
 		default:
 			lisys_free (self->name);
 			lisys_free (self);
 			lisys_assert (0);
-			return 0;
+			return NULL;
 	}
 
 	return self;
@@ -75,6 +145,123 @@ LIMaiMessage* limai_message_new (
 
 void limai_message_free (
 	LIMaiMessage* self)
+{
+	private_free_data (self);
+	lisys_free (self->name);
+	lisys_free (self);
+}
+
+/**
+ * \brief Removes the data from the message.
+ *
+ * This is used for giving moved data back to its original owner when the
+ * message couldn't be delivered.
+ *
+ * \param self Message.
+ * \return Data owned by the caller or NULL.
+ */
+void* limai_message_detach (
+	LIMaiMessage* self)
+{
+	void* data = NULL;
+
+	switch (self->type)
+	{
+		case LIMAI_MESSAGE_TYPE_MODEL:
+			data = self->model;
+			self->model = NULL;
+			break;
+		case LIMAI_MESSAGE_TYPE_PACKET:
+			data = self->packet;
+			self->packet = NULL;
+			break;
+		case LIMAI_MESSAGE_TYPE_STRING:
+			data = self->string;
+			self->string = NULL;
+			break;
+	}
+
+	return data;
+}
+
+/**
+ * \brief Pushes the message to the Lua stack as a table.
+ *
+ * Models and packets are moved from the message to the script without
+ * copying them.
+ *
+ * \param self Message.
+ * \param engine Engine that will own the model.
+ * \param script Script.
+ * \param lua Lua state.
+ * \return Nonzero on success.
+ */
+int limai_message_push_script (
+	LIMaiMessage* self,
+	LIEngEngine*  engine,
+	LIScrScript*  script,
+	lua_State*    lua)
+{
+	LIEngModel* model;
+	LIScrData* data;
+
+	lua_newtable (lua);
+	lua_pushstring (lua, self->name);
+	lua_setfield (lua, -2, "name");
+	switch (self->type)
+	{
+		case LIMAI_MESSAGE_TYPE_EMPTY:
+			lua_pushstring (lua, "empty");
+			lua_setfield (lua, -2, "type");
+			break;
+		case LIMAI_MESSAGE_TYPE_MODEL:
+			lua_pushstring (lua, "model");
+			lua_setfield (lua, -2, "type");
+			model = lieng_model_new_model (engine, self->model);
+			if (model != NULL)
+			{
+				self->model = NULL;
+				model->script = liscr_data_new (script, lua, model, LISCR_SCRIPT_MODEL, lieng_model_free);
+				if (model->script != NULL)
+					lua_setfield (lua, -2, "model");
+				else
+					lieng_model_free (model);
+			}
+			break;
+		case LIMAI_MESSAGE_TYPE_PACKET:
+			lua_pushstring (lua, "packet");
+			lua_setfield (lua, -2, "type");
+			data = liscr_data_new (script, lua, self->packet, LISCR_SCRIPT_PACKET, liarc_packet_free);
+			if (data != NULL)
+			{
+				self->packet = NULL;
+				lua_setfield (lua, -2, "packet");
+			}
+			break;
+		case LIMAI_MESSAGE_TYPE_STRING:
+			lua_pushstring (lua, "string");
+			lua_setfield (lua, -2, "type");
+			lua_pushstring (lua, self->string);
+			lua_setfield (lua, -2, "string");
+			break;
+	}
+
+	return 1;
+}
+
+/*****************************************************************************/
+
+static LIArcPacket* private_copy_packet (
+	const LIArcPacket* packet)
+{
+	if (packet->reader != NULL)
+		return liarc_packet_new_readable (packet->reader->buffer, packet->reader->length);
+	else
+		return liarc_packet_new_readable (liarc_writer_get_buffer (packet->writer), liarc_writer_get_length (packet->writer));
+}
+
+static void private_free_data (
+	LIMaiMessage* self)
 {
 	switch (self->type)
 	{
@@ -84,6 +271,10 @@ void limai_message_free (
 			if (self->model != NULL)
 				limdl_model_free (self->model);
 			break;
+		case LIMAI_MESSAGE_TYPE_PACKET:
+			if (self->packet != NULL)
+				liarc_packet_free (self->packet);
+			break;
 		case LIMAI_MESSAGE_TYPE_STRING:
 			lisys_free (self->string);
 			break;
@@ -91,8 +282,6 @@ void limai_message_free (
 			lisys_assert (0);
 			break;
 	}
-	lisys_free (self->name);
-	lisys_free (self);
 }
 
 /** @} */
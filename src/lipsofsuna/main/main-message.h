@@ -18,9 +18,15 @@
 #ifndef __MAIN_MESSAGE_H__
 #define __MAIN_MESSAGE_H__
 
+#include "lipsofsuna/archive.h"
+#include "lipsofsuna/engine.h"
 #include "lipsofsuna/model.h"
+#include "lipsofsuna/script.h"
 #include "lipsofsuna/system.h"
 
+#define LIMAI_MESSAGE_BATCH_MAX 256
+#define LIMAI_MESSAGE_QUEUE_SIZE 4096
+
 enum
 {
 	LIMAI_MESSAGE_QUEUE_PROGRAM,
@@ -32,6 +38,7 @@ enum
 {
 	LIMAI_MESSAGE_TYPE_EMPTY,
 	LIMAI_MESSAGE_TYPE_MODEL,
+	LIMAI_MESSAGE_TYPE_PACKET,
 	LIMAI_MESSAGE_TYPE_STRING
 };
 
@@ -40,11 +47,10 @@ struct _LIMaiMessage
 {
 	int type;
 	char* name;
-	LIMaiMessage* next;
-	LIMaiMessage* prev;
 	union
 	{
 		char* string;
+		LIArcPacket* packet;
 		LIMdlModel* model;
 	};
 };
@@ -54,7 +60,21 @@ LIAPICALL (LIMaiMessage*, limai_message_new, (
 	const char* name,
 	const void* data));
 
+LIAPICALL (LIMaiMessage*, limai_message_new_move, (
+	int         type,
+	const char* name,
+	void*       data));
+
 LIAPICALL (void, limai_message_free, (
 	LIMaiMessage* self));
 
+LIAPICALL (void*, limai_message_detach, (
+	LIMaiMessage* self));
+
+LIAPICALL (int, limai_message_push_script, (
+	LIMaiMessage* self,
+	LIEngEngine*  engine,
+	LIScrScript*  script,
+	lua_State*    lua));
+
 #endif
@@ -98,7 +98,6 @@ void limai_program_free (
 	LIMaiExtension* extension;
 	LIMaiExtension* extension_next;
 	LIMaiMessage* message;
-	LIMaiMessage* message_next;
 
 	/* Invoke callbacks. */
 	if (self->callbacks != NULL)
@@ -153,14 +152,13 @@ void limai_program_free (
 		lipth_paths_free (self->paths);
 
 	/* Free messaging. */
-	if (self->message_mutex != NULL)
-		lisys_mutex_free (self->message_mutex);
 	for (i = 0 ; i < LIMAI_MESSAGE_QUEUE_MAX ; i++)
 	{
-		for (message = self->messages[i] ; message != NULL ; message = message_next)
+		if (self->messages[i] != NULL)
 		{
-			message_next = message->next;
-			limai_message_free (message);
+			while ((message = lisys_channel_pop (self->messages[i])) != NULL)
+				limai_message_free (message);
+			lisys_channel_free (self->messages[i]);
 		}
 	}
 
@@ -170,6 +168,22 @@ void limai_program_free (
 	lisys_free (self);
 }
 
+/**
+ * \brief Executes the performance benchmarks of the engine.
+ *
+ * These are slow and print timings instead of asserting, so they are
+ * kept separate from the unit tests.
+ *
+ * \param self Program.
+ */
+void limai_program_benchmark (
+	LIMaiProgram* self)
+{
+	lisys_unittest ();
+	limdl_unittest (self->paths->global_data);
+	lieng_unittest ();
+}
+
 /**
  * \brief Emits an event.
  * \param self Program.
@@ -208,21 +222,8 @@ void limai_program_eventva (
 	LIScrData* data;
 	lua_State* lua = liscr_script_get_lua (self->script);
 
-	/* Get the event queue. */
-	lua_getglobal (lua, "__events");
-	if (lua_type (lua, -1) != LUA_TTABLE)
-	{
-		lua_pop (lua, 1);
-		lua_newtable (lua);
-		lua_pushvalue (lua, -1);
-		lua_setglobal (lua, "__events");
-	}
-	lua_pushnumber (lua, lua_objlen (lua, -1) + 1);
-
 	/* Create the event. */
 	lua_newtable (lua);
-	lua_pushstring (lua, type);
-	lua_setfield (lua, -2, "type");
 	while (1)
 	{
 		/* Get name. */
@@ -260,7 +261,7 @@ void limai_program_eventva (
 		}
 		else if (!strcmp (type_, LISCR_SCRIPT_VECTOR))
 		{
-			data = liscr_data_new_alloc (self->script, lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+			data = liscr_data_new_value (self->script, lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
 			if (data == NULL)
 				break;
 			pptr = va_arg (args, void*);
@@ -271,7 +272,7 @@ void limai_program_eventva (
 			pptr = va_arg (args, void*);
 			if (pptr == NULL)
 				break;
-			liscr_pushdata (lua, pptr);
+			liscr_pushwrapper (lua, pptr);
 		}
 
 		/* Set field. */
@@ -279,8 +280,41 @@ void limai_program_eventva (
 	}
 
 	/* Push to event queue. */
-	lua_settable (lua, -3);
-	lua_pop (lua, 1);
+	limai_program_event_table (self, type);
+}
+
+/**
+ * \brief Emits an event stored in a table.
+ *
+ * The event table must be at the top of the Lua stack. Its type field is
+ * set and it is popped from the stack and appended to the event queue.
+ *
+ * \param self Program.
+ * \param type Event type.
+ */
+void limai_program_event_table (
+	LIMaiProgram* self,
+	const char*   type)
+{
+	lua_State* lua = liscr_script_get_lua (self->script);
+
+	lua_pushstring (lua, type);
+	lua_setfield (lua, -2, "type");
+
+	/* Get the event queue. */
+	lua_getglobal (lua, "__events");
+	if (lua_type (lua, -1) != LUA_TTABLE)
+	{
+		lua_pop (lua, 1);
+		lua_newtable (lua);
+		lua_pushvalue (lua, -1);
+		lua_setglobal (lua, "__events");
+	}
+
+	/* Append the event. */
+	lua_pushvalue (lua, -2);
+	lua_rawseti (lua, -2, lua_objlen (lua, -2) + 1);
+	lua_pop (lua, 2);
 }
 
 /**
@@ -537,20 +571,27 @@ LIMaiMessage* limai_program_pop_message (
 	LIMaiProgram* self,
 	int           queue)
 {
-	LIMaiMessage* message;
-
-	/* Pop a message from the queue. */
-	lisys_mutex_lock (self->message_mutex);
-	message = self->messages[queue];
-	if (message != NULL)
-	{
-		if (message->next != NULL)
-			message->next->prev = NULL;
-		self->messages[queue] = message->next;
-	}
-	lisys_mutex_unlock (self->message_mutex);
+	return lisys_channel_pop (self->messages[queue]);
+}
 
-	return message;
+/**
+ * \brief Pops multiple messages from the message queue.
+ *
+ * This function is thread safe. The caller owns the returned messages.
+ *
+ * \param self Program.
+ * \param queue Message queue.
+ * \param result Return location for the messages.
+ * \param count Maximum number of messages to pop.
+ * \return Number of messages popped.
+ */
+int limai_program_pop_messages (
+	LIMaiProgram*  self,
+	int            queue,
+	LIMaiMessage** result,
+	int            count)
+{
+	return lisys_channel_pop_batch (self->messages[queue], (void**) result, count);
 }
 
 /**
@@ -558,6 +599,8 @@ LIMaiMessage* limai_program_pop_message (
  *
  * This function is thread safe. It's specifically intended for thread safe
  * communication between scripted programs running in different threads.
+ * The queue is bounded, so pushing fails if the receiver has fallen more
+ * than LIMAI_MESSAGE_QUEUE_SIZE messages behind.
  *
  * \param queue Message queue.
  * \param type Message type.
@@ -572,7 +615,6 @@ int limai_program_push_message (
 	const char*   name,
 	const void*   data)
 {
-	LIMaiMessage* ptr;
 	LIMaiMessage* message;
 
 	/* Create the message. */
@@ -581,21 +623,129 @@ int limai_program_push_message (
 		return 0;
 
 	/* Append it to the message queue. */
-	lisys_mutex_lock (self->message_mutex);
-	if (self->messages[queue] != NULL)
+	if (!lisys_channel_push (self->messages[queue], message))
 	{
-		for (ptr = self->messages[queue] ; ptr->next != NULL ; ptr = ptr->next)
-			{}
-		ptr->next = message;
-		message->prev = ptr;
+		limai_message_free (message);
+		return 0;
 	}
-	else
-		self->messages[queue] = message;
-	lisys_mutex_unlock (self->message_mutex);
 
 	return 1;
 }
 
+/**
+ * \brief Pushes a message to the message queue without copying the data.
+ *
+ * This function is thread safe. If the push succeeds, the ownership of the
+ * data is moved to the receiver. Otherwise, the caller still owns it.
+ *
+ * \param queue Message queue.
+ * \param type Message type.
+ * \param name Message name.
+ * \param data Message data to be moved.
+ * \return Nonzero on success.
+ */
+int limai_program_push_message_move (
+	LIMaiProgram* self,
+	int           queue,
+	int           type,
+	const char*   name,
+	void*         data)
+{
+	LIMaiMessage* message;
+
+	/* Create the message. */
+	message = limai_message_new_move (type, name, data);
+	if (message == NULL)
+		return 0;
+
+	/* Append it to the message queue. */
+	if (!lisys_channel_push (self->messages[queue], message))
+	{
+		limai_message_detach (message);
+		limai_message_free (message);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * \brief Pushes a message described by script arguments to the message queue.
+ *
+ * The message is read from the arguments in the form (name, data) or
+ * {name=string, string=string, model=Model, packet=Packet, move=boolean}.
+ * Strings are always copied. Models and packets are copied unless move is
+ * true, in which case their data is handed over to the receiving thread and
+ * the script side objects are left empty.
+ *
+ * \param self Program.
+ * \param queue Message queue.
+ * \param args Script arguments.
+ * \return Nonzero on success.
+ */
+int limai_program_push_message_script (
+	LIMaiProgram* self,
+	int           queue,
+	LIScrArgs*    args)
+{
+	int move = 0;
+	const char* name = "";
+	const char* string = NULL;
+	LIArcPacket* packet;
+	LIEngModel* emodel;
+	LIMdlModel* model;
+	LIScrData* data;
+
+	/* Read the name. */
+	if (!liscr_args_geti_string (args, 0, &name))
+		liscr_args_gets_string (args, "name", &name);
+	liscr_args_gets_bool (args, "move", &move);
+
+	/* Push a string. */
+	if (liscr_args_geti_string (args, 1, &string) ||
+	    liscr_args_gets_string (args, "string", &string))
+		return limai_program_push_message (self, queue, LIMAI_MESSAGE_TYPE_STRING, name, string);
+
+	/* Push a model. */
+	if (liscr_args_geti_data (args, 1, LISCR_SCRIPT_MODEL, &data) ||
+	    liscr_args_gets_data (args, "model", LISCR_SCRIPT_MODEL, &data))
+	{
+		emodel = liscr_data_get_data (data);
+		if (!move)
+			return limai_program_push_message (self, queue, LIMAI_MESSAGE_TYPE_MODEL, name, emodel->model);
+		model = lieng_model_detach (emodel);
+		if (model == NULL)
+			return limai_program_push_message (self, queue, LIMAI_MESSAGE_TYPE_MODEL, name, emodel->model);
+		if (limai_program_push_message_move (self, queue, LIMAI_MESSAGE_TYPE_MODEL, name, model))
+			return 1;
+		limdl_model_free (emodel->model);
+		emodel->model = model;
+		lieng_model_changed (emodel);
+		return 0;
+	}
+
+	/* Push a packet. */
+	if (liscr_args_geti_data (args, 1, LISCR_SCRIPT_PACKET, &data) ||
+	    liscr_args_gets_data (args, "packet", LISCR_SCRIPT_PACKET, &data))
+	{
+		if (!move)
+			return limai_program_push_message (self, queue, LIMAI_MESSAGE_TYPE_PACKET, name, liscr_data_get_data (data));
+		packet = liarc_packet_new_writable (0);
+		if (packet == NULL)
+			return 0;
+		if (!limai_program_push_message_move (self, queue, LIMAI_MESSAGE_TYPE_PACKET, name, liscr_data_get_data (data)))
+		{
+			liarc_packet_free (packet);
+			return 0;
+		}
+		liscr_data_set_data (data, packet);
+		return 1;
+	}
+
+	/* Push an empty message. */
+	return limai_program_push_message (self, queue, LIMAI_MESSAGE_TYPE_EMPTY, name, NULL);
+}
+
 /**
  * \brief Unregisters a component.
  *
@@ -665,11 +815,13 @@ int limai_program_update (
 	   else is working on them and generating events. */
 	liscr_script_set_gc (self->script, 0);
 	lialg_sectors_update (self->sectors, secs);
-	liscr_script_update (self->script, secs);
 	lieng_engine_update (self->engine, secs);
 	lical_callbacks_call (self->callbacks, "tick", lical_marshal_DATA_FLT, secs);
 	liscr_script_set_gc (self->script, 1);
 
+	/* Collect garbage within the time budget of the tick. */
+	liscr_script_update (self->script, secs);
+
 	/* Sleep until end of frame. */
 	if (self->sleep > (int)(1000000 * secs))
 		lisys_usleep (self->sleep - (int)(1000000 * secs));
@@ -708,6 +860,8 @@ static int private_init (
 	const char*   name,
 	const char*   args)
 {
+	int i;
+
 	/* Initialize paths. */
 	self->paths = lipth_paths_new (path, name);
 	if (self->paths == NULL)
@@ -738,6 +892,7 @@ static int private_init (
 	self->script = liscr_script_new ();
 	if (self->script == NULL)
 		return 0;
+	liscr_script_set_cache (self->script, self->paths->module_cache);
 
 	/* Initialize timer. */
 	gettimeofday (&self->start, NULL);
@@ -745,9 +900,12 @@ static int private_init (
 	self->curr_tick = self->start;
 
 	/* Initialize messaging. */
-	self->message_mutex = lisys_mutex_new ();
-	if (self->message_mutex == NULL)
-		return 0;
+	for (i = 0 ; i < LIMAI_MESSAGE_QUEUE_MAX ; i++)
+	{
+		self->messages[i] = lisys_channel_new (LIMAI_MESSAGE_QUEUE_SIZE);
+		if (self->messages[i] == NULL)
+			return 0;
+	}
 
 	/* Register classes. */
 	liscr_script_set_userdata (self->script, LISCR_SCRIPT_PROGRAM, self);
@@ -51,11 +51,10 @@ struct _LIMaiProgram
 	LICalHandle calls[4];
 	LIEngEngine* engine;
 	LIMaiExtension* extensions;
-	LIMaiMessage* messages[LIMAI_MESSAGE_QUEUE_MAX];
 	LIMaiProgram* parent;
 	LIPthPaths* paths;
 	LIScrScript* script;
-	LISysMutex* message_mutex;
+	LISysChannel* messages[LIMAI_MESSAGE_QUEUE_MAX];
 };
 
 LIAPICALL (LIMaiProgram*, limai_program_new, (
@@ -66,6 +65,9 @@ LIAPICALL (LIMaiProgram*, limai_program_new, (
 LIAPICALL (void, limai_program_free, (
 	LIMaiProgram* self));
 
+LIAPICALL (void, limai_program_benchmark, (
+	LIMaiProgram* self));
+
 LIAPICALL (void, limai_program_event, (
 	LIMaiProgram* self,
 	const char*   type,
@@ -76,6 +78,10 @@ LIAPICALL (void, limai_program_eventva, (
 	const char*   type,
 	va_list       args));
 
+LIAPICALL (void, limai_program_event_table, (
+	LIMaiProgram* self,
+	const char*   type));
+
 LIAPICALL (int, limai_program_execute_script, (
 	LIMaiProgram* self,
 	const char*   file));
@@ -105,6 +111,12 @@ LIAPICALL (LIMaiMessage*, limai_program_pop_message, (
 	LIMaiProgram* self,
 	int           queue));
 
+LIAPICALL (int, limai_program_pop_messages, (
+	LIMaiProgram*  self,
+	int            queue,
+	LIMaiMessage** result,
+	int            count));
+
 LIAPICALL (int, limai_program_push_message, (
 	LIMaiProgram* self,
 	int           queue,
@@ -112,6 +124,18 @@ LIAPICALL (int, limai_program_push_message, (
 	const char*   name,
 	const void*   data));
 
+LIAPICALL (int, limai_program_push_message_move, (
+	LIMaiProgram* self,
+	int           queue,
+	int           type,
+	const char*   name,
+	void*         data));
+
+LIAPICALL (int, limai_program_push_message_script, (
+	LIMaiProgram* self,
+	int           queue,
+	LIScrArgs*    args));
+
 LIAPICALL (void, limai_program_remove_component, (
 	LIMaiProgram* self,
 	const char*   name));
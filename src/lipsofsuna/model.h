@@ -31,6 +31,7 @@
 #include "model/model-shape.h"
 #include "model/model-shape-key.h"
 #include "model/model-texture.h"
+#include "model/model-unittest.h"
 #include "model/model-vertex.h"
 
 #endif
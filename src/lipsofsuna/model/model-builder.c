@@ -53,6 +53,23 @@ static int private_realloc_array (
 	int    required,
 	size_t size);
 
+static int private_weld_find (
+	LIMdlBuilder*      self,
+	const LIMdlVertex* vertex,
+	uint32_t           hash);
+
+static uint32_t private_weld_hash (
+	const LIMdlVertex* vertex);
+
+static void private_weld_insert (
+	LIMdlBuilder* self,
+	int           index,
+	uint32_t      hash);
+
+static int private_weld_reserve (
+	LIMdlBuilder* self,
+	int           count);
+
 /*****************************************************************************/
 
 /**
@@ -126,8 +143,7 @@ void limdl_builder_free (
 {
 	int j;
 
-	if (self->vertex_lookup)
-		lialg_memdic_free (self->vertex_lookup);
+	lisys_free (self->vertex_lookup.array);
 	for (j = 0 ; j < self->lod.count ; j++)
 		private_lod_clear (self->lod.array + j);
 	lisys_free (self->lod.array);
@@ -168,6 +184,10 @@ int limdl_builder_add_detail_levels (
 
 /**
  * \brief Finds the index of a matching vertex.
+ *
+ * Vertices are matched by their rounded attributes using a hash table that
+ * is updated incrementally as vertices are added to the model.
+ *
  * \param self Model builder.
  * \param vertex Matched vertex.
  * \return Vertex index or -1.
@@ -176,36 +196,17 @@ int limdl_builder_find_vertex (
 	LIMdlBuilder*      self,
 	const LIMdlVertex* vertex)
 {
-	int i;
-	void* ptr;
 	LIMdlVertex tmp;
 
-	/* Create the vertex lookup table. */
-	if (self->vertex_lookup == NULL)
-	{
-		self->vertex_lookup = lialg_memdic_new ();
-		if (self->vertex_lookup == NULL)
-			return -1;
-	}
-
 	/* Update the vertex lookup table. */
-	for (i = self->vertex_lookup_count ; i < self->model->vertices.count ; i++)
-	{
-		ptr = (void*)(intptr_t)(i + 1);
-		tmp = self->model->vertices.array[i];
-		limdl_vertex_round (&tmp);
-		lialg_memdic_insert (self->vertex_lookup, &tmp, sizeof (LIMdlVertex), ptr);
-	}
-	self->vertex_lookup_count = self->model->vertices.count;
+	if (!private_weld_reserve (self, 0))
+		return -1;
 
 	/* Find the vertex. */
 	tmp = *vertex;
 	limdl_vertex_round (&tmp);
-	ptr = lialg_memdic_find (self->vertex_lookup, &tmp, sizeof (LIMdlVertex));
-	if (ptr == NULL)
-		return -1;
 
-	return ((int)(intptr_t) ptr) - 1;
+	return private_weld_find (self, &tmp, private_weld_hash (&tmp));
 }
 
 /**
@@ -355,28 +356,22 @@ int limdl_builder_insert_face_welded (
 	int                material,
 	const LIMdlVertex* vertices)
 {
-	int i;
-	int index;
+	int count;
+	int welded[3];
 	LIMdlIndex indices[3];
 
 	/* Insert vertices. */
-	for (i = 0 ; i < 3 ; i++)
-	{
-		index = limdl_builder_find_vertex (self, vertices + i);
-		if (index == -1)
-		{
-			if (!limdl_builder_insert_vertices (self, vertices + i, 1, NULL))
-				return 0;
-			indices[i] = self->model->vertices.count - 1;
-		}
-		else
-			indices[i] = index;
-	}
+	count = self->model->vertices.count;
+	if (!limdl_builder_insert_vertices_welded (self, vertices, 3, welded))
+		return 0;
+	indices[0] = welded[0];
+	indices[1] = welded[1];
+	indices[2] = welded[2];
 
 	/* Insert indices. */
 	if (!limdl_builder_insert_indices (self, level, material, indices, 3, 0))
 	{
-		self->model->vertices.count -= 3;
+		self->model->vertices.count = count;
 		return 0;
 	}
 
@@ -545,6 +540,60 @@ int limdl_builder_insert_vertices (
 	return 1;
 }
 
+/**
+ * \brief Inserts vertices to the model while trying to weld them.
+ *
+ * Each vertex is merged with an existing vertex with matching rounded
+ * attributes, or appended to the model if no such vertex exists. The
+ * vertices in the array are also welded with each other.
+ *
+ * \param self Model builder.
+ * \param vertices Array of vertices.
+ * \param count Number of vertices.
+ * \param result Array of count indices to receive the vertex indices.
+ * \return Nonzero on success.
+ */
+int limdl_builder_insert_vertices_welded (
+	LIMdlBuilder*      self,
+	const LIMdlVertex* vertices,
+	int                count,
+	int*               result)
+{
+	int i;
+	int index;
+	int orig;
+	uint32_t hash;
+	LIMdlVertex tmp;
+
+	/* Allocate space for the worst case. */
+	orig = self->model->vertices.count;
+	if (!private_realloc_array (&self->model->vertices.array,
+	    &self->vertex_capacity, orig + count, sizeof (LIMdlVertex)))
+		return 0;
+	if (!private_weld_reserve (self, count))
+		return 0;
+
+	/* Weld or append the vertices. */
+	for (i = 0 ; i < count ; i++)
+	{
+		tmp = vertices[i];
+		limdl_vertex_round (&tmp);
+		hash = private_weld_hash (&tmp);
+		index = private_weld_find (self, &tmp, hash);
+		if (index == -1)
+		{
+			index = self->model->vertices.count;
+			self->model->vertices.array[index] = vertices[i];
+			self->model->vertices.count++;
+			private_weld_insert (self, index, hash);
+			self->vertex_lookup_count = self->model->vertices.count;
+		}
+		result[i] = index;
+	}
+
+	return 1;
+}
+
 /**
  * \brief Inserts a weight group to the model.
  * \param self Model builder.
@@ -726,5 +775,128 @@ static int private_realloc_array (
 	return 1;
 }
 
+static int private_weld_find (
+	LIMdlBuilder*      self,
+	const LIMdlVertex* vertex,
+	uint32_t           hash)
+{
+	int i;
+	int mask;
+	LIMdlBuilderWeld* weld;
+	LIMdlVertex tmp;
+
+	if (!self->vertex_lookup.capacity)
+		return -1;
+
+	/* Linear probing until an empty slot is found. The stored vertices are
+	   rounded again only for the rare slots whose full hash matches. */
+	mask = self->vertex_lookup.capacity - 1;
+	for (i = hash & mask ; ; i = (i + 1) & mask)
+	{
+		weld = self->vertex_lookup.array + i;
+		if (!weld->index)
+			return -1;
+		if (weld->hash != hash)
+			continue;
+		tmp = self->model->vertices.array[weld->index - 1];
+		limdl_vertex_round (&tmp);
+		if (!limdl_vertex_compare (&tmp, vertex))
+			return weld->index - 1;
+	}
+}
+
+static uint32_t private_weld_hash (
+	const LIMdlVertex* vertex)
+{
+	int i;
+	uint32_t hash;
+	uint32_t words[sizeof (LIMdlVertex) / 4];
+
+	/* The vertex has no padding and its size is a multiple of four so the
+	   rounded attributes can be hashed as words. */
+	memcpy (words, vertex, sizeof (words));
+	hash = 2166136261u;
+	for (i = 0 ; i < (int)(sizeof (words) / 4) ; i++)
+	{
+		hash ^= words[i];
+		hash *= 16777619u;
+		hash ^= hash >> 15;
+	}
+
+	return hash;
+}
+
+static void private_weld_insert (
+	LIMdlBuilder* self,
+	int           index,
+	uint32_t      hash)
+{
+	int i;
+	int mask;
+	LIMdlBuilderWeld* weld;
+
+	mask = self->vertex_lookup.capacity - 1;
+	for (i = hash & mask ; ; i = (i + 1) & mask)
+	{
+		weld = self->vertex_lookup.array + i;
+		if (!weld->index)
+			break;
+	}
+	weld->hash = hash;
+	weld->index = index + 1;
+	self->vertex_lookup.count++;
+}
+
+static int private_weld_reserve (
+	LIMdlBuilder* self,
+	int           count)
+{
+	int i;
+	int capacity;
+	int required;
+	uint32_t hash;
+	LIMdlBuilderWeld* tmp;
+	LIMdlVertex vertex;
+
+	/* Rebuild the table if vertices were removed behind our back. */
+	if (self->vertex_lookup_count > self->model->vertices.count)
+	{
+		memset (self->vertex_lookup.array, 0, self->vertex_lookup.capacity * sizeof (LIMdlBuilderWeld));
+		self->vertex_lookup.count = 0;
+		self->vertex_lookup_count = 0;
+	}
+
+	/* Keep the load factor below one half. */
+	required = 2 * (self->model->vertices.count + count);
+	if (self->vertex_lookup.capacity < required)
+	{
+		capacity = (self->vertex_lookup.capacity > 64)? self->vertex_lookup.capacity : 64;
+		while (capacity < required)
+			capacity <<= 1;
+		tmp = lisys_calloc (capacity, sizeof (LIMdlBuilderWeld));
+		if (tmp == NULL)
+			return 0;
+		lisys_free (self->vertex_lookup.array);
+		self->vertex_lookup.array = tmp;
+		self->vertex_lookup.capacity = capacity;
+		self->vertex_lookup.count = 0;
+		self->vertex_lookup_count = 0;
+	}
+
+	/* Add the vertices not yet in the table. The first matching vertex must
+	   win so duplicates already in the model are skipped. */
+	for (i = self->vertex_lookup_count ; i < self->model->vertices.count ; i++)
+	{
+		vertex = self->model->vertices.array[i];
+		limdl_vertex_round (&vertex);
+		hash = private_weld_hash (&vertex);
+		if (private_weld_find (self, &vertex, hash) == -1)
+			private_weld_insert (self, i, hash);
+	}
+	self->vertex_lookup_count = self->model->vertices.count;
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -45,6 +45,13 @@ struct _LIMdlBuilderLod
 	} face_groups;
 };
 
+typedef struct _LIMdlBuilderWeld LIMdlBuilderWeld;
+struct _LIMdlBuilderWeld
+{
+	uint32_t hash;
+	int index;
+};
+
 typedef struct _LIMdlBuilder LIMdlBuilder;
 struct _LIMdlBuilder
 {
@@ -52,9 +59,14 @@ struct _LIMdlBuilder
 	int weightgroup_capacity;
 	int vertex_capacity;
 	int vertex_lookup_count;
-	LIAlgMemdic* vertex_lookup;
 	LIMdlModel* model;
 	struct
+	{
+		int count;
+		int capacity;
+		LIMdlBuilderWeld* array;
+	} vertex_lookup;
+	struct
 	{
 		int count;
 		int capacity;
@@ -119,6 +131,12 @@ LIAPICALL (int, limdl_builder_insert_vertices, (
 	int                count,
 	const int*         bone_mapping));
 
+LIAPICALL (int, limdl_builder_insert_vertices_welded, (
+	LIMdlBuilder*      self,
+	const LIMdlVertex* vertices,
+	int                count,
+	int*               result));
+
 LIAPICALL (int, limdl_builder_insert_weightgroup, (
 	LIMdlBuilder* self,
 	const char*   name,
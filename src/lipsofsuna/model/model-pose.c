@@ -36,6 +36,9 @@ static void private_clear_node (
 static void private_clear_pose (
 	LIMdlPose* self);
 
+static int private_copy_nodes (
+	LIMdlPose* self);
+
 static LIMdlPoseChannel* private_create_channel (
 	LIMdlPose* self,
 	int        channel);
@@ -51,6 +54,12 @@ static LIMdlPoseChannel* private_find_channel (
 	const LIMdlPose* self,
 	int              channel);
 
+static void private_free_nodes (
+	LIMdlPose* self);
+
+static int private_get_node_memory (
+	const LIMdlNode* node);
+
 static int private_init_pose (
 	LIMdlPose*  self,
 	LIMdlModel* model);
@@ -60,6 +69,9 @@ static int private_play_channel (
 	LIMdlPoseChannel* channel,
 	float             secs);
 
+static void private_rebind_groups (
+	LIMdlPose* self);
+
 static void private_transform_node (
 	LIMdlPose* self,
 	LIMdlNode* node);
@@ -205,13 +217,10 @@ void limdl_pose_fade_channel (
 	fade->time_fade = 0.0f;
 	fade->current_weight_transform = fade->priority_transform;
 	fade->current_weight_scale = fade->priority_scale;
-	fade->animation = limdl_animation_new_copy (chan->animation);
-	if (fade->animation == NULL)
-	{
-		limdl_pose_destroy_channel (self, channel);
-		lisys_free (fade);
-		return;
-	}
+	fade->animation = chan->animation;
+	fade->animation_owned = chan->animation_owned;
+	chan->animation = NULL;
+	chan->animation_owned = 0;
 
 	/* Link to fade list. */
 	fade->prev = NULL;
@@ -241,6 +250,10 @@ LIMdlNode* limdl_pose_find_node (
 	if (self->model == NULL)
 		return NULL;
 
+	/* Poses at rest use the nodes of the model. */
+	if (self->nodes.array == NULL)
+		return limdl_model_find_node (self->model, name);
+
 	for (i = 0 ; i < self->nodes.count ; i++)
 	{
 		node = self->nodes.array[i];
@@ -316,6 +329,21 @@ void limdl_pose_update (
 		}
 	}
 
+	/* Store the nodes only while they differ from the rest pose. */
+	/* Without channels or fades, every node would end up in its rest
+	   transformation, so the pose uses the nodes of the model instead of
+	   keeping identical copies of them. */
+	if (self->channels->size || self->fades != NULL)
+	{
+		if (self->nodes.array == NULL && private_copy_nodes (self))
+			private_rebind_groups (self);
+	}
+	else if (self->nodes.array != NULL)
+	{
+		private_free_nodes (self);
+		private_rebind_groups (self);
+	}
+
 	/* Clear each node. */
 	for (i = 0 ; i < self->nodes.count ; i++)
 	{
@@ -408,22 +436,21 @@ void limdl_pose_set_channel_animation (
 		limdl_pose_destroy_channel (self, channel);
 		return;
 	}
-	anim = limdl_animation_new_copy (anim);
-	if (anim == NULL)
-		return;
 
 	/* Create a channel. */
 	chan = private_create_channel (self, channel);
 	if (chan == NULL)
-	{
-		limdl_animation_free (anim);
 		return;
-	}
 	chan->time = 0.0f;
 	chan->fade_in = 0.0f;
 	chan->fade_out = 0.0f;
-	limdl_animation_free (chan->animation);
+
+	/* Reference the animation of the model. The frames are shared with the
+	   model and copied only if the channel is modified. */
+	if (chan->animation_owned)
+		limdl_animation_free (chan->animation);
 	chan->animation = anim;
+	chan->animation_owned = 0;
 }
 
 int limdl_pose_get_channel_repeat_start (
@@ -775,6 +802,7 @@ int limdl_pose_set_channel_transform (
 	float                 scale,
 	const LIMatTransform* transform)
 {
+	LIMdlAnimation* anim;
 	LIMdlNode* node_;
 	LIMdlPoseChannel* chan;
 
@@ -788,6 +816,16 @@ int limdl_pose_set_channel_transform (
 	if (chan == NULL)
 		return 0;
 
+	/* Copy the animation if it's still shared with the model. */
+	if (!chan->animation_owned)
+	{
+		anim = limdl_animation_new_copy (chan->animation);
+		if (anim == NULL)
+			return 0;
+		chan->animation = anim;
+		chan->animation_owned = 1;
+	}
+
 	/* Make sure the channel and the frame exist. */
 	if (!limdl_animation_insert_channel (chan->animation, node))
 		return 0;
@@ -803,6 +841,46 @@ int limdl_pose_set_channel_transform (
 	return 1;
 }
 
+/**
+ * \brief Gets the approximate memory used by the pose.
+ *
+ * Animations referenced from the model aren't included since they're
+ * shared. Only channels whose animations have been modified own their
+ * frames.
+ *
+ * \param self Model pose.
+ * \return Memory used, in bytes.
+ */
+int limdl_pose_get_memory (
+	const LIMdlPose* self)
+{
+	int i;
+	int total;
+	LIAlgU32dicIter iter;
+	LIMdlPoseChannel* chan;
+	LIMdlPoseFade* fade;
+
+	total = sizeof (LIMdlPose);
+	LIALG_U32DIC_FOREACH (iter, self->channels)
+	{
+		chan = iter.value;
+		total += sizeof (LIMdlPoseChannel);
+		if (chan->animation_owned)
+			total += sizeof (LIMdlAnimation) + chan->animation->buffer.count * sizeof (LIMdlFrame);
+	}
+	for (fade = self->fades ; fade != NULL ; fade = fade->next)
+	{
+		total += sizeof (LIMdlPoseFade);
+		if (fade->animation_owned)
+			total += sizeof (LIMdlAnimation) + fade->animation->buffer.count * sizeof (LIMdlFrame);
+	}
+	for (i = 0 ; i < self->nodes.count ; i++)
+		total += sizeof (LIMdlNode*) + private_get_node_memory (self->nodes.array[i]);
+	total += self->groups.count * sizeof (LIMdlPoseGroup);
+
+	return total;
+}
+
 /**
  * \brief Sets the posed model.
  *
@@ -849,17 +927,15 @@ int limdl_pose_set_model (
 	{
 		chan = iter.value;
 		if (model != NULL)
-		{
 			anim = limdl_model_find_animation (model, chan->animation->name);
-			if (anim != NULL)
-				anim = limdl_animation_new_copy (anim);
-		}
 		else
 			anim = NULL;
 		if (anim != NULL)
 		{
-			limdl_animation_free (chan->animation);
+			if (chan->animation_owned)
+				limdl_animation_free (chan->animation);
 			chan->animation = anim;
+			chan->animation_owned = 0;
 		}
 		else
 		{
@@ -883,6 +959,8 @@ int limdl_pose_set_model (
 			private_fade_remove (self, fade);
 			private_fade_free (fade);
 		}
+		else if (!fade->animation_owned)
+			fade->animation = anim;
 	}
 
 	/* Clear old data. */
@@ -901,7 +979,8 @@ static void private_channel_free (
 {
 	LIAlgStrdicIter iter;
 
-	limdl_animation_free (chan->animation);
+	if (chan->animation_owned)
+		limdl_animation_free (chan->animation);
 	if (chan->weights)
 	{
 		LIALG_STRDIC_FOREACH (iter, chan->weights)
@@ -932,7 +1011,6 @@ static void private_clear_node (
 static void private_clear_pose (
 	LIMdlPose* self)
 {
-	int i;
 	LIAlgU32dicIter iter;
 	LIMdlPoseFade* fade;
 	LIMdlPoseFade* fade_next;
@@ -953,25 +1031,42 @@ static void private_clear_pose (
 		lialg_u32dic_clear (self->channels);
 	}
 
-	/* Free nodes. */
-	if (self->nodes.array != NULL)
+	private_free_nodes (self);
+	lisys_free (self->groups.array);
+}
+
+static int private_copy_nodes (
+	LIMdlPose* self)
+{
+	int i;
+	LIMdlNode** nodes;
+
+	if (!self->model->nodes.count)
+		return 0;
+	nodes = lisys_calloc (self->model->nodes.count, sizeof (LIMdlNode*));
+	if (nodes == NULL)
+		return 0;
+	for (i = 0 ; i < self->model->nodes.count ; i++)
 	{
-		for (i = 0 ; i < self->nodes.count ; i++)
+		nodes[i] = limdl_node_copy (self->model->nodes.array[i]);
+		if (nodes[i] == NULL)
 		{
-			if (self->nodes.array[i] != NULL)
-				limdl_node_free (self->nodes.array[i]);
+			while (i--)
+				limdl_node_free (nodes[i]);
+			lisys_free (nodes);
+			return 0;
 		}
-		lisys_free (self->nodes.array);
 	}
+	self->nodes.count = self->model->nodes.count;
+	self->nodes.array = nodes;
 
-	lisys_free (self->groups.array);
+	return 1;
 }
 
 static LIMdlPoseChannel* private_create_channel (
 	LIMdlPose* self,
 	int        channel)
 {
-	LIMdlAnimation* anim;
 	LIMdlPoseChannel* chan;
 
 	/* Check for an existing channel. */
@@ -979,20 +1074,13 @@ static LIMdlPoseChannel* private_create_channel (
 	if (chan != NULL)
 		return chan;
 
-	/* Create an empty animation. */
-	anim = limdl_animation_new_copy (&private_empty_anim);
-	if (anim == NULL)
-		return 0;
-
 	/* Create a new channel. */
+	/* The empty animation is shared until the channel is modified. */
 	chan = lisys_calloc (1, sizeof (LIMdlPoseChannel));
 	if (chan == NULL)
-	{
-		limdl_animation_free (anim);
 		return 0;
-	}
 	chan->state = LIMDL_POSE_CHANNEL_STATE_PLAYING;
-	chan->animation = anim;
+	chan->animation = &private_empty_anim;
 	chan->priority_scale = 0.0f;
 	chan->priority_transform = 1.0f;
 	chan->time_scale = 1.0f;
@@ -1000,7 +1088,6 @@ static LIMdlPoseChannel* private_create_channel (
 	/* Register the channel. */
 	if (!lialg_u32dic_insert (self->channels, channel, chan))
 	{
-		limdl_animation_free (chan->animation);
 		lisys_free (chan);
 		return 0;
 	}
@@ -1011,7 +1098,8 @@ static LIMdlPoseChannel* private_create_channel (
 static void private_fade_free (
 	LIMdlPoseFade* fade)
 {
-	limdl_animation_free (fade->animation);
+	if (fade->animation_owned)
+		limdl_animation_free (fade->animation);
 	lisys_free (fade);
 }
 
@@ -1034,6 +1122,36 @@ static LIMdlPoseChannel* private_find_channel (
 	return lialg_u32dic_find (self->channels, channel);
 }
 
+static void private_free_nodes (
+	LIMdlPose* self)
+{
+	int i;
+
+	if (self->nodes.array == NULL)
+		return;
+	for (i = 0 ; i < self->nodes.count ; i++)
+	{
+		if (self->nodes.array[i] != NULL)
+			limdl_node_free (self->nodes.array[i]);
+	}
+	lisys_free (self->nodes.array);
+	self->nodes.count = 0;
+	self->nodes.array = NULL;
+}
+
+static int private_get_node_memory (
+	const LIMdlNode* node)
+{
+	int i;
+	int total;
+
+	total = sizeof (LIMdlNode) + node->nodes.count * sizeof (LIMdlNode*);
+	for (i = 0 ; i < node->nodes.count ; i++)
+		total += private_get_node_memory (node->nodes.array[i]);
+
+	return total;
+}
+
 static int private_init_pose (
 	LIMdlPose*  self,
 	LIMdlModel* model)
@@ -1043,23 +1161,10 @@ static int private_init_pose (
 	LIMdlWeightGroup* weight_group;
 
 	/* Set model. */
+	/* The nodes are copied by the first update that has animations to
+	   apply. Until then, the pose is at rest and uses the model nodes. */
 	self->model = model;
 	self->groups.count = model->weight_groups.count;
-	self->nodes.count = model->nodes.count;
-
-	/* Copy nodes. */
-	if (self->nodes.count)
-	{
-		self->nodes.array = lisys_calloc (self->nodes.count, sizeof (LIMdlNode*));
-		if (self->nodes.array == NULL)
-			return 0;
-		for (i = 0 ; i < self->nodes.count ; i++)
-		{
-			self->nodes.array[i] = limdl_node_copy (model->nodes.array[i]);
-			if (self->nodes.array[i] == NULL)
-				return 0;
-		}
-	}
 
 	/* Precalculate weight group information. */
 	if (self->groups.count)
@@ -1131,6 +1236,20 @@ static int private_play_channel (
 	return 1;
 }
 
+static void private_rebind_groups (
+	LIMdlPose* self)
+{
+	int i;
+	LIMdlPoseGroup* group;
+
+	for (i = 0 ; i < self->groups.count ; i++)
+	{
+		group = self->groups.array + i;
+		group->pose_node = limdl_pose_find_node (self, group->weight_group->bone);
+		group->enabled = (group->rest_node != NULL && group->pose_node != NULL);
+	}
+}
+
 static void private_transform_node (
 	LIMdlPose* self,
 	LIMdlNode* node)
@@ -49,6 +49,7 @@ struct _LIMdlPoseChannel
 	float fade_out;
 	LIAlgStrdic* weights;
 	LIMdlAnimation* animation;
+	int animation_owned;
 };
 
 struct _LIMdlPoseFade
@@ -63,6 +64,7 @@ struct _LIMdlPoseFade
 	LIMdlPoseFade* prev;
 	LIMdlPoseFade* next;
 	LIMdlAnimation* animation;
+	int animation_owned;
 };
 
 typedef struct _LIMdlPoseGroup LIMdlPoseGroup;
@@ -95,6 +97,7 @@ struct _LIMdlPose
 		int count;
 		LIMdlPoseGroup* array;
 	} groups;
+	/* Posed copies of the model nodes, or NULL while the pose is at rest. */
 	struct
 	{
 		int count;
@@ -254,6 +257,9 @@ LIAPICALL (int, limdl_pose_set_channel_transform, (
 	float                 scale,
 	const LIMatTransform* transform));
 
+LIAPICALL (int, limdl_pose_get_memory, (
+	const LIMdlPose* self));
+
 LIAPICALL (int, limdl_pose_set_model, (
 	LIMdlPose*  self,
 	LIMdlModel* model));
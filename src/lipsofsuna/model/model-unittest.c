@@ -0,0 +1,446 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LIMdl Model
+ * @{
+ * \addtogroup LIMdlUnittest Unittest
+ * @{
+ */
+
+#include <sys/time.h>
+#include "model.h"
+#include "model-builder.h"
+#include "model-pose.h"
+#include "model-unittest.h"
+
+#define BENCHMARK_LOADS 20
+#define BENCHMARK_OBJECTS 100
+#define BENCHMARK_WELD_SIZE 409
+
+static double private_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
+static int private_compare (
+	const LIMdlModel* model0,
+	const LIMdlModel* model1)
+{
+	int i;
+	const LIMdlLod* lod0;
+	const LIMdlLod* lod1;
+
+	if (model0->vertices.count != model1->vertices.count ||
+	    model0->lod.count != model1->lod.count ||
+	    model0->animations.count != model1->animations.count ||
+	    model0->weight_groups.count != model1->weight_groups.count)
+		return 0;
+	for (i = 0 ; i < model0->vertices.count ; i++)
+	{
+		if (memcmp (model0->vertices.array[i].bones, model1->vertices.array[i].bones, sizeof (model0->vertices.array[i].bones)) ||
+		    limat_vector_get_length (limat_vector_subtract (model0->vertices.array[i].coord, model1->vertices.array[i].coord)) > 0.001f)
+			return 0;
+	}
+	for (i = 0 ; i < model0->lod.count ; i++)
+	{
+		lod0 = model0->lod.array + i;
+		lod1 = model1->lod.array + i;
+		if (lod0->indices.count != lod1->indices.count ||
+		    lod0->face_groups.count != lod1->face_groups.count ||
+		    memcmp (lod0->indices.array, lod1->indices.array, lod0->indices.count * sizeof (LIMdlIndex)))
+			return 0;
+	}
+	for (i = 0 ; i < model0->animations.count ; i++)
+	{
+		if (model0->animations.array[i].buffer.count != model1->animations.array[i].buffer.count ||
+		    memcmp (model0->animations.array[i].buffer.array, model1->animations.array[i].buffer.array,
+		            model0->animations.array[i].buffer.count * sizeof (LIMdlFrame)))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void private_benchmark_load (
+	const char* path,
+	double*     total)
+{
+	int i;
+	double t0;
+	double t1;
+	double t2;
+	LIArcReader* file;
+	LIArcReader* reader;
+	LIArcWriter* writer;
+	LIMdlModel* model;
+	LIMdlModel* baked;
+
+	/* Convert the model to the baked format. */
+	model = limdl_model_new_from_file (path, 1);
+	if (model == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+	writer = liarc_writer_new ();
+	if (writer == NULL || !limdl_model_write_baked (model, writer))
+	{
+		printf ("%s: FAILED to bake!\n", path);
+		if (writer != NULL)
+			liarc_writer_free (writer);
+		limdl_model_free (model);
+		return;
+	}
+
+	/* Time loading the portable format. */
+	/* Both formats are loaded from memory so that file access doesn't
+	   skew the comparison. */
+	file = liarc_reader_new_from_file (path);
+	if (file == NULL)
+	{
+		lisys_error_report ();
+		liarc_writer_free (writer);
+		limdl_model_free (model);
+		return;
+	}
+	t0 = private_time ();
+	for (i = 0 ; i < BENCHMARK_LOADS ; i++)
+	{
+		reader = liarc_reader_new (file->buffer, file->length);
+		if (reader == NULL)
+			break;
+		baked = limdl_model_new_from_data (reader, 1);
+		liarc_reader_free (reader);
+		if (baked != NULL)
+			limdl_model_free (baked);
+	}
+	t1 = private_time ();
+	liarc_reader_free (file);
+
+	/* Time loading the baked format. */
+	baked = NULL;
+	for (i = 0 ; i < BENCHMARK_LOADS ; i++)
+	{
+		if (baked != NULL)
+			limdl_model_free (baked);
+		reader = liarc_reader_new (liarc_writer_get_buffer (writer), liarc_writer_get_length (writer));
+		if (reader == NULL)
+			break;
+		baked = limdl_model_new_from_data (reader, 1);
+		liarc_reader_free (reader);
+		if (baked == NULL)
+			break;
+	}
+	t2 = private_time ();
+
+	/* Check that the contents survived baking. */
+	if (baked == NULL)
+	{
+		printf ("%s: FAILED to load baked!\n", path);
+		lisys_error_report ();
+	}
+	else
+	{
+		if (!private_compare (model, baked))
+			printf ("%s: FAILED! Baked model differs.\n", path);
+		printf ("%s: %d vertices, %.3f ms portable, %.3f ms baked\n", path,
+			model->vertices.count, 1000.0 * (t1 - t0) / BENCHMARK_LOADS,
+			1000.0 * (t2 - t1) / BENCHMARK_LOADS);
+		total[0] += (t1 - t0) / BENCHMARK_LOADS;
+		total[1] += (t2 - t1) / BENCHMARK_LOADS;
+		limdl_model_free (baked);
+	}
+	liarc_writer_free (writer);
+	limdl_model_free (model);
+}
+
+static int private_benchmark_objects (
+	LIMdlModel* model,
+	int         shared,
+	int         animated)
+{
+	int i;
+	int total = 0;
+	LIMdlModel* models[BENCHMARK_OBJECTS];
+	LIMdlPose* poses[BENCHMARK_OBJECTS];
+
+	/* Create the objects. */
+	/* Animated objects play the first animation of the model like a typical
+	   creature would. The rest stay in the rest pose like furniture does. */
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+	{
+		if (shared)
+			models[i] = limdl_model_ref (model);
+		else
+			models[i] = limdl_model_new_copy (model);
+		poses[i] = limdl_pose_new ();
+		if (models[i] != NULL && poses[i] != NULL)
+		{
+			limdl_pose_set_model (poses[i], models[i]);
+			if (animated && model->animations.count)
+				limdl_pose_set_channel_animation (poses[i], 0, model->animations.array[0].name);
+			limdl_pose_update (poses[i], 0.0f);
+		}
+	}
+
+	/* Measure the memory used by the objects. */
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+	{
+		if (models[i] != NULL)
+			total += limdl_model_get_memory (models[i]);
+		if (poses[i] != NULL)
+			total += limdl_pose_get_memory (poses[i]);
+	}
+
+	/* Free the objects. */
+	for (i = 0 ; i < BENCHMARK_OBJECTS ; i++)
+	{
+		if (poses[i] != NULL)
+			limdl_pose_free (poses[i]);
+		if (models[i] != NULL)
+			limdl_model_free (models[i]);
+	}
+
+	return total / BENCHMARK_OBJECTS;
+}
+
+static void private_benchmark_share (
+	const char* path,
+	double*     total)
+{
+	int copied;
+	int shared;
+	int rest;
+	int memory;
+	LIMdlModel* model;
+	LIMdlNode* node;
+	LIMdlNode* light = NULL;
+	LIMdlNodeIter iter;
+	LIMdlPose* pose;
+
+	model = limdl_model_new_from_file (path, 1);
+	if (model == NULL)
+	{
+		lisys_error_report ();
+		return;
+	}
+	copied = private_benchmark_objects (model, 0, 1);
+	shared = private_benchmark_objects (model, 1, 1);
+	rest = private_benchmark_objects (model, 1, 0);
+	printf ("%s: %d bytes copied, %d bytes shared, %d bytes at rest per object\n", path, copied, shared, rest);
+	total[0] += copied;
+	total[1] += shared;
+	total[2] += rest;
+
+	/* Find a light node, or any named node, to look up like the renderer. */
+	LIMDL_FOREACH_NODE (iter, &model->nodes)
+	{
+		node = iter.value;
+		if (node->name != NULL && (light == NULL || node->type == LIMDL_NODE_LIGHT))
+			light = node;
+	}
+
+	/* Check that the nodes are released when the animation ends. */
+	/* The renderer looks up the light nodes by name on each update so the
+	   lookups must resolve to the model at rest and to the copies while
+	   animated. */
+	pose = limdl_pose_new ();
+	if (pose != NULL && model->animations.count && model->nodes.count)
+	{
+		limdl_pose_set_model (pose, model);
+		memory = limdl_pose_get_memory (pose);
+		if (light != NULL && limdl_pose_find_node (pose, light->name) != light)
+			printf ("%s: FAILED! Node of a pose at rest not found.\n", path);
+		limdl_pose_set_channel_animation (pose, 0, model->animations.array[0].name);
+		limdl_pose_update (pose, 0.0f);
+		if (pose->nodes.array == NULL || limdl_pose_get_memory (pose) <= memory)
+			printf ("%s: FAILED! Animated pose has no nodes.\n", path);
+		node = (light != NULL)? limdl_pose_find_node (pose, light->name) : NULL;
+		if (light != NULL && (node == NULL || node == light))
+			printf ("%s: FAILED! Node of an animated pose not found.\n", path);
+		limdl_pose_destroy_channel (pose, 0);
+		limdl_pose_update (pose, 0.0f);
+		if (pose->nodes.array != NULL || limdl_pose_get_memory (pose) != memory)
+			printf ("%s: FAILED! Pose at rest kept its nodes.\n", path);
+		if (light != NULL && limdl_pose_find_node (pose, light->name) != light)
+			printf ("%s: FAILED! Node of a pose returned to rest not found.\n", path);
+	}
+	if (pose != NULL)
+		limdl_pose_free (pose);
+	limdl_model_free (model);
+}
+
+static void private_benchmark_dir (
+	const char* path,
+	double*     total)
+{
+	int i;
+	char* file;
+	LISysDir* dir;
+	LISysStat st;
+
+	dir = lisys_dir_open (path);
+	if (dir == NULL)
+		return;
+	lisys_dir_set_filter (dir, lisys_dir_filter_visible, NULL);
+	lisys_dir_set_sorter (dir, lisys_dir_sorter_alpha);
+	if (lisys_dir_scan (dir))
+	{
+		for (i = 0 ; i < lisys_dir_get_count (dir) ; i++)
+		{
+			file = lisys_dir_get_path (dir, i);
+			if (file == NULL)
+				continue;
+			if (lisys_filesystem_stat (file, &st))
+			{
+				if (st.type == LISYS_STAT_DIRECTORY)
+					private_benchmark_dir (file, total);
+				else if (lisys_path_check_ext (file, "lmdl"))
+				{
+					private_benchmark_load (file, total);
+					private_benchmark_share (file, total + 2);
+				}
+			}
+			lisys_free (file);
+		}
+	}
+	lisys_dir_free (dir);
+}
+
+static void private_benchmark_weld ()
+{
+	int i;
+	int x;
+	int y;
+	int count;
+	int unique;
+	int* indices;
+	double t0;
+	double t1;
+	double t2;
+	void* ptr;
+	LIAlgMemdic* dic;
+	LIMatVector coord;
+	LIMatVector normal = { 0.0f, 1.0f, 0.0f };
+	LIMdlBuilder* builder;
+	LIMdlModel* model;
+	LIMdlVertex tmp;
+	LIMdlVertex* vertices;
+
+	/* Create a triangulated grid where most corners are shared. */
+	count = 6 * BENCHMARK_WELD_SIZE * BENCHMARK_WELD_SIZE;
+	vertices = lisys_calloc (count, sizeof (LIMdlVertex));
+	indices = lisys_calloc (count, sizeof (int));
+	if (vertices == NULL || indices == NULL)
+	{
+		lisys_free (vertices);
+		lisys_free (indices);
+		return;
+	}
+	for (i = y = 0 ; y < BENCHMARK_WELD_SIZE ; y++)
+	{
+		for (x = 0 ; x < BENCHMARK_WELD_SIZE ; x++)
+		{
+#define CORNER(a,b) \
+	coord = limat_vector_init ((x + a) * 0.5f, 0.0f, (y + b) * 0.5f); \
+	limdl_vertex_init (vertices + i++, &coord, &normal, (x + a) * 0.5f, (y + b) * 0.5f);
+			CORNER (0, 0) CORNER (1, 0) CORNER (1, 1)
+			CORNER (0, 0) CORNER (1, 1) CORNER (0, 1)
+#undef CORNER
+		}
+	}
+
+	/* Time the welding with the hash table of the builder. */
+	t0 = private_time ();
+	model = limdl_model_new ();
+	builder = (model != NULL)? limdl_builder_new (model) : NULL;
+	if (builder == NULL || !limdl_builder_insert_vertices_welded (builder, vertices, count, indices))
+	{
+		printf ("Welding: FAILED!\n");
+		if (builder != NULL)
+			limdl_builder_free (builder);
+		if (model != NULL)
+			limdl_model_free (model);
+		lisys_free (vertices);
+		lisys_free (indices);
+		return;
+	}
+	t1 = private_time ();
+	unique = model->vertices.count;
+	limdl_builder_free (builder);
+	limdl_model_free (model);
+
+	/* Time the same with a binary tree for reference. */
+	dic = lialg_memdic_new ();
+	if (dic != NULL)
+	{
+		for (i = x = y = 0 ; i < count ; i++)
+		{
+			tmp = vertices[i];
+			limdl_vertex_round (&tmp);
+			ptr = lialg_memdic_find (dic, &tmp, sizeof (LIMdlVertex));
+			if (ptr == NULL)
+				lialg_memdic_insert (dic, &tmp, sizeof (LIMdlVertex), (void*)(intptr_t)(++x));
+			else if (indices[i] != (int)(intptr_t) ptr - 1)
+				y++;
+		}
+		lialg_memdic_free (dic);
+		if (x != unique || y)
+			printf ("Welding: FAILED! %d vertices welded differently.\n", y + abs (x - unique));
+	}
+	t2 = private_time ();
+
+	printf ("Welding: %d vertices into %d, %.3f ms hashed, %.3f ms tree\n",
+		count, unique, 1000.0 * (t1 - t0), 1000.0 * (t2 - t1));
+	lisys_free (vertices);
+	lisys_free (indices);
+}
+
+/*****************************************************************************/
+
+/**
+ * \brief Runs the model unit tests and benchmarks.
+ *
+ * Every model found in the data directory is converted to the baked format
+ * and loaded repeatedly in both formats to compare the load times. The
+ * memory used by objects sharing the model is also compared to that of
+ * objects using private copies of it and to objects in the rest pose. Lastly, a grid of about a million
+ * vertices is welded to benchmark the vertex lookup of the model builder.
+ *
+ * \param path Data directory.
+ */
+void limdl_unittest (
+	const char* path)
+{
+	double total[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	printf ("Benchmarking model loading.\n");
+	private_benchmark_dir (path, total);
+	printf ("Total: %.3f ms portable, %.3f ms baked\n",
+		1000.0 * total[0], 1000.0 * total[1]);
+	printf ("Total: %.0f bytes copied, %.0f bytes shared, %.0f bytes at rest per object\n",
+		total[2], total[3], total[4]);
+	printf ("Benchmarking vertex welding.\n");
+	private_benchmark_weld ();
+}
+
+/** @} */
+/** @} */
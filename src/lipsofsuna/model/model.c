@@ -29,7 +29,8 @@
 typedef int (*LIMdlWriteFunc)(const LIMdlModel*, LIArcWriter*);
 
 static void private_build (
-	LIMdlModel* self);
+	LIMdlModel* self,
+	int         tangents);
 
 static void private_build_tangents (
 	LIMdlModel* self);
@@ -37,12 +38,40 @@ static void private_build_tangents (
 static int private_read (
 	LIMdlModel*  self,
 	LIArcReader* reader,
-	int          mesh);
+	int          mesh,
+	int*         baked);
 
 static int private_read_animations (
 	LIMdlModel*  self,
 	LIArcReader* reader);
 
+static int private_read_baked (
+	LIMdlModel*  self,
+	LIArcReader* reader);
+
+static int private_read_baked_animations (
+	LIMdlModel*  self,
+	LIArcReader* reader);
+
+static int private_read_baked_array (
+	LIArcReader* reader,
+	int          start,
+	int          count,
+	int          size,
+	void**       result);
+
+static int private_read_baked_lod (
+	LIMdlModel*  self,
+	LIArcReader* reader);
+
+static int private_read_baked_vertices (
+	LIMdlModel*  self,
+	LIArcReader* reader);
+
+static int private_read_baked_weights (
+	LIMdlModel*  self,
+	LIArcReader* reader);
+
 static int private_read_bounds (
 	LIMdlModel*  self,
 	LIArcReader* reader);
@@ -96,12 +125,47 @@ static int private_write (
 	const LIMdlModel* self,
 	LIArcWriter*      writer);
 
+static int private_write_baked (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
+static int private_write_baked_animations (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
+static int private_write_baked_array (
+	LIArcWriter* writer,
+	const void*  data,
+	int          size);
+
+static int private_write_baked_header (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
+static int private_write_baked_lod (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
+static int private_write_baked_vertices (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
+static int private_write_baked_weights (
+	const LIMdlModel* self,
+	LIArcWriter*      writer);
+
 static int private_write_block (
 	const LIMdlModel* self,
 	const char*       name,
 	LIMdlWriteFunc    func,
 	LIArcWriter*      writer);
 
+static int private_write_block_aligned (
+	const LIMdlModel* self,
+	const char*       name,
+	LIMdlWriteFunc    func,
+	LIArcWriter*      writer);
+
 static int private_write_animations (
 	const LIMdlModel* self,
 	LIArcWriter*      writer);
@@ -284,6 +348,7 @@ LIMdlModel* limdl_model_new_from_data (
 	LIArcReader* reader,
 	int          mesh)
 {
+	int baked;
 	LIMdlModel* self;
 
 	/* Allocate self. */
@@ -295,7 +360,7 @@ LIMdlModel* limdl_model_new_from_data (
 	}
 
 	/* Read from stream. */
-	if (!private_read (self, reader, mesh))
+	if (!private_read (self, reader, mesh, &baked))
 	{
 		lisys_error_append ("cannot load model");
 		limdl_model_free (self);
@@ -303,7 +368,7 @@ LIMdlModel* limdl_model_new_from_data (
 	}
 
 	/* Construct the rest pose. */
-	private_build (self);
+	private_build (self, !baked);
 	return self;
 }
 
@@ -317,6 +382,7 @@ LIMdlModel* limdl_model_new_from_file (
 	const char* path,
 	int         mesh)
 {
+	int baked;
 	LIArcReader* reader;
 	LIMdlModel* self;
 
@@ -334,12 +400,12 @@ LIMdlModel* limdl_model_new_from_file (
 		goto error;
 
 	/* Read from stream. */
-	if (!private_read (self, reader, mesh))
+	if (!private_read (self, reader, mesh, &baked))
 		goto error;
 	liarc_reader_free (reader);
 
 	/* Construct the rest pose. */
-	private_build (self);
+	private_build (self, !baked);
 
 	return self;
 
@@ -353,6 +419,10 @@ error:
 
 /**
  * \brief Frees the model.
+ *
+ * If the model is shared, only the reference is released and the model
+ * data is freed when the last owner releases it.
+ *
  * \param self Model.
  */
 void limdl_model_free (
@@ -361,6 +431,13 @@ void limdl_model_free (
 	int i;
 	LIMdlMaterial* material;
 
+	/* Release shared references. */
+	if (self->refs > 0)
+	{
+		self->refs--;
+		return;
+	}
+
 	/* Free materials. */
 	if (self->materials.array != NULL)
 	{
@@ -869,6 +946,27 @@ int limdl_model_morph (
 	return 1;
 }
 
+/**
+ * \brief Adds a reference to the model.
+ *
+ * The returned model is the same instance that must be released with
+ * limdl_model_free. The data is shared by all the owners so it must not
+ * be modified while limdl_model_get_shared returns nonzero. Callers that
+ * want to modify a shared model must create a private copy of it first.
+ *
+ * The reference count is not atomic so the owners must all live in the
+ * same thread. Models passed between threads must still be copied.
+ *
+ * \param self Model.
+ * \return Model.
+ */
+LIMdlModel* limdl_model_ref (
+	LIMdlModel* self)
+{
+	self->refs++;
+	return self;
+}
+
 int limdl_model_write (
 	const LIMdlModel* self,
 	LIArcWriter*      writer)
@@ -899,8 +997,74 @@ int limdl_model_write_file (
 	return 1;
 }
 
+/**
+ * \brief Writes the model in the baked format.
+ *
+ * The baked format stores the vertex, index and keyframe arrays in the
+ * native memory layout of the engine, aligned so that the loader can copy
+ * each of them with a single memcpy instead of decoding them field by
+ * field. Baked files are only loadable by builds with the same byte order
+ * and structure layout, so they are meant to be generated by the content
+ * pipeline from the portable format.
+ *
+ * \param self Model.
+ * \param writer Writer.
+ * \return Nonzero on success.
+ */
+int limdl_model_write_baked (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	int ret;
+	LIArcWriter* data;
+
+	/* The alignment padding depends on the absolute offset of each
+	   block so the model is always built in memory first. */
+	data = liarc_writer_new ();
+	if (data == NULL)
+		return 0;
+	ret = private_write_baked (self, data);
+	if (ret)
+	{
+		ret = liarc_writer_append_raw (writer, liarc_writer_get_buffer (data),
+			liarc_writer_get_length (data));
+	}
+	liarc_writer_free (data);
+
+	return ret;
+}
+
+/**
+ * \brief Writes the model to a file in the baked format.
+ * \param self Model.
+ * \param path Path to the file.
+ * \return Nonzero on success.
+ */
+int limdl_model_write_file_baked (
+	const LIMdlModel* self,
+	const char*       path)
+{
+	LIArcWriter* writer;
+
+	writer = liarc_writer_new_file (path);
+	if (writer == NULL)
+		return 0;
+	if (!limdl_model_write_baked (self, writer))
+	{
+		liarc_writer_free (writer);
+		return 0;
+	}
+	liarc_writer_free (writer);
+
+	return 1;
+}
+
 /**
  * \brief Gets the approximate memory used by the model.
+ *
+ * The memory of a shared model is divided evenly between its owners so
+ * that summing the values over all the models gives the real total.
+ *
  * \param self Model.
  * \return Memory used, in bytes.
  */
@@ -913,7 +1077,10 @@ int limdl_model_get_memory (
 	/* TODO: Many of these have memory allocations of their own, */
 	total = sizeof (LIMdlModel);
 	for (i = 0 ; i < self->animations.count ; i++)
+	{
 		total += sizeof (LIMdlAnimation);
+		total += self->animations.array[i].buffer.count * sizeof (LIMdlFrame);
+	}
 	for (i = 0 ; i < self->hairs.count ; i++)
 		total += sizeof (LIMdlHairs);
 	for (i = 0 ; i < self->lod.count ; i++)
@@ -937,13 +1104,25 @@ int limdl_model_get_memory (
 	for (i = 0 ; i < self->weight_groups.count ; i++)
 		total += sizeof (LIMdlWeightGroup);
 
-	return total;
+	return total / (self->refs + 1);
+}
+
+/**
+ * \brief Checks if the model data is shared by multiple owners.
+ * \param self Model.
+ * \return Nonzero if shared.
+ */
+int limdl_model_get_shared (
+	const LIMdlModel* self)
+{
+	return self->refs > 0;
 }
 
 /*****************************************************************************/
 
 static void private_build (
-	LIMdlModel* self)
+	LIMdlModel* self,
+	int         tangents)
 {
 	int i;
 	LIMdlNode* node;
@@ -963,8 +1142,9 @@ static void private_build (
 		limdl_node_rebuild (node, 1);
 	}
 
-	/* Calculate vertex tangents. */
-	private_build_tangents (self);
+	/* Calculate vertex tangents. Baked models store them. */
+	if (tangents)
+		private_build_tangents (self);
 }
 
 static void private_build_tangents (
@@ -1015,7 +1195,8 @@ static void private_build_tangents (
 static int private_read (
 	LIMdlModel*  self,
 	LIArcReader* reader,
-	int          mesh)
+	int          mesh,
+	int*         baked)
 {
 	int i;
 	int j;
@@ -1026,6 +1207,8 @@ static int private_read (
 	uint32_t version;
 	LIMdlLod* lod;
 
+	*baked = 0;
+
 	/* Read magic. */
 	if (!liarc_reader_check_text (reader, "lips/mdl", ""))
 	{
@@ -1097,6 +1280,16 @@ static int private_read (
 			ret = private_read_particles (self, reader);
 		else if (!strcmp (id, "sha"))
 			ret = private_read_shapes (self, reader);
+		else if (mesh && !strcmp (id, "bak"))
+			ret = *baked = private_read_baked (self, reader);
+		else if (mesh && *baked && !strcmp (id, "bve"))
+			ret = private_read_baked_vertices (self, reader);
+		else if (mesh && *baked && !strcmp (id, "bwe"))
+			ret = private_read_baked_weights (self, reader);
+		else if (mesh && *baked && !strcmp (id, "blo"))
+			ret = private_read_baked_lod (self, reader);
+		else if (mesh && *baked && !strcmp (id, "ban"))
+			ret = private_read_baked_animations (self, reader);
 		else
 		{
 			if (!liarc_reader_skip_bytes (reader, size))
@@ -1190,6 +1383,226 @@ static int private_read_animations (
 	return 1;
 }
 
+static int private_read_baked (
+	LIMdlModel*  self,
+	LIArcReader* reader)
+{
+	uint32_t tmp[5];
+	uint32_t order = 0x01020304;
+
+	/* Check that the layout matches that of this build. */
+	if (!liarc_reader_get_uint32 (reader, tmp + 0) ||
+	    !liarc_reader_check_data (reader, &order, 4) ||
+	    !liarc_reader_get_uint32 (reader, tmp + 2) ||
+	    !liarc_reader_get_uint32 (reader, tmp + 3) ||
+	    !liarc_reader_get_uint32 (reader, tmp + 4))
+	{
+		lisys_error_set (LISYS_ERROR_VERSION, "baked model byte order mismatch");
+		return 0;
+	}
+	if (tmp[0] != LIMDL_BAKED_VERSION)
+	{
+		lisys_error_set (LISYS_ERROR_VERSION, "baked model version mismatch");
+		return 0;
+	}
+	if (tmp[2] != sizeof (LIMdlVertex) ||
+	    tmp[3] != sizeof (LIMdlIndex) ||
+	    tmp[4] != sizeof (LIMdlFrame))
+	{
+		lisys_error_set (LISYS_ERROR_VERSION, "baked model layout mismatch");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int private_read_baked_animations (
+	LIMdlModel*  self,
+	LIArcReader* reader)
+{
+	int i;
+	int j;
+	int start;
+	uint32_t tmp[3];
+	LIMdlAnimation* animation;
+
+	/* Read header. */
+	start = reader->pos;
+	if (!liarc_reader_get_uint32 (reader, tmp + 0))
+		return 0;
+	if (!tmp[0])
+		return 1;
+	self->animations.array = lisys_calloc (tmp[0], sizeof (LIMdlAnimation));
+	if (self->animations.array == NULL)
+		return 0;
+	self->animations.count = tmp[0];
+
+	/* Read animations. */
+	for (i = 0 ; i < self->animations.count ; i++)
+	{
+		animation = self->animations.array + i;
+		if (!liarc_reader_get_text (reader, "", &animation->name) ||
+		    !liarc_reader_get_uint32 (reader, tmp + 1) ||
+		    !liarc_reader_get_uint32 (reader, tmp + 2))
+			return 0;
+		if (tmp[1])
+		{
+			animation->channels.array = lisys_calloc (tmp[1], sizeof (char*));
+			if (animation->channels.array == NULL)
+				return 0;
+			animation->channels.count = tmp[1];
+		}
+		for (j = 0 ; j < animation->channels.count ; j++)
+		{
+			if (!liarc_reader_get_text (reader, "", animation->channels.array + j))
+				return 0;
+		}
+		animation->length = tmp[2];
+		animation->buffer.count = tmp[1] * tmp[2];
+		if (!private_read_baked_array (reader, start, animation->buffer.count,
+		     sizeof (LIMdlFrame), (void**) &animation->buffer.array))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Reads a raw native array aligned relative to the start of the block. */
+static int private_read_baked_array (
+	LIArcReader* reader,
+	int          start,
+	int          count,
+	int          size,
+	void**       result)
+{
+	int pad;
+	size_t bytes;
+
+	/* Skip the alignment padding. */
+	pad = (LIMDL_BAKED_ALIGN - (reader->pos - start) % LIMDL_BAKED_ALIGN) % LIMDL_BAKED_ALIGN;
+	if (!liarc_reader_skip_bytes (reader, pad))
+		return 0;
+	*result = NULL;
+	if (!count)
+		return 1;
+
+	/* Copy the array. */
+	/* The bounds are checked before multiplying so that a corrupt count
+	   can't overflow the size. */
+	if (count < 0 || size <= 0 || (size_t) count > (size_t)(reader->length - reader->pos) / (size_t) size)
+	{
+		lisys_error_set (EINVAL, "baked array out of bounds");
+		return 0;
+	}
+	bytes = (size_t) count * (size_t) size;
+	*result = lisys_malloc (bytes);
+	if (*result == NULL)
+		return 0;
+	memcpy (*result, reader->buffer + reader->pos, bytes);
+	reader->pos += bytes;
+
+	return 1;
+}
+
+static int private_read_baked_lod (
+	LIMdlModel*  self,
+	LIArcReader* reader)
+{
+	int i;
+	int j;
+	int pos;
+	int start;
+	uint32_t tmp[3];
+	LIMdlLod* lod;
+
+	/* Read header. */
+	start = reader->pos;
+	if (!liarc_reader_get_uint32 (reader, tmp + 0))
+		return 0;
+	if (!tmp[0])
+	{
+		lisys_error_set (EINVAL, "empty lod block");
+		return 0;
+	}
+	self->lod.array = lisys_calloc (tmp[0], sizeof (LIMdlLod));
+	if (self->lod.array == NULL)
+		return 0;
+	self->lod.count = tmp[0];
+
+	/* Read the detail levels. */
+	for (i = 0 ; i < self->lod.count ; i++)
+	{
+		lod = self->lod.array + i;
+		if (!liarc_reader_get_uint32 (reader, tmp + 1) ||
+		    !liarc_reader_get_uint32 (reader, tmp + 2))
+			return 0;
+		if (tmp[1])
+		{
+			lod->face_groups.array = lisys_calloc (tmp[1], sizeof (LIMdlFaces));
+			if (lod->face_groups.array == NULL)
+				return 0;
+			lod->face_groups.count = tmp[1];
+		}
+		for (j = pos = 0 ; j < lod->face_groups.count ; j++)
+		{
+			if (!liarc_reader_get_uint32 (reader, tmp + 1))
+				return 0;
+			lod->face_groups.array[j].start = pos;
+			lod->face_groups.array[j].count = tmp[1];
+			pos += tmp[1];
+		}
+		lod->indices.count = tmp[2];
+		if (!private_read_baked_array (reader, start, lod->indices.count,
+		     sizeof (LIMdlIndex), (void**) &lod->indices.array))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int private_read_baked_vertices (
+	LIMdlModel*  self,
+	LIArcReader* reader)
+{
+	int start;
+	uint32_t tmp;
+
+	start = reader->pos;
+	if (!liarc_reader_get_uint32 (reader, &tmp))
+		return 0;
+	self->vertices.count = tmp;
+
+	return private_read_baked_array (reader, start, self->vertices.count,
+		sizeof (LIMdlVertex), (void**) &self->vertices.array);
+}
+
+static int private_read_baked_weights (
+	LIMdlModel*  self,
+	LIArcReader* reader)
+{
+	int i;
+	uint32_t tmp;
+	LIMdlWeightGroup* group;
+
+	if (!liarc_reader_get_uint32 (reader, &tmp))
+		return 0;
+	if (!tmp)
+		return 1;
+	self->weight_groups.array = lisys_calloc (tmp, sizeof (LIMdlWeightGroup));
+	if (self->weight_groups.array == NULL)
+		return 0;
+	self->weight_groups.count = tmp;
+	for (i = 0 ; i < self->weight_groups.count ; i++)
+	{
+		group = self->weight_groups.array + i;
+		if (!liarc_reader_get_text (reader, "", &group->name) ||
+		    !liarc_reader_get_text (reader, "", &group->bone))
+			return 0;
+	}
+
+	return 1;
+}
+
 static int private_read_bounds (
 	LIMdlModel*  self,
 	LIArcReader* reader)
@@ -1616,6 +2029,174 @@ static int private_write (
 	return 1;
 }
 
+static int private_write_baked (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	if (!private_write_block (self, "lips/mdl", private_write_header, writer) ||
+	    !private_write_block (self, "bou", private_write_bounds, writer) ||
+	    !private_write_block (self, "bak", private_write_baked_header, writer) ||
+	    !private_write_block (self, "mat", private_write_materials, writer) ||
+	    !private_write_block_aligned (self, "bve", private_write_baked_vertices, writer) ||
+	    !private_write_block (self, "bwe", private_write_baked_weights, writer) ||
+	    !private_write_block_aligned (self, "blo", private_write_baked_lod, writer) ||
+	    !private_write_block (self, "shk", private_write_shape_keys, writer) ||
+	    !private_write_block (self, "nod", private_write_nodes, writer) ||
+	    !private_write_block_aligned (self, "ban", private_write_baked_animations, writer) ||
+	    !private_write_block (self, "hai", private_write_hairs, writer) ||
+	    !private_write_block (self, "par", private_write_particles, writer) ||
+	    !private_write_block (self, "sha", private_write_shapes, writer))
+		return 0;
+	return 1;
+}
+
+static int private_write_baked_animations (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	int i;
+	int j;
+	LIMdlAnimation* animation;
+
+	/* Check if writing is needed. */
+	if (!self->animations.count)
+		return 1;
+
+	/* Write animations. */
+	if (!liarc_writer_append_uint32 (writer, self->animations.count))
+		return 0;
+	for (i = 0 ; i < self->animations.count ; i++)
+	{
+		animation = self->animations.array + i;
+		if (!liarc_writer_append_string (writer, animation->name) ||
+		    !liarc_writer_append_nul (writer) ||
+		    !liarc_writer_append_uint32 (writer, animation->channels.count) ||
+		    !liarc_writer_append_uint32 (writer, animation->length))
+			return 0;
+		for (j = 0 ; j < animation->channels.count ; j++)
+		{
+			if (!liarc_writer_append_string (writer, animation->channels.array[j]) ||
+			    !liarc_writer_append_nul (writer))
+				return 0;
+		}
+		if (!private_write_baked_array (writer, animation->buffer.array,
+		     animation->channels.count * animation->length * sizeof (LIMdlFrame)))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Writes a raw native array aligned relative to the start of the block. */
+static int private_write_baked_array (
+	LIArcWriter* writer,
+	const void*  data,
+	int          size)
+{
+	int pad;
+	char zero[LIMDL_BAKED_ALIGN];
+
+	memset (zero, 0, sizeof (zero));
+	pad = (LIMDL_BAKED_ALIGN - liarc_writer_get_length (writer) % LIMDL_BAKED_ALIGN) % LIMDL_BAKED_ALIGN;
+	if (pad && !liarc_writer_append_raw (writer, zero, pad))
+		return 0;
+	if (size && !liarc_writer_append_raw (writer, data, size))
+		return 0;
+
+	return 1;
+}
+
+static int private_write_baked_header (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	uint32_t order = 0x01020304;
+
+	if (!liarc_writer_append_uint32 (writer, LIMDL_BAKED_VERSION) ||
+	    !liarc_writer_append_raw (writer, &order, 4) ||
+	    !liarc_writer_append_uint32 (writer, sizeof (LIMdlVertex)) ||
+	    !liarc_writer_append_uint32 (writer, sizeof (LIMdlIndex)) ||
+	    !liarc_writer_append_uint32 (writer, sizeof (LIMdlFrame)))
+		return 0;
+	return 1;
+}
+
+static int private_write_baked_lod (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	int i;
+	int j;
+	LIMdlLod* lod;
+
+	/* Check if writing is needed. */
+	if (!self->lod.count)
+		return 1;
+
+	/* Write the detail levels. */
+	if (!liarc_writer_append_uint32 (writer, self->lod.count))
+		return 0;
+	for (i = 0 ; i < self->lod.count ; i++)
+	{
+		lod = self->lod.array + i;
+		if (!liarc_writer_append_uint32 (writer, lod->face_groups.count) ||
+		    !liarc_writer_append_uint32 (writer, lod->indices.count))
+			return 0;
+		for (j = 0 ; j < lod->face_groups.count ; j++)
+		{
+			if (!liarc_writer_append_uint32 (writer, lod->face_groups.array[j].count))
+				return 0;
+		}
+		if (!private_write_baked_array (writer, lod->indices.array,
+		     lod->indices.count * sizeof (LIMdlIndex)))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int private_write_baked_vertices (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	/* Check if writing is needed. */
+	if (!self->vertices.count)
+		return 1;
+
+	/* Write vertices. */
+	if (!liarc_writer_append_uint32 (writer, self->vertices.count))
+		return 0;
+	return private_write_baked_array (writer, self->vertices.array,
+		self->vertices.count * sizeof (LIMdlVertex));
+}
+
+static int private_write_baked_weights (
+	const LIMdlModel* self,
+	LIArcWriter*      writer)
+{
+	int i;
+	LIMdlWeightGroup* group;
+
+	/* Check if writing is needed. */
+	if (!self->weight_groups.count)
+		return 1;
+
+	/* Write weight groups. The vertex weights are part of the baked vertices. */
+	if (!liarc_writer_append_uint32 (writer, self->weight_groups.count))
+		return 0;
+	for (i = 0 ; i < self->weight_groups.count ; i++)
+	{
+		group = self->weight_groups.array + i;
+		if (!liarc_writer_append_string (writer, group->name) ||
+		    !liarc_writer_append_nul (writer) ||
+		    !liarc_writer_append_string (writer, group->bone) ||
+		    !liarc_writer_append_nul (writer))
+			return 0;
+	}
+
+	return 1;
+}
+
 static int private_write_block (
 	const LIMdlModel* self,
 	const char*       name,
@@ -1655,6 +2236,36 @@ static int private_write_block (
 	return 1;
 }
 
+/* Writes a block whose payload starts at an aligned offset of the writer.
+   Alignment is achieved by inserting a padding block that readers skip. */
+static int private_write_block_aligned (
+	const LIMdlModel* self,
+	const char*       name,
+	LIMdlWriteFunc    func,
+	LIArcWriter*      writer)
+{
+	int pad;
+	int len;
+	char zero[LIMDL_BAKED_ALIGN];
+
+	/* Both the padding block header and the header of the actual block are
+	   eight bytes long since their names are three characters long. */
+	lisys_assert (strlen (name) == 3);
+	len = liarc_writer_get_length (writer);
+	if ((len + 8) % LIMDL_BAKED_ALIGN)
+	{
+		pad = (LIMDL_BAKED_ALIGN - (len + 16) % LIMDL_BAKED_ALIGN) % LIMDL_BAKED_ALIGN;
+		memset (zero, 0, sizeof (zero));
+		if (!liarc_writer_append_string (writer, "pad") ||
+		    !liarc_writer_append_nul (writer) ||
+		    !liarc_writer_append_uint32 (writer, pad) ||
+		    !liarc_writer_append_raw (writer, zero, pad))
+			return 0;
+	}
+
+	return private_write_block (self, name, func, writer);
+}
+
 static int private_write_animations (
 	const LIMdlModel* self,
 	LIArcWriter*      writer)
@@ -36,12 +36,15 @@
 #include "model-weight-group.h"
 
 #define LIMDL_FORMAT_VERSION 0xFFFFFFF3
+#define LIMDL_BAKED_VERSION 1
+#define LIMDL_BAKED_ALIGN 16
 
 typedef int LIMdlModelFlags;
 
 struct _LIMdlModel
 {
 	int flags;
+	int refs;
 	LIMatAabb bounds;
 	struct { int count; LIMdlAnimation* array; } animations;
 	struct { int count; LIMdlHairs* array; } hairs;
@@ -120,6 +123,9 @@ LIAPICALL (int, limdl_model_morph, (
 	const char* shape,
 	float       value));
 
+LIAPICALL (LIMdlModel*, limdl_model_ref, (
+	LIMdlModel* self));
+
 LIAPICALL (int, limdl_model_write, (
 	const LIMdlModel* self,
 	LIArcWriter*      writer));
@@ -128,7 +134,18 @@ LIAPICALL (int, limdl_model_write_file, (
 	const LIMdlModel* self,
 	const char*       path));
 
+LIAPICALL (int, limdl_model_write_baked, (
+	const LIMdlModel* self,
+	LIArcWriter*      writer));
+
+LIAPICALL (int, limdl_model_write_file_baked, (
+	const LIMdlModel* self,
+	const char*       path));
+
 LIAPICALL (int, limdl_model_get_memory, (
 	const LIMdlModel* self));
 
+LIAPICALL (int, limdl_model_get_shared, (
+	const LIMdlModel* self));
+
 #endif
@@ -86,6 +86,14 @@ LIPthPaths* lipth_paths_new (
 		goto error;
 	}
 
+	/* Get cache directory. */
+	self->module_cache = lisys_path_concat (tmp, "lipsofsuna", "cache", name, NULL);
+	if (self->module_cache == NULL)
+	{
+		lisys_free (tmp);
+		goto error;
+	}
+
 	/* Get save directory. */
 	self->global_state = lisys_path_concat (tmp, "lipsofsuna", "save", NULL);
 	lisys_free (tmp);
@@ -136,6 +144,7 @@ void lipth_paths_free (
 	lisys_free (self->global_data);
 #endif
 	lisys_free (self->global_state);
+	lisys_free (self->module_cache);
 	lisys_free (self->module_data);
 	lisys_free (self->module_name);
 	lisys_free (self->module_state);
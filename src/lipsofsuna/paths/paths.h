@@ -27,6 +27,7 @@ struct _LIPthPaths
 	char* global_exts;
 	char* global_data;
 	char* global_state;
+	char* module_cache;
 	char* module_data;
 	char* module_name;
 	char* module_state;
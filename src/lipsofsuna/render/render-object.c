@@ -44,6 +44,7 @@ LIRenObject* liren_object_new (
 	if (self == NULL)
 		return NULL;
 	self->scene = scene;
+	self->transform = limat_transform_identity ();
 
 	/* Choose a unique ID. */
 	while (!id)
@@ -91,6 +92,18 @@ LIRenObject* liren_object_new (
 void liren_object_free (
 	LIRenObject* self)
 {
+	LIRenObject* moved;
+	LIRenScene* scene;
+
+	/* Remove from the dirty list. */
+	scene = self->scene;
+	if (self->dirty)
+	{
+		moved = scene->dirty.array[--scene->dirty.count];
+		scene->dirty.array[self->dirty - 1] = moved;
+		moved->dirty = self->dirty;
+	}
+
 	lialg_u32dic_remove (self->scene->objects, self->id);
 	if (self->v32 != NULL)
 		liren_object32_free (self->v32);
@@ -221,6 +234,18 @@ int liren_object_set_realized (
 
 /**
  * \brief Sets the transformation of the object.
+ *
+ * The transformation is only stored and the object is added to the dirty
+ * list of the scene. The backend object, its bounding box and its lights
+ * are updated once per frame when the scene is updated or rendered, no
+ * matter how many times the object was moved.
+ *
+ * Until then, the transformation and the bounding box of the backend object
+ * and the transformations of its lights are those of the previous frame.
+ * The culling, shadow and light passes of the backends only read them after
+ * the update. Any other code reading them must call
+ * liren_scene_update_transforms first.
+ *
  * \param self Object.
  * \param value Transformation.
  */
@@ -228,10 +253,34 @@ void liren_object_set_transform (
 	LIRenObject*          self,
 	const LIMatTransform* value)
 {
-	if (self->v32 != NULL)
-		liren_object32_set_transform (self->v32, value);
-	else
-		liren_object21_set_transform (self->v21, value);
+	int capacity;
+	LIRenObject** tmp;
+	LIRenScene* scene;
+
+	self->transform = *value;
+	if (self->dirty)
+		return;
+
+	/* Add to the dirty list. */
+	scene = self->scene;
+	if (scene->dirty.count == scene->dirty.capacity)
+	{
+		capacity = (scene->dirty.capacity > 32)? 2 * scene->dirty.capacity : 64;
+		tmp = lisys_realloc (scene->dirty.array, capacity * sizeof (LIRenObject*));
+		if (tmp == NULL)
+		{
+			/* Fall back to an immediate update. */
+			if (self->v32 != NULL)
+				liren_object32_set_transform (self->v32, value);
+			else
+				liren_object21_set_transform (self->v21, value);
+			return;
+		}
+		scene->dirty.array = tmp;
+		scene->dirty.capacity = capacity;
+	}
+	scene->dirty.array[scene->dirty.count++] = self;
+	self->dirty = scene->dirty.count;
 }
 
 /** @} */
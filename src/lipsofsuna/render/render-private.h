@@ -71,6 +71,8 @@ struct _LIRenModel
 struct _LIRenObject
 {
 	int id;
+	int dirty;
+	LIMatTransform transform;
 	LIRenModel* model;
 	LIRenScene* scene;
 	LIRenObject21* v21;
@@ -92,6 +94,12 @@ struct _LIRenScene
 {
 	LIAlgU32dic* objects;
 	LIRenRender* render;
+	struct
+	{
+		int count;
+		int capacity;
+		LIRenObject** array;
+	} dirty;
 	LIRenScene21* v21;
 	LIRenScene32* v32;
 };
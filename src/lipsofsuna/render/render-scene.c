@@ -77,6 +77,7 @@ void liren_scene_free (
 {
 	if (self->objects != NULL)
 		lialg_u32dic_free (self->objects);
+	lisys_free (self->dirty.array);
 	if (self->v32 != NULL)
 		liren_scene32_free (self->v32);
 	if (self->v21 != NULL)
@@ -146,6 +147,7 @@ void liren_scene_render (
 	LIRenPassPostproc* postproc_passes,
 	int                postproc_passes_num)
 {
+	liren_scene_update_transforms (self);
 	if (self->v32 != NULL)
 	{
 		return liren_scene32_render (self->v32, framebuffer->v32, viewport,
@@ -169,11 +171,41 @@ void liren_scene_update (
 	LIRenScene* self,
 	float       secs)
 {
+	liren_scene_update_transforms (self);
 	if (self->v32 != NULL)
 		return liren_scene32_update (self->v32, secs);
 	else
 		return liren_scene21_update (self->v21, secs);
 }
 
+/**
+ * \brief Applies the pending transformations of moved objects.
+ *
+ * Only the objects in the dirty list are visited so static objects cost
+ * nothing. This is called automatically when the scene is updated or
+ * rendered. It must also be called before reading the transformations or
+ * bounding boxes of backend objects anywhere else, since those of moved
+ * objects are stale until then.
+ *
+ * \param self Scene.
+ */
+void liren_scene_update_transforms (
+	LIRenScene* self)
+{
+	int i;
+	LIRenObject* object;
+
+	for (i = 0 ; i < self->dirty.count ; i++)
+	{
+		object = self->dirty.array[i];
+		object->dirty = 0;
+		if (object->v32 != NULL)
+			liren_object32_set_transform (object->v32, &object->transform);
+		else
+			liren_object21_set_transform (object->v21, &object->transform);
+	}
+	self->dirty.count = 0;
+}
+
 /** @} */
 /** @} */
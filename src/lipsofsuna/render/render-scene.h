@@ -63,4 +63,7 @@ LIAPICALL (void, liren_scene_update, (
 	LIRenScene* self,
 	float       secs));
 
+LIAPICALL (void, liren_scene_update_transforms, (
+	LIRenScene* self));
+
 #endif
@@ -295,9 +295,11 @@ static int private_lights_create (
 	LIRenLight21* light;
 
 	/* Create light sources. */
-	if (pose != NULL)
+	/* The lights are created from the nodes of the model since the posed
+	   copies of the nodes only exist while the pose is animated. */
+	if (pose != NULL && pose->model != NULL)
 	{
-		LIMDL_FOREACH_NODE (iter, &pose->nodes)
+		LIMDL_FOREACH_NODE (iter, &pose->model->nodes)
 		{
 			/* Find a light node. */
 			node = iter.value;
@@ -348,6 +350,7 @@ static void private_lights_update (
 	int i;
 	float scale;
 	LIMatTransform transform;
+	const LIMdlNode* node;
 	LIRenLight21* light;
 
 	for (i = 0 ; i < self->lights.count ; i++)
@@ -355,7 +358,13 @@ static void private_lights_update (
 		light = self->lights.array[i];
 		if (light->node != NULL)
 		{
-			limdl_node_get_world_transform (light->node, &scale, &transform);
+			/* Use the posed copy of the node if the pose has one. */
+			node = NULL;
+			if (self->pose != NULL && light->node->name != NULL)
+				node = limdl_pose_find_node (self->pose, light->node->name);
+			if (node == NULL)
+				node = light->node;
+			limdl_node_get_world_transform (node, &scale, &transform);
 			transform = limat_transform_multiply (self->transform, transform);
 			liren_light21_set_transform (light, &transform);
 		}
@@ -38,9 +38,6 @@ static void private_envmap_clear (
 static int private_envmap_create (
 	LIRenObject32* self);
 
-static void private_envmap_update (
-	LIRenObject32* self);
-
 static void private_lights_clear (
 	LIRenObject32* self);
 
@@ -70,6 +67,7 @@ LIRenObject32* liren_object32_new (
 	if (self == NULL)
 		return NULL;
 	self->scene = scene;
+	self->particle.start = scene->time;
 	self->transform = limat_transform_identity ();
 	self->orientation.matrix = limat_matrix_identity ();
 
@@ -121,23 +119,10 @@ void liren_object32_particle_animation (
 	float          start,
 	int            loop)
 {
-	self->particle.time = start;
+	self->particle.start = self->scene->time - start;
 	self->particle.loop = loop;
 }
 
-/**
- * \brief Advances the timer of the object and deforms its mesh.
- * \param self Object.
- * \param secs Number of seconds since the last update.
- */
-void liren_object32_update (
-	LIRenObject32* self,
-	float          secs)
-{
-	self->particle.time += secs;
-	private_envmap_update (self);
-}
-
 /**
  * \brief Gets the bounding box of the object.
  * \param self Object.
@@ -504,76 +489,6 @@ error:
 	return 1;
 }
 
-static void private_envmap_update (
-	LIRenObject32* self)
-{
-#if 0
-	int i;
-	LIAlgU32dicIter iter;
-	LIMatFrustum frustum;
-	LIMatVector ctr;
-	LIMatMatrix modelview;
-	LIMatMatrix projection;
-	LIRenContext32* context;
-	const LIMatVector dir[6] =
-	{
-		{ 1.0f, 0.0f, 0.0f }, /* Back. */
-		{ -1.0f, 0.0f, 0.0f }, /* Front. */
-		{ 0.0f, 1.0f, 0.0f }, /* Up. */
-		{ 0.0f, -1.0f, 0.0f }, /* Down. */
-		{ 0.0f, 0.0f, 1.0f }, /* Left. */
-		{ 0.0f, 0.0f, -1.0f } /* Right. */
-	};
-	const LIMatVector up[6] =
-	{
-		{ 0.0f, -1.0f, 0.0f }, /* Back. */
-		{ 0.0f, -1.0f, 0.0f }, /* Front. */
-		{ 0.0f, 0.0f, 1.0f }, /* Up. */
-		{ 0.0f, 0.0f, -1.0f }, /* Down. */
-		{ 0.0f, -1.0f, 0.0f }, /* Left. */
-		{ 0.0f, -1.0f, 0.0f } /* Right. */
-	};
-
-	if (!self->cubemap.map)
-		return;
-	modelview = self->orientation.matrix;
-	projection = limat_matrix_perspective (0.5 * M_PI, 1.0f, 1.0f, 100.0f);
-	liren_object32_get_center (self, &ctr);
-
-	/* Enable cube map rendering mode. */
-	glPushAttrib (GL_VIEWPORT_BIT);
-	glViewport (0, 0, self->cubemap.width, self->cubemap.height);
-	glEnable (GL_DEPTH_TEST);
-	glEnable (GL_CULL_FACE);
-	glFrontFace (GL_CCW);
-	glDepthFunc (GL_LEQUAL);
-	glBindTexture (GL_TEXTURE_2D, 0);
-
-	/* Render each cube face. */
-	for (i = 0 ; i < 6 ; i++)
-	{
-		modelview = limat_matrix_look (
-			ctr.x, ctr.y, ctr.z,
-			dir[i].x, dir[i].y, dir[i].z,
-			up[i].x, up[i].y, up[i].z);
-		glBindFramebufferEXT (GL_FRAMEBUFFER_EXT, self->cubemap.fbo[i]);
-		glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		limat_frustum_init (&frustum, &modelview, &projection);
-		context = liren_render32_get_context (self->scene->render);
-		liren_context32_set_scene (context, self->scene);
-		liren_context32_set_viewmatrix (context, &modelview);
-		liren_context32_set_projection (context, &projection);
-		liren_context32_set_frustum (context, &frustum);
-		LIALG_U32DIC_FOREACH (iter, self->scene->objects)
-			liren_draw_exclude (context, iter.value, self);
-	}
-
-	/* Disable cube map rendering mode. */
-	glBindFramebufferEXT (GL_FRAMEBUFFER_EXT, 0);
-	glPopAttrib ();
-#endif
-}
-
 static void private_lights_clear (
 	LIRenObject32* self)
 {
@@ -602,9 +517,11 @@ static int private_lights_create (
 	LIRenLight32* light;
 
 	/* Create light sources. */
-	if (pose != NULL)
+	/* The lights are created from the nodes of the model since the posed
+	   copies of the nodes only exist while the pose is animated. */
+	if (pose != NULL && pose->model != NULL)
 	{
-		LIMDL_FOREACH_NODE (iter, &pose->nodes)
+		LIMDL_FOREACH_NODE (iter, &pose->model->nodes)
 		{
 			node = iter.value;
 			if (node->type != LIMDL_NODE_LIGHT)
@@ -644,6 +561,7 @@ static void private_lights_update (
 	int i;
 	float scale;
 	LIMatTransform transform;
+	const LIMdlNode* node;
 	LIRenLight32* light;
 
 	for (i = 0 ; i < self->lights.count ; i++)
@@ -651,7 +569,13 @@ static void private_lights_update (
 		light = self->lights.array[i];
 		if (light->node != NULL)
 		{
-			limdl_node_get_world_transform (light->node, &scale, &transform);
+			/* Use the posed copy of the node if the pose has one. */
+			node = NULL;
+			if (self->pose != NULL && light->node->name != NULL)
+				node = limdl_pose_find_node (self->pose, light->node->name);
+			if (node == NULL)
+				node = light->node;
+			limdl_node_get_world_transform (node, &scale, &transform);
 			transform = limat_transform_multiply (self->transform, transform);
 			liren_light32_set_transform (light, &transform);
 		}
@@ -42,10 +42,6 @@ LIAPICALL (void, liren_object32_particle_animation, (
 	float          start,
 	int            loop));
 
-LIAPICALL (void, liren_object32_update, (
-	LIRenObject32* self,
-	float          secs));
-
 LIAPICALL (void, liren_object32_get_bounds, (
 	const LIRenObject32* self,
 	LIMatAabb*           result));
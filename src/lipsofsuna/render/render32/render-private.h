@@ -175,7 +175,7 @@ struct _LIRenObject32
 	struct
 	{
 		int loop;
-		float time;
+		float start;
 	} particle;
 };
 
@@ -256,19 +256,12 @@ void liren_scene32_update (
 	LIRenScene32* self,
 	float         secs)
 {
-	LIAlgU32dicIter iter;
-	LIRenObject32* object;
-
 	/* Update the effect timer. */
+	/* The particle timers of objects are relative to this so objects don't
+	   need to be iterated. Environment maps are currently disabled so they
+	   don't need updating either. */
 	self->time += secs;
 
-	/* Update objects. */
-	LIALG_U32DIC_FOREACH (iter, self->scene->objects)
-	{
-		object = ((LIRenObject*) iter.value)->v32;
-		liren_object32_update (object, secs);
-	}
-
 	/* Update lights. */
 	liren_lighting32_update (self->lighting);
 }
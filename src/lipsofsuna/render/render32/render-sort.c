@@ -164,7 +164,7 @@ int liren_sort32_add_object (
 	/* Add particle systems of the object. */
 	liren_particles32_sort (
 		&object->model->particles,
-		object->particle.time,
+		object->scene->time - object->particle.start,
 		object->particle.loop,
 		&object->transform, self);
 
@@ -22,6 +22,7 @@
 #include "script/script-args.h"
 #include "script/script-data.h"
 #include "script/script-library.h"
+#include "script/script-serialize.h"
 #include "script/script-util.h"
 
 #endif
@@ -27,6 +27,13 @@
 #include "script-private.h"
 #include "script-util.h"
 
+static int private_seti_data (
+	LIScrArgs* self,
+	LIScrData* value,
+	int      (*push)(lua_State*, LIScrData*));
+
+/*****************************************************************************/
+
 void liscr_args_init_func (
 	LIScrArgs*   self,
 	lua_State*   lua,
@@ -732,37 +739,24 @@ int liscr_args_seti_data (
 	LIScrArgs* self,
 	LIScrData* value)
 {
-	if (self->output_mode != LISCR_ARGS_OUTPUT_TABLE)
-	{
-		if (value != NULL)
-		{
-			if (!liscr_pushdata (self->lua, value))
-				return 0;
-		}
-		else
-			lua_pushnil (self->lua);
-		self->ret++;
-	}
-	else
-	{
-		if (!self->output_table)
-		{
-			lua_newtable (self->lua);
-			self->output_table = lua_gettop (self->lua);
-		}
-		if (value != NULL)
-		{
-			lua_pushnumber (self->lua, ++self->ret);
-			if (!liscr_pushdata (self->lua, value))
-			{
-				lua_pop (self->lua, 1);
-				return 0;
-			}
-			lua_settable (self->lua, self->output_table);
-		}
-	}
+	return private_seti_data (self, value, liscr_pushdata);
+}
 
-	return 1;
+/**
+ * \brief Appends the script wrapper of the userdata to the return values.
+ *
+ * Like #liscr_args_seti_data but returns the wrapper table assigned to the
+ * userdata with Los.data_set_wrapper, if any.
+ *
+ * \param self Arguments.
+ * \param value Script userdata.
+ * \return Nonzero on success.
+ */
+int liscr_args_seti_wrapper (
+	LIScrArgs* self,
+	LIScrData* value)
+{
+	return private_seti_data (self, value, liscr_pushwrapper);
 }
 
 void
@@ -829,7 +823,7 @@ liscr_args_seti_quaternion (LIScrArgs*             self,
 
 	if (self->output_mode != LISCR_ARGS_OUTPUT_TABLE)
 	{
-		quat = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
+		quat = liscr_data_new_value (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
 		if (quat != NULL)
 		{
 			*((LIMatQuaternion*) quat->data) = *value;
@@ -844,7 +838,7 @@ liscr_args_seti_quaternion (LIScrArgs*             self,
 			self->output_table = lua_gettop (self->lua);
 		}
 		lua_pushnumber (self->lua, ++self->ret);
-		quat = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
+		quat = liscr_data_new_value (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
 		if (quat != NULL)
 		{
 			*((LIMatQuaternion*) quat->data) = *value;
@@ -919,7 +913,7 @@ void liscr_args_seti_vector (
 
 	if (self->output_mode != LISCR_ARGS_OUTPUT_TABLE)
 	{
-		vector = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+		vector = liscr_data_new_value (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
 		if (vector != NULL)
 		{
 			*((LIMatVector*) vector->data) = *value;
@@ -934,7 +928,7 @@ void liscr_args_seti_vector (
 			self->output_table = lua_gettop (self->lua);
 		}
 		lua_pushnumber (self->lua, ++self->ret);
-		vector = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+		vector = liscr_data_new_value (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
 		if (vector != NULL)
 		{
 			*((LIMatVector*) vector->data) = *value;
@@ -1030,7 +1024,7 @@ void liscr_args_sets_quaternion (
 			lua_newtable (self->lua);
 			self->output_table = lua_gettop (self->lua);
 		}
-		quat = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
+		quat = liscr_data_new_value (self->script, self->lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
 		if (quat != NULL)
 		{
 			*((LIMatQuaternion*) quat->data) = *value;
@@ -1087,7 +1081,7 @@ void liscr_args_sets_vector (
 			lua_newtable (self->lua);
 			self->output_table = lua_gettop (self->lua);
 		}
-		vector = liscr_data_new_alloc (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+		vector = liscr_data_new_value (self->script, self->lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
 		if (vector != NULL)
 		{
 			*((LIMatVector*) vector->data) = *value;
@@ -1098,6 +1092,44 @@ void liscr_args_sets_vector (
 
 /*****************************************************************************/
 
+static int private_seti_data (
+	LIScrArgs* self,
+	LIScrData* value,
+	int      (*push)(lua_State*, LIScrData*))
+{
+	if (self->output_mode != LISCR_ARGS_OUTPUT_TABLE)
+	{
+		if (value != NULL)
+		{
+			if (!push (self->lua, value))
+				return 0;
+		}
+		else
+			lua_pushnil (self->lua);
+		self->ret++;
+	}
+	else
+	{
+		if (!self->output_table)
+		{
+			lua_newtable (self->lua);
+			self->output_table = lua_gettop (self->lua);
+		}
+		if (value != NULL)
+		{
+			lua_pushnumber (self->lua, ++self->ret);
+			if (!push (self->lua, value))
+			{
+				lua_pop (self->lua, 1);
+				return 0;
+			}
+			lua_settable (self->lua, self->output_table);
+		}
+	}
+
+	return 1;
+}
+
 int liscr_marshal_CLASS (lua_State* lua)
 {
 	LIScrArgs args;
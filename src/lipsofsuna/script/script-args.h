@@ -185,6 +185,10 @@ LIAPICALL (int, liscr_args_seti_data, (
 	LIScrArgs* self,
 	LIScrData* value));
 
+LIAPICALL (int, liscr_args_seti_wrapper, (
+	LIScrArgs* self,
+	LIScrData* value));
+
 LIAPICALL (void, liscr_args_seti_float, (
 	LIScrArgs* self,
 	float      value));
@@ -30,6 +30,11 @@
 static int private_gc (
 	lua_State* lua);
 
+static int private_push_metatable (
+	LIScrScript* script,
+	lua_State*   lua,
+	const char*  type);
+
 /*****************************************************************************/
 
 /**
@@ -37,6 +42,12 @@ static int private_gc (
  *
  * The created userdata is pushed to the top of the Lua stack.
  *
+ * All userdata of the same type share a single metatable. The userdata is
+ * assigned a slot in the lookup table of the script so that #liscr_pushdata
+ * can find it with an array index instead of a hash lookup. The userdata
+ * itself only holds a pointer to a pooled record. The records and the
+ * slots of collected userdata are recycled by later allocations.
+ *
  * \param script Script.
  * \param lua Lua state whose stack will contain the userdata.
  * \param data Wrapped data.
@@ -51,39 +62,61 @@ LIScrData* liscr_data_new (
 	const char*  type,
 	LIScrGCFunc  free)
 {
+	int slot;
 	LIScrData* object;
+	LIScrDataBox* box;
 
-	/* Allocate object. */
-	object = lua_newuserdata (lua, sizeof (LIScrData));
-	if (object == NULL)
+	/* Allocate the userdata. */
+	/* The record isn't attached until it has been allocated so that the
+	   userdata is never mistaken for a valid one. */
+	box = lua_newuserdata (lua, sizeof (LIScrDataBox));
+	if (box == NULL)
 	{
 		lisys_error_set (ENOMEM, NULL);
 		return NULL;
 	}
+	box->signature = 0;
+	box->data = NULL;
+
+	/* Allocate the record. */
+	if (script->pool.count)
+		object = script->pool.array[--script->pool.count];
+	else
+	{
+		object = lisys_malloc (sizeof (LIScrData));
+		if (object == NULL)
+		{
+			lua_pop (lua, 1);
+			return NULL;
+		}
+	}
+	box->signature = 'B';
+	box->data = object;
+
+	/* Allocate a lookup slot. */
+	if (script->slots.count)
+		slot = script->slots.array[--script->slots.count];
+	else
+		slot = ++script->slots_used;
 	memset (object, 0, sizeof (LIScrData));
 	object->signature = 'D';
 	object->type = type;
 	object->script = script;
 	object->data = data;
 	object->free = free;
-	lua_newtable (lua);
-	lua_pushcfunction (lua, private_gc);
-	lua_setfield (lua, -2, "__gc");
+	object->slot = slot;
+
+	/* Use the shared metatable of the type. */
+	private_push_metatable (script, lua, type);
 	lua_setmetatable (lua, -2);
 
 	/* Add to lookup table. */
-	lua_pushlightuserdata (lua, LISCR_SCRIPT_LOOKUP_DATA);
-	lua_gettable (lua, LUA_REGISTRYINDEX);
+	lua_rawgeti (lua, LUA_REGISTRYINDEX, script->lookup);
 	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
-	lua_pushlightuserdata (lua, object);
-	lua_pushvalue (lua, -3);
-	lua_settable (lua, -3);
+	lua_pushvalue (lua, -2);
+	lua_rawseti (lua, -2, slot);
 	lua_pop (lua, 1);
 
-	/* Create private table. */
-	lua_newtable (lua);
-	lua_setfenv (lua, -2);
-
 	return object;
 }
 
@@ -120,34 +153,110 @@ LIScrData* liscr_data_new_alloc (
 	return self;
 }
 
+/**
+ * \brief Allocates a value type script userdata object.
+ *
+ * Like #liscr_data_new_alloc but the wrapped data is stored inline in the
+ * userdata. The userdata has no metatable, no private table, no lookup table
+ * entry, and no finalizer, so it is as cheap to create and collect as any
+ * plain userdata. This is meant for small values such as vectors that are
+ * created in large numbers and never referenced from C.
+ *
+ * Since the userdata isn't in the lookup table, it can't be pushed to the
+ * stack with #liscr_pushdata.
+ *
+ * \param script Script.
+ * \param lua Lua state whose stack will contain the userdata.
+ * \param size Wrapped data size.
+ * \param type Type identifier string.
+ * \return New script userdata or NULL.
+ */
+LIScrData* liscr_data_new_value (
+	LIScrScript* script,
+	lua_State*   lua,
+	size_t       size,
+	const char*  type)
+{
+	LIScrData* object;
+
+	object = lua_newuserdata (lua, sizeof (LIScrData) + size);
+	if (object == NULL)
+	{
+		lisys_error_set (ENOMEM, NULL);
+		return NULL;
+	}
+	memset (object, 0, sizeof (LIScrData) + size);
+	object->signature = 'D';
+	object->type = type;
+	object->script = script;
+	object->data = object + 1;
+
+	return object;
+}
+
 /**
  * \brief Called in the garbage collection routines.
  *
  * All the values referenced by the userdata are garbage
- * collected automatically since they are stored to the
- * private table, which is always collected at the same
- * time with the userdata. What is left for us to do is
- * removing some values from the lookup tables.
+ * collected automatically. What is left for us to do is
+ * removing the userdata from the lookup and wrapper tables
+ * and returning its slot and record to the pools.
  *
  * \param object Script userdata.
  */
 void liscr_data_free (
 	LIScrData* object)
 {
+	int* tmp;
+	LIScrData** tmp_pool;
 	LIScrScript* script = object->script;
 
 	/* Call free function. */
 	if (object->free != NULL)
 		object->free (object->data, object);
 
-	/* Remove from lookup table. */
-	lua_pushlightuserdata (script->lua, LISCR_SCRIPT_LOOKUP_DATA);
-	lua_gettable (script->lua, LUA_REGISTRYINDEX);
+	/* Remove from the lookup and wrapper tables. */
+	if (!object->slot)
+		return;
+	lua_rawgeti (script->lua, LUA_REGISTRYINDEX, script->lookup);
 	lisys_assert (lua_type (script->lua, -1) == LUA_TTABLE);
-	lua_pushlightuserdata (script->lua, object);
 	lua_pushnil (script->lua);
-	lua_settable (script->lua, -3);
+	lua_rawseti (script->lua, -2, object->slot);
 	lua_pop (script->lua, 1);
+	lua_rawgeti (script->lua, LUA_REGISTRYINDEX, script->wrappers);
+	lisys_assert (lua_type (script->lua, -1) == LUA_TTABLE);
+	lua_pushnil (script->lua);
+	lua_rawseti (script->lua, -2, object->slot);
+	lua_pop (script->lua, 1);
+
+	/* Return the slot to the pool. */
+	if (script->slots.count == script->slots.capacity)
+	{
+		tmp = lisys_realloc (script->slots.array, (script->slots.capacity + 256) * sizeof (int));
+		if (tmp != NULL)
+		{
+			script->slots.array = tmp;
+			script->slots.capacity += 256;
+		}
+	}
+	if (script->slots.count < script->slots.capacity)
+		script->slots.array[script->slots.count++] = object->slot;
+	object->slot = 0;
+
+	/* Return the record to the pool. */
+	if (script->pool.count == script->pool.capacity)
+	{
+		tmp_pool = lisys_realloc (script->pool.array, (script->pool.capacity + 256) * sizeof (LIScrData*));
+		if (tmp_pool != NULL)
+		{
+			script->pool.array = tmp_pool;
+			script->pool.capacity += 256;
+		}
+	}
+	if (script->pool.count < script->pool.capacity)
+		script->pool.array[script->pool.count++] = object;
+	else
+		lisys_free (object);
 }
 
 /**
@@ -172,20 +281,66 @@ LIScrScript* liscr_data_get_script (
 	return self->script;
 }
 
+/**
+ * \brief Replaces the C data stored to the userdata.
+ *
+ * The old data is not freed, so the caller must have taken ownership of it.
+ * The new data will be freed with the free function of the userdata.
+ *
+ * \param self Script userdata.
+ * \param data C data.
+ */
+void liscr_data_set_data (
+	LIScrData* self,
+	void*      data)
+{
+	self->data = data;
+}
+
 /*****************************************************************************/
 
 static int private_gc (
 	lua_State* lua)
 {
-	char* data;
+	LIScrDataBox* box;
 
-	data = lua_touserdata (lua, 1);
-	lisys_assert (data != NULL);
-	lisys_assert (*data == 'D');
-	liscr_data_free ((void*) data);
+	/* Detach the record before it's returned to the pool. */
+	box = lua_touserdata (lua, 1);
+	lisys_assert (box != NULL);
+	lisys_assert (box->signature == 'B');
+	box->signature = 0;
+	liscr_data_free (box->data);
+	box->data = NULL;
 
 	return 0;
 }
 
+static int private_push_metatable (
+	LIScrScript* script,
+	lua_State*   lua,
+	const char*  type)
+{
+	/* Find an existing metatable. */
+	lua_rawgeti (lua, LUA_REGISTRYINDEX, script->metatables);
+	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
+	lua_getfield (lua, -1, type);
+	if (lua_istable (lua, -1))
+	{
+		lua_remove (lua, -2);
+		return 1;
+	}
+	lua_pop (lua, 1);
+
+	/* Create a new metatable. */
+	lua_newtable (lua);
+	lua_pushcfunction (lua, private_gc);
+	lua_setfield (lua, -2, "__gc");
+	lua_pushvalue (lua, -1);
+	lua_setfield (lua, -3, type);
+	lua_remove (lua, -2);
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -34,6 +34,12 @@ LIAPICALL (LIScrData*, liscr_data_new_alloc, (
 	size_t       size,
 	const char*  type));
 
+LIAPICALL (LIScrData*, liscr_data_new_value, (
+	LIScrScript* script,
+	lua_State*   lua,
+	size_t       size,
+	const char*  type));
+
 LIAPICALL (void, liscr_data_free, (
 	LIScrData* object));
 
@@ -43,4 +49,8 @@ LIAPICALL (void*, liscr_data_get_data, (
 LIAPICALL (LIScrScript*, liscr_data_get_script, (
 	LIScrData* self));
 
+LIAPICALL (void, liscr_data_set_data, (
+	LIScrData* self,
+	void*      data));
+
 #endif
@@ -27,45 +27,111 @@
 #include "lipsofsuna/script.h"
 #include "script-private.h"
 
+typedef struct _LIScrObjectFind LIScrObjectFind;
+struct _LIScrObjectFind
+{
+	int cone;
+	int realized;
+	float cone_cos;
+	LIMatVector cone_dir;
+	LIMatVector point;
+	LIScrArgs* args;
+};
+
+static int private_find_filter (
+	void*        data,
+	LIEngObject* object);
+
+static int private_find_push (
+	void*        data,
+	LIEngObject* object);
+
+/*****************************************************************************/
+
 static void Object_find (LIScrArgs* args)
 {
+	int i;
 	int id;
+	int count;
+	float angle;
 	float radius = 32.0f;
 	LIAlgU32dicIter iter1;
 	LIEngObject* object;
+	LIEngObject** nearest;
 	LIEngSector* sector;
-	LIMatVector center;
-	LIMatVector diff;
+	LIMatAabb box;
 	LIMaiProgram* program;
+	LIScrObjectFind find;
 
 	/* Find class data. */
 	program = liscr_script_get_userdata (args->script, LISCR_SCRIPT_PROGRAM);
 
+	/* Get filters. */
+	memset (&find, 0, sizeof (LIScrObjectFind));
+	find.args = args;
+	liscr_args_gets_bool (args, "realized", &find.realized);
+	if (liscr_args_gets_vector (args, "dir", &find.cone_dir) &&
+	    liscr_args_gets_float (args, "angle", &angle))
+	{
+		find.cone = 1;
+		find.cone_dir = limat_vector_normalize (find.cone_dir);
+		find.cone_cos = cos (angle);
+	}
+
+	/* Results are stored by object ID to the output table, which may be
+	   provided by the caller to avoid creating a new table each call. */
+	if (liscr_args_gets_table (args, "result"))
+	{
+		args->output_mode = LISCR_ARGS_OUTPUT_TABLE;
+		args->output_table = lua_gettop (args->lua);
+	}
+	else
+		liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+
+	/* Box find mode. */
+	if (liscr_args_gets_vector (args, "min", &box.min) &&
+	    liscr_args_gets_vector (args, "max", &box.max))
+	{
+		find.cone = 0;
+		lieng_grid_find_box (program->engine->grid, &box, private_find_push, &find);
+	}
+
 	/* Radial find mode. */
-	if (liscr_args_gets_vector (args, "point", &center))
+	else if (liscr_args_gets_vector (args, "point", &find.point))
 	{
 		liscr_args_gets_float (args, "radius", &radius);
-		liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
-		LIALG_U32DIC_FOREACH (iter1, program->engine->objects)
+		if (liscr_args_gets_int (args, "count", &count))
+		{
+			/* Nearest neighbor mode. */
+			if (count <= 0)
+				return;
+			nearest = lisys_calloc (count, sizeof (LIEngObject*));
+			if (nearest == NULL)
+				return;
+			count = lieng_grid_find_nearest (program->engine->grid, &find.point, radius,
+				private_find_filter, &find, nearest, count);
+			for (i = 0 ; i < count ; i++)
+				private_find_push (&find, nearest[i]);
+			lisys_free (nearest);
+		}
+		else
 		{
-			object = iter1.value;
-			diff = limat_vector_subtract (center, object->transform.position);
-			if (limat_vector_get_length (diff) < radius)
-				liscr_args_seti_data (args, object->script);
+			/* Sphere or cone mode. */
+			lieng_grid_find_sphere (program->engine->grid, &find.point, radius, private_find_push, &find);
 		}
 	}
 
 	/* Sector find mode. */
 	else if (liscr_args_gets_int (args, "sector", &id))
 	{
+		find.cone = 0;
 		sector = lialg_sectors_data_index (program->sectors, LIALG_SECTORS_CONTENT_ENGINE, id, 0);
-		liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
 		if (sector != NULL)
 		{
 			LIALG_U32DIC_FOREACH (iter1, sector->objects)
 			{
 				object = iter1.value;
-				liscr_args_seti_data (args, object->script);
+				private_find_push (&find, object);
 			}
 		}
 	}
@@ -202,5 +268,47 @@ void liscr_script_object (
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_OBJECT, "object_get_sector", Object_get_sector);
 }
 
+/*****************************************************************************/
+
+static int private_find_filter (
+	void*        data,
+	LIEngObject* object)
+{
+	LIMatVector diff;
+	LIScrObjectFind* self = data;
+
+	if (self->realized && !lieng_object_get_realized (object))
+		return 0;
+	if (self->cone)
+	{
+		diff = limat_vector_subtract (object->transform.position, self->point);
+		if (limat_vector_get_length (diff) > LIMAT_VECTOR_EPSILON &&
+		    limat_vector_dot (limat_vector_normalize (diff), self->cone_dir) < self->cone_cos)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int private_find_push (
+	void*        data,
+	LIEngObject* object)
+{
+	LIScrObjectFind* self = data;
+	lua_State* lua = self->args->lua;
+
+	if (object->script == NULL || !private_find_filter (data, object))
+		return 0;
+	lua_pushnumber (lua, object->id);
+	if (!liscr_pushwrapper (lua, object->script))
+	{
+		lua_pop (lua, 1);
+		return 0;
+	}
+	lua_settable (lua, self->args->output_table);
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -27,7 +27,19 @@
 
 #define LISCR_SCRIPT_SELF (NULL + 1)
 #define LISCR_SCRIPT_REFS (NULL + 2)
-#define LISCR_SCRIPT_LOOKUP_DATA (NULL + 3)
+#define LISCR_SCRIPT_GC_BUDGET 0.002f
+#define LISCR_SCRIPT_GC_LIMIT 4096
+#define LISCR_SCRIPT_GC_STEP_MIN 4
+#define LISCR_SCRIPT_GC_STEP_MAX 1024
+#define LISCR_SCRIPT_CACHE_MAGIC "LOSBC001"
+
+/* Reference type userdata only hold a pointer to their pooled record. */
+typedef struct _LIScrDataBox LIScrDataBox;
+struct _LIScrDataBox
+{
+	char signature;
+	LIScrData* data;
+};
 
 struct _LIScrData
 {
@@ -37,12 +49,31 @@ struct _LIScrData
 	LIScrGCFunc free;
 	void* data;
 	int refcount;
+	int slot;
 };
 
 struct _LIScrScript
 {
+	char* cache;
 	lua_State* lua;
 	LIAlgStrdic* userdata;
+	int lookup;
+	int metatables;
+	int wrappers;
+	LIScrGcStats gc;
+	int slots_used;
+	struct
+	{
+		int count;
+		int capacity;
+		int* array;
+	} slots;
+	struct
+	{
+		int count;
+		int capacity;
+		LIScrData** array;
+	} pool;
 };
 
 #endif
@@ -25,6 +25,14 @@
 #include <lipsofsuna/main.h>
 #include <lipsofsuna/script.h>
 
+static void Program_benchmark (LIScrArgs* args)
+{
+	LIMaiProgram* program;
+
+	program = liscr_script_get_userdata (args->script, LISCR_SCRIPT_PROGRAM);
+	limai_program_benchmark (program);
+}
+
 static void Program_launch_mod (LIScrArgs* args)
 {
 	const char* name;
@@ -71,7 +79,6 @@ static void Program_pop_message (LIScrArgs* args)
 {
 	LIMaiMessage* message;
 	LIMaiProgram* self;
-	LIEngModel* model;
 
 	/* Only allowed for child programs. */
 	self = liscr_script_get_userdata (args->script, LISCR_SCRIPT_PROGRAM);
@@ -84,72 +91,83 @@ static void Program_pop_message (LIScrArgs* args)
 		return;
 
 	/* Return the message. */
-	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE);
-	liscr_args_sets_string (args, "name", message->name);
-	switch (message->type)
+	limai_message_push_script (message, self->engine, args->script, args->lua);
+	liscr_args_seti_stack (args);
+	limai_message_free (message);
+}
+
+static void Program_pop_messages (LIScrArgs* args)
+{
+	int i;
+	int count;
+	int max = LIMAI_MESSAGE_BATCH_MAX;
+	LIMaiMessage* messages[LIMAI_MESSAGE_BATCH_MAX];
+	LIMaiProgram* self;
+
+	/* Only allowed for child programs. */
+	self = liscr_script_get_userdata (args->script, LISCR_SCRIPT_PROGRAM);
+	if (self->parent == NULL)
+		return;
+	if (!liscr_args_geti_int (args, 0, &max))
+		liscr_args_gets_int (args, "count", &max);
+	max = LIMAT_CLAMP (max, 1, LIMAI_MESSAGE_BATCH_MAX);
+
+	/* Pop and return the messages. */
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE_FORCE);
+	count = limai_program_pop_messages (self, LIMAI_MESSAGE_QUEUE_THREAD, messages, max);
+	for (i = 0 ; i < count ; i++)
 	{
-		case LIMAI_MESSAGE_TYPE_EMPTY:
-			liscr_args_sets_string (args, "type", "empty");
-			break;
-		case LIMAI_MESSAGE_TYPE_MODEL:
-			liscr_args_sets_string (args, "type", "model");
-			model = lieng_model_new_model (self->engine, message->model);
-			if (model != NULL)
-			{
-				message->model = NULL;
-				model->script = liscr_data_new (args->script, args->lua, model, LISCR_SCRIPT_MODEL, lieng_model_free);
-				if (model->script != NULL)
-					liscr_args_sets_stack (args, "model");
-				else
-					lieng_model_free (model);
-			}
-			break;
-		case LIMAI_MESSAGE_TYPE_STRING:
-			liscr_args_sets_string (args, "type", "string");
-			liscr_args_sets_string (args, "string", message->string);
-			break;
+		limai_message_push_script (messages[i], self->engine, args->script, args->lua);
+		liscr_args_seti_stack (args);
+		limai_message_free (messages[i]);
 	}
-
-	/* Free the message. */
-	limai_message_free (message);
 }
 
 static void Program_push_message (LIScrArgs* args)
 {
-	const char* name = "";
-	const char* string = NULL;
 	LIMaiProgram* self;
-	LIScrData* data;
-	LIEngModel* emodel;
 
 	/* Only allowed for child programs. */
 	self = liscr_script_get_userdata (args->script, LISCR_SCRIPT_PROGRAM);
 	if (self->parent == NULL)
 		return;
 
-	/* Read the name. */
-	if (!liscr_args_geti_string (args, 0, &name))
-		liscr_args_gets_string (args, "name", &name);
+	/* Push the message. */
+	if (limai_program_push_message_script (self, LIMAI_MESSAGE_QUEUE_PROGRAM, args))
+		liscr_args_seti_bool (args, 1);
+}
 
-	/* Read and push the data. */
-	if (liscr_args_geti_string (args, 1, &string) ||
-	    liscr_args_gets_string (args, "string", &string))
-	{
-		if (limai_program_push_message (self, LIMAI_MESSAGE_QUEUE_PROGRAM, LIMAI_MESSAGE_TYPE_STRING, name, string))
-			liscr_args_seti_bool (args, 1);
-	}
-	else if (liscr_args_geti_data (args, 1, LISCR_SCRIPT_MODEL, &data) ||
-	         liscr_args_gets_data (args, "model", LISCR_SCRIPT_MODEL, &data))
+static void Program_serialize (LIScrArgs* args)
+{
+	LIArcPacket* packet;
+	LIArcWriter* writer;
+	LIScrData* data;
+
+	/* Encode the value. */
+	writer = liarc_writer_new ();
+	if (writer == NULL)
+		return;
+	lua_settop (args->lua, args->args_start);
+	if (!liscr_serialize_encode (writer, args->lua, args->args_start))
 	{
-		emodel = liscr_data_get_data (data);
-		if (limai_program_push_message (self, LIMAI_MESSAGE_QUEUE_PROGRAM, LIMAI_MESSAGE_TYPE_MODEL, name, emodel->model))
-			liscr_args_seti_bool (args, 1);
+		liarc_writer_free (writer);
+		liscr_args_seti_nil (args);
+		liscr_args_seti_string (args, lisys_error_get_string ());
+		return;
 	}
-	else
+
+	/* Return the encoded data as a packet. */
+	packet = liarc_packet_new_readable (liarc_writer_get_buffer (writer), liarc_writer_get_length (writer));
+	liarc_writer_free (writer);
+	if (packet == NULL)
+		return;
+	data = liscr_data_new (args->script, args->lua, packet, LISCR_SCRIPT_PACKET, liarc_packet_free);
+	if (data == NULL)
 	{
-		if (limai_program_push_message (self, LIMAI_MESSAGE_QUEUE_PROGRAM, LIMAI_MESSAGE_TYPE_EMPTY, name, NULL))
-			liscr_args_seti_bool (args, 1);
+		liarc_packet_free (packet);
+		return;
 	}
+	liscr_args_seti_stack (args);
 }
 
 static void Program_unittest (LIScrArgs* args)
@@ -160,6 +178,51 @@ static void Program_unittest (LIScrArgs* args)
 	limai_program_unittest (program);
 }
 
+static void Program_unserialize (LIScrArgs* args)
+{
+	int ok;
+	size_t length;
+	const char* buffer;
+	LIArcPacket* packet;
+	LIArcReader* reader;
+	LIScrData* data;
+
+	/* Get the encoded data. */
+	if (liscr_args_geti_data (args, 0, LISCR_SCRIPT_PACKET, &data))
+	{
+		packet = liscr_data_get_data (data);
+		if (packet->reader != NULL)
+		{
+			buffer = packet->reader->buffer;
+			length = packet->reader->length;
+		}
+		else
+		{
+			buffer = liarc_writer_get_buffer (packet->writer);
+			length = liarc_writer_get_length (packet->writer);
+		}
+	}
+	else if (lua_type (args->lua, args->args_start) == LUA_TSTRING)
+		buffer = lua_tolstring (args->lua, args->args_start, &length);
+	else
+		return;
+
+	/* Decode the value. */
+	reader = liarc_reader_new (buffer, length);
+	if (reader == NULL)
+		return;
+	lua_settop (args->lua, args->args_start + 1);
+	ok = liscr_serialize_decode (reader, args->lua, args->args_start + 1);
+	liarc_reader_free (reader);
+	if (!ok)
+	{
+		liscr_args_seti_nil (args);
+		liscr_args_seti_string (args, lisys_error_get_string ());
+		return;
+	}
+	liscr_args_seti_stack (args);
+}
+
 static void Program_unload_sector (LIScrArgs* args)
 {
 	int sector;
@@ -213,6 +276,35 @@ static void Program_get_args (LIScrArgs* args)
 	liscr_args_seti_string (args, program->args);
 }
 
+static void Program_get_gc_budget (LIScrArgs* args)
+{
+	liscr_args_seti_float (args, liscr_script_get_gc_budget (args->script));
+}
+
+static void Program_set_gc_budget (LIScrArgs* args)
+{
+	float value;
+
+	if (liscr_args_geti_float (args, 0, &value))
+		liscr_script_set_gc_budget (args->script, value);
+}
+
+static void Program_get_gc_stats (LIScrArgs* args)
+{
+	LIScrGcStats stats;
+
+	liscr_script_get_gc_stats (args->script, &stats);
+	liscr_args_set_output (args, LISCR_ARGS_OUTPUT_TABLE);
+	liscr_args_sets_int (args, "alloc", stats.alloc);
+	liscr_args_sets_float (args, "budget", stats.budget);
+	liscr_args_sets_int (args, "cycles", stats.cycles);
+	liscr_args_sets_int (args, "live", stats.live);
+	liscr_args_sets_int (args, "memory", stats.memory);
+	liscr_args_sets_int (args, "overruns", stats.overruns);
+	liscr_args_sets_int (args, "step", stats.step);
+	liscr_args_sets_float (args, "time", stats.time);
+}
+
 static void Program_get_quit (LIScrArgs* args)
 {
 	LIMaiProgram* program;
@@ -293,17 +385,24 @@ static void Program_get_time (LIScrArgs* args)
 void liscr_script_program (
 	LIScrScript* self)
 {
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_benchmark", Program_benchmark);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_launch_mod", Program_launch_mod);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_load_extension", Program_load_extension);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_pop_message", Program_pop_message);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_pop_messages", Program_pop_messages);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_push_message", Program_push_message);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_serialize", Program_serialize);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_unittest", Program_unittest);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_unserialize", Program_unserialize);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_unload_sector", Program_unload_sector);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_unload_world", Program_unload_world);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_shutdown", Program_shutdown);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_update", Program_update);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_wait", Program_wait);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_get_args", Program_get_args);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_get_gc_budget", Program_get_gc_budget);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_set_gc_budget", Program_set_gc_budget);
+	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_get_gc_stats", Program_get_gc_stats);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_get_quit", Program_get_quit);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_set_quit", Program_set_quit);
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_PROGRAM, "program_get_sectors", Program_get_sectors);
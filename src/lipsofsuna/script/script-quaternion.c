@@ -159,6 +159,17 @@ static void Quaternion_normalize (LIScrArgs* args)
 	liscr_args_seti_quaternion (args, &tmp);
 }
 
+static void Quaternion_get_components (LIScrArgs* args)
+{
+	LIMatQuaternion* data;
+
+	data = args->self;
+	liscr_args_seti_float (args, data->x);
+	liscr_args_seti_float (args, data->y);
+	liscr_args_seti_float (args, data->z);
+	liscr_args_seti_float (args, data->w);
+}
+
 static void Quaternion_get_conjugate (LIScrArgs* args)
 {
 	LIMatQuaternion* data;
@@ -236,6 +247,7 @@ void liscr_script_quaternion (
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_tostring", Quaternion_tostring);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_nlerp", Quaternion_nlerp);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_normalize", Quaternion_normalize);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_get_components", Quaternion_get_components);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_get_conjugate", Quaternion_get_conjugate);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_get_euler", Quaternion_get_euler);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_QUATERNION, "quaternion_get_length", Quaternion_get_length);
@@ -0,0 +1,536 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LIScr Script
+ * @{
+ * \addtogroup LIScrSerialize Serialize
+ * @{
+ */
+
+#include <math.h>
+#include <lipsofsuna/engine.h>
+#include <lipsofsuna/system.h>
+#include "script-library.h"
+#include "script-private.h"
+#include "script-serialize.h"
+#include "script-util.h"
+
+static int private_read (
+	LIArcReader* reader,
+	lua_State*   lua,
+	int          wrap,
+	int          depth);
+
+static int private_read_float (
+	LIArcReader* reader,
+	float*       result,
+	int          count);
+
+static int private_read_varint (
+	LIArcReader* reader,
+	uint64_t*    result);
+
+static int private_wrap (
+	lua_State*  lua,
+	int         wrap,
+	const char* name);
+
+static int private_write (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index,
+	int          depth);
+
+static int private_write_data (
+	LIArcWriter* writer,
+	LIScrData*   data);
+
+static int private_write_varint (
+	LIArcWriter* writer,
+	uint64_t     value);
+
+/*****************************************************************************/
+
+/**
+ * \brief Decodes a versioned value written with #liscr_serialize_encode.
+ *
+ * The stream is decoded in a single pass. Vectors and quaternions are
+ * decoded as value userdata and objects as their IDs. If the wrap table
+ * is given, its "vector", "quaternion" and "object" fields are used to
+ * wrap the decoded values. If the field is a function, it is called with
+ * the value and the return value is used instead. If the field is a table,
+ * it is used as a prototype: the value is stored to the handle field of a
+ * new table that has the same class field and metatable as the prototype.
+ *
+ * Nothing is pushed if the function fails.
+ *
+ * \param reader Reader.
+ * \param lua Lua state.
+ * \param wrap Stack index of the wrap table or zero.
+ * \return Nonzero on success.
+ */
+int liscr_serialize_decode (
+	LIArcReader* reader,
+	lua_State*   lua,
+	int          wrap)
+{
+	uint8_t magic;
+	uint8_t version;
+
+	if (!liarc_reader_get_uint8 (reader, &magic) ||
+	    !liarc_reader_get_uint8 (reader, &version))
+		return 0;
+	if (magic != LISCR_SERIALIZE_MAGIC)
+	{
+		lisys_error_set (EINVAL, "invalid serialized data");
+		return 0;
+	}
+	if (version != LISCR_SERIALIZE_VERSION)
+	{
+		lisys_error_set (EINVAL, "unsupported serialized data version %d", version);
+		return 0;
+	}
+	if (wrap < 0 && wrap > LUA_REGISTRYINDEX)
+		wrap = lua_gettop (lua) + wrap + 1;
+	if (wrap && !lua_istable (lua, wrap))
+		wrap = 0;
+
+	return private_read (reader, lua, wrap, 0);
+}
+
+/**
+ * \brief Encodes a Lua value into a versioned stream.
+ *
+ * Like #liscr_serialize_write but prefixes the stream with a version header
+ * so that the stream can be stored persistently.
+ *
+ * \param writer Writer.
+ * \param lua Lua state.
+ * \param index Stack index of the value.
+ * \return Nonzero on success.
+ */
+int liscr_serialize_encode (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index)
+{
+	if (!liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_MAGIC) ||
+	    !liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_VERSION))
+		return 0;
+
+	return liscr_serialize_write (writer, lua, index);
+}
+
+/**
+ * \brief Reads a serialized value and pushes it to the Lua stack.
+ *
+ * Vectors and quaternions are pushed as value userdata and objects as
+ * their IDs. Nothing is pushed if the function fails.
+ *
+ * \param reader Reader.
+ * \param lua Lua state.
+ * \return Nonzero on success.
+ */
+int liscr_serialize_read (
+	LIArcReader* reader,
+	lua_State*   lua)
+{
+	return private_read (reader, lua, 0, 0);
+}
+
+/**
+ * \brief Serializes a Lua value.
+ *
+ * The serialized form is a compact binary stream that can be decoded in
+ * another Lua state without invoking the parser. Supported values are nil,
+ * booleans, numbers, strings, vectors, quaternions, engine objects and
+ * tables containing them. Vectors, quaternions and objects may be passed
+ * either as userdata or as tables whose handle field contains the
+ * userdata. Objects are stored as references by ID.
+ *
+ * Other types and tables nested deeper than LISCR_SERIALIZE_DEPTH, which
+ * includes all cyclic tables, cause the function to fail.
+ *
+ * \param writer Writer.
+ * \param lua Lua state.
+ * \param index Stack index of the value.
+ * \return Nonzero on success.
+ */
+int liscr_serialize_write (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index)
+{
+	if (index < 0 && index > LUA_REGISTRYINDEX)
+		index = lua_gettop (lua) + index + 1;
+	return private_write (writer, lua, index, 0);
+}
+
+/*****************************************************************************/
+
+static int private_read (
+	LIArcReader* reader,
+	lua_State*   lua,
+	int          wrap,
+	int          depth)
+{
+	uint8_t type;
+	uint32_t len;
+	uint32_t hi;
+	uint32_t lo;
+	uint64_t bits;
+	uint64_t varint;
+	int64_t integer;
+	float real;
+	double number;
+	LIMatQuaternion quat;
+	LIMatVector vector;
+	LIScrData* data;
+
+	if (!liarc_reader_get_uint8 (reader, &type))
+		return 0;
+	switch (type)
+	{
+		case LISCR_SERIALIZE_NIL:
+			lua_pushnil (lua);
+			return 1;
+		case LISCR_SERIALIZE_FALSE:
+			lua_pushboolean (lua, 0);
+			return 1;
+		case LISCR_SERIALIZE_TRUE:
+			lua_pushboolean (lua, 1);
+			return 1;
+		case LISCR_SERIALIZE_NUMBER:
+			if (!liarc_reader_get_uint32 (reader, &hi) ||
+			    !liarc_reader_get_uint32 (reader, &lo))
+				return 0;
+			bits = (((uint64_t) hi) << 32) | lo;
+			memcpy (&number, &bits, sizeof (double));
+			lua_pushnumber (lua, number);
+			return 1;
+		case LISCR_SERIALIZE_INTEGER:
+			if (!private_read_varint (reader, &varint))
+				return 0;
+			integer = (int64_t)(varint >> 1) ^ -(int64_t)(varint & 1);
+			lua_pushnumber (lua, integer);
+			return 1;
+		case LISCR_SERIALIZE_FLOAT:
+			if (!liarc_reader_get_float (reader, &real))
+				return 0;
+			lua_pushnumber (lua, real);
+			return 1;
+		case LISCR_SERIALIZE_STRING:
+			if (!private_read_varint (reader, &varint))
+				return 0;
+			len = varint;
+			if (varint > (uint64_t)(reader->length - reader->pos))
+			{
+				lisys_error_set (EINVAL, "unexpected end of stream");
+				return 0;
+			}
+			lua_pushlstring (lua, reader->buffer + reader->pos, len);
+			reader->pos += len;
+			return 1;
+		case LISCR_SERIALIZE_TABLE:
+			if (depth >= LISCR_SERIALIZE_DEPTH || !lua_checkstack (lua, 4))
+			{
+				lisys_error_set (EINVAL, "table nested too deeply");
+				return 0;
+			}
+			lua_newtable (lua);
+			while (1)
+			{
+				if (reader->pos < reader->length &&
+				    ((uint8_t*) reader->buffer)[reader->pos] == LISCR_SERIALIZE_END)
+				{
+					reader->pos++;
+					return 1;
+				}
+				if (!private_read (reader, lua, wrap, depth + 1))
+				{
+					lua_pop (lua, 1);
+					return 0;
+				}
+				if (!private_read (reader, lua, wrap, depth + 1))
+				{
+					lua_pop (lua, 2);
+					return 0;
+				}
+				if (lua_isnil (lua, -2))
+				{
+					lua_pop (lua, 3);
+					lisys_error_set (EINVAL, "nil table key");
+					return 0;
+				}
+				lua_rawset (lua, -3);
+			}
+		case LISCR_SERIALIZE_VECTOR:
+			if (!private_read_float (reader, &vector.x, 3))
+				return 0;
+			data = liscr_data_new_value (liscr_script (lua), lua, sizeof (LIMatVector), LISCR_SCRIPT_VECTOR);
+			if (data == NULL)
+				return 0;
+			*((LIMatVector*) data->data) = vector;
+			return private_wrap (lua, wrap, "vector");
+		case LISCR_SERIALIZE_QUATERNION:
+			if (!private_read_float (reader, &quat.x, 4))
+				return 0;
+			data = liscr_data_new_value (liscr_script (lua), lua, sizeof (LIMatQuaternion), LISCR_SCRIPT_QUATERNION);
+			if (data == NULL)
+				return 0;
+			*((LIMatQuaternion*) data->data) = quat;
+			return private_wrap (lua, wrap, "quaternion");
+		case LISCR_SERIALIZE_OBJECT:
+			if (!liarc_reader_get_uint32 (reader, &len))
+				return 0;
+			lua_pushnumber (lua, len);
+			return private_wrap (lua, wrap, "object");
+		default:
+			lisys_error_set (EINVAL, "invalid serialized value type %d", type);
+			return 0;
+	}
+}
+
+static int private_read_float (
+	LIArcReader* reader,
+	float*       result,
+	int          count)
+{
+	int i;
+
+	for (i = 0 ; i < count ; i++)
+	{
+		if (!liarc_reader_get_float (reader, result + i))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int private_read_varint (
+	LIArcReader* reader,
+	uint64_t*    result)
+{
+	int shift;
+	uint8_t byte;
+
+	*result = 0;
+	for (shift = 0 ; shift < 64 ; shift += 7)
+	{
+		if (!liarc_reader_get_uint8 (reader, &byte))
+			return 0;
+		*result |= ((uint64_t)(byte & 0x7F)) << shift;
+		if (!(byte & 0x80))
+			return 1;
+	}
+	lisys_error_set (EINVAL, "invalid variable length integer");
+
+	return 0;
+}
+
+static int private_wrap (
+	lua_State*  lua,
+	int         wrap,
+	const char* name)
+{
+	if (!wrap)
+		return 1;
+
+	/* Get the wrapper. */
+	if (!lua_checkstack (lua, 4))
+	{
+		lisys_error_set (ENOMEM, NULL);
+		return 0;
+	}
+	lua_getfield (lua, wrap, name);
+
+	/* Replace the value with a copy of the prototype. */
+	if (lua_type (lua, -1) == LUA_TTABLE)
+	{
+		lua_createtable (lua, 0, 2);
+		lua_pushstring (lua, "class");
+		lua_pushstring (lua, "class");
+		lua_rawget (lua, -4);
+		lua_rawset (lua, -3);
+		lua_pushstring (lua, "handle");
+		lua_pushvalue (lua, -4);
+		lua_rawset (lua, -3);
+		if (lua_getmetatable (lua, -2))
+			lua_setmetatable (lua, -2);
+		lua_replace (lua, -3);
+		lua_pop (lua, 1);
+		return 1;
+	}
+	if (lua_type (lua, -1) != LUA_TFUNCTION)
+	{
+		lua_pop (lua, 1);
+		return 1;
+	}
+
+	/* Replace the value with the return value of the function. */
+	lua_insert (lua, -2);
+	if (lua_pcall (lua, 1, 1, 0) != 0)
+	{
+		lisys_error_set (EINVAL, "%s", lua_tostring (lua, -1));
+		lua_pop (lua, 1);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int private_write (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index,
+	int          depth)
+{
+	size_t len;
+	int64_t integer;
+	uint64_t bits;
+	double number;
+	const char* str;
+	LIScrData* data;
+
+	switch (lua_type (lua, index))
+	{
+		case LUA_TNIL:
+			return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_NIL);
+		case LUA_TBOOLEAN:
+			if (lua_toboolean (lua, index))
+				return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_TRUE);
+			return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_FALSE);
+		case LUA_TNUMBER:
+			number = lua_tonumber (lua, index);
+			if (number >= -LISCR_SERIALIZE_INTEGER_MAX && number <= LISCR_SERIALIZE_INTEGER_MAX &&
+			    number == (int64_t) number && (number != 0.0 || !signbit (number)))
+			{
+				/* Integers are zigzag encoded so that small negative numbers are short. */
+				integer = (int64_t) number;
+				return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_INTEGER) &&
+				       private_write_varint (writer, ((uint64_t) integer << 1) ^ (uint64_t)(integer >> 63));
+			}
+			if (number == (float) number)
+			{
+				return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_FLOAT) &&
+				       liarc_writer_append_float (writer, number);
+			}
+			memcpy (&bits, &number, sizeof (double));
+			return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_NUMBER) &&
+			       liarc_writer_append_uint32 (writer, bits >> 32) &&
+			       liarc_writer_append_uint32 (writer, bits & 0xFFFFFFFF);
+		case LUA_TSTRING:
+			str = lua_tolstring (lua, index, &len);
+			return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_STRING) &&
+			       private_write_varint (writer, len) &&
+			       liarc_writer_append_raw (writer, str, len);
+		case LUA_TTABLE:
+			if (depth >= LISCR_SERIALIZE_DEPTH || !lua_checkstack (lua, 4))
+			{
+				lisys_error_set (EINVAL, "table nested too deeply or cyclic");
+				return 0;
+			}
+			/* Tables wrapping userdata are stored as the userdata. */
+			lua_pushstring (lua, "handle");
+			lua_rawget (lua, index);
+			data = liscr_isanydata (lua, -1);
+			lua_pop (lua, 1);
+			if (data != NULL)
+				return private_write_data (writer, data);
+			/* Plain tables are stored as key-value pairs. */
+			if (!liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_TABLE))
+				return 0;
+			lua_pushnil (lua);
+			while (lua_next (lua, index) != 0)
+			{
+				if (!private_write (writer, lua, lua_gettop (lua) - 1, depth + 1) ||
+				    !private_write (writer, lua, lua_gettop (lua), depth + 1))
+				{
+					lua_pop (lua, 2);
+					return 0;
+				}
+				lua_pop (lua, 1);
+			}
+			return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_END);
+		case LUA_TUSERDATA:
+			data = liscr_isanydata (lua, index);
+			if (data != NULL)
+				return private_write_data (writer, data);
+			/* Fall through. */
+		default:
+			lisys_error_set (EINVAL, "cannot serialize a value of type %s", lua_typename (lua, lua_type (lua, index)));
+			return 0;
+	}
+}
+
+static int private_write_data (
+	LIArcWriter* writer,
+	LIScrData*   data)
+{
+	LIEngObject* object;
+	LIMatQuaternion* quat;
+	LIMatVector* vector;
+
+	if (!strcmp (data->type, LISCR_SCRIPT_VECTOR))
+	{
+		vector = data->data;
+		return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_VECTOR) &&
+		       liarc_writer_append_float (writer, vector->x) &&
+		       liarc_writer_append_float (writer, vector->y) &&
+		       liarc_writer_append_float (writer, vector->z);
+	}
+	if (!strcmp (data->type, LISCR_SCRIPT_QUATERNION))
+	{
+		quat = data->data;
+		return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_QUATERNION) &&
+		       liarc_writer_append_float (writer, quat->x) &&
+		       liarc_writer_append_float (writer, quat->y) &&
+		       liarc_writer_append_float (writer, quat->z) &&
+		       liarc_writer_append_float (writer, quat->w);
+	}
+	if (!strcmp (data->type, LISCR_SCRIPT_OBJECT))
+	{
+		object = data->data;
+		return liarc_writer_append_uint8 (writer, LISCR_SERIALIZE_OBJECT) &&
+		       liarc_writer_append_uint32 (writer, object->id);
+	}
+	lisys_error_set (EINVAL, "cannot serialize userdata of type %s", data->type);
+
+	return 0;
+}
+
+static int private_write_varint (
+	LIArcWriter* writer,
+	uint64_t     value)
+{
+	int len = 0;
+	uint8_t tmp[10];
+
+	while (value >= 0x80)
+	{
+		tmp[len++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	tmp[len++] = value;
+
+	return liarc_writer_append_raw (writer, tmp, len);
+}
+
+/** @} */
+/** @} */
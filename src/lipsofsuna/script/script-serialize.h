@@ -0,0 +1,65 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __SCRIPT_SERIALIZE_H__
+#define __SCRIPT_SERIALIZE_H__
+
+#include <lipsofsuna/archive.h>
+#include "script-types.h"
+
+#define LISCR_SERIALIZE_DEPTH 32
+#define LISCR_SERIALIZE_INTEGER_MAX 9007199254740992.0
+#define LISCR_SERIALIZE_MAGIC 'S'
+#define LISCR_SERIALIZE_VERSION 1
+
+enum
+{
+	LISCR_SERIALIZE_NIL,
+	LISCR_SERIALIZE_FALSE,
+	LISCR_SERIALIZE_TRUE,
+	LISCR_SERIALIZE_NUMBER,
+	LISCR_SERIALIZE_STRING,
+	LISCR_SERIALIZE_TABLE,
+	LISCR_SERIALIZE_END,
+	LISCR_SERIALIZE_INTEGER,
+	LISCR_SERIALIZE_FLOAT,
+	LISCR_SERIALIZE_VECTOR,
+	LISCR_SERIALIZE_QUATERNION,
+	LISCR_SERIALIZE_OBJECT
+};
+
+LIAPICALL (int, liscr_serialize_decode, (
+	LIArcReader* reader,
+	lua_State*   lua,
+	int          wrap));
+
+LIAPICALL (int, liscr_serialize_encode, (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index));
+
+LIAPICALL (int, liscr_serialize_read, (
+	LIArcReader* reader,
+	lua_State*   lua));
+
+LIAPICALL (int, liscr_serialize_write, (
+	LIArcWriter* writer,
+	lua_State*   lua,
+	int          index));
+
+#endif
@@ -29,6 +29,7 @@
 
 typedef struct _LIScrArgs LIScrArgs;
 typedef struct _LIScrData LIScrData;
+typedef struct _LIScrGcStats LIScrGcStats;
 typedef struct _LIScrScript LIScrScript;
 typedef void (*LIScrGCFunc)();
 typedef int (*LIScrMarshal)(lua_State*);
@@ -27,42 +27,33 @@
 #include "script-private.h"
 #include "script-util.h"
 
-#define ALL_USERDATA_IS_OURS
-
+/**
+ * \brief Gets any script userdata from stack.
+ *
+ * All userdata in the script are assumed to be created by us, so the type
+ * is recognized by the signature byte alone. Value type userdata aren't in
+ * the lookup table so a table check wouldn't work for them anyway. Reference
+ * type userdata hold a pointer to their record instead of the record itself.
+ *
+ * \param lua Lua state.
+ * \param arg Stack index.
+ * \return Userdata owned by Lua or NULL.
+ */
 LIScrData* liscr_isanydata (
 	lua_State* lua,
 	int        arg)
 {
-#ifdef ALL_USERDATA_IS_OURS
 	LIScrData* ptr;
-	ptr = lua_touserdata (lua, arg);
-	if (ptr == NULL || ptr->signature != 'D')
-		return NULL;
-	return ptr;
-#else
-	int ret;
-	void* ptr;
 
-	/* Check if userdata. */
 	ptr = lua_touserdata (lua, arg);
 	if (ptr == NULL)
 		return NULL;
-
-	/* Get the data lookup table. */
-	lua_pushlightuserdata (lua, LISCR_SCRIPT_LOOKUP_DATA);
-	lua_gettable (lua, LUA_REGISTRYINDEX);
-	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
-
-	/* Check if in the lookup table. */
-	lua_pushlightuserdata (lua, ptr);
-	lua_gettable (lua, -2);
-	ret = lua_isuserdata (lua, -1);
-	lua_pop (lua, 2);
-	if (!ret)
+	if (ptr->signature == 'B')
+		return ((LIScrDataBox*) ptr)->data;
+	if (ptr->signature != 'D')
 		return NULL;
 
 	return ptr;
-#endif
 }
 
 /**
@@ -109,18 +100,18 @@ int liscr_pushdata (
 	LIScrData* object)
 {
 	/* Get the lookup table. */
-	lua_pushlightuserdata (lua, LISCR_SCRIPT_LOOKUP_DATA);
-	lua_gettable (lua, LUA_REGISTRYINDEX);
+	if (!object->slot)
+		return 0;
+	lua_rawgeti (lua, LUA_REGISTRYINDEX, object->script->lookup);
 	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
 
 	/* Get the userdata. */
 	/* In some cases, the object might have been garbage collected when we
 	   do this. We let the caller decide whether to catch the error or prevent
 	   it by disabling garbage collection. */
-	lua_pushlightuserdata (lua, object);
-	lua_gettable (lua, -2);
+	lua_rawgeti (lua, -1, object->slot);
 	lua_remove (lua, -2);
-	if (!lua_isuserdata (lua, -1))
+	if (liscr_isanydata (lua, -1) != object)
 	{
 		lua_pop (lua, 1);
 		return 0;
@@ -129,6 +120,41 @@ int liscr_pushdata (
 	return 1;
 }
 
+/**
+ * \brief Pushes the script wrapper of the userdata to stack.
+ *
+ * If the script has assigned a wrapper table to the userdata with
+ * Los.data_set_wrapper, the wrapper is pushed instead of the userdata
+ * so that scripts don't need to look it up themselves. The wrappers are
+ * referenced weakly, so the userdata is pushed if its wrapper has been
+ * garbage collected.
+ *
+ * Consumes: 0.
+ * Returns: 1.
+ *
+ * \param lua Lua state.
+ * \param object Pointer to script userdata.
+ * \return Nonzero if succeded.
+ */
+int liscr_pushwrapper (
+	lua_State* lua,
+	LIScrData* object)
+{
+	/* Get the wrapper. */
+	if (!object->slot)
+		return 0;
+	lua_rawgeti (lua, LUA_REGISTRYINDEX, object->script->wrappers);
+	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
+	lua_rawgeti (lua, -1, object->slot);
+	lua_remove (lua, -2);
+	if (!lua_isnil (lua, -1))
+		return 1;
+	lua_pop (lua, 1);
+
+	/* Push the userdata if there's no wrapper. */
+	return liscr_pushdata (lua, object);
+}
+
 /**
  * \brief Returns the current script.
  *
@@ -33,6 +33,10 @@ LIAPICALL (int, liscr_pushdata, (
 	lua_State* lua,
 	LIScrData* object));
 
+LIAPICALL (int, liscr_pushwrapper, (
+	lua_State* lua,
+	LIScrData* object));
+
 LIAPICALL (LIScrScript*, liscr_script, (
 	lua_State* lua));
 
@@ -29,6 +29,9 @@ static void Vector_new (LIScrArgs* args)
 {
 	LIMatVector vec = { 0.0f, 0.0f, 0.0f };
 
+	liscr_args_geti_float (args, 0, &vec.x);
+	liscr_args_geti_float (args, 1, &vec.y);
+	liscr_args_geti_float (args, 2, &vec.z);
 	liscr_args_seti_vector (args, &vec);
 }
 
@@ -44,6 +47,16 @@ static void Vector_add (LIScrArgs* args)
 	liscr_args_seti_vector (args, &tmp);
 }
 
+static void Vector_add_into (LIScrArgs* args)
+{
+	LIScrData* b;
+
+	if (!liscr_args_geti_data (args, 0, LISCR_SCRIPT_VECTOR, &b))
+		return;
+
+	*((LIMatVector*) args->self) = limat_vector_add (*((LIMatVector*) args->self), *((LIMatVector*) b->data));
+}
+
 static void Vector_mul (LIScrArgs* args)
 {
 	float s;
@@ -56,6 +69,16 @@ static void Vector_mul (LIScrArgs* args)
 	liscr_args_seti_vector (args, &tmp);
 }
 
+static void Vector_mul_into (LIScrArgs* args)
+{
+	float s;
+
+	if (!liscr_args_geti_float (args, 0, &s))
+		return;
+
+	*((LIMatVector*) args->self) = limat_vector_multiply (*((LIMatVector*) args->self), s);
+}
+
 static void Vector_sub (LIScrArgs* args)
 {
 	LIMatVector tmp;
@@ -68,6 +91,16 @@ static void Vector_sub (LIScrArgs* args)
 	liscr_args_seti_vector (args, &tmp);
 }
 
+static void Vector_sub_into (LIScrArgs* args)
+{
+	LIScrData* b;
+
+	if (!liscr_args_geti_data (args, 0, LISCR_SCRIPT_VECTOR, &b))
+		return;
+
+	*((LIMatVector*) args->self) = limat_vector_subtract (*((LIMatVector*) args->self), *((LIMatVector*) b->data));
+}
+
 static void Vector_tostring (LIScrArgs* args)
 {
 	char buffer[256];
@@ -110,6 +143,27 @@ static void Vector_normalize (LIScrArgs* args)
 	liscr_args_seti_vector (args, &tmp);
 }
 
+static void Vector_get_components (LIScrArgs* args)
+{
+	LIMatVector* self;
+
+	self = args->self;
+	liscr_args_seti_float (args, self->x);
+	liscr_args_seti_float (args, self->y);
+	liscr_args_seti_float (args, self->z);
+}
+
+static void Vector_set_components (LIScrArgs* args)
+{
+	LIMatVector vec = { 0.0f, 0.0f, 0.0f };
+
+	/* Missing components are zero like in Vector_new. */
+	liscr_args_geti_float (args, 0, &vec.x);
+	liscr_args_geti_float (args, 1, &vec.y);
+	liscr_args_geti_float (args, 2, &vec.z);
+	*((LIMatVector*) args->self) = vec;
+}
+
 static void Vector_get_length (LIScrArgs* args)
 {
 	liscr_args_seti_float (args, limat_vector_get_length (*((LIMatVector*) args->self)));
@@ -149,12 +203,17 @@ void liscr_script_vector (
 {
 	liscr_script_insert_cfunc (self, LISCR_SCRIPT_VECTOR, "vector_new", Vector_new);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_add", Vector_add);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_add_into", Vector_add_into);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_mul", Vector_mul);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_mul_into", Vector_mul_into);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_sub", Vector_sub);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_sub_into", Vector_sub_into);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_tostring", Vector_tostring);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_cross", Vector_cross);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_dot", Vector_dot);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_normalize", Vector_normalize);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_get_components", Vector_get_components);
+	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_set_components", Vector_set_components);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_get_length", Vector_get_length);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_get_x", Vector_get_x);
 	liscr_script_insert_mfunc (self, LISCR_SCRIPT_VECTOR, "vector_set_x", Vector_set_x);
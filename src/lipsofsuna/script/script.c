@@ -22,6 +22,8 @@
  * @{
  */
 
+#include <stdio.h>
+#include <sys/time.h>
 #include <lipsofsuna/system.h>
 #include "script.h"
 #include "script-args.h"
@@ -29,14 +31,48 @@
 #include "script-private.h"
 #include "script-util.h"
 
+static char* private_cache_path (
+	LIScrScript* self,
+	const char*  path);
+
+static int private_cache_read (
+	LIScrScript*     self,
+	const char*      path,
+	const LISysStat* stat);
+
+static void private_cache_write (
+	LIScrScript*     self,
+	const char*      path,
+	const LISysStat* stat);
+
+static int private_cache_writer (
+	lua_State*  lua,
+	const void* data,
+	size_t      size,
+	void*       user);
+
+static int private_data_get_wrapper (
+	lua_State* lua);
+
+static int private_data_set_wrapper (
+	lua_State* lua);
+
 static int private_exec_script (
 	LIScrScript* self);
 
+static int private_gc_count (
+	LIScrScript* self);
+
+static double private_gc_time ();
+
 static int private_init_includes (
 	LIScrScript* self,
 	const char*  path1,
 	const char*  path2);
 
+static int private_loader (
+	lua_State* lua);
+
 /*****************************************************************************/
 
 /**
@@ -51,6 +87,8 @@ LIScrScript* liscr_script_new ()
 	self = lisys_calloc (1, sizeof (LIScrScript));
 	if (self == NULL)
 		return NULL;
+	self->gc.budget = LISCR_SCRIPT_GC_BUDGET;
+	self->gc.step = LISCR_SCRIPT_GC_STEP_MIN;
 	self->userdata = lialg_strdic_new ();
 	if (self->userdata == NULL)
 	{
@@ -88,6 +126,13 @@ LIScrScript* liscr_script_new ()
 	lua_pushstring (self->lua, LUA_DBLIBNAME);
 	lua_call (self->lua, 1, 0);
 
+	/* Replace the Lua file loader of require with a caching one. */
+	lua_getglobal (self->lua, "package");
+	lua_getfield (self->lua, -1, "loaders");
+	lua_pushcfunction (self->lua, private_loader);
+	lua_rawseti (self->lua, -2, 2);
+	lua_pop (self->lua, 2);
+
 	/* Create shortcut to self. */
 	lua_pushlightuserdata (self->lua, LISCR_SCRIPT_SELF);
 	lua_pushlightuserdata (self->lua, self);
@@ -98,17 +143,32 @@ LIScrScript* liscr_script_new ()
 	lua_newtable (self->lua);
 	lua_settable (self->lua, LUA_REGISTRYINDEX);
 
-	/* Create pointer->data lookup table. */
-	lua_pushlightuserdata (self->lua, LISCR_SCRIPT_LOOKUP_DATA);
+	/* Create slot->data lookup table. */
 	lua_newtable (self->lua);
 	lua_newtable (self->lua);
 	lua_pushstring (self->lua, "v");
 	lua_setfield (self->lua, -2, "__mode");
 	lua_setmetatable (self->lua, -2);
-	lua_settable (self->lua, LUA_REGISTRYINDEX);
+	self->lookup = luaL_ref (self->lua, LUA_REGISTRYINDEX);
+
+	/* Create type->metatable lookup table. */
+	lua_newtable (self->lua);
+	self->metatables = luaL_ref (self->lua, LUA_REGISTRYINDEX);
+
+	/* Create slot->wrapper lookup table. */
+	lua_newtable (self->lua);
+	lua_newtable (self->lua);
+	lua_pushstring (self->lua, "v");
+	lua_setfield (self->lua, -2, "__mode");
+	lua_setmetatable (self->lua, -2);
+	self->wrappers = luaL_ref (self->lua, LUA_REGISTRYINDEX);
 
 	/* Initialize the function table. */
 	lua_newtable (self->lua);
+	lua_pushcfunction (self->lua, private_data_get_wrapper);
+	lua_setfield (self->lua, -2, "data_get_wrapper");
+	lua_pushcfunction (self->lua, private_data_set_wrapper);
+	lua_setfield (self->lua, -2, "data_set_wrapper");
 	lua_setglobal (self->lua, "Los");
 
 	/* Initialize random numbers. */
@@ -136,7 +196,13 @@ void liscr_script_free (LIScrScript* self)
 	lua_close (self->lua);
 	self->lua = NULL;
 
+	/* Free the pooled userdata records. */
+	while (self->pool.count)
+		lisys_free (self->pool.array[--self->pool.count]);
+	lisys_free (self->pool.array);
+	lisys_free (self->slots.array);
 	lialg_strdic_free (self->userdata);
+	lisys_free (self->cache);
 	lisys_free (self);
 }
 
@@ -192,7 +258,7 @@ int liscr_script_load_file (
 		return 0;
 
 	/* Load the file. */
-	ret = luaL_loadfile (self->lua, path);
+	ret = liscr_script_load_chunk (self, path);
 	if (ret)
 	{
 		lisys_error_set (EIO, "%s", lua_tostring (self->lua, -1));
@@ -207,6 +273,39 @@ int liscr_script_load_file (
 	return 1;
 }
 
+/**
+ * \brief Compiles a file and pushes the resulting chunk to the stack.
+ *
+ * If a cache directory has been set, the compiled bytecode is stored there
+ * and reused as long as the modification time and the size of the source
+ * file stay the same. Scripts loaded with require go through this too.
+ *
+ * \param self Script.
+ * \param path Path to the file.
+ * \return Zero on success, or a Lua error code with the message pushed.
+ */
+int liscr_script_load_chunk (
+	LIScrScript* self,
+	const char*  path)
+{
+	int ret;
+	LISysStat stat;
+
+	/* Try to load from the cache. */
+	if (self->cache == NULL || !lisys_filesystem_stat (path, &stat))
+		return luaL_loadfile (self->lua, path);
+	if (private_cache_read (self, path, &stat))
+		return 0;
+
+	/* Compile and update the cache. */
+	ret = luaL_loadfile (self->lua, path);
+	if (ret)
+		return ret;
+	private_cache_write (self, path, &stat);
+
+	return 0;
+}
+
 /**
  * \brief Executes a string.
  * \param self Script.
@@ -244,6 +343,19 @@ int liscr_script_load_string (
 
 /**
  * \brief Updates the script.
+ *
+ * Runs the garbage collector scheduler. This should be called once per tick
+ * at a point where it is safe to collect garbage. The collector is advanced
+ * incrementally in steps until it has done at least twice as much work as
+ * was allocated since the previous tick, a collection cycle completes, or
+ * the time budget runs out. The step size follows the allocation rate so
+ * that busy ticks don't need a huge number of small steps.
+ *
+ * Between ticks the automatic collector stays stopped so that collection
+ * only happens here. If the memory use grows past twice the live size of
+ * the last completed cycle, the budget is ignored until a cycle completes
+ * so that the memory use stays bounded even if the budget is too small.
+ *
  * \param self Script.
  * \param secs Duration of the tick in seconds.
  */
@@ -251,10 +363,78 @@ void liscr_script_update (
 	LIScrScript* self,
 	float        secs)
 {
+	int done;
+	int limit;
+	int memory;
+	int over;
+	int work;
+	double start;
+	double time;
+
+	if (self->gc.budget <= 0.0f)
+		return;
+
+	/* Calculate the allocation rate. */
+	memory = private_gc_count (self);
+	self->gc.alloc = LIMAT_MAX (0, memory - self->gc.memory);
+	self->gc.step = LIMAT_CLAMP (self->gc.alloc / 4096,
+		LISCR_SCRIPT_GC_STEP_MIN, LISCR_SCRIPT_GC_STEP_MAX);
+	limit = LIMAT_MAX (2 * self->gc.live, 1024 * LISCR_SCRIPT_GC_LIMIT);
+
+	/* Advance the collector within the budget. */
+	start = private_gc_time ();
+	time = 0.0;
+	for (done = work = over = 0 ; !done ; )
+	{
+		if (memory < limit)
+		{
+			if (work >= 2 * self->gc.alloc || time >= self->gc.budget)
+				break;
+		}
+		else if (time >= self->gc.budget)
+			over = 1;
+		done = lua_gc (self->lua, LUA_GCSTEP, self->gc.step);
+		work += 1024 * self->gc.step;
+		memory = private_gc_count (self);
+		time = private_gc_time () - start;
+	}
+	if (done)
+	{
+		self->gc.cycles++;
+		self->gc.live = memory;
+	}
+	self->gc.overruns += over;
+
+	/* Stepping restarts the automatic collector so stop it again. */
+	lua_gc (self->lua, LUA_GCSTOP, 0);
+	self->gc.memory = memory;
+	self->gc.time = time;
+}
+
+/**
+ * \brief Sets the bytecode cache directory.
+ *
+ * The directory is created when the first file is written to it.
+ *
+ * \param self Script.
+ * \param path Directory path or NULL to disable caching.
+ */
+void liscr_script_set_cache (
+	LIScrScript* self,
+	const char*  path)
+{
+	lisys_free (self->cache);
+	self->cache = (path != NULL)? lisys_string_dup (path) : NULL;
 }
 
 /**
  * \brief Enables or disables garbage collection.
+ *
+ * Disabling prevents the collector from running while the engine works on
+ * objects referenced by scripts. Enabling only restarts the automatic
+ * collector if the scheduler is disabled. Otherwise, the collection is
+ * deferred to the next call to #liscr_script_update.
+ *
  * \param self Script.
  * \param value Nonzero to enable.
  */
@@ -262,12 +442,54 @@ void liscr_script_set_gc (
 	LIScrScript* self,
 	int          value)
 {
-	if (value)
+	if (value && self->gc.budget <= 0.0f)
 		lua_gc (self->lua, LUA_GCRESTART, 0);
 	else
 		lua_gc (self->lua, LUA_GCSTOP, 0);
 }
 
+/**
+ * \brief Gets the time budget of the garbage collector scheduler.
+ * \param self Script.
+ * \return Time budget per tick in seconds.
+ */
+float liscr_script_get_gc_budget (
+	LIScrScript* self)
+{
+	return self->gc.budget;
+}
+
+/**
+ * \brief Sets the time budget of the garbage collector scheduler.
+ *
+ * Setting the budget to zero disables the scheduler and returns the
+ * garbage collection to the automatic collector of Lua.
+ *
+ * \param self Script.
+ * \param value Time budget per tick in seconds.
+ */
+void liscr_script_set_gc_budget (
+	LIScrScript* self,
+	float        value)
+{
+	if (value <= 0.0f && self->gc.budget > 0.0f)
+		lua_gc (self->lua, LUA_GCRESTART, 0);
+	self->gc.budget = LIMAT_MAX (0.0f, value);
+}
+
+/**
+ * \brief Gets garbage collection statistics.
+ * \param self Script.
+ * \param result Return location for the statistics.
+ */
+void liscr_script_get_gc_stats (
+	LIScrScript*  self,
+	LIScrGcStats* result)
+{
+	*result = self->gc;
+	result->memory = private_gc_count (self);
+}
+
 lua_State* liscr_script_get_lua (
 	LIScrScript* self)
 {
@@ -291,6 +513,193 @@ void liscr_script_set_userdata (
 
 /*****************************************************************************/
 
+static int private_gc_count (
+	LIScrScript* self)
+{
+	return 1024 * lua_gc (self->lua, LUA_GCCOUNT, 0) + lua_gc (self->lua, LUA_GCCOUNTB, 0);
+}
+
+static double private_gc_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
+static char* private_cache_path (
+	LIScrScript* self,
+	const char*  path)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const char* ptr;
+
+	/* The file name is the FNV-1a hash of the absolute source path. */
+	for (ptr = path ; *ptr != '\0' ; ptr++)
+	{
+		hash ^= (uint8_t) *ptr;
+		hash *= 1099511628211ULL;
+	}
+
+	return lisys_string_format ("%s/%016llx.luac", self->cache, (unsigned long long) hash);
+}
+
+static int private_cache_read (
+	LIScrScript*     self,
+	const char*      path,
+	const LISysStat* stat)
+{
+	int ret;
+	int len;
+	int size;
+	char* name;
+	char* header;
+	const char* buffer;
+	LISysMmap* mmap;
+
+	/* Map the cache file. */
+	name = private_cache_path (self, path);
+	if (name == NULL)
+		return 0;
+	mmap = lisys_mmap_open (name);
+	lisys_free (name);
+	if (mmap == NULL)
+	{
+		lisys_error_get (NULL);
+		return 0;
+	}
+	buffer = lisys_mmap_get_buffer (mmap);
+	size = lisys_mmap_get_size (mmap);
+
+	/* Validate the header. */
+	header = lisys_string_format ("%s %ld %d %s\n", LISCR_SCRIPT_CACHE_MAGIC, stat->mtime, stat->size, path);
+	if (header == NULL)
+	{
+		lisys_mmap_free (mmap);
+		return 0;
+	}
+	len = strlen (header);
+	if (size <= len || memcmp (buffer, header, len))
+	{
+		lisys_free (header);
+		lisys_mmap_free (mmap);
+		return 0;
+	}
+	lisys_free (header);
+
+	/* Load the bytecode. */
+	ret = luaL_loadbuffer (self->lua, buffer + len, size - len, path);
+	lisys_mmap_free (mmap);
+	if (ret)
+	{
+		lua_pop (self->lua, 1);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void private_cache_write (
+	LIScrScript*     self,
+	const char*      path,
+	const LISysStat* stat)
+{
+	int ok;
+	char* name;
+	char* temp;
+	FILE* file;
+
+	/* Don't cache files modified very recently. The modification time has
+	   a resolution of one second, so another edit within the same second
+	   wouldn't be noticed if the size stayed the same. */
+	if (lisys_time (NULL) - stat->mtime < 2)
+		return;
+
+	/* Create the cache directory. */
+	if (!lisys_filesystem_access (self->cache, LISYS_ACCESS_EXISTS) &&
+	    !lisys_filesystem_makepath (self->cache))
+	{
+		lisys_error_get (NULL);
+		return;
+	}
+
+	/* Write to a temporary file. */
+	/* Worker threads may compile the same file at the same time, so each
+	   writes its own temporary file that is atomically renamed in place. */
+	name = private_cache_path (self, path);
+	if (name == NULL)
+		return;
+	temp = lisys_string_format ("%s.%p.tmp", name, (void*) self);
+	if (temp == NULL)
+	{
+		lisys_free (name);
+		return;
+	}
+	file = fopen (temp, "wb");
+	if (file == NULL)
+	{
+		lisys_free (temp);
+		lisys_free (name);
+		return;
+	}
+	ok = fprintf (file, "%s %ld %d %s\n", LISCR_SCRIPT_CACHE_MAGIC, stat->mtime, stat->size, path) > 0;
+	ok &= !lua_dump (self->lua, private_cache_writer, file);
+	ok &= !fclose (file);
+
+	/* Replace the old cache file. */
+	if (!ok || rename (temp, name))
+		remove (temp);
+	lisys_free (temp);
+	lisys_free (name);
+}
+
+static int private_cache_writer (
+	lua_State*  lua,
+	const void* data,
+	size_t      size,
+	void*       user)
+{
+	return fwrite (data, 1, size, user) != size;
+}
+
+static int private_data_get_wrapper (
+	lua_State* lua)
+{
+	LIScrData* data;
+
+	data = liscr_isanydata (lua, 1);
+	if (data == NULL || !data->slot)
+		return 0;
+	liscr_pushwrapper (lua, data);
+
+	return 1;
+}
+
+static int private_data_set_wrapper (
+	lua_State* lua)
+{
+	LIScrData* data;
+
+	/* Only reference type userdata have a slot for the wrapper. The
+	   value type userdata used by vectors have none. */
+	data = liscr_isanydata (lua, 1);
+	if (data == NULL || !data->slot)
+		return 0;
+
+	/* Store the wrapper to the weak wrapper table. A strong reference would
+	   keep the wrapper alive for as long as the engine keeps the userdata. */
+	lua_rawgeti (lua, LUA_REGISTRYINDEX, data->script->wrappers);
+	lisys_assert (lua_type (lua, -1) == LUA_TTABLE);
+	if (lua_istable (lua, 2))
+		lua_pushvalue (lua, 2);
+	else
+		lua_pushnil (lua);
+	lua_rawseti (lua, -2, data->slot);
+	lua_pop (lua, 1);
+
+	return 0;
+}
+
 static int private_exec_script (
 	LIScrScript* self)
 {
@@ -338,5 +747,86 @@ static int private_init_includes (
 	return 1;
 }
 
+static int private_loader (
+	lua_State* lua)
+{
+	int errors;
+	char* tmp;
+	char* file;
+	char* path;
+	char* templates;
+	char* ptr;
+	char* next;
+	const char* name;
+	FILE* test;
+	LIScrScript* self;
+
+	/* Convert the module name to a file name. */
+	self = liscr_script (lua);
+	name = luaL_checkstring (lua, 1);
+	file = lisys_string_dup (name);
+	if (file == NULL)
+		return 0;
+	for (ptr = file ; *ptr != '\0' ; ptr++)
+	{
+		if (*ptr == '.')
+			*ptr = '/';
+	}
+
+	/* Get the search templates. */
+	lua_getglobal (lua, "package");
+	lua_getfield (lua, -1, "path");
+	templates = lisys_string_dup (lua_tostring (lua, -1));
+	lua_pop (lua, 2);
+	if (templates == NULL)
+	{
+		lisys_free (file);
+		return 0;
+	}
+
+	/* Find the first readable file. */
+	errors = 0;
+	for (ptr = templates ; ptr != NULL ; ptr = next)
+	{
+		next = strchr (ptr, ';');
+		if (next != NULL)
+			*(next++) = '\0';
+		tmp = strchr (ptr, '?');
+		if (*ptr == '\0' || tmp == NULL)
+			continue;
+		*tmp = '\0';
+		path = lisys_string_format ("%s%s%s", ptr, file, tmp + 1);
+		if (path == NULL)
+			break;
+		test = fopen (path, "r");
+		if (test != NULL)
+		{
+			fclose (test);
+			lua_settop (lua, 1);
+			if (liscr_script_load_chunk (self, path))
+			{
+				lisys_free (file);
+				lisys_free (templates);
+				lua_pushfstring (lua, "error loading module '%s' from file '%s':\n\t%s",
+					name, path, lua_tostring (lua, -1));
+				lisys_free (path);
+				return lua_error (lua);
+			}
+			lisys_free (path);
+			lisys_free (file);
+			lisys_free (templates);
+			return 1;
+		}
+		lua_pushfstring (lua, "\n\tno file '%s'", path);
+		lisys_free (path);
+		errors++;
+	}
+	lisys_free (file);
+	lisys_free (templates);
+	lua_concat (lua, errors);
+
+	return 1;
+}
+
 /** @} */
 /** @} */
@@ -24,6 +24,18 @@
 #include <lipsofsuna/system.h>
 #include "script-types.h"
 
+struct _LIScrGcStats
+{
+	int alloc;
+	int cycles;
+	int live;
+	int memory;
+	int overruns;
+	int step;
+	float budget;
+	float time;
+};
+
 LIAPICALL (LIScrScript*, liscr_script_new, ());
 
 LIAPICALL (void, liscr_script_free, (
@@ -53,14 +65,33 @@ LIAPICALL (void, liscr_script_insert_mfunc, (
 	const char*   name,
 	LIScrArgsFunc func));
 
+LIAPICALL (int, liscr_script_load_chunk, (
+	LIScrScript* self,
+	const char*  path));
+
 LIAPICALL (void, liscr_script_update, (
 	LIScrScript* self,
 	float        secs));
 
+LIAPICALL (void, liscr_script_set_cache, (
+	LIScrScript* self,
+	const char*  path));
+
 LIAPICALL (void, liscr_script_set_gc, (
 	LIScrScript* self,
 	int          value));
 
+LIAPICALL (float, liscr_script_get_gc_budget, (
+	LIScrScript* self));
+
+LIAPICALL (void, liscr_script_set_gc_budget, (
+	LIScrScript* self,
+	float        value));
+
+LIAPICALL (void, liscr_script_get_gc_stats, (
+	LIScrScript*  self,
+	LIScrGcStats* result));
+
 LIAPICALL (lua_State*, liscr_script_get_lua, (
 	LIScrScript* self));
 
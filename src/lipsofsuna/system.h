@@ -20,6 +20,8 @@
 
 #include "system/system.h"
 #include "system/system-async-call.h"
+#include "system/system-batch.h"
+#include "system/system-channel.h"
 #include "system/system-compiler.h"
 #include "system/system-directory.h"
 #include "system/system-endian.h"
@@ -37,6 +39,7 @@
 #include "system/system-string.h"
 #include "system/system-thread.h"
 #include "system/system-types.h"
+#include "system/system-unittest.h"
 #include "system/system-user.h"
 #include "system/system-utf8.h"
 
@@ -0,0 +1,758 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \addtogroup LISys System
+ * @{
+ * \addtogroup LISysBatch Batch
+ * @{
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#endif
+#include "system.h"
+#include "system-batch.h"
+#include "system-directory.h"
+#include "system-error.h"
+#include "system-filesystem.h"
+#include "system-memory.h"
+#include "system-mmap.h"
+#include "system-mutex.h"
+#include "system-path.h"
+#include "system-string.h"
+#include "system-thread.h"
+
+#define LISYS_BATCH_CACHE_MAGIC "# lipsofsuna-batch-cache 1"
+
+enum
+{
+	LISYS_BATCH_PENDING,
+	LISYS_BATCH_BUILT,
+	LISYS_BATCH_SKIPPED,
+	LISYS_BATCH_FAILED
+};
+
+typedef struct _LISysBatchEntry LISysBatchEntry;
+struct _LISysBatchEntry
+{
+	char* path;
+	uint64_t hash;
+};
+
+typedef struct _LISysBatchFile LISysBatchFile;
+struct _LISysBatchFile
+{
+	int result;
+	char* path;
+	uint64_t hash;
+};
+
+struct _LISysBatch
+{
+	void* data;
+	LISysBatchFunc func;
+	LISysBatchFunc check;
+	LISysMutex* mutex;
+	struct
+	{
+		int count;
+		int capacity;
+		LISysBatchFile* array;
+	} files;
+	struct
+	{
+		int count;
+		int sorted;
+		LISysBatchEntry* array;
+	} cache;
+	struct
+	{
+		int next;
+		int built;
+		int skipped;
+		int failed;
+		double bytes;
+	} status;
+};
+
+static int private_cache_compare (
+	const void* a,
+	const void* b);
+
+static LISysBatchEntry* private_cache_find (
+	LISysBatch* self,
+	const char* path);
+
+static int private_cache_insert (
+	LISysBatch* self,
+	const char* path,
+	uint64_t    hash);
+
+static void private_cache_sort (
+	LISysBatch* self);
+
+static void private_process (
+	LISysBatch*     self,
+	LISysBatchFile* file);
+
+static void private_worker (
+	LISysThread* thread,
+	void*        data);
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new batch processor.
+ *
+ * The batch processor collects a list of input files, runs the processing
+ * function for each of them on a pool of worker threads, and keeps a cache
+ * of content hashes so that unchanged inputs are skipped on later runs.
+ *
+ * The processing function is called from worker threads and must hence be
+ * thread safe. It receives the path of the input file and should return
+ * nonzero on success.
+ *
+ * \param func Processing function.
+ * \param data Userdata passed to the processing function.
+ * \return New batch processor or NULL.
+ */
+LISysBatch* lisys_batch_new (
+	LISysBatchFunc func,
+	void*          data)
+{
+	LISysBatch* self;
+
+	self = lisys_calloc (1, sizeof (LISysBatch));
+	if (self == NULL)
+		return NULL;
+	self->func = func;
+	self->data = data;
+	self->mutex = lisys_mutex_new ();
+	if (self->mutex == NULL)
+	{
+		lisys_free (self);
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * \brief Frees the batch processor.
+ * \param self Batch processor.
+ */
+void lisys_batch_free (
+	LISysBatch* self)
+{
+	int i;
+
+	for (i = 0 ; i < self->files.count ; i++)
+		lisys_free (self->files.array[i].path);
+	for (i = 0 ; i < self->cache.count ; i++)
+		lisys_free (self->cache.array[i].path);
+	lisys_free (self->files.array);
+	lisys_free (self->cache.array);
+	lisys_mutex_free (self->mutex);
+	lisys_free (self);
+}
+
+/**
+ * \brief Recursively adds the files of a directory to the batch.
+ *
+ * Hidden files and directories are ignored.
+ *
+ * \param self Batch processor.
+ * \param path Directory path.
+ * \param ext File extension without the leading period, or NULL for all files.
+ * \return Nonzero on success.
+ */
+int lisys_batch_add_directory (
+	LISysBatch* self,
+	const char* path,
+	const char* ext)
+{
+	int i;
+	int ret = 1;
+	char* file;
+	LISysDir* dir;
+	LISysStat st;
+
+	dir = lisys_dir_open (path);
+	if (dir == NULL)
+		return 0;
+	lisys_dir_set_filter (dir, lisys_dir_filter_visible, NULL);
+	lisys_dir_set_sorter (dir, lisys_dir_sorter_alpha);
+	if (!lisys_dir_scan (dir))
+	{
+		lisys_dir_free (dir);
+		return 0;
+	}
+
+	for (i = 0 ; i < lisys_dir_get_count (dir) ; i++)
+	{
+		file = lisys_dir_get_path (dir, i);
+		if (file == NULL)
+		{
+			ret = 0;
+			break;
+		}
+		if (!lisys_filesystem_stat (file, &st))
+			ret = 0;
+		else if (st.type == LISYS_STAT_DIRECTORY)
+			ret &= lisys_batch_add_directory (self, file, ext);
+		else if (st.type == LISYS_STAT_FILE && (ext == NULL || lisys_path_check_ext (file, ext)))
+			ret &= lisys_batch_add_file (self, file);
+		lisys_free (file);
+	}
+	lisys_dir_free (dir);
+
+	return ret;
+}
+
+/**
+ * \brief Adds a file to the batch.
+ * \param self Batch processor.
+ * \param path File path.
+ * \return Nonzero on success.
+ */
+int lisys_batch_add_file (
+	LISysBatch* self,
+	const char* path)
+{
+	int cap;
+	LISysBatchFile* tmp;
+
+	/* Resize the file list. */
+	if (self->files.count == self->files.capacity)
+	{
+		cap = self->files.capacity? 2 * self->files.capacity : 64;
+		tmp = lisys_realloc (self->files.array, cap * sizeof (LISysBatchFile));
+		if (tmp == NULL)
+			return 0;
+		self->files.array = tmp;
+		self->files.capacity = cap;
+	}
+
+	/* Append the file. */
+	tmp = self->files.array + self->files.count;
+	memset (tmp, 0, sizeof (LISysBatchFile));
+	tmp->path = lisys_string_dup (path);
+	if (tmp->path == NULL)
+		return 0;
+	self->files.count++;
+
+	return 1;
+}
+
+/**
+ * \brief Adds the files listed in a manifest to the batch.
+ *
+ * The manifest is a text file with one path per line. Empty lines and lines
+ * starting with '#' are ignored. Paths are relative to the working directory
+ * and may refer to both files and directories.
+ *
+ * \param self Batch processor.
+ * \param path Manifest path.
+ * \param ext File extension used for filtering directories, or NULL.
+ * \return Nonzero on success.
+ */
+int lisys_batch_add_manifest (
+	LISysBatch* self,
+	const char* path,
+	const char* ext)
+{
+	int len;
+	int ret = 1;
+	char line[1024];
+	FILE* file;
+
+	file = fopen (path, "r");
+	if (file == NULL)
+	{
+		lisys_error_set (EIO, "cannot open manifest `%s'", path);
+		return 0;
+	}
+	while (fgets (line, sizeof (line), file) != NULL)
+	{
+		len = strlen (line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' '))
+			line[--len] = '\0';
+		if (!len || line[0] == '#')
+			continue;
+		ret &= lisys_batch_add_path (self, line, ext);
+	}
+	fclose (file);
+
+	return ret;
+}
+
+/**
+ * \brief Adds a file or a directory to the batch.
+ *
+ * Explicitly named files are added regardless of the extension filter.
+ *
+ * \param self Batch processor.
+ * \param path File or directory path.
+ * \param ext File extension used for filtering directories, or NULL.
+ * \return Nonzero on success.
+ */
+int lisys_batch_add_path (
+	LISysBatch* self,
+	const char* path,
+	const char* ext)
+{
+	LISysStat st;
+
+	if (!lisys_filesystem_stat (path, &st))
+		return 0;
+	if (st.type == LISYS_STAT_DIRECTORY)
+		return lisys_batch_add_directory (self, path, ext);
+	return lisys_batch_add_file (self, path);
+}
+
+/**
+ * \brief Loads the content hash cache.
+ *
+ * A missing cache file is not an error since it simply means that nothing
+ * has been processed yet.
+ *
+ * \param self Batch processor.
+ * \param path Cache file path.
+ * \return Nonzero on success.
+ */
+int lisys_batch_load_cache (
+	LISysBatch* self,
+	const char* path)
+{
+	int len;
+	char line[1100];
+	FILE* file;
+	unsigned long long hash;
+
+	file = fopen (path, "r");
+	if (file == NULL)
+		return 1;
+
+	/* Check for the format version. */
+	if (fgets (line, sizeof (line), file) == NULL ||
+	    strncmp (line, LISYS_BATCH_CACHE_MAGIC, strlen (LISYS_BATCH_CACHE_MAGIC)))
+	{
+		fclose (file);
+		return 1;
+	}
+
+	/* Read the entries. */
+	while (fgets (line, sizeof (line), file) != NULL)
+	{
+		len = strlen (line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		if (len < 18 || line[16] != ' ' || sscanf (line, "%16llx", &hash) != 1)
+			continue;
+		if (!private_cache_insert (self, line + 17, hash))
+		{
+			fclose (file);
+			return 0;
+		}
+	}
+	fclose (file);
+	private_cache_sort (self);
+
+	return 1;
+}
+
+/**
+ * \brief Saves the content hash cache.
+ *
+ * The cache is written to a temporary file that then atomically replaces
+ * the old cache so that an interrupted run never leaves a corrupted cache.
+ *
+ * \param self Batch processor.
+ * \param path Cache file path.
+ * \return Nonzero on success.
+ */
+int lisys_batch_save_cache (
+	LISysBatch* self,
+	const char* path)
+{
+	int i;
+	int ret;
+	char* tmp;
+	FILE* file;
+
+	tmp = lisys_string_format ("%s.tmp", path);
+	if (tmp == NULL)
+		return 0;
+	file = fopen (tmp, "w");
+	if (file == NULL)
+	{
+		lisys_error_set (EIO, "cannot write cache `%s'", tmp);
+		lisys_free (tmp);
+		return 0;
+	}
+	fprintf (file, "%s\n", LISYS_BATCH_CACHE_MAGIC);
+	for (i = 0 ; i < self->cache.count ; i++)
+	{
+		fprintf (file, "%016llx %s\n", (unsigned long long) self->cache.array[i].hash,
+			self->cache.array[i].path);
+	}
+	ret = !ferror (file);
+	ret &= !fclose (file);
+	if (!ret)
+	{
+		lisys_error_set (EIO, "cannot write cache `%s'", tmp);
+		remove (tmp);
+		lisys_free (tmp);
+		return 0;
+	}
+	ret = lisys_batch_replace_file (tmp, path);
+	lisys_free (tmp);
+
+	return ret;
+}
+
+/**
+ * \brief Processes all the files in the batch.
+ *
+ * Files whose content hash matches the cache are skipped. The cache is
+ * updated with the new hashes of successfully processed files and the
+ * throughput statistics are printed when done.
+ *
+ * \param self Batch processor.
+ * \param threads Number of worker threads, or zero for the number of CPUs.
+ * \return Nonzero if all files were processed successfully.
+ */
+int lisys_batch_run (
+	LISysBatch* self,
+	int         threads)
+{
+	int i;
+	double secs;
+	struct timeval t0;
+	struct timeval t1;
+	LISysBatchFile* file;
+	LISysThread** workers;
+
+	/* Initialize the status. */
+	memset (&self->status, 0, sizeof (self->status));
+	for (i = 0 ; i < self->files.count ; i++)
+		self->files.array[i].result = LISYS_BATCH_PENDING;
+	if (threads <= 0)
+		threads = lisys_batch_get_cpus ();
+	if (threads > self->files.count)
+		threads = self->files.count;
+	gettimeofday (&t0, NULL);
+
+	/* Run the worker pool. If spawning threads fails, the main thread
+	   processes whatever is left over. */
+	if (threads > 1)
+	{
+		workers = lisys_calloc (threads, sizeof (LISysThread*));
+		if (workers != NULL)
+		{
+			for (i = 0 ; i < threads ; i++)
+				workers[i] = lisys_thread_new (private_worker, self);
+			for (i = 0 ; i < threads ; i++)
+			{
+				if (workers[i] != NULL)
+					lisys_thread_free (workers[i]);
+			}
+			lisys_free (workers);
+		}
+	}
+	private_worker (NULL, self);
+	gettimeofday (&t1, NULL);
+
+	/* Update the cache. */
+	for (i = 0 ; i < self->files.count ; i++)
+	{
+		file = self->files.array + i;
+		if (file->result == LISYS_BATCH_BUILT)
+			private_cache_insert (self, file->path, file->hash);
+	}
+	private_cache_sort (self);
+
+	/* Print the statistics. */
+	secs = t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) * 0.000001;
+	if (secs <= 0.0)
+		secs = 0.000001;
+	printf ("Built %d, skipped %d, failed %d of %d files in %.2f seconds\n",
+		self->status.built, self->status.skipped, self->status.failed,
+		self->files.count, secs);
+	printf ("Throughput: %.1f files/s, %.2f MB/s with %d threads\n",
+		(self->status.built + self->status.skipped) / secs,
+		self->status.bytes / (1024.0 * 1024.0) / secs, threads > 1? threads : 1);
+
+	return !self->status.failed;
+}
+
+/**
+ * \brief Sets the function used for validating cached files.
+ *
+ * The check function is called for files whose content hash matches the
+ * cache. If it returns zero, the file is processed again. This is useful
+ * for checking that the output files of the processing function exist.
+ *
+ * \param self Batch processor.
+ * \param check Check function or NULL.
+ */
+void lisys_batch_set_check (
+	LISysBatch*    self,
+	LISysBatchFunc check)
+{
+	self->check = check;
+}
+
+/**
+ * \brief Gets the number of CPUs available.
+ * \return Number of CPUs.
+ */
+int lisys_batch_get_cpus ()
+{
+#if defined HAVE_UNISTD_H && defined _SC_NPROCESSORS_ONLN
+	long num;
+	num = sysconf (_SC_NPROCESSORS_ONLN);
+	return num > 0? num : 1;
+#elif defined HAVE_WINDOWS_H
+	SYSTEM_INFO info;
+	GetSystemInfo (&info);
+	return info.dwNumberOfProcessors > 0? info.dwNumberOfProcessors : 1;
+#else
+	return 1;
+#endif
+}
+
+/**
+ * \brief Calculates the 64-bit FNV-1a hash of the contents of a file.
+ * \param path File path.
+ * \param result Return location for the hash.
+ * \return Nonzero on success.
+ */
+int lisys_batch_hash_file (
+	const char* path,
+	uint64_t*   result)
+{
+	int i;
+	int size;
+	uint64_t hash;
+	const uint8_t* buffer;
+	LISysMmap* mmap;
+
+	mmap = lisys_mmap_open (path);
+	if (mmap == NULL)
+		return 0;
+	size = lisys_mmap_get_size (mmap);
+	buffer = lisys_mmap_get_buffer (mmap);
+	hash = 14695981039346656037ULL;
+	for (i = 0 ; i < size ; i++)
+	{
+		hash ^= buffer[i];
+		hash *= 1099511628211ULL;
+	}
+	lisys_mmap_free (mmap);
+	*result = hash;
+
+	return 1;
+}
+
+/**
+ * \brief Atomically replaces a file with another.
+ *
+ * Tools should write their output to a temporary file and then replace the
+ * destination with this function so that interrupted runs never leave
+ * truncated files behind.
+ *
+ * \param src Path to the new file.
+ * \param dst Path to the file to replace.
+ * \return Nonzero on success.
+ */
+int lisys_batch_replace_file (
+	const char* src,
+	const char* dst)
+{
+#ifdef HAVE_WINDOWS_H
+	if (!MoveFileEx (src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (rename (src, dst) != 0)
+#endif
+	{
+		lisys_error_set (EIO, "cannot replace `%s'", dst);
+		remove (src);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*****************************************************************************/
+
+static int private_cache_compare (
+	const void* a,
+	const void* b)
+{
+	const LISysBatchEntry* e0 = a;
+	const LISysBatchEntry* e1 = b;
+
+	return strcmp (e0->path, e1->path);
+}
+
+static LISysBatchEntry* private_cache_find (
+	LISysBatch* self,
+	const char* path)
+{
+	LISysBatchEntry key;
+
+	if (!self->cache.sorted)
+		return NULL;
+	key.path = (char*) path;
+
+	return bsearch (&key, self->cache.array, self->cache.sorted,
+		sizeof (LISysBatchEntry), private_cache_compare);
+}
+
+static int private_cache_insert (
+	LISysBatch* self,
+	const char* path,
+	uint64_t    hash)
+{
+	LISysBatchEntry* entry;
+	LISysBatchEntry* tmp;
+
+	/* Replace an existing entry. Only the sorted part of the array is
+	   searched so new entries are appended until the array is resorted. */
+	entry = private_cache_find (self, path);
+	if (entry != NULL)
+	{
+		entry->hash = hash;
+		return 1;
+	}
+
+	/* Append a new entry. */
+	tmp = lisys_realloc (self->cache.array, (self->cache.count + 1) * sizeof (LISysBatchEntry));
+	if (tmp == NULL)
+		return 0;
+	self->cache.array = tmp;
+	entry = self->cache.array + self->cache.count;
+	entry->path = lisys_string_dup (path);
+	entry->hash = hash;
+	if (entry->path == NULL)
+		return 0;
+	self->cache.count++;
+
+	return 1;
+}
+
+static void private_cache_sort (
+	LISysBatch* self)
+{
+	qsort (self->cache.array, self->cache.count, sizeof (LISysBatchEntry), private_cache_compare);
+	self->cache.sorted = self->cache.count;
+}
+
+static void private_process (
+	LISysBatch*     self,
+	LISysBatchFile* file)
+{
+	int size;
+	LISysStat st;
+	LISysBatchEntry* entry;
+
+	/* Hash the input. */
+	size = lisys_filesystem_stat (file->path, &st)? st.size : 0;
+	if (!lisys_batch_hash_file (file->path, &file->hash))
+	{
+		lisys_error_report ();
+		file->result = LISYS_BATCH_FAILED;
+		return;
+	}
+
+	/* Skip unchanged files. The cache isn't modified while workers are
+	   running so the lookup needs no locking. */
+	entry = private_cache_find (self, file->path);
+	if (entry != NULL && entry->hash == file->hash &&
+	   (self->check == NULL || self->check (self, file->path, self->data)))
+	{
+		file->result = LISYS_BATCH_SKIPPED;
+		return;
+	}
+
+	/* Process the file. The input may have been modified in place so
+	   the hash is recalculated afterwards. */
+	if (!self->func (self, file->path, self->data))
+	{
+		lisys_error_report ();
+		file->result = LISYS_BATCH_FAILED;
+		return;
+	}
+	if (!lisys_batch_hash_file (file->path, &file->hash))
+	{
+		lisys_error_report ();
+		file->result = LISYS_BATCH_FAILED;
+		return;
+	}
+	file->result = LISYS_BATCH_BUILT;
+	lisys_mutex_lock (self->mutex);
+	self->status.bytes += size;
+	lisys_mutex_unlock (self->mutex);
+}
+
+static void private_worker (
+	LISysThread* thread,
+	void*        data)
+{
+	int index;
+	LISysBatch* self = data;
+	LISysBatchFile* file;
+
+	while (1)
+	{
+		/* Pick the next file. */
+		lisys_mutex_lock (self->mutex);
+		index = self->status.next++;
+		lisys_mutex_unlock (self->mutex);
+		if (index >= self->files.count)
+			break;
+		file = self->files.array + index;
+
+		/* Process the file. */
+		private_process (self, file);
+
+		/* Update the statistics. */
+		lisys_mutex_lock (self->mutex);
+		switch (file->result)
+		{
+			case LISYS_BATCH_BUILT: self->status.built++; break;
+			case LISYS_BATCH_SKIPPED: self->status.skipped++; break;
+			default: self->status.failed++; break;
+		}
+		lisys_mutex_unlock (self->mutex);
+	}
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,87 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SYSTEM_BATCH_H__
+#define __SYSTEM_BATCH_H__
+
+#include <stdint.h>
+#include "system-compiler.h"
+
+typedef struct _LISysBatch LISysBatch;
+typedef int (*LISysBatchFunc)(LISysBatch*, const char*, void*);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIAPICALL (LISysBatch*, lisys_batch_new, (
+	LISysBatchFunc func,
+	void*          data));
+
+LIAPICALL (void, lisys_batch_free, (
+	LISysBatch* self));
+
+LIAPICALL (int, lisys_batch_add_directory, (
+	LISysBatch* self,
+	const char* path,
+	const char* ext));
+
+LIAPICALL (int, lisys_batch_add_file, (
+	LISysBatch* self,
+	const char* path));
+
+LIAPICALL (int, lisys_batch_add_manifest, (
+	LISysBatch* self,
+	const char* path,
+	const char* ext));
+
+LIAPICALL (int, lisys_batch_add_path, (
+	LISysBatch* self,
+	const char* path,
+	const char* ext));
+
+LIAPICALL (int, lisys_batch_load_cache, (
+	LISysBatch* self,
+	const char* path));
+
+LIAPICALL (int, lisys_batch_save_cache, (
+	LISysBatch* self,
+	const char* path));
+
+LIAPICALL (int, lisys_batch_run, (
+	LISysBatch* self,
+	int         threads));
+
+LIAPICALL (void, lisys_batch_set_check, (
+	LISysBatch*    self,
+	LISysBatchFunc check));
+
+LIAPICALL (int, lisys_batch_get_cpus, ());
+
+LIAPICALL (int, lisys_batch_hash_file, (
+	const char* path,
+	uint64_t*   result));
+
+LIAPICALL (int, lisys_batch_replace_file, (
+	const char* src,
+	const char* dst));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,234 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LISys System
+ * @{
+ * \addtogroup LISysChannel Channel
+ * @{
+ */
+
+#include <stdint.h>
+#include "system-channel.h"
+#include "system-memory.h"
+
+#define LISYS_CHANNEL_PAD 64
+
+typedef struct _LISysChannelCell LISysChannelCell;
+struct _LISysChannelCell
+{
+	volatile uint32_t sequence;
+	void* data;
+};
+
+struct _LISysChannel
+{
+	uint32_t mask;
+	LISysChannelCell* cells;
+	char pad0[LISYS_CHANNEL_PAD];
+	volatile uint32_t head;
+	char pad1[LISYS_CHANNEL_PAD];
+	volatile uint32_t tail;
+	char pad2[LISYS_CHANNEL_PAD];
+};
+
+/*****************************************************************************/
+
+/**
+ * \brief Creates a new message channel.
+ *
+ * The channel is a bounded ring buffer of pointers that can be pushed and
+ * popped by any number of threads without locks. Each cell has a sequence
+ * number that tells whether it's ready for writing or reading on the
+ * current lap of the ring, so producers and consumers only contend on their
+ * own position counter.
+ *
+ * The channel only stores pointers. The ownership of the pointed data is
+ * moved from the pushing thread to the popping thread.
+ *
+ * \param capacity Minimum number of queued items, rounded up to a power of two.
+ * \return New channel or NULL.
+ */
+LISysChannel* lisys_channel_new (
+	int capacity)
+{
+	uint32_t i;
+	uint32_t size;
+	LISysChannel* self;
+
+	/* Allocate self. */
+	self = lisys_calloc (1, sizeof (LISysChannel));
+	if (self == NULL)
+		return NULL;
+
+	/* Allocate the ring. */
+	for (size = 2 ; size < (uint32_t) capacity ; size <<= 1)
+		{}
+	self->mask = size - 1;
+	self->cells = lisys_calloc (size, sizeof (LISysChannelCell));
+	if (self->cells == NULL)
+	{
+		lisys_free (self);
+		return NULL;
+	}
+	for (i = 0 ; i < size ; i++)
+		self->cells[i].sequence = i;
+
+	return self;
+}
+
+/**
+ * \brief Frees the channel.
+ *
+ * Any items still in the channel are not freed.
+ *
+ * \param self Channel.
+ */
+void lisys_channel_free (
+	LISysChannel* self)
+{
+	lisys_free (self->cells);
+	lisys_free (self);
+}
+
+/**
+ * \brief Pops an item from the channel.
+ *
+ * This function is thread safe.
+ *
+ * \param self Channel.
+ * \return Item or NULL if the channel was empty.
+ */
+void* lisys_channel_pop (
+	LISysChannel* self)
+{
+	int32_t diff;
+	uint32_t pos;
+	uint32_t seq;
+	void* data;
+	LISysChannelCell* cell;
+
+	pos = self->tail;
+	while (1)
+	{
+		cell = self->cells + (pos & self->mask);
+		seq = cell->sequence;
+		__sync_synchronize ();
+		diff = (int32_t) seq - (int32_t)(pos + 1);
+		if (diff == 0)
+		{
+			if (__sync_bool_compare_and_swap (&self->tail, pos, pos + 1))
+				break;
+			pos = self->tail;
+		}
+		else if (diff < 0)
+			return NULL;
+		else
+			pos = self->tail;
+	}
+	data = cell->data;
+	__sync_synchronize ();
+	cell->sequence = pos + self->mask + 1;
+
+	return data;
+}
+
+/**
+ * \brief Pops up to the given number of items from the channel.
+ *
+ * This function is thread safe.
+ *
+ * \param self Channel.
+ * \param result Return location for the items.
+ * \param count Maximum number of items to pop.
+ * \return Number of items popped.
+ */
+int lisys_channel_pop_batch (
+	LISysChannel* self,
+	void**        result,
+	int           count)
+{
+	int i;
+
+	for (i = 0 ; i < count ; i++)
+	{
+		result[i] = lisys_channel_pop (self);
+		if (result[i] == NULL)
+			break;
+	}
+
+	return i;
+}
+
+/**
+ * \brief Pushes an item to the channel.
+ *
+ * This function is thread safe. If the function succeeds, the ownership
+ * of the item is moved to the thread that pops it.
+ *
+ * \param self Channel.
+ * \param data Item, not NULL.
+ * \return Nonzero on success, zero if the channel was full.
+ */
+int lisys_channel_push (
+	LISysChannel* self,
+	void*         data)
+{
+	int32_t diff;
+	uint32_t pos;
+	uint32_t seq;
+	LISysChannelCell* cell;
+
+	pos = self->head;
+	while (1)
+	{
+		cell = self->cells + (pos & self->mask);
+		seq = cell->sequence;
+		__sync_synchronize ();
+		diff = (int32_t) seq - (int32_t) pos;
+		if (diff == 0)
+		{
+			if (__sync_bool_compare_and_swap (&self->head, pos, pos + 1))
+				break;
+			pos = self->head;
+		}
+		else if (diff < 0)
+			return 0;
+		else
+			pos = self->head;
+	}
+	cell->data = data;
+	__sync_synchronize ();
+	cell->sequence = pos + 1;
+
+	return 1;
+}
+
+/**
+ * \brief Gets the maximum number of items in the channel.
+ * \param self Channel.
+ * \return Capacity.
+ */
+int lisys_channel_get_capacity (
+	LISysChannel* self)
+{
+	return self->mask + 1;
+}
+
+/** @} */
+/** @} */
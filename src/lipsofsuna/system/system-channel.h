@@ -0,0 +1,55 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __SYSTEM_CHANNEL_H__
+#define __SYSTEM_CHANNEL_H__
+
+#include "system-compiler.h"
+
+typedef struct _LISysChannel LISysChannel;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIAPICALL (LISysChannel*, lisys_channel_new, (
+	int capacity));
+
+LIAPICALL (void, lisys_channel_free, (
+	LISysChannel* self));
+
+LIAPICALL (void*, lisys_channel_pop, (
+	LISysChannel* self));
+
+LIAPICALL (int, lisys_channel_pop_batch, (
+	LISysChannel* self,
+	void**        result,
+	int           count));
+
+LIAPICALL (int, lisys_channel_push, (
+	LISysChannel* self,
+	void*         data));
+
+LIAPICALL (int, lisys_channel_get_capacity, (
+	LISysChannel* self));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -49,10 +49,12 @@
 struct _LISysMmap
 {
 #ifdef HAVE_SYS_MMAN_H
+	int fd;
 	int size;
 	void* buffer;
 #elif defined HAVE_WINDOWS_H
 	int size;
+	int writable;
 	void* buffer;
 	HANDLE file;
 	HANDLE handle;
@@ -97,11 +99,13 @@ LISysMmap* lisys_mmap_open (
 		free (self);
 		return NULL;
 	}
+	self->fd = -1;
 	self->size = st.st_size;
 
 	/* Memory map the file. */
 	if (!self->size)
 	{
+		close (fd);
 		self->buffer = NULL;
 		return self;
 	}
@@ -126,6 +130,8 @@ LISysMmap* lisys_mmap_open (
 		return NULL;
 	}
 
+	self->writable = 0;
+
 	/* Open the file. */
 	self->file = CreateFile (path, GENERIC_READ, FILE_SHARE_READ, NULL,
 		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
@@ -178,6 +184,117 @@ LISysMmap* lisys_mmap_open (
 #endif
 }
 
+/**
+ * \brief Creates a writable shared memory map of the file.
+ *
+ * The file is created if it doesn't exist and grown to the given size if
+ * it's smaller. Writes to the mapping are written back to the file by the
+ * operating system, or immediately with #lisys_mmap_sync.
+ *
+ * \param path Path.
+ * \param size Minimum size of the file in bytes.
+ * \return New memory map handle or NULL.
+ */
+LISysMmap* lisys_mmap_open_writable (
+	const char* path,
+	int         size)
+{
+#ifdef HAVE_SYS_MMAN_H
+	struct stat st;
+	LISysMmap* self;
+
+	/* Allocate self. */
+	self = malloc (sizeof (LISysMmap));
+	if (self == NULL)
+	{
+		lisys_error_set (ENOMEM, NULL);
+		return NULL;
+	}
+	self->size = 0;
+	self->buffer = NULL;
+
+	/* Open or create the file. */
+	self->fd = open (path, O_RDWR | O_CREAT, 0644);
+	if (self->fd == -1)
+	{
+		lisys_error_set (EIO, "cannot open `%s'", path);
+		free (self);
+		return NULL;
+	}
+	if (fstat (self->fd, &st) == -1)
+	{
+		lisys_error_set (EIO, "cannot stat `%s'", path);
+		close (self->fd);
+		free (self);
+		return NULL;
+	}
+	self->size = st.st_size;
+
+	/* Grow and memory map the file. */
+	if (self->size < size)
+	{
+		if (!lisys_mmap_resize (self, size))
+		{
+			close (self->fd);
+			free (self);
+			return NULL;
+		}
+	}
+	else if (self->size)
+	{
+		self->buffer = mmap (NULL, self->size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+		if (self->buffer == MAP_FAILED)
+		{
+			lisys_error_set (EIO, "cannot mmap `%s'", path);
+			close (self->fd);
+			free (self);
+			return NULL;
+		}
+	}
+
+	return self;
+#elif defined HAVE_WINDOWS_H
+	LISysMmap* self;
+
+	/* Allocate self. */
+	self = malloc (sizeof (LISysMmap));
+	if (self == NULL)
+	{
+		lisys_error_set (ENOMEM, NULL);
+		return NULL;
+	}
+	self->size = 0;
+	self->writable = 1;
+	self->buffer = NULL;
+	self->handle = NULL;
+
+	/* Open or create the file. */
+	self->file = CreateFile (path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (self->file == INVALID_HANDLE_VALUE)
+	{
+		lisys_error_set (EIO, "cannot open `%s'", path);
+		free (self);
+		return NULL;
+	}
+
+	/* Grow and memory map the file. */
+	if ((int) GetFileSize (self->file, NULL) > size)
+		size = GetFileSize (self->file, NULL);
+	if (!lisys_mmap_resize (self, size))
+	{
+		CloseHandle (self->file);
+		free (self);
+		return NULL;
+	}
+
+	return self;
+#else
+#error "Mmap not supported"
+	return NULL;
+#endif
+}
+
 /**
  * \brief Frees a memory map handle.
  * \param self Memory map handle.
@@ -188,11 +305,14 @@ void lisys_mmap_free (
 #ifdef HAVE_SYS_MMAN_H
 	if (self->buffer != NULL)
 		munmap ((void*) self->buffer, self->size);
+	if (self->fd != -1)
+		close (self->fd);
 	free (self);
 #elif defined HAVE_WINDOWS_H
 	if (self->buffer != NULL)
 		UnmapViewOfFile ((void*) self->buffer);
-	CloseHandle (self->handle);
+	if (self->handle != NULL)
+		CloseHandle (self->handle);
 	CloseHandle (self->file);
 #else
 #error "Mmap not supported"
@@ -200,6 +320,133 @@ void lisys_mmap_free (
 #endif
 }
 
+/**
+ * \brief Grows a writable memory map and the file behind it.
+ *
+ * The file is remapped so the buffer may move. On failure the old mapping
+ * is kept so the memory map remains usable at its old size.
+ *
+ * \param self Writable memory map.
+ * \param size New size in bytes.
+ * \return Nonzero on success.
+ */
+int lisys_mmap_resize (
+	LISysMmap* self,
+	int        size)
+{
+#ifdef HAVE_SYS_MMAN_H
+	void* buffer;
+
+	lisys_assert (self->fd != -1);
+	if (size <= self->size)
+		return 1;
+	if (ftruncate (self->fd, size) == -1)
+	{
+		lisys_error_set (EIO, "cannot grow mapped file");
+		return 0;
+	}
+
+	/* The old mapping is released only after the new one succeeds. */
+	buffer = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+	if (buffer == MAP_FAILED)
+	{
+		lisys_error_set (EIO, "cannot mmap grown file");
+		if (ftruncate (self->fd, self->size) == -1)
+			lisys_error_append ("cannot shrink mapped file");
+		return 0;
+	}
+	if (self->buffer != NULL)
+		munmap (self->buffer, self->size);
+	self->buffer = buffer;
+	self->size = size;
+
+	return 1;
+#elif defined HAVE_WINDOWS_H
+	void* buffer;
+	HANDLE handle;
+
+	lisys_assert (self->writable);
+	if (size <= self->size && self->buffer != NULL)
+		return 1;
+
+	/* Creating a larger mapping grows the file. */
+	/* The old mapping is released only after the new one succeeds. */
+	handle = CreateFileMapping (self->file, NULL, PAGE_READWRITE, 0, size, NULL);
+	if (handle == NULL)
+	{
+		lisys_error_set (EIO, "cannot grow mapped file");
+		return 0;
+	}
+	buffer = MapViewOfFile (handle, FILE_MAP_WRITE, 0, 0, size);
+	if (buffer == NULL)
+	{
+		lisys_error_set (EIO, "cannot map grown file");
+		CloseHandle (handle);
+		return 0;
+	}
+	if (self->buffer != NULL)
+		UnmapViewOfFile (self->buffer);
+	if (self->handle != NULL)
+		CloseHandle (self->handle);
+	self->buffer = buffer;
+	self->handle = handle;
+	self->size = size;
+
+	return 1;
+#else
+#error "Mmap not supported"
+	return 0;
+#endif
+}
+
+/**
+ * \brief Writes a range of a writable memory map to the disk.
+ *
+ * Returns after the data has reached the disk so that callers can order
+ * their writes for crash safety.
+ *
+ * \param self Writable memory map.
+ * \param offset Offset of the range in bytes.
+ * \param length Length of the range in bytes.
+ * \return Nonzero on success.
+ */
+int lisys_mmap_sync (
+	LISysMmap* self,
+	int        offset,
+	int        length)
+{
+#ifdef HAVE_SYS_MMAN_H
+	long page;
+
+	if (self->buffer == NULL || length <= 0)
+		return 1;
+	page = sysconf (_SC_PAGESIZE);
+	length += offset % page;
+	offset -= offset % page;
+	if (msync ((char*) self->buffer + offset, length, MS_SYNC) == -1)
+	{
+		lisys_error_set (EIO, "cannot sync mapped file");
+		return 0;
+	}
+
+	return 1;
+#elif defined HAVE_WINDOWS_H
+	if (self->buffer == NULL || length <= 0)
+		return 1;
+	if (!FlushViewOfFile ((char*) self->buffer + offset, length) ||
+	    !FlushFileBuffers (self->file))
+	{
+		lisys_error_set (EIO, "cannot sync mapped file");
+		return 0;
+	}
+
+	return 1;
+#else
+#error "Mmap not supported"
+	return 0;
+#endif
+}
+
 /**
  * \brief Gets the mapped memory area.
  * \param self Memory map.
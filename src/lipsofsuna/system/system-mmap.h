@@ -29,9 +29,22 @@ extern "C" {
 LIAPICALL (LISysMmap*, lisys_mmap_open, (
 	const char* path));
 
+LIAPICALL (LISysMmap*, lisys_mmap_open_writable, (
+	const char* path,
+	int         size));
+
 LIAPICALL (void, lisys_mmap_free, (
 	LISysMmap* self));
 
+LIAPICALL (int, lisys_mmap_resize, (
+	LISysMmap* self,
+	int        size));
+
+LIAPICALL (int, lisys_mmap_sync, (
+	LISysMmap* self,
+	int        offset,
+	int        length));
+
 LIAPICALL (void*, lisys_mmap_get_buffer, (
 	LISysMmap* self));
 
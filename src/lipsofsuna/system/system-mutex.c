@@ -31,6 +31,11 @@ struct _LISysMutex
 	pthread_mutex_t mutex;
 };
 
+struct _LISysCond
+{
+	pthread_cond_t cond;
+};
+
 LISysMutex* lisys_mutex_new ()
 {
 	LISysMutex* self;
@@ -62,5 +67,45 @@ void lisys_mutex_unlock (
 	pthread_mutex_unlock (&self->mutex);
 }
 
+LISysCond* lisys_cond_new ()
+{
+	LISysCond* self;
+
+	self = lisys_calloc (1, sizeof (LISysCond));
+	if (self == NULL)
+		return NULL;
+	pthread_cond_init (&self->cond, NULL);
+
+	return self;
+}
+
+void lisys_cond_free (
+	LISysCond* self)
+{
+	pthread_cond_destroy (&self->cond);
+	lisys_free (self);
+}
+
+void lisys_cond_broadcast (
+	LISysCond* self)
+{
+	pthread_cond_broadcast (&self->cond);
+}
+
+void lisys_cond_signal (
+	LISysCond* self)
+{
+	pthread_cond_signal (&self->cond);
+}
+
+/* The mutex must be locked by the caller. Spurious wakeups are possible
+   so the caller must check its condition in a loop. */
+void lisys_cond_wait (
+	LISysCond*  self,
+	LISysMutex* mutex)
+{
+	pthread_cond_wait (&self->cond, &mutex->mutex);
+}
+
 /** @} */
 /** @} */
@@ -21,6 +21,7 @@
 #include "system-memory.h"
 
 typedef struct _LISysMutex LISysMutex;
+typedef struct _LISysCond LISysCond;
 
 LIAPICALL (LISysMutex*, lisys_mutex_new, ());
 
@@ -33,4 +34,19 @@ LIAPICALL (void, lisys_mutex_lock, (
 LIAPICALL (void, lisys_mutex_unlock, (
 	LISysMutex* self));
 
+LIAPICALL (LISysCond*, lisys_cond_new, ());
+
+LIAPICALL (void, lisys_cond_free, (
+	LISysCond* self));
+
+LIAPICALL (void, lisys_cond_broadcast, (
+	LISysCond* self));
+
+LIAPICALL (void, lisys_cond_signal, (
+	LISysCond* self));
+
+LIAPICALL (void, lisys_cond_wait, (
+	LISysCond*  self,
+	LISysMutex* mutex));
+
 #endif
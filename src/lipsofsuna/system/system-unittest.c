@@ -0,0 +1,202 @@
+/* Lips of Suna
+ * Copyright© 2007-2011 Lips of Suna development team.
+ *
+ * Lips of Suna is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Lips of Suna is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Lips of Suna. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \addtogroup LISys System
+ * @{
+ * \addtogroup LISysUnittest Unittest
+ * @{
+ */
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include "system-channel.h"
+#include "system-memory.h"
+#include "system-mutex.h"
+#include "system-thread.h"
+#include "system-unittest.h"
+
+#define BENCHMARK_CAPACITY 4096
+#define BENCHMARK_ITEMS 1000000
+#define BENCHMARK_PRODUCERS 4
+
+typedef struct _LISysListItem LISysListItem;
+struct _LISysListItem
+{
+	intptr_t value;
+	LISysListItem* next;
+};
+
+typedef struct _LISysBenchmark LISysBenchmark;
+struct _LISysBenchmark
+{
+	int items;
+	LISysChannel* channel;
+	LISysMutex* mutex;
+	LISysListItem* list;
+};
+
+static void private_produce_channel (
+	LISysThread* thread,
+	void*        data);
+
+static void private_produce_list (
+	LISysThread* thread,
+	void*        data);
+
+static double private_time ();
+
+/*****************************************************************************/
+
+static double private_benchmark (
+	int producers,
+	int locked)
+{
+	int i;
+	int count;
+	int total;
+	double t;
+	int64_t sum = 0;
+	int64_t expected;
+	void* items[64];
+	LISysBenchmark bench;
+	LISysListItem* item;
+	LISysThread* threads[BENCHMARK_PRODUCERS];
+
+	bench.items = BENCHMARK_ITEMS / producers;
+	bench.channel = lisys_channel_new (BENCHMARK_CAPACITY);
+	bench.mutex = lisys_mutex_new ();
+	bench.list = NULL;
+	total = bench.items * producers;
+	expected = producers * ((int64_t) bench.items * (bench.items + 1) / 2);
+
+	/* Consume everything the producers push. */
+	t = private_time ();
+	for (i = 0 ; i < producers ; i++)
+		threads[i] = lisys_thread_new (locked? private_produce_list : private_produce_channel, &bench);
+	while (total)
+	{
+		if (locked)
+		{
+			lisys_mutex_lock (bench.mutex);
+			item = bench.list;
+			if (item != NULL)
+				bench.list = item->next;
+			lisys_mutex_unlock (bench.mutex);
+			if (item != NULL)
+			{
+				sum += item->value;
+				lisys_free (item);
+				total--;
+			}
+			else
+				sched_yield ();
+		}
+		else
+		{
+			count = lisys_channel_pop_batch (bench.channel, items, 64);
+			if (!count)
+				sched_yield ();
+			for (i = 0 ; i < count ; i++)
+				sum += (intptr_t) items[i];
+			total -= count;
+		}
+	}
+	for (i = 0 ; i < producers ; i++)
+		lisys_thread_free (threads[i]);
+	t = private_time () - t;
+
+	if (sum != expected)
+		printf ("Channel: FAILED! Received sum %lld, expected %lld.\n", (long long) sum, (long long) expected);
+	lisys_channel_free (bench.channel);
+	lisys_mutex_free (bench.mutex);
+
+	return BENCHMARK_ITEMS / t / 1000000.0;
+}
+
+static void private_produce_channel (
+	LISysThread* thread,
+	void*        data)
+{
+	intptr_t i;
+	LISysBenchmark* bench = data;
+
+	for (i = 1 ; i <= bench->items ; i++)
+	{
+		while (!lisys_channel_push (bench->channel, (void*) i))
+			sched_yield ();
+	}
+}
+
+static void private_produce_list (
+	LISysThread* thread,
+	void*        data)
+{
+	intptr_t i;
+	LISysBenchmark* bench = data;
+	LISysListItem* item;
+	LISysListItem* ptr;
+
+	/* Mimics the old message queue that appended to the tail of a list. */
+	for (i = 1 ; i <= bench->items ; i++)
+	{
+		item = lisys_calloc (1, sizeof (LISysListItem));
+		item->value = i;
+		lisys_mutex_lock (bench->mutex);
+		if (bench->list != NULL)
+		{
+			for (ptr = bench->list ; ptr->next != NULL ; ptr = ptr->next)
+				{}
+			ptr->next = item;
+		}
+		else
+			bench->list = item;
+		lisys_mutex_unlock (bench->mutex);
+	}
+}
+
+static double private_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
+/*****************************************************************************/
+
+/**
+ * \brief Runs the system unit tests and benchmarks.
+ *
+ * A million items are passed through a message channel by one and by
+ * several producer threads, and the throughput is compared to a mutex
+ * protected list.
+ */
+void lisys_unittest ()
+{
+	printf ("Benchmarking message channels.\n");
+	printf ("Channel: SPSC %.2f M/s lock-free, %.2f M/s locked\n",
+		private_benchmark (1, 0), private_benchmark (1, 1));
+	printf ("Channel: MPSC %.2f M/s lock-free, %.2f M/s locked\n",
+		private_benchmark (BENCHMARK_PRODUCERS, 0), private_benchmark (BENCHMARK_PRODUCERS, 1));
+}
+
+/** @} */
+/** @} */
@@ -19,6 +19,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "lipsofsuna/image/image-dds.h"
+#include "lipsofsuna/system/system-batch.h"
+#include "lipsofsuna/system/system-filesystem.h"
+#include "lipsofsuna/system/system-string.h"
 #include "ddstool-image.h"
 #include "ddstool-compress.h"
 
@@ -101,9 +104,138 @@ static int private_convert_to_dds_rgba (
 	return ret;
 }
 
+static char* private_batch_get_output (
+	const char* src)
+{
+	int len;
+	char* dst;
+
+	dst = lisys_string_dup (src);
+	if (dst == NULL)
+		return NULL;
+	len = strlen (dst);
+	if (len > 4 && !strcmp (dst + len - 4, ".png"))
+		strcpy (dst + len - 4, ".dds");
+	else
+	{
+		lisys_free (dst);
+		dst = lisys_string_concat (src, ".dds");
+	}
+
+	return dst;
+}
+
+static int private_batch_check (
+	LISysBatch* batch,
+	const char* src,
+	void*       data)
+{
+	int ret;
+	char* dst;
+
+	dst = private_batch_get_output (src);
+	if (dst == NULL)
+		return 0;
+	ret = lisys_filesystem_access (dst, LISYS_ACCESS_EXISTS);
+	lisys_free (dst);
+
+	return ret;
+}
+
+static int private_batch_convert (
+	LISysBatch* batch,
+	const char* src,
+	void*       data)
+{
+	int ret;
+	int* rgba = data;
+	char* dst;
+	char* tmp;
+
+	/* Convert to a temporary file. */
+	dst = private_batch_get_output (src);
+	if (dst == NULL)
+		return 0;
+	tmp = lisys_string_concat (dst, ".tmp");
+	if (tmp == NULL)
+	{
+		lisys_free (dst);
+		return 0;
+	}
+	if (*rgba)
+		ret = private_convert_to_dds_rgba (src, tmp);
+	else
+		ret = private_convert_to_dds_s3tc (src, tmp);
+
+	/* Atomically replace the old output. */
+	if (ret)
+		ret = lisys_batch_replace_file (tmp, dst);
+	else
+		remove (tmp);
+	if (ret)
+		printf ("Converted %s\n", dst);
+	lisys_free (tmp);
+	lisys_free (dst);
+
+	return ret;
+}
+
+static int private_batch (
+	int    argc,
+	char** argv)
+{
+	int i;
+	int ret;
+	int rgba = 0;
+	int threads = 0;
+	const char* cache = NULL;
+	LISysBatch* batch;
+
+	batch = lisys_batch_new (private_batch_convert, &rgba);
+	if (batch == NULL)
+		return 0;
+	lisys_batch_set_check (batch, private_batch_check);
+
+	/* Collect the images. */
+	for (i = 0 ; i < argc ; i++)
+	{
+		if (!strcmp (argv[i], "-c") && i + 1 < argc)
+			cache = argv[++i];
+		else if (!strcmp (argv[i], "-j") && i + 1 < argc)
+			threads = atoi (argv[++i]);
+		else if (!strcmp (argv[i], "-r"))
+			rgba = 1;
+		else if (!strcmp (argv[i], "-m") && i + 1 < argc)
+		{
+			if (!lisys_batch_add_manifest (batch, argv[++i], "png"))
+				lisys_error_report ();
+		}
+		else if (!lisys_batch_add_path (batch, argv[i], "png"))
+			lisys_error_report ();
+	}
+
+	/* Convert the images. */
+	if (cache != NULL && !lisys_batch_load_cache (batch, cache))
+		lisys_error_report ();
+	ret = lisys_batch_run (batch, threads);
+	if (cache != NULL && !lisys_batch_save_cache (batch, cache))
+	{
+		lisys_error_report ();
+		ret = 0;
+	}
+	lisys_batch_free (batch);
+
+	return ret;
+}
+
 int main (int argc, char** argv)
 {
-	if (argc == 3 && !strcmp (argv[1], "-i"))
+	if (argc >= 2 && !strcmp (argv[1], "-b"))
+	{
+		if (!private_batch (argc - 2, argv + 2))
+			return 1;
+	}
+	else if (argc == 3 && !strcmp (argv[1], "-i"))
 	{
 		if (!private_print_info (argv[2]))
 		{
@@ -129,11 +261,18 @@ int main (int argc, char** argv)
 	}
 	else
 	{
-		printf ("Usage: %s [OPTION] [src] [dst]\n\n", argv[0]);
+		printf ("Usage: %s [OPTION] [src] [dst]\n", argv[0]);
+		printf ("       %s -b [BATCH OPTION] [png|directory...]\n\n", argv[0]);
+		printf (" -b   Convert images to DDS files next to them in parallel.\n");
 		printf (" -h   Print this help message.\n");
 		printf (" -i   Print image information.\n");
 		printf (" -r   Convert to DDS RGBA.\n");
-		printf (" -s   Convert to DDS S3TC DXT5.\n");
+		printf (" -s   Convert to DDS S3TC DXT5.\n\n");
+		printf ("Batch options:\n");
+		printf (" -c FILE   Skip images unchanged since listed in the cache file.\n");
+		printf (" -j NUM    Number of worker threads. [default: number of CPUs]\n");
+		printf (" -m FILE   Read image and directory paths from a manifest.\n");
+		printf (" -r        Convert to DDS RGBA instead of S3TC DXT5.\n");
 	}
 
 	return 0;
@@ -40,6 +40,53 @@ livox_block_get_dirty (const LIVoxBlock* self)
 	return self->dirty;
 }
 
+/**
+ * \brief Marks a box of tiles of the block dirty.
+ *
+ * The dirty box grows to cover all the tiles whose hints or geometry may
+ * have changed since the block was last rebuilt, so that the rebuild can
+ * be limited to them.
+ *
+ * \param self Block.
+ * \param flags Dirty flags to add.
+ * \param min Minimum tile offset inside the block, or NULL for the whole block.
+ * \param max Maximum tile offset inside the block, or NULL for the whole block.
+ */
+void livox_block_mark_dirty (
+	LIVoxBlock* self,
+	int         flags,
+	const int*  min,
+	const int*  max)
+{
+	int i;
+
+	if (min == NULL || max == NULL)
+	{
+		for (i = 0 ; i < 3 ; i++)
+		{
+			self->dirty_min[i] = 0;
+			self->dirty_max[i] = 0xFF;
+		}
+	}
+	else if (!self->dirty)
+	{
+		for (i = 0 ; i < 3 ; i++)
+		{
+			self->dirty_min[i] = min[i];
+			self->dirty_max[i] = max[i];
+		}
+	}
+	else
+	{
+		for (i = 0 ; i < 3 ; i++)
+		{
+			self->dirty_min[i] = LIMAT_MIN (self->dirty_min[i], min[i]);
+			self->dirty_max[i] = LIMAT_MAX (self->dirty_max[i], max[i]);
+		}
+	}
+	self->dirty |= flags;
+}
+
 /**
  * \brief Sets or clears the dirty flag of the block.
  *
@@ -50,7 +97,36 @@ void
 livox_block_set_dirty (LIVoxBlock* self,
                        int         value)
 {
-	self->dirty = value;
+	if (value)
+		livox_block_mark_dirty (self, value, NULL, NULL);
+	else
+		self->dirty = 0;
+}
+
+/**
+ * \brief Gets the dirty box of the block.
+ *
+ * \param self Block.
+ * \param size Number of tiles per block line.
+ * \param min Return location for the minimum tile offset.
+ * \param max Return location for the maximum tile offset.
+ * \return Nonzero if the block is dirty.
+ */
+int livox_block_get_dirty_box (
+	const LIVoxBlock* self,
+	int               size,
+	int*              min,
+	int*              max)
+{
+	int i;
+
+	for (i = 0 ; i < 3 ; i++)
+	{
+		min[i] = LIMAT_MIN (self->dirty_min[i], size - 1);
+		max[i] = LIMAT_MIN (self->dirty_max[i], size - 1);
+	}
+
+	return self->dirty;
 }
 
 /**
@@ -47,10 +47,22 @@ struct _LIVoxBlockAddr
 LIAPICALL (int, livox_block_get_dirty, (
 	const LIVoxBlock* self));
 
+LIAPICALL (void, livox_block_mark_dirty, (
+	LIVoxBlock* self,
+	int         flags,
+	const int*  min,
+	const int*  max));
+
 LIAPICALL (void, livox_block_set_dirty, (
 	LIVoxBlock* self,
 	int         value));
 
+LIAPICALL (int, livox_block_get_dirty_box, (
+	const LIVoxBlock* self,
+	int               size,
+	int*              min,
+	int*              max));
+
 LIAPICALL (int, livox_block_get_stamp, (
 	const LIVoxBlock* self));
 
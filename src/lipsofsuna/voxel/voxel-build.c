@@ -29,6 +29,7 @@
 
 #define CULL_EPSILON 0.01f
 #define LIVOX_ISEMPTY(m)
+#define LIVOX_BUILD_VERTICES_MAX 600
 
 /* The builder isn't completely thread-safe at the moment. The biggest issue is
    that material data is queried from the voxel manager without locking. Our
@@ -36,10 +37,43 @@
    but it needs to be fixed in the future. */
 #warning Thread-safety issues in terrain builder
 
+static int private_downsample (
+	LIVoxBuilder* self,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           seams);
+
+static void private_find_faces (
+	LIVoxBuilder* self);
+
+static void private_find_hidden (
+	LIVoxBuilder* self);
+
+static void private_merge_faces (
+	LIVoxBuilder* self);
+
 static int private_merge_material (
 	LIVoxBuilder*  self,
 	LIMdlMaterial* material);
 
+static int private_merge_quad (
+	LIVoxBuilder*  self,
+	LIVoxMaterial* material,
+	int            face,
+	int            slice,
+	int            u,
+	int            v,
+	int            width,
+	int            height);
+
+static void private_merge_quad_point (
+	int    index,
+	int    width,
+	int    height,
+	float* u,
+	float* v);
+
 static int private_merge_triangles_model (
 	LIVoxBuilder* self,
 	LIVoxVoxelB*  voxel,
@@ -54,6 +88,12 @@ static void private_merge_voxel (
 	int           vy,
 	int           vz);
 
+static void private_texcoords (
+	int                face,
+	float              scale,
+	const LIMatVector* coord,
+	float*             result);
+
 /*****************************************************************************/
 
 LIVoxBuilder* livox_builder_new (
@@ -65,39 +105,111 @@ LIVoxBuilder* livox_builder_new (
 	int           ysize,
 	int           zsize)
 {
+	return livox_builder_new_lod (manager, xstart, ystart, zstart, xsize, ysize, zsize, 0, 0);
+}
+
+/**
+ * \brief Creates a terrain builder for a reduced level of detail.
+ *
+ * The area is downsampled so that each cell of the built model covers
+ * 2^lod tiles along each axis. The start and size of the area are given in
+ * tiles and must be multiples of the cell size.
+ *
+ * Faces that border terrain built at a finer level of detail are passed in
+ * the seam mask. The cells along those faces are filled if any of their
+ * tiles is filled and the cells beyond them are only considered filled if
+ * all their tiles are. The coarse model hence encloses the finer surface at
+ * the seam and closes the cracks between the two levels with side faces.
+ *
+ * \param manager Voxel manager.
+ * \param xstart Start tile in X.
+ * \param ystart Start tile in Y.
+ * \param zstart Start tile in Z.
+ * \param xsize Number of tiles in X.
+ * \param ysize Number of tiles in Y.
+ * \param zsize Number of tiles in Z.
+ * \param lod Level of detail, zero for full resolution.
+ * \param seams Mask of #LIVOX_BUILD_SEAM_NEGATIVE_X and the like.
+ * \return Builder or NULL.
+ */
+LIVoxBuilder* livox_builder_new_lod (
+	LIVoxManager* manager,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           xsize,
+	int           ysize,
+	int           zsize,
+	int           lod,
+	int           seams)
+{
+	int max;
+	int rows;
+	int scale;
 	LIVoxBuilder* self;
 
 	/* Allocate self. */
 	self = lisys_calloc (1, sizeof (LIVoxBuilder));
 	if (self == NULL)
 		return NULL;
+	scale = 1 << lod;
+	lisys_assert (xstart % scale == 0 && ystart % scale == 0 && zstart % scale == 0);
+	lisys_assert (xsize % scale == 0 && ysize % scale == 0 && zsize % scale == 0);
+	xsize /= scale;
+	ysize /= scale;
+	zsize /= scale;
+	self->greedy = manager->greedy;
+	self->lod = lod;
 	self->manager = manager;
-	self->tile_width = manager->tile_width;
-	self->vertex_scale = manager->tile_width * 0.5f;
-	self->offset[0] = xstart;
-	self->offset[1] = ystart;
-	self->offset[2] = zstart;
+	self->tile_width = manager->tile_width * scale;
+	self->vertex_scale = self->tile_width * 0.5f;
+	self->offset[0] = xstart / scale;
+	self->offset[1] = ystart / scale;
+	self->offset[2] = zstart / scale;
 	self->size[0] = xsize + 2;
 	self->size[1] = ysize + 2;
 	self->size[2] = zsize + 2;
 	self->step[0] = 1;
 	self->step[1] = self->size[0];
 	self->step[2] = self->size[0] * self->size[1];
+	max = LIMAT_MAX (LIMAT_MAX (xsize, ysize), zsize);
 	self->voxels = lisys_calloc (self->size[0] * self->size[1] * self->size[2], sizeof (LIVoxVoxel));
 	self->voxelsb = lisys_calloc (self->size[0] * self->size[1] * self->size[2], sizeof (LIVoxVoxelB));
-	if (self->voxels == NULL || self->voxelsb == NULL)
+	self->mask = lisys_calloc (max * max, sizeof (LIVoxVoxelB*));
+	if (self->voxels == NULL || self->voxelsb == NULL || self->mask == NULL)
 	{
-		lisys_free (self->voxels);
-		lisys_free (self->voxelsb);
-		lisys_free (self);
+		livox_builder_free (self);
 		return NULL;
 	}
 
+	/* Allocate the occupancy bitmasks. */
+	/* Each row of tiles along the X axis is stored as a bit string so that
+	   the faces of the whole row can be tested at once. */
+	rows = self->size[1] * self->size[2];
+	self->masks.words = (self->size[0] + 63) / 64;
+	self->masks.filled = lisys_calloc (4 * rows * self->masks.words, sizeof (uint64_t));
+	if (self->masks.filled == NULL)
+	{
+		livox_builder_free (self);
+		return NULL;
+	}
+	self->masks.liquid = self->masks.filled + rows * self->masks.words;
+	self->masks.solid = self->masks.liquid + rows * self->masks.words;
+	self->masks.visible = self->masks.solid + rows * self->masks.words;
+
 	/* Fetch terrain data. */
 	/* This is done in the initializer so that the builder doesn't need to
 	   reference to external data. This helps with thread-safety. */
-	livox_manager_copy_voxels (manager, xstart - 1, ystart - 1, zstart - 1,
-		self->size[0], self->size[1], self->size[2], self->voxels);
+	if (!lod)
+	{
+		livox_manager_copy_voxels (manager, xstart - 1, ystart - 1, zstart - 1,
+			self->size[0], self->size[1], self->size[2], self->voxels);
+	}
+	else if (!private_downsample (self, xstart, ystart, zstart, seams))
+	{
+		livox_builder_free (self);
+		return NULL;
+	}
 
 	return self;
 }
@@ -107,6 +219,10 @@ void livox_builder_free (
 {
 	lisys_free (self->voxels);
 	lisys_free (self->voxelsb);
+	lisys_free (self->mask);
+	lisys_free (self->indices);
+	lisys_free (self->vertices);
+	lisys_free (self->masks.filled);
 	lisys_free (self);
 }
 
@@ -114,9 +230,11 @@ int livox_builder_build_model (
 	LIVoxBuilder*  self,
 	LIMdlModel**   result)
 {
+	int i;
 	int x;
 	int y;
 	int z;
+	uint64_t bits;
 
 	lisys_assert (result != NULL);
 
@@ -126,11 +244,26 @@ int livox_builder_build_model (
 		return 1;
 	}
 
+	/* Merge large flat areas. */
+	if (self->greedy)
+	{
+		private_find_faces (self);
+		private_merge_faces (self);
+	}
+
 	/* Build all voxels inside the area. */
+	/* Rows without visible faces are skipped without looking at the voxels. */
 	for (z = 1 ; z < self->size[2] - 1 ; z++)
 	for (y = 1 ; y < self->size[1] - 1 ; y++)
-	for (x = 1 ; x < self->size[0] - 1 ; x++)
-		private_merge_voxel (self, x, y, z);
+	for (i = 0 ; i < self->masks.words ; i++)
+	{
+		bits = self->masks.visible[(y + z * self->size[1]) * self->masks.words + i];
+		for (x = 64 * i ; bits ; x++, bits >>= 1)
+		{
+			if (bits & 1)
+				private_merge_voxel (self, x, y, z);
+		}
+	}
 
 	/* Calculate bounds and tangents. */
 	if (self->model_builder != NULL)
@@ -152,9 +285,12 @@ void livox_builder_preprocess (
 	int x;
 	int y;
 	int z;
+	int row;
+	uint32_t type = 0;
+	uint64_t bit;
 	LIMatVector offset;
 	LIMatVector vector;
-	LIVoxMaterial* material;
+	LIVoxMaterial* material = NULL;
 	LIVoxVoxel* voxel;
 
 	/* Calculate area offset. */
@@ -162,12 +298,15 @@ void livox_builder_preprocess (
 	offset = limat_vector_multiply (offset, self->tile_width);
 
 	/* Precalculate useful information on voxels. */
+	memset (self->masks.filled, 0, 4 * self->size[1] * self->size[2] * self->masks.words * sizeof (uint64_t));
 	for (z = 0 ; z < self->size[2] ; z++)
 	for (y = 0 ; y < self->size[1] ; y++)
 	for (x = 0 ; x < self->size[0] ; x++)
 	{
 		i = x + y * self->step[1] + z * self->step[2];
 		self->voxelsb[i].voxel = NULL;
+		self->voxelsb[i].hidden = 0;
+		self->voxelsb[i].merged = 0;
 
 		/* Type check. */
 		voxel = self->voxels + i;
@@ -175,7 +314,13 @@ void livox_builder_preprocess (
 			continue;
 
 		/* Material check. */
-		material = livox_manager_find_material (self->manager, voxel->type);
+		/* Neighboring tiles are usually of the same type so the result of
+		   the previous lookup is reused when possible. */
+		if (voxel->type != type)
+		{
+			type = voxel->type;
+			material = livox_manager_find_material (self->manager, type);
+		}
 		if (material == NULL)
 			continue;
 		self->voxelsb[i].material = material;
@@ -186,8 +331,20 @@ void livox_builder_preprocess (
 		vector = limat_vector_init (x + 0.5f, y + 0.5f, z + 0.5f);
 		vector = limat_vector_multiply (vector, self->tile_width);
 		self->voxelsb[i].position = limat_vector_add (vector, offset);
+
+		/* Update the occupancy bitmasks. */
+		row = (y + z * self->size[1]) * self->masks.words + x / 64;
+		bit = ((uint64_t) 1) << (x % 64);
+		self->masks.filled[row] |= bit;
+		if (material->type == LIVOX_MATERIAL_TYPE_LIQUID)
+			self->masks.liquid[row] |= bit;
+		else
+			self->masks.solid[row] |= bit;
 	}
 
+	/* Determine the hidden faces. */
+	private_find_hidden (self);
+
 	/* Store voxel coordinates so that we can save them to collision
 	   objects and then later use them to determine the exact tile hit. */
 	for (z = 0 ; z < self->size[2] - 2 ; z++)
@@ -201,6 +358,357 @@ void livox_builder_preprocess (
 
 /*****************************************************************************/
 
+static int private_downsample (
+	LIVoxBuilder* self,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           seams)
+{
+	int a;
+	int i;
+	int j;
+	int best;
+	int count;
+	int level;
+	int scale;
+	int total;
+	int pad;
+	int shell;
+	int filled;
+	int pos[3];
+	int size[3];
+	uint16_t* counts;
+	LIVoxVoxel* tiles;
+
+	/* Fetch the full resolution tiles. */
+	/* The padding is one cell thick so it's as many tiles as a cell. */
+	scale = 1 << self->lod;
+	total = scale * scale * scale;
+	size[0] = self->size[0] * scale;
+	size[1] = self->size[1] * scale;
+	size[2] = self->size[2] * scale;
+	count = size[0] * size[1] * size[2];
+	tiles = lisys_malloc (count * sizeof (LIVoxVoxel));
+	counts = lisys_malloc (count * sizeof (uint16_t));
+	if (tiles == NULL || counts == NULL)
+	{
+		lisys_free (tiles);
+		lisys_free (counts);
+		return 0;
+	}
+	livox_manager_copy_voxels (self->manager, xstart - scale, ystart - scale, zstart - scale,
+		size[0], size[1], size[2], tiles);
+	for (i = 0 ; i < count ; i++)
+		counts[i] = (tiles[i].type != 0);
+
+	/* Build the pyramid one level at a time. */
+	/* Each level halves the resolution. The cells are reduced in place since
+	   the children of a cell are never stored before the cell itself. Each
+	   cell remembers how many full resolution tiles it contains and takes
+	   the type of its fullest child. */
+	for (level = 0 ; level < self->lod ; level++)
+	{
+		for (pos[2] = 0 ; pos[2] < size[2] / 2 ; pos[2]++)
+		for (pos[1] = 0 ; pos[1] < size[1] / 2 ; pos[1]++)
+		for (pos[0] = 0 ; pos[0] < size[0] / 2 ; pos[0]++)
+		{
+			best = -1;
+			count = 0;
+			for (a = 0 ; a < 8 ; a++)
+			{
+				j = (2 * pos[0] + (a & 1)) +
+				    (2 * pos[1] + ((a >> 1) & 1)) * size[0] +
+				    (2 * pos[2] + (a >> 2)) * size[0] * size[1];
+				count += counts[j];
+				if (best == -1 || counts[j] > counts[best])
+					best = j;
+			}
+			i = pos[0] + pos[1] * (size[0] / 2) + pos[2] * (size[0] / 2) * (size[1] / 2);
+			tiles[i] = tiles[best];
+			counts[i] = count;
+		}
+		size[0] /= 2;
+		size[1] /= 2;
+		size[2] /= 2;
+	}
+
+	/* Decide which cells are filled. */
+	/* Cells are filled by majority except at seams, where the cells inside
+	   the area are filled conservatively and those outside of it are emptied
+	   conservatively so that the coarse surface covers the finer one. */
+	for (pos[2] = 0, i = 0 ; pos[2] < size[2] ; pos[2]++)
+	for (pos[1] = 0 ; pos[1] < size[1] ; pos[1]++)
+	for (pos[0] = 0 ; pos[0] < size[0] ; pos[0]++, i++)
+	{
+		pad = 0;
+		shell = 0;
+		for (a = 0 ; a < 3 ; a++)
+		{
+			if (pos[a] == 0)
+				pad |= 1 << (2 * a);
+			else if (pos[a] == size[a] - 1)
+				pad |= 2 << (2 * a);
+			else
+			{
+				if (pos[a] == 1)
+					shell |= 1 << (2 * a);
+				if (pos[a] == size[a] - 2)
+					shell |= 2 << (2 * a);
+			}
+		}
+		if (pad & seams)
+			filled = (counts[i] == total);
+		else if (!pad && (shell & seams))
+			filled = (counts[i] > 0);
+		else
+			filled = (2 * counts[i] >= total);
+		if (filled)
+			livox_voxel_init (self->voxels + i, tiles[i].type);
+	}
+
+	lisys_free (tiles);
+	lisys_free (counts);
+
+	return 1;
+}
+
+static void private_find_faces (
+	LIVoxBuilder* self)
+{
+	int a;
+	int d;
+	int i;
+	int x;
+	int y;
+	int z;
+	int x1;
+	int y1;
+	int z1;
+	int off[2];
+	int empty;
+	int uniform;
+	uint64_t bits;
+	LIVoxVoxelB* front;
+	LIVoxVoxelB* voxel;
+	LIVoxVoxelB* tmp;
+
+	for (z = 1 ; z < self->size[2] - 1 ; z++)
+	for (y = 1 ; y < self->size[1] - 1 ; y++)
+	for (i = 0 ; i < self->masks.words ; i++)
+	{
+		bits = self->masks.visible[(y + z * self->size[1]) * self->masks.words + i];
+		for (x = 64 * i ; bits ; x++, bits >>= 1)
+		{
+			if (!(bits & 1))
+				continue;
+			voxel = self->voxelsb + x + y * self->step[1] + z * self->step[2];
+			if (voxel->material->type != LIVOX_MATERIAL_TYPE_CUBE)
+				continue;
+
+			/* Check if there are other tile types nearby. They would affect
+			   the texture splatting factors of the vertices. */
+			uniform = 1;
+			for (z1 = -1 ; z1 <= 1 && uniform ; z1++)
+			for (y1 = -1 ; y1 <= 1 && uniform ; y1++)
+			for (x1 = -1 ; x1 <= 1 && uniform ; x1++)
+			{
+				tmp = voxel + x1 + y1 * self->step[1] + z1 * self->step[2];
+				if (tmp->voxel != NULL && tmp->voxel->type != voxel->voxel->type)
+					uniform = 0;
+			}
+			if (!uniform)
+				continue;
+
+			/* Find the visible faces that have nothing in front of them that
+			   would contribute to the ambient occlusion factors. */
+			for (d = 0 ; d < 6 ; d++)
+			{
+				if (voxel->hidden & (1 << d))
+					continue;
+				a = d / 2;
+				front = voxel + ((d & 1)? self->step[a] : -self->step[a]);
+				empty = 1;
+				for (off[1] = -1 ; off[1] <= 1 && empty ; off[1]++)
+				for (off[0] = -1 ; off[0] <= 1 && empty ; off[0]++)
+				{
+					tmp = front + off[0] * self->step[(a + 1) % 3] + off[1] * self->step[(a + 2) % 3];
+					if (tmp->voxel != NULL)
+						empty = 0;
+				}
+				if (empty)
+					voxel->merged |= 1 << d;
+			}
+		}
+	}
+}
+
+static void private_find_hidden (
+	LIVoxBuilder* self)
+{
+	int d;
+	int i;
+	int r;
+	int x;
+	int y;
+	int z;
+	int last;
+	int words;
+	uint64_t f;
+	uint64_t l;
+	uint64_t s;
+	uint64_t all;
+	uint64_t bits;
+	uint64_t inner;
+	uint64_t prev[2];
+	uint64_t next[2];
+	uint64_t hidden[6];
+	LIVoxVoxelB* voxel;
+
+	words = self->masks.words;
+	last = self->size[0] - 1;
+	for (z = 1 ; z < self->size[2] - 1 ; z++)
+	for (y = 1 ; y < self->size[1] - 1 ; y++)
+	for (i = 0 ; i < words ; i++)
+	{
+		r = (y + z * self->size[1]) * words + i;
+		f = self->masks.filled[r];
+		l = self->masks.liquid[r];
+		s = ~l;
+
+		/* Exclude the border tiles. */
+		inner = ~((uint64_t) 0);
+		if (i == 0)
+			inner &= ~((uint64_t) 1);
+		if (i == words - 1)
+			inner &= (((uint64_t) 1) << (last % 64)) - 1;
+		f &= inner;
+		if (!f)
+		{
+			self->masks.visible[r] = 0;
+			continue;
+		}
+
+		/* Shift the neighbor rows along the X axis. */
+		prev[0] = self->masks.solid[r] << 1;
+		prev[1] = self->masks.filled[r] << 1;
+		next[0] = self->masks.solid[r] >> 1;
+		next[1] = self->masks.filled[r] >> 1;
+		if (i > 0)
+		{
+			prev[0] |= self->masks.solid[r - 1] >> 63;
+			prev[1] |= self->masks.filled[r - 1] >> 63;
+		}
+		if (i < words - 1)
+		{
+			next[0] |= self->masks.solid[r + 1] << 63;
+			next[1] |= self->masks.filled[r + 1] << 63;
+		}
+
+		/* Solid tiles are occluded by solid neighbors. Liquid tiles are
+		   occluded by any filled neighbors, except from above where only
+		   liquid occludes them. */
+		hidden[LIVOX_TRIANGULATE_NEGATIVE_X] = (s & prev[0]) | (l & prev[1]);
+		hidden[LIVOX_TRIANGULATE_POSITIVE_X] = (s & next[0]) | (l & next[1]);
+		hidden[LIVOX_TRIANGULATE_NEGATIVE_Y] =
+			(s & self->masks.solid[r - words]) |
+			(l & self->masks.filled[r - words]);
+		hidden[LIVOX_TRIANGULATE_POSITIVE_Y] =
+			(s & self->masks.solid[r + words]) |
+			(l & self->masks.liquid[r + words]);
+		hidden[LIVOX_TRIANGULATE_NEGATIVE_Z] =
+			(s & self->masks.solid[r - words * self->size[1]]) |
+			(l & self->masks.filled[r - words * self->size[1]]);
+		hidden[LIVOX_TRIANGULATE_POSITIVE_Z] =
+			(s & self->masks.solid[r + words * self->size[1]]) |
+			(l & self->masks.filled[r + words * self->size[1]]);
+
+		/* Reject the fully hidden tiles of the whole row at once. */
+		all = hidden[0] & hidden[1] & hidden[2] & hidden[3] & hidden[4] & hidden[5];
+		self->masks.visible[r] = f & ~all;
+
+		/* Store the hidden faces of the remaining tiles. */
+		for (bits = f & ~all, x = 64 * i ; bits ; bits >>= 1, x++)
+		{
+			if (!(bits & 1))
+				continue;
+			voxel = self->voxelsb + x + y * self->step[1] + z * self->step[2];
+			for (d = 0 ; d < 6 ; d++)
+				voxel->hidden |= ((hidden[d] >> (x % 64)) & 1) << d;
+		}
+	}
+}
+
+static void private_merge_faces (
+	LIVoxBuilder* self)
+{
+	int a;
+	int d;
+	int i;
+	int j;
+	int k;
+	int n;
+	int u;
+	int v;
+	int w;
+	int h;
+	int pos[3];
+	int size[2];
+	LIVoxVoxelB* first;
+	LIVoxVoxelB* voxel;
+
+	for (d = 0 ; d < 6 ; d++)
+	{
+		a = d / 2;
+		u = (a + 1) % 3;
+		v = (a + 2) % 3;
+		size[0] = self->size[u] - 2;
+		size[1] = self->size[v] - 2;
+		for (i = 1 ; i < self->size[a] - 1 ; i++)
+		{
+			/* Collect the mergeable faces of the slice. */
+			pos[a] = i;
+			for (k = 0 ; k < size[1] ; k++)
+			for (j = 0 ; j < size[0] ; j++)
+			{
+				pos[u] = j + 1;
+				pos[v] = k + 1;
+				voxel = self->voxelsb + pos[0] + pos[1] * self->step[1] + pos[2] * self->step[2];
+				self->mask[j + k * size[0]] = (voxel->merged & (1 << d))? voxel : NULL;
+			}
+
+			/* Cover them with as large rectangles as possible. */
+			for (k = 0 ; k < size[1] ; k++)
+			for (j = 0 ; j < size[0] ; j++)
+			{
+				first = self->mask[j + k * size[0]];
+				if (first == NULL)
+					continue;
+				for (w = 1 ; j + w < size[0] ; w++)
+				{
+					voxel = self->mask[j + w + k * size[0]];
+					if (voxel == NULL || voxel->material != first->material)
+						break;
+				}
+				for (h = 1 ; k + h < size[1] ; h++)
+				{
+					for (n = 0 ; n < w ; n++)
+					{
+						voxel = self->mask[j + n + (k + h) * size[0]];
+						if (voxel == NULL || voxel->material != first->material)
+							break;
+					}
+					if (n < w)
+						break;
+				}
+				for (n = 0 ; n < h ; n++)
+					memset (self->mask + j + (k + n) * size[0], 0, w * sizeof (LIVoxVoxelB*));
+				private_merge_quad (self, first->material, d, i, j + 1, k + 1, w, h);
+			}
+		}
+	}
+}
+
 static int private_merge_material (
 	LIVoxBuilder*  self,
 	LIMdlMaterial* material)
@@ -219,6 +727,126 @@ static int private_merge_material (
 	return m;
 }
 
+static int private_merge_quad (
+	LIVoxBuilder*  self,
+	LIVoxMaterial* material,
+	int            face,
+	int            slice,
+	int            u,
+	int            v,
+	int            width,
+	int            height)
+{
+	int i;
+	int a;
+	int n;
+	int base;
+	int group;
+	float uv[2];
+	float pos[3];
+	LIMdlIndex indices[3];
+	LIMatVector coord;
+	LIMatVector normal;
+	LIMdlVertex vertex;
+
+	/* Create the model. */
+	if (self->model_builder == NULL)
+	{
+		self->model_builder = limdl_builder_new (NULL);
+		if (self->model_builder == NULL)
+			return 0;
+	}
+
+	/* Find or create material. */
+	group = private_merge_material (self, &material->material);
+	if (group == -1)
+		return 0;
+
+	/* Calculate the vertices. */
+	/* The per-tile faces have vertices at the corners and the midpoints of
+	   the tile edges. The rectangle is a fan around its center with a vertex
+	   at each of those points along the perimeter, so that it shares all
+	   its edge vertices with its neighbors and doesn't form T-junctions. */
+	a = face / 2;
+	n = 4 * (width + height);
+	normal = limat_vector_init (a == 0, a == 1, a == 2);
+	if (!(face & 1))
+		normal = limat_vector_multiply (normal, -1.0f);
+	base = self->model_builder->model->vertices.count;
+	for (i = 0 ; i <= n ; i++)
+	{
+		pos[a] = slice + (face & 1);
+		private_merge_quad_point (i, width, height, pos + (a + 1) % 3, pos + (a + 2) % 3);
+		pos[(a + 1) % 3] += u;
+		pos[(a + 2) % 3] += v;
+		coord = limat_vector_init (
+			(self->offset[0] + pos[0] - 1) * self->tile_width,
+			(self->offset[1] + pos[1] - 1) * self->tile_width,
+			(self->offset[2] + pos[2] - 1) * self->tile_width);
+		private_texcoords (face, material->texture_scale, &coord, uv);
+		limdl_vertex_init (&vertex, &coord, &normal, uv[0], uv[1]);
+		vertex.color[0] = vertex.color[1] = vertex.color[2] = 255;
+		vertex.color[3] = 255;
+		if (!limdl_builder_insert_vertices (self->model_builder, &vertex, 1, NULL))
+		{
+			self->model_builder->model->vertices.count = base;
+			return 0;
+		}
+	}
+
+	/* Append the triangles of the fan. */
+	for (i = 0 ; i < n ; i++)
+	{
+		indices[0] = n;
+		indices[1] = (face & 1)? i : (i + 1) % n;
+		indices[2] = (face & 1)? (i + 1) % n : i;
+		if (!limdl_builder_insert_indices (self->model_builder, 0, group, indices, 3, base))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Gets a point of the merged rectangle. The points go counterclockwise
+   around the perimeter in half tile steps, followed by the center. */
+static void private_merge_quad_point (
+	int    index,
+	int    width,
+	int    height,
+	float* u,
+	float* v)
+{
+	if (index < 2 * width)
+	{
+		*u = 0.5f * index;
+		*v = 0.0f;
+		return;
+	}
+	index -= 2 * width;
+	if (index < 2 * height)
+	{
+		*u = width;
+		*v = 0.5f * index;
+		return;
+	}
+	index -= 2 * height;
+	if (index < 2 * width)
+	{
+		*u = width - 0.5f * index;
+		*v = height;
+		return;
+	}
+	index -= 2 * width;
+	if (index < 2 * height)
+	{
+		*u = 0.0f;
+		*v = height - 0.5f * index;
+		return;
+	}
+	*u = 0.5f * width;
+	*v = 0.5f * height;
+}
+
 static int private_merge_triangles_model (
 	LIVoxBuilder* self,
 	LIVoxVoxelB*  voxel,
@@ -232,10 +860,13 @@ static int private_merge_triangles_model (
 	int x;
 	int y;
 	int z;
+	int base;
 	int xr;
 	int yr;
 	int zr;
 	int group;
+	int vertex;
+	int welded[LIVOX_BUILD_VERTICES_MAX];
 	float ao;
 	float dot;
 	float tmp;
@@ -245,9 +876,26 @@ static int private_merge_triangles_model (
 	LIMatVector diff;
 	LIMatVector coord[3];
 	LIMatVector normal[3];
-	LIMdlVertex vertices[3];
+	LIMdlVertex* vertices;
 	const int regions[4] = { 0, 1, 1, 2 };
 
+	/* Allocate the vertex buffers. */
+	/* This is done only when needed since most blocks are either empty or
+	   fully underground and produce no per-tile geometry. */
+	if (self->vertices == NULL)
+	{
+		self->indices = lisys_malloc (LIVOX_BUILD_VERTICES_MAX * sizeof (LIMdlIndex));
+		self->vertices = lisys_malloc (LIVOX_BUILD_VERTICES_MAX * sizeof (LIMdlVertex));
+		if (self->indices == NULL || self->vertices == NULL)
+		{
+			lisys_free (self->indices);
+			lisys_free (self->vertices);
+			self->indices = NULL;
+			self->vertices = NULL;
+			return 0;
+		}
+	}
+
 	/* Find or create material. */
 	group = private_merge_material (self, &voxel->material->material);
 	if (group == -1)
@@ -256,8 +904,15 @@ static int private_merge_triangles_model (
 	/* Generate normals and texture coordinates. */
 	/* TODO: Smooth normals. */
 	scale = voxel->material->texture_scale;
+	vertex = 0;
 	for (i = 0 ; i < count ; i += 3)
 	{
+		/* Skip faces merged by the greedy mesher. */
+		if (voxel->merged & (1 << faces[i / 3]))
+			continue;
+		vertices = self->vertices + vertex;
+		vertex += 3;
+
 		/* Calculate world coordinates and the triangle normal. */
 		coord[0] = limat_vector_multiply (coords[i + 0], self->tile_width);
 		coord[1] = limat_vector_multiply (coords[i + 1], self->tile_width);
@@ -315,44 +970,29 @@ static int private_merge_triangles_model (
 			ao = LIMAT_CLAMP (ao, 0.0f, 1.0f);
 
 			/* Calculate texture coordinates. */
-			switch (faces[i / 3])
-			{
-				case LIVOX_TRIANGULATE_NEGATIVE_X:
-					uv[0] = scale * coord[j].z;
-					uv[1] = scale * coord[j].y;
-					break;
-				case LIVOX_TRIANGULATE_POSITIVE_X:
-					uv[0] = scale * coord[j].z;
-					uv[1] = scale * coord[j].y;
-					break;
-				case LIVOX_TRIANGULATE_NEGATIVE_Y:
-					uv[0] = scale * coord[j].x;
-					uv[1] = scale * coord[j].z;
-					break;
-				case LIVOX_TRIANGULATE_POSITIVE_Y:
-					uv[0] = -scale * coord[j].x;
-					uv[1] = scale * coord[j].z;
-					break;
-				case LIVOX_TRIANGULATE_NEGATIVE_Z:
-					uv[0] = scale * coord[j].x;
-					uv[1] = scale * coord[j].y;
-					break;
-				case LIVOX_TRIANGULATE_POSITIVE_Z:
-				default:
-					uv[0] = scale * coord[j].x;
-					uv[1] = scale * coord[j].y;
-					break;
-			}
+			private_texcoords (faces[i / 3], scale, coord + j, uv);
 
 			/* Initialize the vertex. */
 			limdl_vertex_init (vertices + j, coord + j, normal + j, uv[0], uv[1]);
 			vertices[j].color[0] = vertices[j].color[1] = vertices[j].color[2] = (int)(255 * (1.0 - ao));
 			vertices[j].color[3] = (int)(255 * splat);
 		}
+	}
 
-		/* Merge vertices. */
-		if (!limdl_builder_insert_face (self->model_builder, 0, group, vertices, NULL))
-			return 0;
+	/* Append the vertices and indices. */
+	/* The vertices are welded so that the triangles of the tile share the
+	   vertices that have identical attributes. */
+	if (!vertex)
+		return 1;
+	base = self->model_builder->model->vertices.count;
+	if (!limdl_builder_insert_vertices_welded (self->model_builder, self->vertices, vertex, welded))
+		return 0;
+	for (i = 0 ; i < vertex ; i++)
+		self->indices[i] = welded[i];
+	if (!limdl_builder_insert_indices (self->model_builder, 0, group, self->indices, vertex, 0))
+	{
+		self->model_builder->model->vertices.count = base;
+		return 0;
 	}
 
 	return 1;
@@ -366,14 +1006,16 @@ static void private_merge_voxel (
 {
 	int count;
 	int types[3][3][3];
-	int faces[200];
-	LIMatVector coords[600];
+	int faces[LIVOX_BUILD_VERTICES_MAX / 3];
+	LIMatVector coords[LIVOX_BUILD_VERTICES_MAX];
 	LIVoxVoxelB* voxel;
 
-	/* Skip empty voxels. */
+	/* Skip empty voxels and voxels built by the greedy mesher. */
 	voxel = self->voxelsb + vx + vy * self->step[1] + vz * self->step[2];
 	if (voxel->voxel == NULL)
 		return;
+	if ((voxel->hidden | voxel->merged) == 0x3F)
+		return;
 
 	/* Generate triangles. */
 	count = livox_triangulate_voxel (self, vx, vy, vz, coords, faces, types);
@@ -387,5 +1029,41 @@ static void private_merge_voxel (
 		private_merge_triangles_model (self, voxel, types, coords, faces, count);
 }
 
+static void private_texcoords (
+	int                face,
+	float              scale,
+	const LIMatVector* coord,
+	float*             result)
+{
+	switch (face)
+	{
+		case LIVOX_TRIANGULATE_NEGATIVE_X:
+			result[0] = scale * coord->z;
+			result[1] = scale * coord->y;
+			break;
+		case LIVOX_TRIANGULATE_POSITIVE_X:
+			result[0] = scale * coord->z;
+			result[1] = scale * coord->y;
+			break;
+		case LIVOX_TRIANGULATE_NEGATIVE_Y:
+			result[0] = scale * coord->x;
+			result[1] = scale * coord->z;
+			break;
+		case LIVOX_TRIANGULATE_POSITIVE_Y:
+			result[0] = -scale * coord->x;
+			result[1] = scale * coord->z;
+			break;
+		case LIVOX_TRIANGULATE_NEGATIVE_Z:
+			result[0] = scale * coord->x;
+			result[1] = scale * coord->y;
+			break;
+		case LIVOX_TRIANGULATE_POSITIVE_Z:
+		default:
+			result[0] = scale * coord->x;
+			result[1] = scale * coord->y;
+			break;
+	}
+}
+
 /** @} */
 /** @} */
@@ -24,6 +24,17 @@
 
 typedef struct _LIVoxBuilder LIVoxBuilder;
 
+enum
+{
+	LIVOX_BUILD_SEAM_NEGATIVE_X = 0x01,
+	LIVOX_BUILD_SEAM_POSITIVE_X = 0x02,
+	LIVOX_BUILD_SEAM_NEGATIVE_Y = 0x04,
+	LIVOX_BUILD_SEAM_POSITIVE_Y = 0x08,
+	LIVOX_BUILD_SEAM_NEGATIVE_Z = 0x10,
+	LIVOX_BUILD_SEAM_POSITIVE_Z = 0x20,
+	LIVOX_BUILD_SEAM_ALL = 0x3F
+};
+
 LIAPICALL (LIVoxBuilder*, livox_builder_new, (
 	LIVoxManager* manager,
 	int           xstart,
@@ -33,6 +44,17 @@ LIAPICALL (LIVoxBuilder*, livox_builder_new, (
 	int           ysize,
 	int           zsize));
 
+LIAPICALL (LIVoxBuilder*, livox_builder_new_lod, (
+	LIVoxManager* manager,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           xsize,
+	int           ysize,
+	int           zsize,
+	int           lod,
+	int           seams));
+
 LIAPICALL (void, livox_builder_free, (
 	LIVoxBuilder* self));
 
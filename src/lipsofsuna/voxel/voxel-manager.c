@@ -22,6 +22,7 @@
  * @{
  */
 
+#include <float.h>
 #include <lipsofsuna/algorithm.h>
 #include "voxel-iterator.h"
 #include "voxel-manager.h"
@@ -30,15 +31,32 @@
 
 #define VOXEL_BORDER_TOLERANCE 0.05f
 
+typedef struct _LIVoxRayCache LIVoxRayCache;
+struct _LIVoxRayCache
+{
+	int index[3];
+	LIVoxSector* sector;
+};
+
 static void private_clear_materials (
 	LIVoxManager* self);
 
+static int private_intersect_ray (
+	LIVoxManager*      self,
+	LIVoxRayCache*     cache,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point,
+	LIMatVector*       result_tile);
+
 static void private_mark_block (
 	LIVoxManager* self,
 	LIVoxSector*  sector,
 	int           x,
 	int           y,
-	int           z);
+	int           z,
+	const int*    min,
+	const int*    max);
 
 static void private_configure (
 	LIVoxManager* self,
@@ -63,6 +81,7 @@ LIVoxManager* livox_manager_new (
 	self = lisys_calloc (1, sizeof (LIVoxManager));
 	if (self == NULL)
 		return NULL;
+	self->greedy = 1;
 	self->callbacks = callbacks;
 	self->sectors = sectors;
 	private_configure (self, 4, 16);
@@ -233,6 +252,162 @@ void livox_manager_copy_voxels (
 	}
 }
 
+/**
+ * \brief Fills the tiles inside a shape.
+ *
+ * The shape is inscribed in the box spanned by the center and the radius
+ * and a tile is considered to be inside the shape if its center is. The
+ * cylinder is aligned along the Y axis. The tiles are modified one sector
+ * at a time with each modified block marked dirty only once.
+ *
+ * \param self Voxel manager.
+ * \param shape Shape type.
+ * \param center Center of the shape in tiles.
+ * \param radius Half extents of the shape in tiles.
+ * \param match Tile type to replace, or -1 to replace all types.
+ * \param value Voxel to fill with.
+ * \return Number of modified tiles.
+ */
+int livox_manager_fill_shape (
+	LIVoxManager*      self,
+	int                shape,
+	const LIMatVector* center,
+	const LIMatVector* radius,
+	int                match,
+	const LIVoxVoxel*  value)
+{
+	int i;
+	int lim;
+	int changed = 0;
+	int min[3];
+	int max[3];
+	int smin[3];
+	int smax[3];
+	int sec[3];
+	int tmin[3];
+	int tmax[3];
+	float c[3];
+	float r[3];
+	LIMatVector ctr;
+	LIVoxSector* sector;
+
+	if (radius->x <= 0.0f || radius->y <= 0.0f || radius->z <= 0.0f)
+		return 0;
+
+	/* Determine the tiles whose centers are inside the bounding box. */
+	lim = self->tiles_per_line * self->sectors->count;
+	c[0] = center->x;
+	c[1] = center->y;
+	c[2] = center->z;
+	r[0] = radius->x;
+	r[1] = radius->y;
+	r[2] = radius->z;
+	for (i = 0 ; i < 3 ; i++)
+	{
+		min[i] = LIMAT_MAX (0, (int) ceilf (c[i] - r[i] - 0.5f));
+		max[i] = LIMAT_MIN (lim - 1, (int) floorf (c[i] + r[i] - 0.5f));
+		if (min[i] > max[i])
+			return 0;
+		smin[i] = min[i] / self->tiles_per_line;
+		smax[i] = max[i] / self->tiles_per_line;
+	}
+
+	/* Fill each affected sector. */
+	for (sec[2] = smin[2] ; sec[2] <= smax[2] ; sec[2]++)
+	for (sec[1] = smin[1] ; sec[1] <= smax[1] ; sec[1]++)
+	for (sec[0] = smin[0] ; sec[0] <= smax[0] ; sec[0]++)
+	{
+		sector = lialg_sectors_data_offset (self->sectors, LIALG_SECTORS_CONTENT_VOXEL, sec[0], sec[1], sec[2], 1);
+		if (sector == NULL)
+			continue;
+		for (i = 0 ; i < 3 ; i++)
+		{
+			tmin[i] = LIMAT_MAX (min[i] - sec[i] * self->tiles_per_line, 0);
+			tmax[i] = LIMAT_MIN (max[i] - sec[i] * self->tiles_per_line, self->tiles_per_line - 1);
+		}
+		ctr = limat_vector_init (
+			c[0] - sec[0] * self->tiles_per_line,
+			c[1] - sec[1] * self->tiles_per_line,
+			c[2] - sec[2] * self->tiles_per_line);
+		changed += livox_sector_fill_shape (sector, shape, tmin, tmax, &ctr, radius, match, value);
+	}
+
+	return changed;
+}
+
+/**
+ * \brief Finds the topmost non-empty tile of each column in a box.
+ *
+ * Sectors that don't exist are treated as empty and aren't created.
+ *
+ * \param self Voxel manager.
+ * \param xstart Start tile.
+ * \param ystart Start tile.
+ * \param zstart Start tile.
+ * \param xsize Number of columns along the X axis.
+ * \param ysize Height of the searched range in tiles.
+ * \param zsize Number of columns along the Z axis.
+ * \param result Buffer of xsize*zsize integers receiving the Y coordinates
+ *   of the topmost non-empty tiles, or -1 for empty columns.
+ */
+void livox_manager_find_heights (
+	LIVoxManager* self,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           xsize,
+	int           ysize,
+	int           zsize,
+	int*          result)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	int lim;
+	int ymin;
+	int ymax;
+	int sec[3];
+	int cache[3] = { -1, -1, -1 };
+	LIVoxSector* sector = NULL;
+
+	lim = self->tiles_per_line * self->sectors->count;
+	ymin = LIMAT_MAX (ystart, 0);
+	ymax = LIMAT_MIN (ystart + ysize, lim) - 1;
+	for (z = zstart, i = 0 ; z < zstart + zsize ; z++)
+	for (x = xstart ; x < xstart + xsize ; x++, i++)
+	{
+		result[i] = -1;
+		if (x < 0 || x >= lim || z < 0 || z >= lim)
+			continue;
+		for (y = ymax ; y >= ymin ; y--)
+		{
+			/* Only look up the sector when the column enters a new one. */
+			sec[0] = x / self->tiles_per_line;
+			sec[1] = y / self->tiles_per_line;
+			sec[2] = z / self->tiles_per_line;
+			if (sec[0] != cache[0] || sec[1] != cache[1] || sec[2] != cache[2])
+			{
+				sector = lialg_sectors_data_offset (self->sectors, LIALG_SECTORS_CONTENT_VOXEL, sec[0], sec[1], sec[2], 0);
+				cache[0] = sec[0];
+				cache[1] = sec[1];
+				cache[2] = sec[2];
+			}
+			if (sector == NULL || livox_sector_get_empty (sector))
+			{
+				y = sec[1] * self->tiles_per_line;
+				continue;
+			}
+			if (livox_sector_get_voxel (sector, x % self->tiles_per_line,
+			    y % self->tiles_per_line, z % self->tiles_per_line)->type)
+			{
+				result[i] = y;
+				break;
+			}
+		}
+	}
+}
+
 /**
  * \brief Finds a material by ID.
  * \param self Voxel manager.
@@ -358,6 +533,12 @@ int livox_manager_insert_material (
 
 /**
  * \brief Finds the intersection with a ray and a tile.
+ *
+ * The ray is traversed one tile at a time with the grid traversal algorithm
+ * of Amanatides and Woo so every tile touched by the ray segment is tested
+ * exactly once. Empty sectors and blocks are skipped without looking at
+ * their tiles.
+ *
  * \param self Voxel manager.
  * \param ray0 Ray start, in tiles.
  * \param ray1 Ray end, in tiles.
@@ -372,63 +553,72 @@ int livox_manager_intersect_ray (
 	LIMatVector*       result_point,
 	LIMatVector*       result_tile)
 {
-#define STEP_SIZE 0.05
-	int p[3];
-	int max;
-	float i;
-	float len;
-	LIMatVector dir;
-	LIMatVector pos;
-	LIVoxVoxel voxel;
-	LIVoxMaterial* material;
+	LIVoxRayCache cache = { { -1, -1, -1 }, NULL };
 
-	max = self->tiles_per_line * self->sectors->count;
+	return private_intersect_ray (self, &cache, ray0, ray1, result_point, result_tile);
+}
 
-	/* Calculate step size. */
-	dir = limat_vector_subtract (*ray1, *ray0);
-	len = limat_vector_get_length (dir);
-	dir = limat_vector_normalize (dir);
-
-	/* Walk through tiles in the path. */
-	/* This can miss tiles in some corner cases but it's good enough for
-	   normal use cases. */
-	for (i = 0.0f ; i <= len + 0.5f * STEP_SIZE ; i += STEP_SIZE)
-	{
-		pos = limat_vector_add (*ray0, limat_vector_multiply (dir, i));
-		p[0] = (int) pos.x;
-		p[1] = (int) pos.y;
-		p[2] = (int) pos.z;
-		if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= max || p[1] >= max || p[2] >= max)
-			continue;
-		livox_manager_get_voxel (self, p[0], p[1], p[2], &voxel);
-		if (!voxel.type)
-			continue;
-		material = livox_manager_find_material (self, voxel.type);
-		if (material == NULL || material->type == LIVOX_MATERIAL_TYPE_LIQUID)
-			continue;
-		*result_point = pos;
-		result_tile->x = (int) pos.x;
-		result_tile->y = (int) pos.y;
-		result_tile->z = (int) pos.z;
-		return 1;
+/**
+ * \brief Finds the intersections of multiple rays with tiles.
+ *
+ * Equivalent to calling #livox_manager_intersect_ray for each ray but the
+ * sector lookups are shared between the rays, which makes checking many
+ * short rays in the same area, such as line of sight tests, cheaper.
+ *
+ * \param self Voxel manager.
+ * \param count Number of rays.
+ * \param rays Array of 2 * count vectors containing the start and end points of the rays, in tiles.
+ * \param result_points Array of count vectors for the intersection points, in tiles.
+ * \param result_tiles Array of count vectors for the intersecting tiles.
+ * \param result_hits Array of count integers set to nonzero for the rays that intersected.
+ * \return Number of rays that intersected.
+ */
+int livox_manager_intersect_rays (
+	LIVoxManager*      self,
+	int                count,
+	const LIMatVector* rays,
+	LIMatVector*       result_points,
+	LIMatVector*       result_tiles,
+	int*               result_hits)
+{
+	int i;
+	int hits = 0;
+	LIVoxRayCache cache = { { -1, -1, -1 }, NULL };
+
+	for (i = 0 ; i < count ; i++)
+	{
+		result_hits[i] = private_intersect_ray (self, &cache, rays + 2 * i, rays + 2 * i + 1,
+			result_points + i, result_tiles + i);
+		hits += result_hits[i];
 	}
 
-	return 0;
-#undef STEP_SIZE
+	return hits;
 }
 
 /**
  * \brief Marks neighbors of dirty sectors for update.
+ *
+ * Only the neighbors that share a face, an edge or a corner with the
+ * modified tiles are marked, and only the tiles next to the modified ones
+ * are marked dirty in them.
+ *
  * \param self Voxel manager.
  */
 void livox_manager_mark_updates (
 	LIVoxManager* self)
 {
+	int a;
 	int i;
 	int j;
+	int m;
 	int x;
 	int y;
 	int z;
+	int off[3];
+	int min[3];
+	int max[3];
+	int nmin[3];
+	int nmax[3];
 	LIAlgSectorsIter iter;
 	LIVoxSector* sector;
 	struct
@@ -469,6 +659,7 @@ void livox_manager_mark_updates (
 	};
 
 	/* Update block boundaries. */
+	m = self->tiles_per_line / self->blocks_per_line;
 	LIALG_SECTORS_FOREACH (iter, self->sectors)
 	{
 		sector = iter.sector->content[LIALG_SECTORS_CONTENT_VOXEL];
@@ -480,14 +671,29 @@ void livox_manager_mark_updates (
 		{
 			if (!(sector->blocks[i].dirty & LIVOX_DIRTY_EXPLICIT))
 				continue;
+			livox_block_get_dirty_box (sector->blocks + i, m, min, max);
 			for (j = 0 ; j < 26 ; j++)
 			{
 				if ((sector->blocks[i].dirty & neighbors[j].mask) != neighbors[j].mask)
 					continue;
-				private_mark_block (self, sector,
-					neighbors[j].x + x,
-					neighbors[j].y + y,
-					neighbors[j].z + z);
+
+				/* Project the dirty box to the shared face, edge or corner. */
+				off[0] = neighbors[j].x;
+				off[1] = neighbors[j].y;
+				off[2] = neighbors[j].z;
+				for (a = 0 ; a < 3 ; a++)
+				{
+					if (off[a] < 0)
+						nmin[a] = nmax[a] = m - 1;
+					else if (off[a] > 0)
+						nmin[a] = nmax[a] = 0;
+					else
+					{
+						nmin[a] = min[a];
+						nmax[a] = max[a];
+					}
+				}
+				private_mark_block (self, sector, off[0] + x, off[1] + y, off[2] + z, nmin, nmax);
 			}
 		}
 	}
@@ -639,6 +845,23 @@ void livox_manager_set_fill (
 	self->fill = type;
 }
 
+/**
+ * \brief Enables or disables greedy meshing.
+ *
+ * When enabled, the visible faces of cube tiles that are lit uniformly are
+ * merged into as large rectangles as possible when building terrain models.
+ * The faces of other tiles are always triangulated per tile.
+ *
+ * \param self Voxel manager.
+ * \param value Nonzero to enable.
+ */
+void livox_manager_set_greedy (
+	LIVoxManager* self,
+	int           value)
+{
+	self->greedy = value;
+}
+
 /**
  * \brief Gets the approximate memory used by the voxel manager.
  * \param self Voxel manager.
@@ -697,6 +920,56 @@ void livox_manager_get_voxel (
 	*value = *livox_sector_get_voxel (sector, sx, sy, sz);
 }
 
+/**
+ * \brief Gets multiple voxels by position.
+ *
+ * Equivalent to calling #livox_manager_get_voxel for each point but the
+ * sector is only looked up again when consecutive points are in different
+ * sectors. Points outside the map are returned as empty voxels.
+ *
+ * \param self Voxel manager.
+ * \param count Number of points.
+ * \param points Array of 3*count tile coordinates.
+ * \param result Return location for count voxels.
+ */
+void livox_manager_get_voxels (
+	LIVoxManager* self,
+	int           count,
+	const int*    points,
+	LIVoxVoxel*   result)
+{
+	int i;
+	int lim;
+	int sec[3];
+	int cache[3] = { -1, -1, -1 };
+	const int* p;
+	LIVoxSector* sector = NULL;
+
+	lim = self->tiles_per_line * self->sectors->count;
+	for (i = 0 ; i < count ; i++)
+	{
+		p = points + 3 * i;
+		livox_voxel_init (result + i, 0);
+		if (p[0] < 0 || p[0] >= lim || p[1] < 0 || p[1] >= lim || p[2] < 0 || p[2] >= lim)
+			continue;
+		sec[0] = p[0] / self->tiles_per_line;
+		sec[1] = p[1] / self->tiles_per_line;
+		sec[2] = p[2] / self->tiles_per_line;
+		if (sec[0] != cache[0] || sec[1] != cache[1] || sec[2] != cache[2])
+		{
+			sector = lialg_sectors_data_offset (self->sectors, LIALG_SECTORS_CONTENT_VOXEL, sec[0], sec[1], sec[2], 1);
+			cache[0] = sec[0];
+			cache[1] = sec[1];
+			cache[2] = sec[2];
+		}
+		if (sector != NULL)
+		{
+			result[i] = *livox_sector_get_voxel (sector, p[0] % self->tiles_per_line,
+				p[1] % self->tiles_per_line, p[2] % self->tiles_per_line);
+		}
+	}
+}
+
 /**
  * \brief Sets a voxel by position.
  * \param self Voxel manager.
@@ -758,16 +1031,209 @@ static void private_configure (
 	self->tile_width = self->sectors->width / self->tiles_per_line;
 }
 
+static int private_intersect_ray (
+	LIVoxManager*      self,
+	LIVoxRayCache*     cache,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point,
+	LIMatVector*       result_tile)
+{
+	int a;
+	int e;
+	int n;
+	int max;
+	int size;
+	int tile[3];
+	int step[3];
+	int local[3];
+	int nexit[3];
+	float t;
+	float t0;
+	float t1;
+	float ta;
+	float tb;
+	float dir[3];
+	float orig[3];
+	float tmax[3];
+	float tdelta[3];
+	float texit[3];
+	LIVoxBlock* block;
+	LIVoxVoxel* voxel;
+	LIVoxMaterial* material;
+
+	max = self->tiles_per_line * self->sectors->count;
+	orig[0] = ray0->x;
+	orig[1] = ray0->y;
+	orig[2] = ray0->z;
+	dir[0] = ray1->x - ray0->x;
+	dir[1] = ray1->y - ray0->y;
+	dir[2] = ray1->z - ray0->z;
+
+	/* Clip the segment to the map. */
+	t0 = 0.0f;
+	t1 = 1.0f;
+	for (a = 0 ; a < 3 ; a++)
+	{
+		if (dir[a] == 0.0f)
+		{
+			if (orig[a] < 0.0f || orig[a] >= max)
+				return 0;
+			continue;
+		}
+		ta = (0.0f - orig[a]) / dir[a];
+		tb = (max - orig[a]) / dir[a];
+		if (ta > tb)
+		{
+			t = ta;
+			ta = tb;
+			tb = t;
+		}
+		if (t0 < ta)
+			t0 = ta;
+		if (t1 > tb)
+			t1 = tb;
+	}
+	if (t0 > t1)
+		return 0;
+
+	/* Initialize the traversal. */
+	for (a = 0 ; a < 3 ; a++)
+	{
+		tile[a] = (int) floorf (orig[a] + dir[a] * t0);
+		tile[a] = LIMAT_CLAMP (tile[a], 0, max - 1);
+		if (dir[a] > 0.0f)
+		{
+			step[a] = 1;
+			tdelta[a] = 1.0f / dir[a];
+			tmax[a] = (tile[a] + 1 - orig[a]) / dir[a];
+		}
+		else if (dir[a] < 0.0f)
+		{
+			step[a] = -1;
+			tdelta[a] = -1.0f / dir[a];
+			tmax[a] = (tile[a] - orig[a]) / dir[a];
+		}
+		else
+		{
+			step[a] = 0;
+			tdelta[a] = FLT_MAX;
+			tmax[a] = FLT_MAX;
+		}
+	}
+	t = t0;
+	e = -1;
+
+	while (1)
+	{
+		/* Find the sector. */
+		if (tile[0] / self->tiles_per_line != cache->index[0] ||
+		    tile[1] / self->tiles_per_line != cache->index[1] ||
+		    tile[2] / self->tiles_per_line != cache->index[2])
+		{
+			for (a = 0 ; a < 3 ; a++)
+				cache->index[a] = tile[a] / self->tiles_per_line;
+			cache->sector = lialg_sectors_data_offset (self->sectors, LIALG_SECTORS_CONTENT_VOXEL,
+				cache->index[0], cache->index[1], cache->index[2], 0);
+		}
+		for (a = 0 ; a < 3 ; a++)
+			local[a] = tile[a] - cache->index[a] * self->tiles_per_line;
+
+		/* Check if the tile, block or sector can be skipped. */
+		size = 1;
+		if (cache->sector == NULL || !cache->sector->solid)
+			size = self->tiles_per_line;
+		else
+		{
+			n = self->tiles_per_line / self->blocks_per_line;
+			block = livox_sector_get_block (cache->sector, local[0] / n, local[1] / n, local[2] / n);
+			if (!block->solid)
+				size = n;
+			else
+			{
+				voxel = livox_sector_get_voxel (cache->sector, local[0], local[1], local[2]);
+				if (voxel->type)
+				{
+					material = livox_manager_find_material (self, voxel->type);
+					if (material != NULL && material->type != LIVOX_MATERIAL_TYPE_LIQUID)
+					{
+						if (e >= 0)
+							t = (tile[e] + (step[e] < 0) - orig[e]) / dir[e];
+						*result_point = limat_vector_add (*ray0, limat_vector_multiply (
+							limat_vector_subtract (*ray1, *ray0), t));
+						*result_tile = limat_vector_init (tile[0], tile[1], tile[2]);
+						return 1;
+					}
+				}
+			}
+		}
+
+		/* Find the axis through which the ray exits the box. For a single tile,
+		   this is the usual step of the traversal. For empty blocks and
+		   sectors, the whole box is crossed at once. */
+		e = 0;
+		for (a = 0 ; a < 3 ; a++)
+		{
+			if (step[a] > 0)
+				nexit[a] = size - local[a] % size;
+			else if (step[a] < 0)
+				nexit[a] = local[a] % size + 1;
+			else
+			{
+				texit[a] = FLT_MAX;
+				continue;
+			}
+			texit[a] = tmax[a] + (nexit[a] - 1) * tdelta[a];
+			if (texit[a] < texit[e])
+				e = a;
+		}
+		if (texit[e] > t1)
+			return 0;
+
+		/* Advance to the first tile outside the box. */
+		t = texit[e];
+		for (a = 0 ; a < 3 ; a++)
+		{
+			if (a == e)
+			{
+				tile[a] += step[a] * nexit[a];
+				tmax[a] = texit[a] + tdelta[a];
+			}
+			else
+			{
+				while (tmax[a] < t)
+				{
+					tile[a] += step[a];
+					tmax[a] += tdelta[a];
+				}
+			}
+			if (tile[a] < 0 || tile[a] >= max)
+				return 0;
+
+			/* Avoid accumulating rounding errors over long skips. */
+			if (size > 1 && step[a])
+				tmax[a] = (tile[a] + (step[a] > 0) - orig[a]) / dir[a];
+		}
+	}
+}
+
 static void private_mark_block (
 	LIVoxManager* self,
 	LIVoxSector*  sector,
 	int           x,
 	int           y,
-	int           z)
+	int           z,
+	const int*    min,
+	const int*    max)
 {
+	int m;
 	int sx;
 	int sy;
 	int sz;
+	int tx;
+	int ty;
+	int tz;
+	int empty;
 	LIVoxBlock* block;
 	LIVoxSector* sector1;
 
@@ -806,12 +1272,31 @@ static void private_mark_block (
 		sz++;
 	}
 
-	/* Mark block as dirty. */
+	/* Find the affected block. */
 	sector1 = lialg_sectors_data_offset (self->sectors, LIALG_SECTORS_CONTENT_VOXEL, sx, sy, sz, 0);
 	if (sector1 == NULL)
 		return;
 	block = livox_sector_get_block (sector1, x, y, z);
-	block->dirty |= LIVOX_DIRTY_PROPAGATED;
+
+	/* Skip the block if it has no filled tiles next to the modified ones. */
+	/* Empty tiles produce no geometry and no hints so the block would be
+	   rebuilt exactly as it was. */
+	if (!block->solid)
+		return;
+	m = self->tiles_per_line / self->blocks_per_line;
+	empty = 1;
+	for (tz = min[2] ; tz <= max[2] && empty ; tz++)
+	for (ty = min[1] ; ty <= max[1] && empty ; ty++)
+	for (tx = min[0] ; tx <= max[0] && empty ; tx++)
+	{
+		if (livox_sector_get_voxel (sector1, x * m + tx, y * m + ty, z * m + tz)->type)
+			empty = 0;
+	}
+	if (empty)
+		return;
+
+	/* Mark the block as dirty. */
+	livox_block_mark_dirty (block, LIVOX_DIRTY_PROPAGATED, min, max);
 	sector1->dirty = 1;
 }
 
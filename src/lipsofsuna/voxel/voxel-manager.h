@@ -43,6 +43,7 @@ struct _LIVoxUpdateEvent
 struct _LIVoxManager
 {
 	int fill;
+	int greedy;
 	int blocks_per_line;
 	int blocks_per_sector;
 	int tiles_per_line;
@@ -82,6 +83,24 @@ LIAPICALL (void, livox_manager_copy_voxels, (
 	int           zsize,
 	LIVoxVoxel*   result));
 
+LIAPICALL (int, livox_manager_fill_shape, (
+	LIVoxManager*      self,
+	int                shape,
+	const LIMatVector* center,
+	const LIMatVector* radius,
+	int                match,
+	const LIVoxVoxel*  value));
+
+LIAPICALL (void, livox_manager_find_heights, (
+	LIVoxManager* self,
+	int           xstart,
+	int           ystart,
+	int           zstart,
+	int           xsize,
+	int           ysize,
+	int           zsize,
+	int*          result));
+
 LIAPICALL (LIVoxMaterial*, livox_manager_find_material, (
 	LIVoxManager* self,
 	uint32_t      id));
@@ -104,6 +123,14 @@ LIAPICALL (int, livox_manager_intersect_ray, (
 	LIMatVector*       result_point,
 	LIMatVector*       result_tile));
 
+LIAPICALL (int, livox_manager_intersect_rays, (
+	LIVoxManager*      self,
+	int                count,
+	const LIMatVector* rays,
+	LIMatVector*       result_points,
+	LIMatVector*       result_tiles,
+	int*               result_hits));
+
 LIAPICALL (void, livox_manager_mark_updates, (
 	LIVoxManager* self));
 
@@ -140,6 +167,10 @@ LIAPICALL (void, livox_manager_set_fill, (
 	LIVoxManager* self,
 	int           fill));
 
+LIAPICALL (void, livox_manager_set_greedy, (
+	LIVoxManager* self,
+	int           value));
+
 LIAPICALL (void, livox_manager_set_load, (
 	LIVoxManager* self,
 	int           value));
@@ -154,6 +185,12 @@ LIAPICALL (void, livox_manager_get_voxel, (
 	int           z,
 	LIVoxVoxel*   value));
 
+LIAPICALL (void, livox_manager_get_voxels, (
+	LIVoxManager* self,
+	int           count,
+	const int*    points,
+	LIVoxVoxel*   result));
+
 LIAPICALL (int, livox_manager_set_voxel, (
 	LIVoxManager*     self,
 	int               x,
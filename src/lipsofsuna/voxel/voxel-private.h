@@ -21,12 +21,16 @@
 struct _LIVoxBlock
 {
 	uint8_t dirty;
+	uint8_t dirty_min[3];
+	uint8_t dirty_max[3];
 	uint16_t stamp;
+	uint16_t solid;
 };
 
 struct _LIVoxSector
 {
 	uint8_t dirty;
+	int solid;
 	LIAlgSector* sector;
 	LIVoxBlock* blocks;
 	LIVoxManager* manager;
@@ -22,6 +22,7 @@
  * @{
  */
 
+#include <zlib.h>
 #include "lipsofsuna/system.h"
 #include "voxel-hinting.h"
 #include "voxel-manager.h"
@@ -30,6 +31,8 @@
 
 #define LIVOX_ERASE_SHIFT (0.25f * LIVOX_TILE_WIDTH)
 #define LIVOX_TILES_PER_SECLINE (LIVOX_TILES_PER_LINE * LIVOX_BLOCKS_PER_LINE)
+#define LIVOX_BLOCK_ENCODING_RAW 0
+#define LIVOX_BLOCK_ENCODING_DEFLATE 1
 
 static int private_build_block (
 	LIVoxSector* self,
@@ -37,6 +40,12 @@ static int private_build_block (
 	int          y,
 	int          z);
 
+static int private_deflate (
+	const char* data,
+	int         length,
+	char*       result,
+	uLongf*     result_length);
+
 static int private_set_voxel (
 	LIVoxSector* self,
 	int          x,
@@ -145,15 +154,152 @@ livox_sector_fill (LIVoxSector* self,
                    LIVoxVoxel*  terrain)
 {
 	int i = 0;
+	int solid;
 
+	solid = terrain->type? self->manager->tiles_per_sector / self->manager->blocks_per_sector : 0;
 	for (i = 0 ; i < self->manager->tiles_per_sector ; i++)
 		self->tiles[i] = *terrain;
 	for (i = 0 ; i < self->manager->blocks_per_sector ; i++)
 	{
-		self->blocks[i].dirty = 0xFF;
+		livox_block_mark_dirty (self->blocks + i, 0xFF, NULL, NULL);
+		self->blocks[i].solid = solid;
 		self->blocks[i].stamp++;
 	}
 	self->dirty = 1;
+	self->solid = solid * self->manager->blocks_per_sector;
+}
+
+/**
+ * \brief Fills the tiles inside a shape.
+ *
+ * The shape is tested against the centers of the tiles in the given range
+ * and the matching tiles are replaced in a single pass. Each modified block
+ * is marked dirty once with a box covering all its changed tiles so large
+ * edits don't pay for dirty marking per tile.
+ *
+ * \param self Sector.
+ * \param shape Shape type.
+ * \param min Minimum tile offset within the sector.
+ * \param max Maximum tile offset within the sector, inclusive.
+ * \param center Center of the shape in tiles relative to the sector.
+ * \param radius Half extents of the shape in tiles.
+ * \param match Tile type to replace, or -1 to replace all types.
+ * \param value Voxel to fill with.
+ * \return Number of modified tiles.
+ */
+int livox_sector_fill_shape (
+	LIVoxSector*       self,
+	int                shape,
+	const int*         min,
+	const int*         max,
+	const LIMatVector* center,
+	const LIMatVector* radius,
+	int                match,
+	const LIVoxVoxel*  value)
+{
+	int i;
+	int m;
+	int x;
+	int y;
+	int z;
+	int flags;
+	int count;
+	int changed = 0;
+	int bmin[3];
+	int bmax[3];
+	int blk[3];
+	int tmin[3];
+	int tmax[3];
+	int cmin[3];
+	int cmax[3];
+	float dx;
+	float dy;
+	float dz;
+	LIVoxBlock* block;
+	LIVoxVoxel* tile;
+
+	m = self->manager->tiles_per_line / self->manager->blocks_per_line;
+	for (i = 0 ; i < 3 ; i++)
+	{
+		bmin[i] = min[i] / m;
+		bmax[i] = max[i] / m;
+	}
+
+	for (blk[2] = bmin[2] ; blk[2] <= bmax[2] ; blk[2]++)
+	for (blk[1] = bmin[1] ; blk[1] <= bmax[1] ; blk[1]++)
+	for (blk[0] = bmin[0] ; blk[0] <= bmax[0] ; blk[0]++)
+	{
+		/* Clip the range to the block. */
+		for (i = 0 ; i < 3 ; i++)
+		{
+			tmin[i] = LIMAT_MAX (min[i], blk[i] * m);
+			tmax[i] = LIMAT_MIN (max[i], blk[i] * m + m - 1);
+			cmin[i] = m;
+			cmax[i] = -1;
+		}
+
+		/* Replace the tiles inside the shape. */
+		count = 0;
+		block = livox_sector_get_block (self, blk[0], blk[1], blk[2]);
+		for (z = tmin[2] ; z <= tmax[2] ; z++)
+		for (y = tmin[1] ; y <= tmax[1] ; y++)
+		{
+			dz = (z + 0.5f - center->z) / radius->z;
+			dy = (y + 0.5f - center->y) / radius->y;
+			tile = self->tiles + tmin[0] + y * self->manager->tiles_per_line +
+				z * self->manager->tiles_per_line * self->manager->tiles_per_line;
+			for (x = tmin[0] ; x <= tmax[0] ; x++, tile++)
+			{
+				if (tile->type == value->type)
+					continue;
+				if (match != -1 && tile->type != match)
+					continue;
+				if (shape != LIVOX_SHAPE_BOX)
+				{
+					dx = (x + 0.5f - center->x) / radius->x;
+					if (shape == LIVOX_SHAPE_SPHERE && dx * dx + dy * dy + dz * dz > 1.0f)
+						continue;
+					if (shape == LIVOX_SHAPE_CYLINDER && dx * dx + dz * dz > 1.0f)
+						continue;
+				}
+				block->solid += (value->type != 0) - (tile->type != 0);
+				self->solid += (value->type != 0) - (tile->type != 0);
+				*tile = *value;
+				cmin[0] = LIMAT_MIN (cmin[0], x - blk[0] * m);
+				cmin[1] = LIMAT_MIN (cmin[1], y - blk[1] * m);
+				cmin[2] = LIMAT_MIN (cmin[2], z - blk[2] * m);
+				cmax[0] = LIMAT_MAX (cmax[0], x - blk[0] * m);
+				cmax[1] = LIMAT_MAX (cmax[1], y - blk[1] * m);
+				cmax[2] = LIMAT_MAX (cmax[2], z - blk[2] * m);
+				count++;
+			}
+		}
+		if (!count)
+			continue;
+
+		/* Mark the block dirty once. */
+		/* The faces and the box are the union of what marking each tile
+		   individually would have produced. */
+		flags = LIVOX_DIRTY_EXPLICIT;
+		if (cmin[0] == 0) flags |= LIVOX_DIRTY_NEGATIVE_X;
+		if (cmax[0] == m - 1) flags |= LIVOX_DIRTY_POSITIVE_X;
+		if (cmin[1] == 0) flags |= LIVOX_DIRTY_NEGATIVE_Y;
+		if (cmax[1] == m - 1) flags |= LIVOX_DIRTY_POSITIVE_Y;
+		if (cmin[2] == 0) flags |= LIVOX_DIRTY_NEGATIVE_Z;
+		if (cmax[2] == m - 1) flags |= LIVOX_DIRTY_POSITIVE_Z;
+		for (i = 0 ; i < 3 ; i++)
+		{
+			cmin[i] = LIMAT_MAX (cmin[i] - 1, 0);
+			cmax[i] = LIMAT_MIN (cmax[i] + 1, m - 1);
+		}
+		livox_block_mark_dirty (block, flags, cmin, cmax);
+		block->stamp++;
+		changed += count;
+	}
+	if (changed)
+		self->dirty = 1;
+
+	return changed;
 }
 
 /**
@@ -192,6 +338,162 @@ int livox_sector_read_block (
 	return 1;
 }
 
+/**
+ * \brief Reads compressed block data from a stream.
+ * \param self Sector.
+ * \param x Block offset.
+ * \param y Block offset.
+ * \param z Block offset.
+ * \param reader Reader.
+ * \return Nonzero on success.
+ */
+int livox_sector_read_block_compressed (
+	LIVoxSector* self,
+	int          x,
+	int          y,
+	int          z,
+	LIArcReader* reader)
+{
+	int c;
+	int ret;
+	char* data;
+	uint8_t method;
+	uint32_t length;
+	uLongf size;
+	LIArcReader* tmp;
+
+	/* Read the header. */
+	if (!liarc_reader_get_uint8 (reader, &method) ||
+	    !liarc_reader_get_uint32 (reader, &length))
+		return 0;
+	if (length > (uint32_t)(reader->length - reader->pos))
+		return 0;
+
+	/* Read uncompressed data directly. */
+	if (method == LIVOX_BLOCK_ENCODING_RAW)
+		return livox_sector_read_block (self, x, y, z, reader);
+	if (method != LIVOX_BLOCK_ENCODING_DEFLATE)
+		return 0;
+
+	/* Decompress. */
+	c = self->manager->tiles_per_line / self->manager->blocks_per_line;
+	size = c * c * c * sizeof (LIVoxVoxel);
+	data = lisys_malloc (size);
+	if (data == NULL)
+		return 0;
+	if (uncompress ((Bytef*) data, &size, (const Bytef*) reader->buffer + reader->pos, length) != Z_OK)
+	{
+		lisys_free (data);
+		return 0;
+	}
+	reader->pos += length;
+
+	/* Read the decompressed data. */
+	tmp = liarc_reader_new (data, size);
+	if (tmp == NULL)
+	{
+		lisys_free (data);
+		return 0;
+	}
+	ret = livox_sector_read_block (self, x, y, z, tmp);
+	liarc_reader_free (tmp);
+	lisys_free (data);
+
+	return ret;
+}
+
+/**
+ * \brief Reads the compressed terrain of the whole sector from a stream.
+ *
+ * The tiles are decompressed straight into the sector and every block is
+ * marked dirty once, which is much faster than pasting the tiles one at a
+ * time when a stored sector is loaded. The reader may point directly to
+ * memory mapped storage since the data is only read.
+ *
+ * \param self Sector.
+ * \param reader Reader.
+ * \return Nonzero on success.
+ */
+int livox_sector_read_compressed (
+	LIVoxSector* self,
+	LIArcReader* reader)
+{
+	int i;
+	int m;
+	int x;
+	int y;
+	int z;
+	int solid;
+	int line;
+	uint8_t method;
+	uint32_t length;
+	uLongf size;
+	uint8_t* data;
+	LIVoxBlock* block;
+	LIVoxVoxel* tile;
+
+	/* Read the header. */
+	if (!liarc_reader_get_uint8 (reader, &method) ||
+	    !liarc_reader_get_uint32 (reader, &length))
+		return 0;
+	if (length > (uint32_t)(reader->length - reader->pos))
+		return 0;
+	if (method != LIVOX_BLOCK_ENCODING_RAW && method != LIVOX_BLOCK_ENCODING_DEFLATE)
+		return 0;
+
+	/* Decompress the tile types. */
+	data = lisys_malloc (self->manager->tiles_per_sector);
+	if (data == NULL)
+		return 0;
+	size = self->manager->tiles_per_sector;
+	if (method == LIVOX_BLOCK_ENCODING_RAW)
+	{
+		if (length != size)
+		{
+			lisys_free (data);
+			return 0;
+		}
+		memcpy (data, reader->buffer + reader->pos, size);
+	}
+	else if (uncompress ((Bytef*) data, &size, (const Bytef*) reader->buffer + reader->pos, length) != Z_OK ||
+	         size != (uLongf) self->manager->tiles_per_sector)
+	{
+		lisys_free (data);
+		return 0;
+	}
+	reader->pos += length;
+
+	/* Replace the tiles. */
+	for (i = 0 ; i < self->manager->tiles_per_sector ; i++)
+		livox_voxel_init (self->tiles + i, data[i]);
+	lisys_free (data);
+
+	/* Recount the solid tiles and mark every block dirty. */
+	self->solid = 0;
+	line = self->manager->tiles_per_line;
+	m = line / self->manager->blocks_per_line;
+	for (i = 0 ; i < self->manager->blocks_per_sector ; i++)
+	{
+		block = self->blocks + i;
+		solid = 0;
+		tile = self->tiles +
+			(i % self->manager->blocks_per_line) * m +
+			(i / self->manager->blocks_per_line % self->manager->blocks_per_line) * m * line +
+			(i / self->manager->blocks_per_line / self->manager->blocks_per_line) * m * line * line;
+		for (z = 0 ; z < m ; z++)
+		for (y = 0 ; y < m ; y++)
+		for (x = 0 ; x < m ; x++)
+			solid += (tile[x + y * line + z * line * line].type != 0);
+		livox_block_mark_dirty (block, 0xFF, NULL, NULL);
+		block->solid = solid;
+		block->stamp++;
+		self->solid += solid;
+	}
+	self->dirty = 1;
+
+	return 1;
+}
+
 /**
  * \brief Called once per tick to update the status of the sector.
  *
@@ -240,6 +542,124 @@ int livox_sector_write_block (
 	return 1;
 }
 
+/**
+ * \brief Writes compressed block data to a stream.
+ *
+ * The block is deflated unless that would make it larger. Uniform blocks,
+ * which are the vast majority, compress to a few bytes.
+ *
+ * \param self Sector.
+ * \param x Block offset.
+ * \param y Block offset.
+ * \param z Block offset.
+ * \param writer Writer.
+ * \return Nonzero on success.
+ */
+int livox_sector_write_block_compressed (
+	LIVoxSector* self,
+	int          x,
+	int          y,
+	int          z,
+	LIArcWriter* writer)
+{
+	int ret;
+	char* data;
+	uLongf size;
+	LIArcWriter* tmp;
+
+	/* Serialize the block. */
+	tmp = liarc_writer_new ();
+	if (tmp == NULL)
+		return 0;
+	if (!livox_sector_write_block (self, x, y, z, tmp))
+	{
+		liarc_writer_free (tmp);
+		return 0;
+	}
+
+	/* Compress the block. */
+	size = compressBound (liarc_writer_get_length (tmp));
+	data = lisys_malloc (size);
+	if (data == NULL)
+	{
+		liarc_writer_free (tmp);
+		return 0;
+	}
+	if (!private_deflate (liarc_writer_get_buffer (tmp), liarc_writer_get_length (tmp), data, &size))
+		size = liarc_writer_get_length (tmp);
+
+	/* Write the smaller of the two. */
+	if (size < (uLongf) liarc_writer_get_length (tmp))
+	{
+		ret = liarc_writer_append_uint8 (writer, LIVOX_BLOCK_ENCODING_DEFLATE) &&
+		      liarc_writer_append_uint32 (writer, size) &&
+		      liarc_writer_append_raw (writer, data, size);
+	}
+	else
+	{
+		ret = liarc_writer_append_uint8 (writer, LIVOX_BLOCK_ENCODING_RAW) &&
+		      liarc_writer_append_uint32 (writer, liarc_writer_get_length (tmp)) &&
+		      liarc_writer_append_raw (writer, liarc_writer_get_buffer (tmp), liarc_writer_get_length (tmp));
+	}
+	lisys_free (data);
+	liarc_writer_free (tmp);
+
+	return ret;
+}
+
+/**
+ * \brief Writes the terrain of the whole sector to a stream compressed.
+ * \param self Sector.
+ * \param writer Writer.
+ * \return Nonzero on success.
+ */
+int livox_sector_write_compressed (
+	LIVoxSector* self,
+	LIArcWriter* writer)
+{
+	int i;
+	int ret;
+	char* data;
+	char* types;
+	uLongf size;
+
+	/* Collect the tile types. */
+	types = lisys_malloc (self->manager->tiles_per_sector);
+	if (types == NULL)
+		return 0;
+	for (i = 0 ; i < self->manager->tiles_per_sector ; i++)
+		types[i] = self->tiles[i].type;
+
+	/* Compress the tile types. */
+	size = compressBound (self->manager->tiles_per_sector);
+	data = lisys_malloc (size);
+	if (data == NULL)
+	{
+		lisys_free (types);
+		return 0;
+	}
+	if (!private_deflate (types, self->manager->tiles_per_sector, data, &size))
+		size = self->manager->tiles_per_sector;
+
+	/* Write the smaller of the two. */
+	if (size < (uLongf) self->manager->tiles_per_sector)
+	{
+		ret = liarc_writer_append_uint8 (writer, LIVOX_BLOCK_ENCODING_DEFLATE) &&
+		      liarc_writer_append_uint32 (writer, size) &&
+		      liarc_writer_append_raw (writer, data, size);
+	}
+	else
+	{
+		ret = liarc_writer_append_uint8 (writer, LIVOX_BLOCK_ENCODING_RAW) &&
+		      liarc_writer_append_uint32 (writer, self->manager->tiles_per_sector) &&
+		      liarc_writer_append_raw (writer, types, self->manager->tiles_per_sector);
+	}
+	lisys_free (data);
+	lisys_free (types);
+
+	return ret;
+}
+
 /**
  * \brief Gets a voxel block.
  *
@@ -319,15 +739,7 @@ livox_sector_set_dirty (LIVoxSector* self,
 int
 livox_sector_get_empty (const LIVoxSector* self)
 {
-	int i;
-
-	for (i = 0 ; i < self->manager->tiles_per_sector ; i++)
-	{
-		if (self->tiles[i].type != 0)
-			return 0;
-	}
-
-	return 1;
+	return !self->solid;
 }
 
 /**
@@ -439,30 +851,45 @@ static int private_build_block (
 	int z1;
 	int blockw;
 	int sectorw;
+	int min[3];
+	int max[3];
+	int size[3];
 	LIVoxUpdateEvent event;
 	LIVoxVoxel* src;
 	LIVoxVoxel* dst;
 	LIVoxVoxel* voxels;
 
-	/* Build triangulation and physics hints. */
+	/* Determine the modified tiles. */
+	/* Only the tiles in the dirty box can have different hints so the
+	   rest of the block is left untouched. */
 	sectorw = self->manager->tiles_per_line;
 	blockw = sectorw / self->manager->blocks_per_line;
+	if (!livox_block_get_dirty_box (livox_sector_get_block (self, x, y, z), blockw, min, max))
+	{
+		min[0] = min[1] = min[2] = 0;
+		max[0] = max[1] = max[2] = blockw - 1;
+	}
+	size[0] = max[0] - min[0] + 1;
+	size[1] = max[1] - min[1] + 1;
+	size[2] = max[2] - min[2] + 1;
+
+	/* Build triangulation and physics hints. */
 	voxels = livox_hinting_process_area (self->manager,
-		sectorw * self->sector->x + blockw * x,
-		sectorw * self->sector->y + blockw * y,
-		sectorw * self->sector->z + blockw * z,
-		blockw, blockw, blockw);
+		sectorw * self->sector->x + blockw * x + min[0],
+		sectorw * self->sector->y + blockw * y + min[1],
+		sectorw * self->sector->z + blockw * z + min[2],
+		size[0], size[1], size[2]);
 	if (voxels != NULL)
 	{
-		for (z1 = 0 ; z1 < blockw ; z1++)
-		for (y1 = 0 ; y1 < blockw ; y1++)
-		for (x1 = 0 ; x1 < blockw ; x1++)
+		for (z1 = 0 ; z1 < size[2] ; z1++)
+		for (y1 = 0 ; y1 < size[1] ; y1++)
+		for (x1 = 0 ; x1 < size[0] ; x1++)
 		{
-			src = voxels + x1 + y1 * blockw + z1 * blockw * blockw;
+			src = voxels + x1 + y1 * size[0] + z1 * size[0] * size[1];
 			dst = self->tiles +
-				(x * blockw + x1) + 
-				(y * blockw + y1) * sectorw + 
-				(z * blockw + z1) * sectorw * sectorw;
+				(x * blockw + min[0] + x1) +
+				(y * blockw + min[1] + y1) * sectorw +
+				(z * blockw + min[2] + z1) * sectorw * sectorw;
 			*dst = *src;
 		}
 		lisys_free (voxels);
@@ -480,6 +907,32 @@ static int private_build_block (
 	return 1;
 }
 
+static int private_deflate (
+	const char* data,
+	int         length,
+	char*       result,
+	uLongf*     result_length)
+{
+	int ret;
+	z_stream stream;
+
+	/* Blocks are tiny so the smallest window and hash table are enough.
+	   The default settings of compress2 spend far more time initializing
+	   the stream than compressing a block. */
+	memset (&stream, 0, sizeof (z_stream));
+	if (deflateInit2 (&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 9, 1, Z_DEFAULT_STRATEGY) != Z_OK)
+		return 0;
+	stream.next_in = (Bytef*) data;
+	stream.avail_in = length;
+	stream.next_out = (Bytef*) result;
+	stream.avail_out = *result_length;
+	ret = deflate (&stream, Z_FINISH);
+	*result_length = stream.total_out;
+	deflateEnd (&stream);
+
+	return ret == Z_STREAM_END;
+}
+
 static int private_set_voxel (
 	LIVoxSector* self,
 	int          x,
@@ -488,6 +941,10 @@ static int private_set_voxel (
 	LIVoxVoxel*  voxel)
 {
 	int m;
+	int flags;
+	int solid;
+	int min[3];
+	int max[3];
 	LIVoxVoxel* tile;
 	LIVoxBlock* block;
 
@@ -496,21 +953,35 @@ static int private_set_voxel (
 		z * self->manager->tiles_per_line * self->manager->tiles_per_line;
 	if (tile->type == voxel->type)
 		return 0;
+	solid = (voxel->type != 0) - (tile->type != 0);
 	*tile = *voxel;
 
-	/* Mark block faces dirty. */
+	/* Update the occupancy counts used for skipping empty space. */
 	m = self->manager->tiles_per_line / self->manager->blocks_per_line;
 	block = livox_sector_get_block (self, x / m, y / m, z / m);
+	block->solid += solid;
+	self->solid += solid;
+
+	/* Mark block faces dirty. */
 	x %= m;
 	y %= m;
 	z %= m;
-	if (x == 0) block->dirty |= LIVOX_DIRTY_NEGATIVE_X;
-	if (x == m - 1) block->dirty |= LIVOX_DIRTY_POSITIVE_X;
-	if (y == 0) block->dirty |= LIVOX_DIRTY_NEGATIVE_Y;
-	if (y == m - 1) block->dirty |= LIVOX_DIRTY_POSITIVE_Y;
-	if (z == 0) block->dirty |= LIVOX_DIRTY_NEGATIVE_Z;
-	if (z == m - 1) block->dirty |= LIVOX_DIRTY_POSITIVE_Z;
-	block->dirty |= LIVOX_DIRTY_EXPLICIT;
+	flags = LIVOX_DIRTY_EXPLICIT;
+	if (x == 0) flags |= LIVOX_DIRTY_NEGATIVE_X;
+	if (x == m - 1) flags |= LIVOX_DIRTY_POSITIVE_X;
+	if (y == 0) flags |= LIVOX_DIRTY_NEGATIVE_Y;
+	if (y == m - 1) flags |= LIVOX_DIRTY_POSITIVE_Y;
+	if (z == 0) flags |= LIVOX_DIRTY_NEGATIVE_Z;
+	if (z == m - 1) flags |= LIVOX_DIRTY_POSITIVE_Z;
+
+	/* Mark the tiles whose hints and geometry depend on the tile dirty. */
+	min[0] = LIMAT_MAX (x - 1, 0);
+	min[1] = LIMAT_MAX (y - 1, 0);
+	min[2] = LIMAT_MAX (z - 1, 0);
+	max[0] = LIMAT_MIN (x + 1, m - 1);
+	max[1] = LIMAT_MIN (y + 1, m - 1);
+	max[2] = LIMAT_MIN (z + 1, m - 1);
+	livox_block_mark_dirty (block, flags, min, max);
 	block->stamp++;
 
 	return 1;
@@ -41,6 +41,16 @@ LIAPICALL (void, livox_sector_fill, (
 	LIVoxSector* self,
 	LIVoxVoxel*  terrain));
 
+LIAPICALL (int, livox_sector_fill_shape, (
+	LIVoxSector*       self,
+	int                shape,
+	const int*         min,
+	const int*         max,
+	const LIMatVector* center,
+	const LIMatVector* radius,
+	int                match,
+	const LIVoxVoxel*  value));
+
 LIAPICALL (int, livox_sector_read_block, (
 	LIVoxSector* self,
 	int          x,
@@ -48,6 +58,17 @@ LIAPICALL (int, livox_sector_read_block, (
 	int          z,
 	LIArcReader* reader));
 
+LIAPICALL (int, livox_sector_read_block_compressed, (
+	LIVoxSector* self,
+	int          x,
+	int          y,
+	int          z,
+	LIArcReader* reader));
+
+LIAPICALL (int, livox_sector_read_compressed, (
+	LIVoxSector* self,
+	LIArcReader* reader));
+
 LIAPICALL (void, livox_sector_update, (
 	LIVoxSector* self,
 	float        secs));
@@ -59,6 +80,17 @@ LIAPICALL (int, livox_sector_write_block, (
 	int          z,
 	LIArcWriter* writer));
 
+LIAPICALL (int, livox_sector_write_block_compressed, (
+	LIVoxSector* self,
+	int          x,
+	int          y,
+	int          z,
+	LIArcWriter* writer));
+
+LIAPICALL (int, livox_sector_write_compressed, (
+	LIVoxSector* self,
+	LIArcWriter* writer));
+
 LIAPICALL (LIVoxBlock*, livox_sector_get_block, (
 	LIVoxSector* self,
 	int          x,
@@ -42,14 +42,6 @@
 #define ISLIQUIDEMPTYROUNDED(x,y,z) (ISLIQUIDEMPTY(x,y,z) || voxels[x][y][z]->material->type == LIVOX_MATERIAL_TYPE_ROUNDED || voxels[x][y][z]->material->type == LIVOX_MATERIAL_TYPE_ROUNDED_FRACTAL)
 #define ISLIQUIDEMPTYSLOPED(x,y,z) (ISLIQUIDEMPTY(x,y,z) || voxels[x][y][z]->material->type == LIVOX_MATERIAL_TYPE_SLOPED || voxels[x][y][z]->material->type == LIVOX_MATERIAL_TYPE_SLOPED_FRACTAL)
 
-#define OCCLUDES(x,y,z) ((liquid && ISFILLED(x,y,z)) || (!liquid && ISSOLID(x,y,z)))
-#define OCCLUDESXNEG(x,y,z) OCCLUDES(x,y,z)
-#define OCCLUDESXPOS(x,y,z) OCCLUDES(x,y,z)
-#define OCCLUDESYNEG(x,y,z) ((liquid && ISFILLED(x,y,z)) || (!liquid && ISSOLID(x,y,z)))
-#define OCCLUDESYPOS(x,y,z) ((liquid && ISLIQUID(x,y,z)) || (!liquid && ISSOLID(x,y,z)))
-#define OCCLUDESZNEG(x,y,z) OCCLUDES(x,y,z)
-#define OCCLUDESZPOS(x,y,z) OCCLUDES(x,y,z)
-
 static inline void private_noise_3d (
 	LIMatVector* vector,
 	LIMatVector* result);
@@ -102,7 +94,6 @@ int livox_triangulate_voxel (
 	int z;
 	int count;
 	int count_faces;
-	int liquid = 0;
 	LIVoxVoxelB* voxel;
 	LIVoxVoxelB* voxels[3][3][3];
 	LIMatVector v[3][3][3] = {
@@ -117,9 +108,8 @@ int livox_triangulate_voxel (
 		 {{ 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.5f }, { 1.0f, 1.0f, 1.0f }}}};
 
 	/* Get the neighborhood. */
-	/* If the neighborhood is full of solid tiles, the centermost one isn't
-	   visible and we can exit early. Liquid tiles don't count towards this. */
-	count = 0;
+	/* Tiles whose all faces are hidden have already been rejected by the
+	   builder so the hidden face flags are the only occlusion test needed. */
 	for (z = -1 ; z <= 1 ; z++)
 	for (y = -1 ; y <= 1 ; y++)
 	for (x = -1 ; x <= 1 ; x++)
@@ -130,16 +120,12 @@ int livox_triangulate_voxel (
 			result_types[x + 1][y + 1][z + 1] = voxel->voxel->type;
 		else
 			result_types[x + 1][y + 1][z + 1] = 0;
-		count += ISSOLID(x + 1, y + 1, z + 1);
 	}
-	if (count == 27)
-		return 0;
 
 	/* Deform the voxel cube. */
 	switch (voxels[1][1][1]->material->type)
 	{
 		case LIVOX_MATERIAL_TYPE_LIQUID:
-			liquid = 1;
 			private_triangulate_liquid (self, voxels, v);
 			break;
 		case LIVOX_MATERIAL_TYPE_ROUNDED:
@@ -161,7 +147,7 @@ int livox_triangulate_voxel (
 	/* Triangulate the deformed cube. */
 	count = 0;
 	count_faces = 0;
-	if (!OCCLUDESXNEG (0, 1, 1))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_NEGATIVE_X)))
 	{
 		for (y = 0 ; y < 2 ; y++)
 		for (z = 0 ; z < 2 ; z++)
@@ -176,7 +162,7 @@ int livox_triangulate_voxel (
 			result_faces[count_faces++] = LIVOX_TRIANGULATE_NEGATIVE_X;
 		}
 	}
-	if (!OCCLUDESXPOS (2, 1, 1))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_POSITIVE_X)))
 	{
 		for (y = 0 ; y < 2 ; y++)
 		for (z = 0 ; z < 2 ; z++)
@@ -191,7 +177,7 @@ int livox_triangulate_voxel (
 			result_faces[count_faces++] = LIVOX_TRIANGULATE_POSITIVE_X;
 		}
 	}
-	if (!OCCLUDESYNEG (1, 0, 1))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_NEGATIVE_Y)))
 	{
 		for (x = 0 ; x < 2 ; x++)
 		for (z = 0 ; z < 2 ; z++)
@@ -206,7 +192,7 @@ int livox_triangulate_voxel (
 			result_faces[count_faces++] = LIVOX_TRIANGULATE_NEGATIVE_Y;
 		}
 	}
-	if (!OCCLUDESYPOS (1, 2, 1))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_POSITIVE_Y)))
 	{
 		for (x = 0 ; x < 2 ; x++)
 		for (z = 0 ; z < 2 ; z++)
@@ -221,7 +207,7 @@ int livox_triangulate_voxel (
 			result_faces[count_faces++] = LIVOX_TRIANGULATE_POSITIVE_Y;
 		}
 	}
-	if (!OCCLUDESZNEG (1, 1, 0))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_NEGATIVE_Z)))
 	{
 		for (x = 0 ; x < 2 ; x++)
 		for (y = 0 ; y < 2 ; y++)
@@ -236,7 +222,7 @@ int livox_triangulate_voxel (
 			result_faces[count_faces++] = LIVOX_TRIANGULATE_NEGATIVE_Z;
 		}
 	}
-	if (!OCCLUDESZPOS (1, 1, 2))
+	if (!(voxels[1][1][1]->hidden & (1 << LIVOX_TRIANGULATE_POSITIVE_Z)))
 	{
 		for (x = 0 ; x < 2 ; x++)
 		for (y = 0 ; y < 2 ; y++)
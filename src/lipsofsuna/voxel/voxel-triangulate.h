@@ -36,6 +36,8 @@ typedef struct _LIVoxVoxelB LIVoxVoxelB;
 struct _LIVoxVoxelB
 {
 	int index;
+	int hidden;
+	int merged;
 	LIMatVector position;
 	LIVoxMaterial* material;
 	LIVoxVoxel* voxel;
@@ -44,6 +46,8 @@ struct _LIVoxVoxelB
 struct _LIVoxBuilder
 {
 	int count;
+	int greedy;
+	int lod;
 	int offset[3];
 	int size[3];
 	int step[3];
@@ -53,6 +57,17 @@ struct _LIVoxBuilder
 	LIVoxManager* manager;
 	LIVoxVoxel* voxels;
 	LIVoxVoxelB* voxelsb;
+	LIVoxVoxelB** mask;
+	LIMdlIndex* indices;
+	LIMdlVertex* vertices;
+	struct
+	{
+		int words;
+		uint64_t* filled;
+		uint64_t* liquid;
+		uint64_t* solid;
+		uint64_t* visible;
+	} masks;
 };
 
 LIAPICALL (int, livox_triangulate_voxel, (
@@ -35,6 +35,13 @@ enum
 	LIVOX_HINT_SLOPE_FACEDOWN = 0x80
 };
 
+enum
+{
+	LIVOX_SHAPE_BOX,
+	LIVOX_SHAPE_CYLINDER,
+	LIVOX_SHAPE_SPHERE
+};
+
 typedef struct _LIVoxVoxel LIVoxVoxel;
 struct _LIVoxVoxel
 {
@@ -22,9 +22,1251 @@
  * @{
  */
 
+#include <sys/time.h>
+#include "voxel-build.h"
 #include "voxel-manager.h"
 #include "voxel-material.h"
+#include "voxel-sector.h"
+#include "voxel-private.h"
 
+#define BENCHMARK_BLOCKS 20
+#define BENCHMARK_DIGS 2000
+#define BENCHMARK_RAYS 20000
+#define BENCHMARK_SHAPES 20
+#define BENCHMARK_SHAPES_SIZE 32
+#define BENCHMARK_SHAPES_START 1024
+#define BENCHMARK_SIZE 64
+#define BENCHMARK_STORAGE 20
+#define BENCHMARK_START 40
+#define BENCHMARK_WORLD 64
+#define BENCHMARK_WORLD_START 256
+
+typedef struct _LIVoxUnittestRebuilds LIVoxUnittestRebuilds;
+struct _LIVoxUnittestRebuilds
+{
+	int count;
+	int blocks[27][3];
+	LIVoxManager* manager;
+};
+
+static int private_block_load (
+	LIVoxUnittestRebuilds* self,
+	LIVoxUpdateEvent*      event);
+
+static double private_build_block (
+	LIVoxManager* manager,
+	int           x,
+	int           y,
+	int           z);
+
+static void private_benchmark_blocks (
+	LIVoxManager* manager);
+
+static void private_benchmark_digging (
+	LIVoxManager* manager);
+
+static void private_benchmark_lod (
+	LIVoxManager* manager);
+
+static void private_benchmark_meshing (
+	LIVoxManager* manager);
+
+static void private_benchmark_rays (
+	LIVoxManager* manager);
+
+static void private_benchmark_shapes (
+	LIVoxManager* manager);
+
+static void private_benchmark_storage (
+	LIVoxManager* manager);
+
+static int private_compare_blocks (
+	LIVoxManager* manager,
+	LIVoxSector*  sector1,
+	LIVoxSector*  sector2,
+	int           x,
+	int           y,
+	int           z);
+
+static int private_count_open_edges (
+	LIMdlModel*   model,
+	float         unit,
+	const int*    min,
+	const int*    max);
+
+static int private_intersect_exact (
+	const LIMatVector* solids,
+	int                count,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point);
+
+static int private_intersect_march (
+	LIVoxManager*      self,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point,
+	LIMatVector*       result_tile);
+
+static int private_lod (
+	int x,
+	int z,
+	int center,
+	int max);
+
+static int private_shape_inside (
+	int          shape,
+	const float* center,
+	const float* radius,
+	int          x,
+	int          y,
+	int          z);
+
+static void private_shape_reset (
+	LIVoxManager* manager,
+	int           xstart);
+
+static double private_time ();
+
+/*****************************************************************************/
+
+static int private_block_load (
+	LIVoxUnittestRebuilds* self,
+	LIVoxUpdateEvent*      event)
+{
+	int i;
+
+	if (self->count == 27)
+		return 1;
+	for (i = 0 ; i < 3 ; i++)
+		self->blocks[self->count][i] = event->sector[i] * self->manager->blocks_per_line + event->block[i];
+	self->count++;
+
+	return 1;
+}
+
+static double private_build_block (
+	LIVoxManager* manager,
+	int           x,
+	int           y,
+	int           z)
+{
+	int i;
+	int w;
+	double sum = 0.0;
+	LIMdlModel* model;
+	LIVoxBuilder* builder;
+
+	/* Build the block like the client would and return a checksum of
+	   the vertices so that the results can be compared. */
+	w = manager->tiles_per_line / manager->blocks_per_line;
+	builder = livox_builder_new (manager, w * x, w * y, w * z, w, w, w);
+	if (builder == NULL)
+		return 0.0;
+	livox_builder_preprocess (builder);
+	livox_builder_build_model (builder, &model);
+	livox_builder_free (builder);
+	if (model == NULL)
+		return 0.0;
+	for (i = 0 ; i < model->vertices.count ; i++)
+	{
+		sum += (i % 7 + 1) * (model->vertices.array[i].coord.x +
+			2.0 * model->vertices.array[i].coord.y +
+			3.0 * model->vertices.array[i].coord.z +
+			model->vertices.array[i].color[0]);
+	}
+	sum += model->vertices.count;
+	limdl_model_free (model);
+
+	return sum;
+}
+
+static void private_benchmark_blocks (
+	LIVoxManager* manager)
+{
+	int i;
+	int j;
+	int x;
+	int y;
+	int z;
+	int mode;
+	int blocks;
+	int errors = 0;
+	int sec[3];
+	int bytes[3];
+	double t[3];
+	LIArcReader* reader;
+	LIArcWriter* client;
+	LIArcWriter* writer;
+	LIVoxSector* copy;
+	LIVoxSector* sector;
+
+	/* Serialize the blocks of the benchmark hills raw and compressed. */
+	/* The last mode encodes each block once and copies it to a packet for
+	   each of 40 clients like the tiles extension does with its cache. */
+	for (mode = 0 ; mode < 3 ; mode++)
+	{
+		blocks = 0;
+		bytes[mode] = 0;
+		t[mode] = private_time ();
+		for (i = 0 ; i < BENCHMARK_BLOCKS ; i++)
+		for (sec[2] = BENCHMARK_WORLD_START / manager->tiles_per_line ; sec[2] < (BENCHMARK_WORLD_START + BENCHMARK_WORLD) / manager->tiles_per_line ; sec[2]++)
+		for (sec[1] = BENCHMARK_WORLD_START / manager->tiles_per_line ; sec[1] < (BENCHMARK_WORLD_START + BENCHMARK_WORLD / 2) / manager->tiles_per_line ; sec[1]++)
+		for (sec[0] = BENCHMARK_WORLD_START / manager->tiles_per_line ; sec[0] < (BENCHMARK_WORLD_START + BENCHMARK_WORLD) / manager->tiles_per_line ; sec[0]++)
+		{
+			sector = lialg_sectors_data_offset (manager->sectors, LIALG_SECTORS_CONTENT_VOXEL, sec[0], sec[1], sec[2], 0);
+			if (sector == NULL)
+				continue;
+			for (z = 0 ; z < manager->blocks_per_line ; z++)
+			for (y = 0 ; y < manager->blocks_per_line ; y++)
+			for (x = 0 ; x < manager->blocks_per_line ; x++)
+			{
+				writer = liarc_writer_new ();
+				if (mode)
+					livox_sector_write_block_compressed (sector, x, y, z, writer);
+				else
+					livox_sector_write_block (sector, x, y, z, writer);
+				bytes[mode] += liarc_writer_get_length (writer);
+				blocks++;
+
+				/* Copy the block to the packets of the clients. */
+				if (mode == 2)
+				{
+					for (j = 0 ; j < 40 ; j++)
+					{
+						client = liarc_writer_new ();
+						liarc_writer_append_uint32 (client, blocks);
+						liarc_writer_append_raw (client, liarc_writer_get_buffer (writer), liarc_writer_get_length (writer));
+						liarc_writer_free (client);
+					}
+				}
+
+				/* Check that the block survives a round trip. */
+				if (mode == 1 && !i)
+				{
+					copy = lialg_sectors_data_offset (manager->sectors, LIALG_SECTORS_CONTENT_VOXEL, sec[0], sec[1] + 8, sec[2], 1);
+					reader = liarc_reader_new (liarc_writer_get_buffer (writer), liarc_writer_get_length (writer));
+					if (copy == NULL || reader == NULL ||
+					    !livox_sector_read_block_compressed (copy, x, y, z, reader) ||
+					    !liarc_reader_check_end (reader))
+						errors++;
+					else
+						errors += private_compare_blocks (manager, sector, copy, x, y, z);
+					if (reader != NULL)
+						liarc_reader_free (reader);
+				}
+				liarc_writer_free (writer);
+			}
+		}
+		t[mode] = private_time () - t[mode];
+	}
+
+	/* Report the cost of replicating a changed block to 40 clients. */
+	/* The raw block used to be serialized for each client whereas the
+	   compressed block is encoded once and then copied to each client. */
+	printf ("Blocks: raw %.1f bytes, %.2f us per block, %.2f us for 40 clients\n",
+		(float) bytes[0] / blocks, 1000000.0 * t[0] / blocks, 40000000.0 * t[0] / blocks);
+	printf ("Blocks: compressed %.1f bytes, %.2f us per block, %.2f us for 40 clients\n",
+		(float) bytes[1] / blocks, 1000000.0 * t[1] / blocks, 1000000.0 * t[2] / blocks);
+	if (errors)
+		printf ("Blocks: FAILED! %d blocks differ after decompression.\n", errors);
+}
+
+static void private_benchmark_digging (
+	LIVoxManager* manager)
+{
+	int i;
+	int j;
+	int k;
+	int m;
+	int x;
+	int y;
+	int z;
+	int old;
+	int face[3][2];
+	int tile[3];
+	int errors = 0;
+	int blocks[2] = { 0, 0 };
+	uint32_t seed = 1;
+	double t[3] = { 0.0, 0.0, 0.0 };
+	double sum[27];
+	LICalHandle handle;
+	LIVoxUnittestRebuilds rebuilds;
+	LIVoxVoxel voxel;
+
+	/* Build the pending changes first. */
+	livox_manager_mark_updates (manager);
+	livox_manager_update_marked (manager);
+	memset (&rebuilds, 0, sizeof (LIVoxUnittestRebuilds));
+	rebuilds.manager = manager;
+	lical_callbacks_insert (manager->callbacks, "block-load", 0, private_block_load, &rebuilds, &handle);
+	m = manager->tiles_per_line / manager->blocks_per_line;
+
+	for (i = 0 ; i < BENCHMARK_DIGS ; i++)
+	{
+		/* Pick a random surface tile of the benchmark hills. */
+		seed = 1103515245 * seed + 12345;
+		tile[0] = BENCHMARK_WORLD_START + 1 + (seed >> 8) % (BENCHMARK_WORLD - 2);
+		seed = 1103515245 * seed + 12345;
+		tile[2] = BENCHMARK_WORLD_START + 1 + (seed >> 8) % (BENCHMARK_WORLD - 2);
+		for (tile[1] = BENCHMARK_WORLD_START + BENCHMARK_WORLD / 2 ; tile[1] > BENCHMARK_WORLD_START ; tile[1]--)
+		{
+			livox_manager_get_voxel (manager, tile[0], tile[1], tile[2], &voxel);
+			if (voxel.type)
+				break;
+		}
+
+		/* The old rules rebuilt every block that touches the dug tile. */
+		for (j = 0 ; j < 3 ; j++)
+		{
+			face[j][0] = (tile[j] % m == 0)? -1 : 0;
+			face[j][1] = (tile[j] % m == m - 1)? 1 : 0;
+		}
+		old = 0;
+		for (z = face[2][0] ; z <= face[2][1] ; z++)
+		for (y = face[1][0] ; y <= face[1][1] ; y++)
+		for (x = face[0][0] ; x <= face[0][1] ; x++)
+		{
+			if (i < BENCHMARK_DIGS / 10)
+				sum[old] = private_build_block (manager, tile[0] / m + x, tile[1] / m + y, tile[2] / m + z);
+			old++;
+		}
+
+		/* Dig the tile and rebuild. */
+		livox_voxel_init (&voxel, 0);
+		livox_manager_set_voxel (manager, tile[0], tile[1], tile[2], &voxel);
+		rebuilds.count = 0;
+		t[0] -= private_time ();
+		livox_manager_mark_updates (manager);
+		livox_manager_update_marked (manager);
+		t[0] += private_time ();
+
+		/* Remesh the blocks the old rules would have rebuilt. */
+		t[1] -= private_time ();
+		for (z = face[2][0] ; z <= face[2][1] ; z++)
+		for (y = face[1][0] ; y <= face[1][1] ; y++)
+		for (x = face[0][0] ; x <= face[0][1] ; x++)
+			private_build_block (manager, tile[0] / m + x, tile[1] / m + y, tile[2] / m + z);
+		t[1] += private_time ();
+		blocks[0] += old;
+
+		/* Remesh the blocks that were actually rebuilt. */
+		t[2] -= private_time ();
+		for (j = 0 ; j < rebuilds.count ; j++)
+			private_build_block (manager, rebuilds.blocks[j][0], rebuilds.blocks[j][1], rebuilds.blocks[j][2]);
+		t[2] += private_time ();
+		blocks[1] += rebuilds.count;
+
+		/* Check that the skipped blocks really didn't change. */
+		if (i >= BENCHMARK_DIGS / 10)
+			continue;
+		k = 0;
+		for (z = face[2][0] ; z <= face[2][1] ; z++)
+		for (y = face[1][0] ; y <= face[1][1] ; y++)
+		for (x = face[0][0] ; x <= face[0][1] ; x++, k++)
+		{
+			for (j = 0 ; j < rebuilds.count ; j++)
+			{
+				if (rebuilds.blocks[j][0] == tile[0] / m + x &&
+				    rebuilds.blocks[j][1] == tile[1] / m + y &&
+				    rebuilds.blocks[j][2] == tile[2] / m + z)
+					break;
+			}
+			if (j == rebuilds.count &&
+			    sum[k] != private_build_block (manager, tile[0] / m + x, tile[1] / m + y, tile[2] / m + z))
+				errors++;
+		}
+	}
+	lical_handle_release (&handle);
+
+	printf ("Dig: face neighbors %.2f blocks, %.3f ms remeshing per dig\n",
+		(float) blocks[0] / BENCHMARK_DIGS, 1000.0 * t[1] / BENCHMARK_DIGS);
+	printf ("Dig: dirty boxes %.2f blocks, %.3f ms remeshing, %.3f ms hinting per dig\n",
+		(float) blocks[1] / BENCHMARK_DIGS, 1000.0 * t[2] / BENCHMARK_DIGS, 1000.0 * t[0] / BENCHMARK_DIGS);
+	if (errors)
+		printf ("Dig: FAILED! %d skipped blocks would have changed.\n", errors);
+}
+
+static int private_compare_blocks (
+	LIVoxManager* manager,
+	LIVoxSector*  sector1,
+	LIVoxSector*  sector2,
+	int           x,
+	int           y,
+	int           z)
+{
+	int c;
+	int tx;
+	int ty;
+	int tz;
+
+	c = manager->tiles_per_line / manager->blocks_per_line;
+	for (tz = c * z ; tz < c * (z + 1) ; tz++)
+	for (ty = c * y ; ty < c * (y + 1) ; ty++)
+	for (tx = c * x ; tx < c * (x + 1) ; tx++)
+	{
+		if (livox_sector_get_voxel (sector1, tx, ty, tz)->type !=
+		    livox_sector_get_voxel (sector2, tx, ty, tz)->type)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Counts the edges that aren't shared by another triangle. The positions are
+   compared in units of the given length. Edges along the sides of the block
+   are ignored since the neighboring blocks continue the surface. */
+static int private_count_open_edges (
+	LIMdlModel*   model,
+	float         unit,
+	const int*    min,
+	const int*    max)
+{
+	int a;
+	int i;
+	int j;
+	int open = 0;
+	int key[6];
+	int reverse[6];
+	LIAlgMemdic* edges;
+	LIAlgMemdicIter iter;
+	LIMatVector v;
+	const LIMdlIndex* indices = model->lod.array[0].indices.array;
+
+	/* Collect the directed edges of the triangles. */
+	edges = lialg_memdic_new ();
+	for (i = 0 ; i < model->lod.array[0].indices.count ; i++)
+	{
+		for (j = 0 ; j < 2 ; j++)
+		{
+			a = (i % 3 == 2 && j)? i - 2 : i + j;
+			v = model->vertices.array[indices[a]].coord;
+			key[3 * j + 0] = (int) lroundf (v.x / unit);
+			key[3 * j + 1] = (int) lroundf (v.y / unit);
+			key[3 * j + 2] = (int) lroundf (v.z / unit);
+		}
+		if (lialg_memdic_find (edges, key, sizeof (key)) == NULL)
+			lialg_memdic_insert (edges, key, sizeof (key), edges);
+	}
+
+	/* Every other edge must be traversed in the opposite direction too. */
+	LIALG_MEMDIC_FOREACH (iter, edges)
+	{
+		memcpy (key, iter.key, sizeof (key));
+		for (a = 0 ; a < 3 ; a++)
+		{
+			if (key[a] == key[3 + a] && (key[a] == min[a] || key[a] == max[a]))
+				break;
+		}
+		if (a < 3)
+			continue;
+		memcpy (reverse, key + 3, 3 * sizeof (int));
+		memcpy (reverse + 3, key, 3 * sizeof (int));
+		if (lialg_memdic_find (edges, reverse, sizeof (reverse)) == NULL)
+			open++;
+	}
+	lialg_memdic_free (edges);
+
+	return open;
+}
+
+static void private_benchmark_lod (
+	LIVoxManager* manager)
+{
+	int a;
+	int x;
+	int y;
+	int z;
+	int d;
+	int w;
+	int lod;
+	int max;
+	int mode;
+	int seams;
+	int blocks[2];
+	int memory[2];
+	int triangles[2];
+	double t[2];
+	LIMdlModel* model;
+	LIVoxBuilder* builder;
+	LIVoxVoxel voxel;
+	const int offsets[6][2] = {{ -1, 0 }, { 1, 0 }, { 0, 0 }, { 0, 0 }, { 0, -1 }, { 0, 1 }};
+
+	/* Build the hills once at full resolution and once with the level of
+	   detail decreasing every two blocks away from a viewer at the center. */
+	w = manager->tiles_per_line / manager->blocks_per_line;
+	for (max = 0 ; (2 << max) <= w ; max++) {}
+	for (mode = 0 ; mode < 2 ; mode++)
+	{
+		blocks[mode] = 0;
+		memory[mode] = 0;
+		triangles[mode] = 0;
+		t[mode] = private_time ();
+		for (z = 0 ; z < BENCHMARK_WORLD ; z += w)
+		for (y = 0 ; y < BENCHMARK_WORLD / 2 ; y += w)
+		for (x = 0 ; x < BENCHMARK_WORLD ; x += w)
+		{
+			/* Choose the level of detail from the distance in blocks. */
+			/* Faces toward finer neighbors get seams. */
+			lod = 0;
+			seams = 0;
+			if (mode)
+			{
+				lod = private_lod (x / w, z / w, BENCHMARK_WORLD / w / 2, max);
+				for (a = 0 ; a < 6 ; a++)
+				{
+					if (private_lod (x / w + offsets[a][0], z / w + offsets[a][1], BENCHMARK_WORLD / w / 2, max) < lod)
+						seams |= 1 << a;
+				}
+			}
+			builder = livox_builder_new_lod (manager, BENCHMARK_WORLD_START + x,
+				BENCHMARK_WORLD_START + y, BENCHMARK_WORLD_START + z, w, w, w, lod, seams);
+			livox_builder_preprocess (builder);
+			livox_builder_build_model (builder, &model);
+			livox_builder_free (builder);
+			if (model == NULL)
+				continue;
+			blocks[mode]++;
+			triangles[mode] += model->lod.array[0].indices.count / 3;
+			memory[mode] += model->vertices.count * sizeof (LIMdlVertex);
+			memory[mode] += model->lod.array[0].indices.count * sizeof (LIMdlIndex);
+			limdl_model_free (model);
+		}
+		t[mode] = private_time () - t[mode];
+	}
+
+	printf ("LOD: full detail %d blocks, %d triangles, %d kB, %.1f ms\n",
+		blocks[0], triangles[0], memory[0] / 1024, 1000.0 * t[0]);
+	printf ("LOD: distance based %d blocks, %d triangles, %d kB, %.1f ms\n",
+		blocks[1], triangles[1], memory[1] / 1024, 1000.0 * t[1]);
+
+	/* Check that seams don't create faces inside solid terrain. */
+	livox_voxel_init (&voxel, 2);
+	for (z = -w ; z < 2 * w ; z++)
+	for (y = -w ; y < 2 * w ; y++)
+	for (x = -w ; x < 2 * w ; x++)
+		livox_manager_set_voxel (manager, 2 * BENCHMARK_WORLD_START + x, BENCHMARK_WORLD_START + y, BENCHMARK_WORLD_START + z, &voxel);
+	builder = livox_builder_new_lod (manager, 2 * BENCHMARK_WORLD_START,
+		BENCHMARK_WORLD_START, BENCHMARK_WORLD_START, w, w, w, max, LIVOX_BUILD_SEAM_ALL);
+	livox_builder_preprocess (builder);
+	livox_builder_build_model (builder, &model);
+	livox_builder_free (builder);
+	if (model != NULL)
+	{
+		printf ("LOD: FAILED! Buried block has %d vertices.\n", model->vertices.count);
+		limdl_model_free (model);
+	}
+
+	/* Check that seams close the gap to a finer surface. */
+	/* The top tile layer is removed so that the surface is in the middle of
+	   a coarse cell. The finer neighbor shows its side there and the coarse
+	   block must cover it with a face pointing toward the neighbor. */
+	livox_voxel_init (&voxel, 0);
+	for (z = -w ; z < 2 * w ; z++)
+	for (x = -w ; x < 2 * w ; x++)
+		livox_manager_set_voxel (manager, 2 * BENCHMARK_WORLD_START + x, BENCHMARK_WORLD_START + w - 1, BENCHMARK_WORLD_START + z, &voxel);
+	for (mode = 0 ; mode < 2 ; mode++)
+	{
+		builder = livox_builder_new_lod (manager, 2 * BENCHMARK_WORLD_START,
+			BENCHMARK_WORLD_START, BENCHMARK_WORLD_START, w, w, w, max, mode? LIVOX_BUILD_SEAM_POSITIVE_X : 0);
+		livox_builder_preprocess (builder);
+		livox_builder_build_model (builder, &model);
+		livox_builder_free (builder);
+		d = 0;
+		if (model != NULL)
+		{
+			for (a = 0 ; a < model->vertices.count ; a++)
+			{
+				if (model->vertices.array[a].normal.x > 0.9f)
+					d++;
+			}
+			limdl_model_free (model);
+		}
+		if (mode && !d)
+			printf ("LOD: FAILED! Seam face missing.\n");
+	}
+}
+
+static void private_benchmark_meshing (
+	LIVoxManager* manager)
+{
+	int i;
+	int j;
+	int x;
+	int y;
+	int z;
+	int h;
+	int w;
+	int mode;
+	int blocks = 0;
+	int min[3];
+	int max[3];
+	int open[2];
+	int triangles[2];
+	int vertices[2];
+	float unit;
+	float area[2];
+	double t[2];
+	LIMatVector v[3];
+	LIMdlModel* model;
+	LIVoxBuilder* builder;
+	LIVoxVoxel voxel;
+
+	/* Generate rolling hills with some sloped tiles on top. */
+	for (z = 0 ; z < BENCHMARK_WORLD ; z++)
+	for (x = 0 ; x < BENCHMARK_WORLD ; x++)
+	{
+		h = 12 + (int)(4.0f * sin (x * 0.2f) + 3.0f * cos (z * 0.15f));
+		for (y = 0 ; y < h ; y++)
+		{
+			if (y == h - 1 && (x / 8 + z / 8) % 3 == 0)
+				livox_voxel_init (&voxel, 1);
+			else
+				livox_voxel_init (&voxel, 2);
+			livox_manager_set_voxel (manager, BENCHMARK_WORLD_START + x,
+				BENCHMARK_WORLD_START + y, BENCHMARK_WORLD_START + z, &voxel);
+		}
+	}
+
+	/* Build every block with and without greedy meshing. The averages
+	   are calculated over the blocks that aren't empty. */
+	w = manager->tiles_per_line / manager->blocks_per_line;
+	for (mode = 0 ; mode < 2 ; mode++)
+	{
+		livox_manager_set_greedy (manager, mode);
+		blocks = 0;
+		area[mode] = 0.0f;
+		open[mode] = 0;
+		triangles[mode] = 0;
+		vertices[mode] = 0;
+		t[mode] = private_time ();
+		for (z = 0 ; z < BENCHMARK_WORLD ; z += w)
+		for (y = 0 ; y < BENCHMARK_WORLD / 2 ; y += w)
+		for (x = 0 ; x < BENCHMARK_WORLD ; x += w)
+		{
+			builder = livox_builder_new (manager, BENCHMARK_WORLD_START + x,
+				BENCHMARK_WORLD_START + y, BENCHMARK_WORLD_START + z, w, w, w);
+			livox_builder_preprocess (builder);
+			livox_builder_build_model (builder, &model);
+			livox_builder_free (builder);
+			if (model == NULL)
+				continue;
+			blocks++;
+			triangles[mode] += model->lod.array[0].indices.count / 3;
+			vertices[mode] += model->vertices.count;
+			for (i = 0 ; i < model->lod.array[0].indices.count ; i += 3)
+			{
+				for (j = 0 ; j < 3 ; j++)
+					v[j] = model->vertices.array[model->lod.array[0].indices.array[i + j]].coord;
+				area[mode] += 0.5f * limat_vector_get_length (limat_vector_cross (
+					limat_vector_subtract (v[1], v[0]), limat_vector_subtract (v[2], v[0])));
+			}
+			limdl_model_free (model);
+		}
+		t[mode] = private_time () - t[mode];
+	}
+
+	/* Check that the triangles share their edges. Merged faces must have
+	   vertices wherever the neighboring tile faces have them. */
+	unit = 0.001f * manager->tile_width;
+	for (mode = 0 ; mode < 2 ; mode++)
+	{
+		livox_manager_set_greedy (manager, mode);
+		for (z = 0 ; z < BENCHMARK_WORLD ; z += w)
+		for (y = 0 ; y < BENCHMARK_WORLD / 2 ; y += w)
+		for (x = 0 ; x < BENCHMARK_WORLD ; x += w)
+		{
+			builder = livox_builder_new (manager, BENCHMARK_WORLD_START + x,
+				BENCHMARK_WORLD_START + y, BENCHMARK_WORLD_START + z, w, w, w);
+			livox_builder_preprocess (builder);
+			livox_builder_build_model (builder, &model);
+			livox_builder_free (builder);
+			if (model == NULL)
+				continue;
+			min[0] = 1000 * (BENCHMARK_WORLD_START + x);
+			min[1] = 1000 * (BENCHMARK_WORLD_START + y);
+			min[2] = 1000 * (BENCHMARK_WORLD_START + z);
+			for (i = 0 ; i < 3 ; i++)
+				max[i] = min[i] + 1000 * w;
+			open[mode] += private_count_open_edges (model, unit, min, max);
+			limdl_model_free (model);
+		}
+	}
+	livox_manager_set_greedy (manager, 1);
+
+	printf ("Meshing: per tile %.1f triangles, %.1f vertices, %.3f ms per block\n",
+		(float) triangles[0] / blocks, (float) vertices[0] / blocks, 1000.0 * t[0] / blocks);
+	printf ("Meshing: greedy %.1f triangles, %.1f vertices, %.3f ms per block\n",
+		(float) triangles[1] / blocks, (float) vertices[1] / blocks, 1000.0 * t[1] / blocks);
+	if (LIMAT_ABS (area[0] - area[1]) > 0.001f * area[0])
+		printf ("Meshing: FAILED! Surface area %f differs from %f.\n", area[1], area[0]);
+	if (open[0] || open[1])
+		printf ("Meshing: FAILED! %d edges aren't shared per tile and %d with merging.\n", open[0], open[1]);
+}
+
+static void private_benchmark_rays (
+	LIVoxManager* manager)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	int count = 0;
+	int hits[3] = { 0, 0, 0 };
+	int wrong[2] = { 0, 0 };
+	int* batch_hits;
+	double t[3];
+	LIAlgRandom random;
+	LIMatVector point;
+	LIMatVector point1;
+	LIMatVector tile;
+	LIMatVector* rays;
+	LIMatVector* solids;
+	LIMatVector* batch_points;
+	LIMatVector* batch_tiles;
+	LIVoxVoxel voxel;
+
+	/* Create sparse terrain with a floor. The terrain has both empty and
+	   populated blocks so that the empty space skipping gets exercised. */
+	lialg_random_init (&random, 1234);
+	solids = lisys_calloc (BENCHMARK_SIZE * BENCHMARK_SIZE * BENCHMARK_SIZE, sizeof (LIMatVector));
+	for (z = 0 ; z < BENCHMARK_SIZE ; z++)
+	for (y = 0 ; y < BENCHMARK_SIZE ; y++)
+	for (x = 0 ; x < BENCHMARK_SIZE ; x++)
+	{
+		if (y > 2 && lialg_random_float (&random) > 0.005f)
+			continue;
+		livox_voxel_init (&voxel, 1);
+		livox_manager_set_voxel (manager, BENCHMARK_START + x, BENCHMARK_START + y, BENCHMARK_START + z, &voxel);
+		solids[count++] = limat_vector_init (BENCHMARK_START + x, BENCHMARK_START + y, BENCHMARK_START + z);
+	}
+
+	/* Create random rays. Some of them start outside of the terrain. */
+	rays = lisys_calloc (2 * BENCHMARK_RAYS, sizeof (LIMatVector));
+	for (i = 0 ; i < 2 * BENCHMARK_RAYS ; i++)
+	{
+		rays[i].x = BENCHMARK_START - 8 + (BENCHMARK_SIZE + 16) * lialg_random_float (&random);
+		rays[i].y = BENCHMARK_START - 8 + (BENCHMARK_SIZE + 16) * lialg_random_float (&random);
+		rays[i].z = BENCHMARK_START - 8 + (BENCHMARK_SIZE + 16) * lialg_random_float (&random);
+	}
+
+	/* Compare the results to the exact solution. */
+	for (i = 0 ; i < BENCHMARK_RAYS ; i++)
+	{
+		if (!private_intersect_exact (solids, count, rays + 2 * i, rays + 2 * i + 1, &point))
+			point.x = -1.0f;
+		else
+			hits[0]++;
+		if (private_intersect_march (manager, rays + 2 * i, rays + 2 * i + 1, &point1, &tile))
+		{
+			if (point.x < 0.0f || limat_vector_get_length (limat_vector_subtract (point, point1)) > 0.1f)
+				wrong[0]++;
+		}
+		else if (point.x >= 0.0f)
+			wrong[0]++;
+		if (livox_manager_intersect_ray (manager, rays + 2 * i, rays + 2 * i + 1, &point1, &tile))
+		{
+			if (point.x < 0.0f || limat_vector_get_length (limat_vector_subtract (point, point1)) > 0.001f)
+				wrong[1]++;
+		}
+		else if (point.x >= 0.0f)
+			wrong[1]++;
+	}
+	printf ("Ray: %d of %d rays hit, %d wrong with marching, %d wrong with traversal\n",
+		hits[0], BENCHMARK_RAYS, wrong[0], wrong[1]);
+	if (wrong[1])
+		printf ("Ray: FAILED! The traversal disagrees with the exact solution.\n");
+
+	/* Measure the throughput. */
+	batch_hits = lisys_calloc (BENCHMARK_RAYS, sizeof (int));
+	batch_points = lisys_calloc (BENCHMARK_RAYS, sizeof (LIMatVector));
+	batch_tiles = lisys_calloc (BENCHMARK_RAYS, sizeof (LIMatVector));
+	t[0] = private_time ();
+	for (i = 0 ; i < BENCHMARK_RAYS ; i++)
+		hits[1] += private_intersect_march (manager, rays + 2 * i, rays + 2 * i + 1, &point, &tile);
+	t[0] = private_time () - t[0];
+	t[1] = private_time ();
+	for (i = 0 ; i < BENCHMARK_RAYS ; i++)
+		hits[2] += livox_manager_intersect_ray (manager, rays + 2 * i, rays + 2 * i + 1, &point, &tile);
+	t[1] = private_time () - t[1];
+	t[2] = private_time ();
+	if (livox_manager_intersect_rays (manager, BENCHMARK_RAYS, rays, batch_points, batch_tiles, batch_hits) != hits[2])
+		printf ("Ray: FAILED! Batched and single ray results differ.\n");
+	t[2] = private_time () - t[2];
+	printf ("Ray: %.2f M/s marching, %.2f M/s traversal, %.2f M/s batched\n",
+		BENCHMARK_RAYS / t[0] / 1000000.0,
+		BENCHMARK_RAYS / t[1] / 1000000.0,
+		BENCHMARK_RAYS / t[2] / 1000000.0);
+
+	lisys_free (batch_hits);
+	lisys_free (batch_points);
+	lisys_free (batch_tiles);
+	lisys_free (rays);
+	lisys_free (solids);
+}
+
+static void private_benchmark_shapes (
+	LIVoxManager* manager)
+{
+	int i;
+	int j;
+	int k;
+	int x;
+	int y;
+	int z;
+	int mode;
+	int count;
+	int errors = 0;
+	int changed[2] = { 0, 0 };
+	int min[3];
+	int max[3];
+	int min1[3];
+	int max1[3];
+	int start[2];
+	int* heights;
+	int* points;
+	double t[4] = { 0.0, 0.0, 0.0, 0.0 };
+	LIMatVector center;
+	LIMatVector radius;
+	LIVoxBlock* block[2];
+	LIVoxSector* sector[2];
+	LIVoxVoxel voxel;
+	LIVoxVoxel voxel1;
+	LIVoxVoxel* voxels;
+	const struct { int shape; float center[3]; float radius[3]; int match; int type; } edits[] =
+	{
+		{ LIVOX_SHAPE_SPHERE, { 16.0f, 12.0f, 16.0f }, { 6.25f, 6.25f, 6.25f }, -1, 0 },
+		{ LIVOX_SHAPE_BOX, { 8.0f, 4.0f, 20.0f }, { 4.0f, 3.0f, 5.0f }, -1, 1 },
+		{ LIVOX_SHAPE_CYLINDER, { 20.5f, 10.0f, 12.0f }, { 3.5f, 8.0f, 3.5f }, 2, 1 },
+		{ LIVOX_SHAPE_SPHERE, { 10.0f, 20.0f, 10.0f }, { 5.0f, 3.0f, 5.0f }, 0, 2 }
+	};
+
+	/* Apply the same edits to two identical regions, one tile at a time
+	   and with the bulk shape fill. The regions are aligned to sectors so
+	   their blocks must end up in the same state. */
+	start[0] = BENCHMARK_SHAPES_START;
+	start[1] = BENCHMARK_SHAPES_START + 2 * BENCHMARK_SHAPES_SIZE;
+	for (i = 0 ; i < BENCHMARK_SHAPES ; i++)
+	for (mode = 0 ; mode < 2 ; mode++)
+	{
+		private_shape_reset (manager, start[mode]);
+		for (j = 0 ; j < (int)(sizeof (edits) / sizeof (*edits)) ; j++)
+		{
+			livox_voxel_init (&voxel, edits[j].type);
+			t[mode] -= private_time ();
+			if (mode)
+			{
+				center = limat_vector_init (start[1] + edits[j].center[0],
+					BENCHMARK_SHAPES_START + edits[j].center[1], BENCHMARK_SHAPES_START + edits[j].center[2]);
+				radius = limat_vector_init (edits[j].radius[0], edits[j].radius[1], edits[j].radius[2]);
+				changed[1] += livox_manager_fill_shape (manager, edits[j].shape, &center, &radius, edits[j].match, &voxel);
+			}
+			else
+			{
+				for (k = 0 ; k < 3 ; k++)
+				{
+					min[k] = (int) ceilf (edits[j].center[k] - edits[j].radius[k] - 0.5f);
+					max[k] = (int) floorf (edits[j].center[k] + edits[j].radius[k] - 0.5f);
+				}
+				for (z = min[2] ; z <= max[2] ; z++)
+				for (y = min[1] ; y <= max[1] ; y++)
+				for (x = min[0] ; x <= max[0] ; x++)
+				{
+					if (!private_shape_inside (edits[j].shape, edits[j].center, edits[j].radius, x, y, z))
+						continue;
+					livox_manager_get_voxel (manager, start[0] + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel1);
+					if (voxel1.type == voxel.type || (edits[j].match != -1 && voxel1.type != edits[j].match))
+						continue;
+					livox_manager_set_voxel (manager, start[0] + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel);
+					changed[0]++;
+				}
+			}
+			t[mode] += private_time ();
+		}
+	}
+
+	/* Compare the tiles and the dirty state of the blocks. */
+	for (z = 0 ; z < BENCHMARK_SHAPES_SIZE ; z++)
+	for (y = 0 ; y < BENCHMARK_SHAPES_SIZE ; y++)
+	for (x = 0 ; x < BENCHMARK_SHAPES_SIZE ; x++)
+	{
+		livox_manager_get_voxel (manager, start[0] + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel);
+		livox_manager_get_voxel (manager, start[1] + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel1);
+		if (voxel.type != voxel1.type)
+			errors++;
+		if (x % manager->tiles_per_line || y % manager->tiles_per_line || z % manager->tiles_per_line)
+			continue;
+		for (k = 0 ; k < 2 ; k++)
+		{
+			sector[k] = lialg_sectors_data_offset (manager->sectors, LIALG_SECTORS_CONTENT_VOXEL,
+				(start[k] + x) / manager->tiles_per_line, (BENCHMARK_SHAPES_START + y) / manager->tiles_per_line,
+				(BENCHMARK_SHAPES_START + z) / manager->tiles_per_line, 0);
+		}
+		if (sector[0]->solid != sector[1]->solid || sector[0]->dirty != sector[1]->dirty)
+			errors++;
+		for (k = 0 ; k < manager->blocks_per_sector ; k++)
+		{
+			block[0] = sector[0]->blocks + k;
+			block[1] = sector[1]->blocks + k;
+			if (block[0]->solid != block[1]->solid ||
+			    livox_block_get_dirty (block[0]) != livox_block_get_dirty (block[1]))
+				errors++;
+			else if (livox_block_get_dirty (block[0]))
+			{
+				livox_block_get_dirty_box (block[0], manager->tiles_per_line / manager->blocks_per_line, min, max);
+				livox_block_get_dirty_box (block[1], manager->tiles_per_line / manager->blocks_per_line, min1, max1);
+				if (memcmp (min, min1, sizeof (min)) || memcmp (max, max1, sizeof (max)))
+					errors++;
+			}
+		}
+	}
+	printf ("Shapes: per tile %.3f ms, bulk %.3f ms per edit, %d tiles changed\n",
+		1000.0 * t[0] / BENCHMARK_SHAPES / (sizeof (edits) / sizeof (*edits)),
+		1000.0 * t[1] / BENCHMARK_SHAPES / (sizeof (edits) / sizeof (*edits)),
+		changed[1] / BENCHMARK_SHAPES);
+	if (errors || changed[0] != changed[1])
+		printf ("Shapes: FAILED! %d differences, %d and %d tiles changed.\n", errors, changed[0], changed[1]);
+
+	/* Compare the column heights to a tile by tile search. */
+	errors = 0;
+	count = BENCHMARK_SHAPES_SIZE * BENCHMARK_SHAPES_SIZE;
+	heights = lisys_calloc (count, sizeof (int));
+	t[2] = private_time ();
+	for (i = 0 ; i < BENCHMARK_SHAPES ; i++)
+	{
+		livox_manager_find_heights (manager, start[1], BENCHMARK_SHAPES_START - BENCHMARK_SHAPES_SIZE,
+			BENCHMARK_SHAPES_START, BENCHMARK_SHAPES_SIZE, 3 * BENCHMARK_SHAPES_SIZE, BENCHMARK_SHAPES_SIZE, heights);
+	}
+	t[2] = private_time () - t[2];
+	for (z = 0 ; z < BENCHMARK_SHAPES_SIZE ; z++)
+	for (x = 0 ; x < BENCHMARK_SHAPES_SIZE ; x++)
+	{
+		for (y = 2 * BENCHMARK_SHAPES_SIZE - 1 ; y >= -BENCHMARK_SHAPES_SIZE ; y--)
+		{
+			livox_manager_get_voxel (manager, start[1] + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel);
+			if (voxel.type)
+				break;
+		}
+		y = (y < -BENCHMARK_SHAPES_SIZE)? -1 : BENCHMARK_SHAPES_START + y;
+		if (heights[x + z * BENCHMARK_SHAPES_SIZE] != y)
+			errors++;
+	}
+	lisys_free (heights);
+
+	/* Compare probing a list of tiles to getting them one at a time. */
+	points = lisys_calloc (3 * count, sizeof (int));
+	voxels = lisys_calloc (count, sizeof (LIVoxVoxel));
+	for (i = 0 ; i < count ; i++)
+	{
+		points[3 * i + 0] = start[1] + i % BENCHMARK_SHAPES_SIZE;
+		points[3 * i + 1] = BENCHMARK_SHAPES_START + (i / 3) % BENCHMARK_SHAPES_SIZE;
+		points[3 * i + 2] = BENCHMARK_SHAPES_START + i / BENCHMARK_SHAPES_SIZE;
+	}
+	t[3] = private_time ();
+	for (i = 0 ; i < BENCHMARK_SHAPES ; i++)
+		livox_manager_get_voxels (manager, count, points, voxels);
+	t[3] = private_time () - t[3];
+	for (i = 0 ; i < count ; i++)
+	{
+		livox_manager_get_voxel (manager, points[3 * i], points[3 * i + 1], points[3 * i + 2], &voxel);
+		if (voxel.type != voxels[i].type)
+			errors++;
+	}
+	lisys_free (points);
+	lisys_free (voxels);
+
+	printf ("Shapes: %.3f us per column height, %.3f us per probed tile\n",
+		1000000.0 * t[2] / BENCHMARK_SHAPES / count, 1000000.0 * t[3] / BENCHMARK_SHAPES / count);
+	if (errors)
+		printf ("Shapes: FAILED! %d heights or probed tiles differ.\n", errors);
+}
+
+static void private_benchmark_storage (
+	LIVoxManager* manager)
+{
+	int i;
+	int j;
+	int size = 0;
+	int errors = 0;
+	int count = 32;
+	int offsets[32][3];
+	double t[2];
+	LIArcReader* reader;
+	LIArcWriter* writers[32];
+	LIVoxSector* sectors[32];
+	LIVoxVoxel* tiles;
+	LIVoxVoxel* result;
+
+	/* Save the sectors edited by the shape benchmark, both as compressed
+	   sectors and as tiles that can be pasted back like region packets. */
+	tiles = lisys_calloc (count * manager->tiles_per_sector, sizeof (LIVoxVoxel));
+	result = lisys_calloc (manager->tiles_per_sector, sizeof (LIVoxVoxel));
+	for (i = 0 ; i < count ; i++)
+	{
+		offsets[i][0] = BENCHMARK_SHAPES_START / manager->tiles_per_line + i % 4;
+		offsets[i][1] = BENCHMARK_SHAPES_START / manager->tiles_per_line + i / 4 % 4 - 2;
+		offsets[i][2] = BENCHMARK_SHAPES_START / manager->tiles_per_line + i / 16;
+		sectors[i] = lialg_sectors_data_offset (manager->sectors, LIALG_SECTORS_CONTENT_VOXEL,
+			offsets[i][0], offsets[i][1], offsets[i][2], 1);
+		livox_manager_copy_voxels (manager, offsets[i][0] * manager->tiles_per_line,
+			offsets[i][1] * manager->tiles_per_line, offsets[i][2] * manager->tiles_per_line,
+			manager->tiles_per_line, manager->tiles_per_line, manager->tiles_per_line,
+			tiles + i * manager->tiles_per_sector);
+		writers[i] = liarc_writer_new ();
+		livox_sector_write_compressed (sectors[i], writers[i]);
+		size += liarc_writer_get_length (writers[i]);
+	}
+
+	/* Load by decompressing directly into the sectors. */
+	t[0] = private_time ();
+	for (j = 0 ; j < BENCHMARK_STORAGE ; j++)
+	for (i = 0 ; i < count ; i++)
+	{
+		reader = liarc_reader_new (liarc_writer_get_buffer (writers[i]), liarc_writer_get_length (writers[i]));
+		if (!livox_sector_read_compressed (sectors[i], reader))
+			errors++;
+		liarc_reader_free (reader);
+	}
+	t[0] = private_time () - t[0];
+	for (i = 0 ; i < count ; i++)
+	{
+		livox_manager_copy_voxels (manager, offsets[i][0] * manager->tiles_per_line,
+			offsets[i][1] * manager->tiles_per_line, offsets[i][2] * manager->tiles_per_line,
+			manager->tiles_per_line, manager->tiles_per_line, manager->tiles_per_line, result);
+		for (j = 0 ; j < manager->tiles_per_sector ; j++)
+		{
+			if (result[j].type != tiles[i * manager->tiles_per_sector + j].type)
+				errors++;
+		}
+	}
+
+	/* Load by pasting tiles. */
+	t[1] = private_time ();
+	for (j = 0 ; j < BENCHMARK_STORAGE ; j++)
+	for (i = 0 ; i < count ; i++)
+	{
+		livox_manager_paste_voxels (manager, offsets[i][0] * manager->tiles_per_line,
+			offsets[i][1] * manager->tiles_per_line, offsets[i][2] * manager->tiles_per_line,
+			manager->tiles_per_line, manager->tiles_per_line, manager->tiles_per_line,
+			tiles + i * manager->tiles_per_sector);
+	}
+	t[1] = private_time () - t[1];
+
+	for (i = 0 ; i < count ; i++)
+		liarc_writer_free (writers[i]);
+	lisys_free (tiles);
+	lisys_free (result);
+	printf ("Storage: compressed %.3f ms, pasted %.3f ms per sector, %d bytes per sector\n",
+		1000.0 * t[0] / BENCHMARK_STORAGE / count, 1000.0 * t[1] / BENCHMARK_STORAGE / count, size / count);
+	if (errors)
+		printf ("Storage: FAILED! %d tiles differ.\n", errors);
+}
+
+static int private_intersect_exact (
+	const LIMatVector* solids,
+	int                count,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point)
+{
+	int a;
+	int i;
+	float t;
+	float t0;
+	float t1;
+	float ta;
+	float tb;
+	float best = 2.0f;
+	float dir[3];
+	float orig[3];
+	float min[3];
+
+	orig[0] = ray0->x;
+	orig[1] = ray0->y;
+	orig[2] = ray0->z;
+	dir[0] = ray1->x - ray0->x;
+	dir[1] = ray1->y - ray0->y;
+	dir[2] = ray1->z - ray0->z;
+
+	/* Clip the segment against the box of each solid tile. */
+	for (i = 0 ; i < count ; i++)
+	{
+		min[0] = solids[i].x;
+		min[1] = solids[i].y;
+		min[2] = solids[i].z;
+		t0 = 0.0f;
+		t1 = 1.0f;
+		for (a = 0 ; a < 3 && t0 <= t1 ; a++)
+		{
+			if (dir[a] == 0.0f)
+			{
+				if (orig[a] < min[a] || orig[a] >= min[a] + 1.0f)
+					t0 = 2.0f;
+				continue;
+			}
+			ta = (min[a] - orig[a]) / dir[a];
+			tb = (min[a] + 1.0f - orig[a]) / dir[a];
+			if (ta > tb)
+			{
+				t = ta;
+				ta = tb;
+				tb = t;
+			}
+			if (t0 < ta)
+				t0 = ta;
+			if (t1 > tb)
+				t1 = tb;
+		}
+		if (t0 <= t1 && t0 < best)
+			best = t0;
+	}
+	if (best > 1.0f)
+		return 0;
+	*result_point = limat_vector_add (*ray0, limat_vector_multiply (
+		limat_vector_subtract (*ray1, *ray0), best));
+
+	return 1;
+}
+
+/* The fixed step ray marcher that preceded the grid traversal. */
+static int private_intersect_march (
+	LIVoxManager*      self,
+	const LIMatVector* ray0,
+	const LIMatVector* ray1,
+	LIMatVector*       result_point,
+	LIMatVector*       result_tile)
+{
+#define STEP_SIZE 0.05
+	int p[3];
+	int max;
+	float i;
+	float len;
+	LIMatVector dir;
+	LIMatVector pos;
+	LIVoxVoxel voxel;
+	LIVoxMaterial* material;
+
+	max = self->tiles_per_line * self->sectors->count;
+	dir = limat_vector_subtract (*ray1, *ray0);
+	len = limat_vector_get_length (dir);
+	dir = limat_vector_normalize (dir);
+	for (i = 0.0f ; i <= len + 0.5f * STEP_SIZE ; i += STEP_SIZE)
+	{
+		pos = limat_vector_add (*ray0, limat_vector_multiply (dir, i));
+		p[0] = (int) pos.x;
+		p[1] = (int) pos.y;
+		p[2] = (int) pos.z;
+		if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= max || p[1] >= max || p[2] >= max)
+			continue;
+		livox_manager_get_voxel (self, p[0], p[1], p[2], &voxel);
+		if (!voxel.type)
+			continue;
+		material = livox_manager_find_material (self, voxel.type);
+		if (material == NULL || material->type == LIVOX_MATERIAL_TYPE_LIQUID)
+			continue;
+		*result_point = pos;
+		result_tile->x = (int) pos.x;
+		result_tile->y = (int) pos.y;
+		result_tile->z = (int) pos.z;
+		return 1;
+	}
+
+	return 0;
+#undef STEP_SIZE
+}
+
+static int private_lod (
+	int x,
+	int z,
+	int center,
+	int max)
+{
+	int d;
+
+	d = LIMAT_MAX (LIMAT_ABS (x - center), LIMAT_ABS (z - center));
+
+	return LIMAT_MIN (d / 2, max);
+}
+
+static int private_shape_inside (
+	int          shape,
+	const float* center,
+	const float* radius,
+	int          x,
+	int          y,
+	int          z)
+{
+	float dx;
+	float dy;
+	float dz;
+
+	dx = (x + 0.5f - center[0]) / radius[0];
+	dy = (y + 0.5f - center[1]) / radius[1];
+	dz = (z + 0.5f - center[2]) / radius[2];
+	if (shape == LIVOX_SHAPE_SPHERE)
+		return dx * dx + dy * dy + dz * dz <= 1.0f;
+	if (shape == LIVOX_SHAPE_CYLINDER)
+		return dx * dx + dz * dz <= 1.0f;
+
+	return 1;
+}
+
+static void private_shape_reset (
+	LIVoxManager* manager,
+	int           xstart)
+{
+	int i;
+	int x;
+	int y;
+	int z;
+	LIVoxSector* sector;
+	LIVoxVoxel voxel;
+
+	/* Create uneven ground. */
+	for (z = 0 ; z < BENCHMARK_SHAPES_SIZE ; z++)
+	for (y = 0 ; y < BENCHMARK_SHAPES_SIZE ; y++)
+	for (x = 0 ; x < BENCHMARK_SHAPES_SIZE ; x++)
+	{
+		livox_voxel_init (&voxel, (y < 10 + (7 * x + 3 * z) % 5)? 2 : 0);
+		livox_manager_set_voxel (manager, xstart + x, BENCHMARK_SHAPES_START + y, BENCHMARK_SHAPES_START + z, &voxel);
+	}
+
+	/* Clear the dirty flags so that only the edits are compared. */
+	for (z = 0 ; z < BENCHMARK_SHAPES_SIZE ; z += manager->tiles_per_line)
+	for (y = 0 ; y < BENCHMARK_SHAPES_SIZE ; y += manager->tiles_per_line)
+	for (x = 0 ; x < BENCHMARK_SHAPES_SIZE ; x += manager->tiles_per_line)
+	{
+		sector = lialg_sectors_data_offset (manager->sectors, LIALG_SECTORS_CONTENT_VOXEL,
+			(xstart + x) / manager->tiles_per_line, (BENCHMARK_SHAPES_START + y) / manager->tiles_per_line,
+			(BENCHMARK_SHAPES_START + z) / manager->tiles_per_line, 0);
+		livox_sector_set_dirty (sector, 0);
+		for (i = 0 ; i < manager->blocks_per_sector ; i++)
+			livox_block_set_dirty (sector->blocks + i, 0);
+	}
+}
+
+static double private_time ()
+{
+	struct timeval t;
+
+	gettimeofday (&t, NULL);
+	return t.tv_sec + t.tv_usec * 0.000001;
+}
+
+/*****************************************************************************/
+
+/**
+ * \brief Runs the voxel unit tests and benchmarks.
+ *
+ * Terrain meshing is benchmarked with and without greedy meshing, and
+ * with distance based level of detail. Block compression is checked and
+ * compared to raw block serialization. Digging single tiles is benchmarked
+ * against rebuilding all the blocks that touch the tile, and the skipped
+ * blocks are checked to be unchanged. Ray casts are checked against an
+ * exact brute force solution and their throughput is compared to the old
+ * ray marcher. Loading compressed sectors is checked and compared to
+ * pasting tiles. After that, the terrain rebuilding is benchmarked.
+ */
 void livox_unittest (
 	LIVoxVoxel* self,
 	int         type)
@@ -44,6 +1286,28 @@ void livox_unittest (
 	material->type = LIVOX_MATERIAL_TYPE_SLOPED;
 	livox_manager_insert_material (manager, material);
 
+	/* Meshing benchmarking. */
+	material = livox_material_new ();
+	material->id = 2;
+	material->type = LIVOX_MATERIAL_TYPE_CUBE;
+	livox_manager_insert_material (manager, material);
+	printf ("Benchmarking terrain meshing.\n");
+	private_benchmark_meshing (manager);
+	printf ("Benchmarking terrain level of detail.\n");
+	private_benchmark_lod (manager);
+	printf ("Benchmarking block replication.\n");
+	private_benchmark_blocks (manager);
+	printf ("Benchmarking digging.\n");
+	private_benchmark_digging (manager);
+
+	/* Ray cast benchmarking. */
+	printf ("Benchmarking ray casts.\n");
+	private_benchmark_rays (manager);
+	printf ("Benchmarking shape edits.\n");
+	private_benchmark_shapes (manager);
+	printf ("Benchmarking sector storage.\n");
+	private_benchmark_storage (manager);
+
 	/* Rebuild benchmarking. */
 	printf ("Benchmarking terrain rebuilding.\n");
 	livox_voxel_init (&voxel, 1);
@@ -22,65 +22,202 @@
 
 #include "lipsofsuna/model.h"
 #include "lipsofsuna/system.h"
+#include "lipsofsuna/system/system-batch.h"
 
-int main (int argc, char** argv)
+static void private_usage (
+	const char* name)
 {
-	int i;
+	printf ("Usage: %s [OPTION] [lmdl|directory...]\n\n", name);
+	printf (" -b        Also write the models in the baked binary format to .blmdl files.\n");
+	printf (" -c FILE   Skip models unchanged since listed in the cache file.\n");
+	printf (" -h        Print this help message.\n");
+	printf (" -j NUM    Number of worker threads. [default: number of CPUs]\n");
+	printf (" -m FILE   Read model and directory paths from a manifest.\n");
+}
+
+static char* private_get_baked (
+	const char* path)
+{
+	/* The baked format depends on the native structure layout so it's
+	   written next to the portable model instead of replacing it. */
+	if (lisys_path_check_ext (path, "lmdl"))
+		return lisys_string_format ("%.*sblmdl", (int) strlen (path) - 4, path);
+	else
+		return lisys_string_format ("%s.blmdl", path);
+}
+
+static int private_check (
+	LISysBatch* batch,
+	const char* path,
+	void*       data)
+{
+	int ret;
+	int* bake = data;
+	char* dst;
+
+	/* The cache doesn't know whether the model was baked when it was
+	   recorded, so the baked model must exist for the input to be skipped. */
+	if (!*bake)
+		return 1;
+	dst = private_get_baked (path);
+	if (dst == NULL)
+		return 0;
+	ret = lisys_filesystem_access (dst, LISYS_ACCESS_EXISTS);
+	lisys_free (dst);
+
+	return ret;
+}
+
+static int private_save (
+	LIMdlModel* model,
+	const char* path,
+	int         bake)
+{
+	int ret;
+	char* dst;
+	char* tmp;
+
+	if (bake)
+		dst = private_get_baked (path);
+	else
+		dst = lisys_string_dup (path);
+	if (dst == NULL)
+		return 0;
+
+	/* The model is written to a temporary file first so that an interrupted
+	   run never leaves a truncated model behind. */
+	tmp = lisys_string_format ("%s.tmp", dst);
+	if (tmp == NULL)
+	{
+		lisys_free (dst);
+		return 0;
+	}
+	if (bake)
+		ret = limdl_model_write_file_baked (model, tmp);
+	else
+		ret = limdl_model_write_file (model, tmp);
+	if (ret)
+		ret = lisys_batch_replace_file (tmp, dst);
+	else
+		remove (tmp);
+	lisys_free (tmp);
+	lisys_free (dst);
+
+	return ret;
+}
+
+static int private_build (
+	LISysBatch* batch,
+	const char* path,
+	void*       data)
+{
+	int ret;
+	int* bake = data;
 	LIMdlBuilder* builder;
 	LIMdlModel* model;
 
-	if (!argc || !strcmp (argv[1], "--help") || !strcmp (argv[1], "-h"))
+	/* Load the model. */
+	model = limdl_model_new_from_file (path, 1);
+	if (model == NULL)
+		return 0;
+
+	/* Check for existing LOD. */
+	if (!model->lod.array[0].indices.count)
+	{
+		printf ("      Unneeded %s\n", path);
+		ret = !*bake || private_save (model, path, 1);
+		limdl_model_free (model);
+		return ret;
+	}
+	if (model->lod.count > 1)
+	{
+		printf ("%3d%%: Existing %s\n", 100 - 100 *
+			model->lod.array[model->lod.count - 1].indices.count /
+			model->lod.array[0].indices.count, path);
+		ret = !*bake || private_save (model, path, 1);
+		limdl_model_free (model);
+		return ret;
+	}
+
+	/* Build the detail levels. */
+	builder = limdl_builder_new (model);
+	if (builder == NULL)
 	{
-		printf ("Usage: %s [lmdl...]\n", argv[0]);
+		limdl_model_free (model);
 		return 0;
 	}
+	limdl_builder_calculate_lod (builder, 5, 0.05f);
+	limdl_builder_finish (builder);
+	limdl_builder_free (builder);
 
-	for (i = 1 ; i < argc ; i++)
+	/* Save the modified model. */
+	ret = private_save (model, path, 0);
+	if (ret && *bake)
+		ret = private_save (model, path, 1);
+	if (ret)
 	{
-		/* Load the model. */
-		model = limdl_model_new_from_file (argv[i], 1);
-		if (model == NULL)
-		{
-			lisys_error_report ();
-			continue;
-		}
+		printf ("%3d%%: Built    %s\n", 100 - 100 *
+			model->lod.array[model->lod.count - 1].indices.count /
+			model->lod.array[0].indices.count, path);
+	}
+	limdl_model_free (model);
 
-		/* Check for existing LOD. */
-		if (!model->lod.array[0].indices.count)
-		{
-			printf ("      Unneeded %s\n", argv[i]);
-			continue;
-		}
-		if (model->lod.count > 1)
-		{
-			printf ("%3d%%: Existing %s\n", 100 - 100 *
-				model->lod.array[model->lod.count - 1].indices.count /
-				model->lod.array[0].indices.count, argv[i]);
-			limdl_model_free (model);
-			continue;
-		}
+	return ret;
+}
+
+int main (int argc, char** argv)
+{
+	int i;
+	int ret;
+	int bake = 0;
+	int threads = 0;
+	const char* cache = NULL;
+	LISysBatch* batch;
 
-		/* Build the detail levels. */
-		builder = limdl_builder_new (model);
-		if (builder == NULL)
+	if (argc < 2 || !strcmp (argv[1], "--help") || !strcmp (argv[1], "-h"))
+	{
+		private_usage (argv[0]);
+		return 0;
+	}
+
+	batch = lisys_batch_new (private_build, &bake);
+	if (batch == NULL)
+	{
+		lisys_error_report ();
+		return 1;
+	}
+	lisys_batch_set_check (batch, private_check);
+
+	/* Collect the models. */
+	for (i = 1 ; i < argc ; i++)
+	{
+		if (!strcmp (argv[i], "-b"))
+			bake = 1;
+		else if (!strcmp (argv[i], "-c") && i + 1 < argc)
+			cache = argv[++i];
+		else if (!strcmp (argv[i], "-j") && i + 1 < argc)
+			threads = atoi (argv[++i]);
+		else if (!strcmp (argv[i], "-m") && i + 1 < argc)
 		{
-			lisys_error_report ();
-			limdl_model_free (model);
-			continue;
+			if (!lisys_batch_add_manifest (batch, argv[++i], "lmdl"))
+				lisys_error_report ();
 		}
-		limdl_builder_calculate_lod (builder, 5, 0.05f);
-		limdl_builder_finish (builder);
-		limdl_builder_free (builder);
+		else if (!lisys_batch_add_path (batch, argv[i], "lmdl"))
+			lisys_error_report ();
+	}
 
-		/* Save the modified model. */
-		printf ("%3d%%: Built    %s\n", 100 - 100 *
-			model->lod.array[model->lod.count - 1].indices.count /
-			model->lod.array[0].indices.count, argv[i]);
-		limdl_model_write_file (model, argv[i]);
-		limdl_model_free (model);
+	/* Build the detail levels. */
+	if (cache != NULL && !lisys_batch_load_cache (batch, cache))
+		lisys_error_report ();
+	ret = lisys_batch_run (batch, threads);
+	if (cache != NULL && !lisys_batch_save_cache (batch, cache))
+	{
+		lisys_error_report ();
+		ret = 0;
 	}
+	lisys_batch_free (batch);
 
-	return 0;
+	return !ret;
 }
 
 /** @} */